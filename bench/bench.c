@@ -0,0 +1,353 @@
+/**
+ * Benchmark suite
+ *
+ * This program runs a fixed set of canonical workloads, each at several
+ * particle numbers, and reports the throughput and accuracy of every run
+ * as JSON. The initial conditions use a fixed random seed so that results
+ * can be compared across versions and machines.
+ *
+ * Usage: ./rebound_bench [-s scale] [-o filename] [workload ...]
+ *
+ * The scale factor multiplies the integration time of every run (default 1).
+ * If workload names (or parts thereof) are given, only matching workloads
+ * are run. The JSON output is written to stdout unless a filename is given.
+ * Progress is printed to stderr.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#ifdef OPENMP
+#include <omp.h>
+#endif // OPENMP
+#include "rebound.h"
+
+#define BENCH_SEED 1
+
+struct bench_run {
+    int N;                      // Number of particles (including the central object if any)
+    double tmax;                // Integration time (multiplied by the scale factor)
+};
+
+struct bench_workload {
+    const char* name;
+    const char* integrator;
+    const char* gravity;
+    const char* collision;
+    struct reb_simulation* (*setup)(int N);
+    int energy;                 // 1 if the energy error is meaningful for this workload
+    struct bench_run runs[3];   // Runs with N=0 are skipped
+};
+
+// Particle-steps are accumulated in the heartbeat because N may change during a run.
+static unsigned long long bench_steps_last;
+static double bench_particle_steps;
+
+static void bench_heartbeat(struct reb_simulation* const r){
+    if (r->steps_done!=bench_steps_last){
+        bench_particle_steps += (double)(r->steps_done-bench_steps_last)*(double)(r->N-r->N_var);
+        bench_steps_last = r->steps_done;
+    }
+}
+
+static double bench_clock(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static struct reb_simulation* bench_create_simulation(void){
+    struct reb_simulation* r = reb_create_simulation();
+    r->rand_seed = BENCH_SEED;
+    r->heartbeat = bench_heartbeat;
+    r->exact_finish_time = 0;
+    return r;
+}
+
+// Outer solar system (Applegate et al 1986) plus N-6 test particles in the Kuiper belt.
+static struct reb_simulation* setup_whfast_outer_solar_system(int N){
+    const double ss_pos[6][3] = {
+        {-4.06428567034226e-3, -6.08813756435987e-3, -1.66162304225834e-6}, // Sun
+        {+3.40546614227466e+0, +3.62978190075864e+0, +3.42386261766577e-2}, // Jupiter
+        {+6.60801554403466e+0, +6.38084674585064e+0, -1.36145963724542e-1}, // Saturn
+        {+1.11636331405597e+1, +1.60373479057256e+1, +3.61783279369958e-1}, // Uranus
+        {-3.01777243405203e+1, +1.91155314998064e+0, -1.53887595621042e-1}, // Neptune
+        {-2.13858977531573e+1, +3.20719104739886e+1, +2.49245689556096e+0}  // Pluto
+    };
+    const double ss_vel[6][3] = {
+        {+6.69048890636161e-6, -6.33922479583593e-6, -3.13202145590767e-9}, // Sun
+        {-5.59797969310664e-3, +5.51815399480116e-3, -2.66711392865591e-6}, // Jupiter
+        {-4.17354020307064e-3, +3.99723751748116e-3, +1.67206320571441e-5}, // Saturn
+        {-3.25884806151064e-3, +2.06438412905916e-3, -2.17699042180559e-5}, // Uranus
+        {-2.17471785045538e-4, -3.11361111025884e-3, +3.58344705491441e-5}, // Neptune
+        {-1.76936577252484e-3, -2.06720938381724e-3, +6.58091931493844e-4}  // Pluto
+    };
+    const double ss_mass[6] = {1.00000597682, 1./1047.355, 1./3501.6, 1./22869., 1./19314., 0.};
+
+    struct reb_simulation* r = bench_create_simulation();
+    const double k = 0.01720209895; // Gaussian constant
+    r->G = k*k;
+    r->dt = 40;                     // in days
+    r->integrator = REB_INTEGRATOR_WHFAST;
+    r->ri_whfast.safe_mode = 0;
+    r->ri_whfast.corrector = 11;
+    r->force_is_velocity_dependent = 0;
+    for (int i=0;i<6;i++){
+        struct reb_particle p = {0};
+        p.x  = ss_pos[i][0]; p.y  = ss_pos[i][1]; p.z  = ss_pos[i][2];
+        p.vx = ss_vel[i][0]; p.vy = ss_vel[i][1]; p.vz = ss_vel[i][2];
+        p.m  = ss_mass[i];
+        reb_add(r, p);
+    }
+    r->N_active = 5;
+    const struct reb_particle sun = r->particles[0];
+    while (r->N<N){
+        double a     = reb_random_uniform(r, 35., 50.);
+        double e     = reb_random_rayleigh(r, 0.05);
+        double inc   = reb_random_rayleigh(r, 0.05);
+        double Omega = reb_random_uniform(r, 0., 2.*M_PI);
+        double omega = reb_random_uniform(r, 0., 2.*M_PI);
+        double f     = reb_random_uniform(r, 0., 2.*M_PI);
+        reb_add(r, reb_tools_orbit_to_particle(r->G, sun, 0., a, e, inc, Omega, omega, f));
+    }
+    reb_move_to_com(r);
+    return r;
+}
+
+// Star, a Neptune-mass scattering planet, a migrating planet and a disk of N-3 planetesimals.
+static struct reb_simulation* setup_mercurius_planetesimal_disk(int N){
+    struct reb_simulation* r = bench_create_simulation();
+    r->integrator = REB_INTEGRATOR_MERCURIUS;
+    r->testparticle_type = 1;
+    r->collision = REB_COLLISION_DIRECT;
+    r->collision_resolve = reb_collision_resolve_merge;
+    r->track_energy_offset = 1;
+    r->collision_resolve_keep_sorted = 1;
+    r->dt = 2.*M_PI/50.;
+
+    const double m_earth = 3.003e-6;
+    struct reb_particle star = {0};
+    star.m = 1;
+    star.r = 0.005;
+    reb_add(r, star);
+    struct reb_particle p = reb_tools_orbit_to_particle(r->G, star, 5.1e-4, 1., 0., reb_random_normal(r, 0.00001), 0., 0., 0.);
+    p.r = 0.000467;
+    reb_add(r, p);
+    p = reb_tools_orbit_to_particle(r->G, star, 2.3*m_earth, 1.67, 0., reb_random_normal(r, 0.00001), 0., 0., 0.);
+    p.r = 0.0000788215;
+    reb_add(r, p);
+    r->N_active = r->N;
+
+    const double planetesimal_mass = 23.*m_earth/(N-r->N_active);
+    while (r->N<N){
+        double a     = reb_random_powerlaw(r, 1.65, 2.67, 1.);
+        double e     = reb_random_rayleigh(r, 0.005);
+        double inc   = reb_random_rayleigh(r, 0.005);
+        double Omega = reb_random_uniform(r, 0., 2.*M_PI);
+        double omega = reb_random_uniform(r, 0., 2.*M_PI);
+        double f     = reb_random_uniform(r, 0., 2.*M_PI);
+        p = reb_tools_orbit_to_particle(r->G, star, planetesimal_mass, a, e, inc, Omega, omega, f);
+        p.r = 0.00000934532;
+        reb_add(r, p);
+    }
+    reb_move_to_com(r);
+    return r;
+}
+
+// Densely packed system of N-1 planets which becomes unstable within a few orbits.
+static struct reb_simulation* setup_ias15_close_encounter(int N){
+    struct reb_simulation* r = bench_create_simulation();
+    r->integrator = REB_INTEGRATOR_IAS15;
+    r->dt = 0.01*2.*M_PI;
+    struct reb_particle star = {0};
+    star.m = 1;
+    reb_add(r, star);
+    for (int i=1;i<N;i++){
+        double a = 1.+(double)(i-1)/(double)(N-1);
+        double f = reb_random_uniform(r, 0., 2.*M_PI);
+        reb_add(r, reb_tools_orbit_to_particle(r->G, star, 1e-4, a, 0., 0., 0., 0., f));
+    }
+    reb_move_to_com(r);
+    return r;
+}
+
+// Plummer sphere in N-body units, integrated with leapfrog and the Barnes-Hut tree.
+static struct reb_simulation* setup_tree_plummer(int N){
+    struct reb_simulation* r = bench_create_simulation();
+    r->integrator = REB_INTEGRATOR_LEAPFROG;
+    r->gravity = REB_GRAVITY_TREE;
+    r->boundary = REB_BOUNDARY_OPEN;
+    r->opening_angle2 = 0.25;
+    r->softening = 0.01;
+    r->dt = 1e-3;
+    reb_configure_box(r, 1000., 1, 1, 1);
+    reb_tools_init_plummer(r, N, 1., 1.);
+    reb_move_to_com(r);
+    return r;
+}
+
+static double coefficient_of_restitution_bridges(const struct reb_simulation* const r, double v){
+    double eps = 0.32*pow(fabs(v)*100.,-0.234);
+    if (eps>1) eps=1;
+    if (eps<0) eps=0;
+    return eps;
+}
+
+// Saturn's rings: self-gravitating shearing sheet of N particles with inelastic collisions.
+static struct reb_simulation* setup_sei_shearing_sheet(int N){
+    struct reb_simulation* r = bench_create_simulation();
+    const double OMEGA = 0.00013143527;             // 1/s
+    const double surfacedensity = 400;              // kg/m^2
+    const double particle_density = 400;            // kg/m^3
+    const double mean_radius3 = 6.4;                // <r^3> in m^3 for a r^-3 power law between 1 m and 4 m
+    r->integrator = REB_INTEGRATOR_SEI;
+    r->boundary = REB_BOUNDARY_SHEAR;
+    r->gravity = REB_GRAVITY_TREE;
+    r->collision = REB_COLLISION_TREE;
+    r->collision_resolve = reb_collision_resolve_hardsphere;
+    r->coefficient_of_restitution = coefficient_of_restitution_bridges;
+    r->minimum_collision_velocity = OMEGA*0.001;
+    r->ri_sei.OMEGA = OMEGA;
+    r->G = 6.67428e-11;
+    r->softening = 0.1;
+    r->opening_angle2 = 0.5;
+    r->dt = 1e-3*2.*M_PI/OMEGA;
+    const double mean_mass = particle_density*4./3.*M_PI*mean_radius3;
+    const double boxsize = sqrt(N*mean_mass/surfacedensity/4.);
+    reb_configure_box(r, boxsize, 2, 2, 1);
+    r->nghostx = 2;
+    r->nghosty = 2;
+    r->nghostz = 0;
+    while (r->N<N){
+        struct reb_particle pt = {0};
+        pt.x  = reb_random_uniform(r, -r->boxsize.x/2., r->boxsize.x/2.);
+        pt.y  = reb_random_uniform(r, -r->boxsize.y/2., r->boxsize.y/2.);
+        pt.z  = reb_random_normal(r, 1.);
+        pt.vy = -1.5*pt.x*OMEGA;
+        pt.r  = reb_random_powerlaw(r, 1., 4., -3.);
+        pt.m  = particle_density*4./3.*M_PI*pt.r*pt.r*pt.r;
+        reb_add(r, pt);
+    }
+    return r;
+}
+
+static void harmonic_oscillator_derivatives(struct reb_ode* const ode, double* const yDot, const double* const y, const double t){
+    struct reb_orbit o = reb_tools_particle_to_orbit(ode->r->G, ode->r->particles[1], ode->r->particles[0]);
+    yDot[0] = y[1];
+    yDot[1] = -y[0] + sin(o.f);
+}
+
+// N-1 planets and a harmonic oscillator driven by the orbital phase of the innermost planet.
+static struct reb_simulation* setup_bs_ode(int N){
+    struct reb_simulation* r = bench_create_simulation();
+    r->integrator = REB_INTEGRATOR_BS;
+    r->ri_bs.eps_rel = 1e-8;
+    r->ri_bs.eps_abs = 1e-8;
+    r->dt = 1e-2;
+    struct reb_particle star = {0};
+    star.m = 1;
+    reb_add(r, star);
+    for (int i=1;i<N;i++){
+        double f = reb_random_uniform(r, 0., 2.*M_PI);
+        reb_add(r, reb_tools_orbit_to_particle(r->G, star, 1e-3, pow(1.6, i-1), 0.1, 0.01*i, 0., 0., f));
+    }
+    reb_move_to_com(r);
+    struct reb_ode* ho = reb_create_ode(r, 2);
+    ho->derivatives = harmonic_oscillator_derivatives;
+    ho->y[0] = 1;
+    ho->y[1] = 0;
+    return r;
+}
+
+static const struct bench_workload workloads[] = {
+    {"whfast_outer_solar_system",   "whfast",    "basic", "none",   setup_whfast_outer_solar_system,   1, {{6, 1.6e7}, {106, 1e6}, {1006, 1e5}}},
+    {"mercurius_planetesimal_disk", "mercurius", "basic", "direct", setup_mercurius_planetesimal_disk, 1, {{53, 3000.}, {203, 500.}, {803, 50.}}},
+    {"ias15_close_encounter",       "ias15",     "basic", "none",   setup_ias15_close_encounter,       1, {{4, 4000.}, {8, 1000.}, {16, 100.}}},
+    {"tree_plummer",                "leapfrog",  "tree",  "none",   setup_tree_plummer,                1, {{1000, 0.1}, {10000, 0.005}, {0, 0.}}},
+    {"sei_shearing_sheet",          "sei",       "tree",  "tree",   setup_sei_shearing_sheet,          0, {{500, 5e4}, {2000, 1e4}, {0, 0.}}},
+    {"bs_ode",                      "bs",        "basic", "none",   setup_bs_ode,                      1, {{2, 1e4}, {5, 1e4}, {0, 0.}}},
+};
+
+static int bench_selected(const char* name, int argc, char* argv[], int first){
+    if (first>=argc) return 1;
+    for (int i=first;i<argc;i++){
+        if (strstr(name, argv[i])) return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]){
+    double scale = 1.;
+    const char* filename = NULL;
+    int first = 1;
+    while (first<argc && argv[first][0]=='-'){
+        if (strcmp(argv[first], "-s")==0 && first+1<argc){
+            scale = atof(argv[first+1]);
+        }else if (strcmp(argv[first], "-o")==0 && first+1<argc){
+            filename = argv[first+1];
+        }else{
+            fprintf(stderr, "Usage: %s [-s scale] [-o filename] [workload ...]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        first += 2;
+    }
+    FILE* of = stdout;
+    if (filename){
+        of = fopen(filename, "w");
+        if (of==NULL){
+            fprintf(stderr, "Can not open file %s.\n", filename);
+            return EXIT_FAILURE;
+        }
+    }
+    int threads = 1;
+#ifdef OPENMP
+    threads = omp_get_max_threads();
+#endif // OPENMP
+
+    fprintf(of, "{\n");
+    fprintf(of, "  \"version\": \"%s\",\n", reb_version_str);
+    fprintf(of, "  \"githash\": \"%s\",\n", reb_githash_str);
+    fprintf(of, "  \"threads\": %d,\n", threads);
+    fprintf(of, "  \"scale\": %g,\n", scale);
+    fprintf(of, "  \"results\": [");
+    int n_results = 0;
+    const int n_workloads = sizeof(workloads)/sizeof(workloads[0]);
+    for (int w=0;w<n_workloads;w++){
+        const struct bench_workload* b = &workloads[w];
+        if (!bench_selected(b->name, argc, argv, first)) continue;
+        for (int k=0;k<3;k++){
+            const struct bench_run run = b->runs[k];
+            if (run.N==0) continue;
+            struct reb_simulation* r = b->setup(run.N);
+            const double E0 = reb_tools_energy(r);
+            bench_steps_last = r->steps_done;
+            bench_particle_steps = 0;
+
+            const double start = bench_clock();
+            reb_integrate(r, r->t + run.tmax*scale);
+            reb_integrator_synchronize(r);
+            const double elapsed = bench_clock()-start;
+
+            const double steps = (double)r->steps_done;
+            fprintf(of, "%s\n    {\"name\": \"%s\", \"integrator\": \"%s\", \"gravity\": \"%s\", \"collision\": \"%s\", ", n_results?",":"", b->name, b->integrator, b->gravity, b->collision);
+            fprintf(of, "\"N\": %d, \"N_final\": %d, \"steps\": %.0f, \"time\": %.6e, ", run.N, r->N-r->N_var, steps, elapsed);
+            fprintf(of, "\"steps_per_s\": %.6e, \"particle_steps_per_s\": %.6e, ", steps/elapsed, bench_particle_steps/elapsed);
+            if (b->energy){
+                fprintf(of, "\"energy_error\": %.6e, ", fabs((reb_tools_energy(r)-E0)/E0));
+            }else{
+                fprintf(of, "\"energy_error\": null, ");
+            }
+            fprintf(of, "\"status\": %d}", r->status);
+            fflush(of);
+            fprintf(stderr, "%-28s N=%-6d %10.0f steps  %8.3f s  %.3e particle-steps/s\n", b->name, run.N, steps, elapsed, bench_particle_steps/elapsed);
+            n_results++;
+            reb_free_simulation(r);
+        }
+    }
+    fprintf(of, "\n  ]\n}\n");
+    if (of!=stdout){
+        fclose(of);
+    }
+    return EXIT_SUCCESS;
+}
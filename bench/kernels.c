@@ -0,0 +1,387 @@
+/**
+ * Kernel microbenchmarks
+ *
+ * This program measures the performance of individual kernels in
+ * isolation: the BASIC and COMPENSATED gravity routines, the scalar and
+ * batched WHFast Kepler solvers in different eccentricity regimes, the
+ * tree walk, the conversion from Cartesian coordinates to orbital
+ * elements, and the binary serialization of a simulation.
+ *
+ * Every kernel is first run for a warmup period. Then a number of samples
+ * is taken, each of them long enough to be timed accurately. The minimum,
+ * median, mean and standard deviation of the time per operation (one pair
+ * interaction, one call, ...) are reported as JSON.
+ *
+ * Usage: ./rebound_kernels [-n samples] [-o filename] [kernel ...]
+ *
+ * If kernel names (or parts thereof) are given, only matching kernels are
+ * run. The JSON output is written to stdout unless a filename is given.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#ifdef OPENMP
+#include <omp.h>
+#endif // OPENMP
+#include "rebound.h"
+#include "gravity.h"
+#include "tree.h"
+#include "output.h"
+#include "input.h"
+#include "integrator_whfast.h"
+
+#define KERNEL_SEED 1
+#define KERNEL_WARMUP 0.05          // Warmup time in seconds
+#define KERNEL_SAMPLE_TIME 0.01     // Minimum duration of one sample in seconds
+#define KERNEL_SAMPLES_MAX 1000
+
+static int kernel_samples = 21;
+static FILE* kernel_of;
+static int kernel_n_results = 0;
+static int kernel_argc;
+static char** kernel_argv;
+static int kernel_first;
+static volatile double kernel_sink; // Prevents the compiler from removing unused results
+
+static double kernel_clock(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static int kernel_selected(const char* name){
+    if (kernel_first>=kernel_argc) return 1;
+    for (int i=kernel_first;i<kernel_argc;i++){
+        if (strstr(name, kernel_argv[i])) return 1;
+    }
+    return 0;
+}
+
+static int kernel_compare(const void* a, const void* b){
+    const double da = *(const double*)a;
+    const double db = *(const double*)b;
+    return (da>db) - (da<db);
+}
+
+// Times run(ctx), which performs ops operations per call, and outputs the statistics.
+static void kernel_measure(const char* name, const char* parameter, const char* unit, double ops, void (*run)(void*), void* ctx){
+    // Warmup. Also determines how many calls are needed for one sample.
+    long calls = 1;
+    double start = kernel_clock();
+    double elapsed;
+    do {
+        run(ctx);
+        elapsed = kernel_clock()-start;
+        calls++;
+    } while (elapsed<KERNEL_WARMUP);
+    calls = (long)ceil(calls*KERNEL_SAMPLE_TIME/elapsed);
+    if (calls<1) calls = 1;
+
+    double samples[KERNEL_SAMPLES_MAX];
+    for (int s=0;s<kernel_samples;s++){
+        start = kernel_clock();
+        for (long c=0;c<calls;c++){
+            run(ctx);
+        }
+        samples[s] = (kernel_clock()-start)/(calls*ops)*1e9;
+    }
+    double mean = 0.;
+    for (int s=0;s<kernel_samples;s++){
+        mean += samples[s];
+    }
+    mean /= kernel_samples;
+    double var = 0.;
+    for (int s=0;s<kernel_samples;s++){
+        var += (samples[s]-mean)*(samples[s]-mean);
+    }
+    const double stddev = kernel_samples>1?sqrt(var/(kernel_samples-1)):0.;
+    qsort(samples, kernel_samples, sizeof(double), kernel_compare);
+    const double median = kernel_samples%2?samples[kernel_samples/2]:0.5*(samples[kernel_samples/2-1]+samples[kernel_samples/2]);
+
+    fprintf(kernel_of, "%s\n    {\"name\": \"%s\", \"parameter\": \"%s\", \"unit\": \"%s\", ", kernel_n_results?",":"", name, parameter, unit);
+    fprintf(kernel_of, "\"ops_per_call\": %.0f, \"calls_per_sample\": %ld, ", ops, calls);
+    fprintf(kernel_of, "\"min\": %.4e, \"median\": %.4e, \"mean\": %.4e, \"stddev\": %.4e}", samples[0], median, mean, stddev);
+    fflush(kernel_of);
+    fprintf(stderr, "%-28s %-16s %10.3f %s (median)  %10.3f (min)  +/- %.3f\n", name, parameter, median, unit, samples[0], stddev);
+    kernel_n_results++;
+}
+
+// Gravity
+
+static struct reb_simulation* kernel_create_cluster(int N){
+    struct reb_simulation* r = reb_create_simulation();
+    r->rand_seed = KERNEL_SEED;
+    reb_tools_init_plummer(r, N, 1., 1.);
+    reb_move_to_com(r);
+    return r;
+}
+
+static void run_gravity(void* ctx){
+    struct reb_simulation* r = ctx;
+    reb_calculate_acceleration(r);
+    kernel_sink = r->particles[0].ax;
+}
+
+static void kernel_gravity(void){
+    const int Ns[] = {10, 100, 1000};
+    const int gravities[] = {REB_GRAVITY_BASIC, REB_GRAVITY_COMPENSATED};
+    const char* names[] = {"gravity_basic", "gravity_compensated"};
+    for (int g=0;g<2;g++){
+        if (!kernel_selected(names[g])) continue;
+        for (int k=0;k<3;k++){
+            struct reb_simulation* r = kernel_create_cluster(Ns[k]);
+            r->gravity = gravities[g];
+            char parameter[64];
+            sprintf(parameter, "N=%d", Ns[k]);
+            kernel_measure(names[g], parameter, "ns/interaction", 0.5*Ns[k]*(Ns[k]-1), run_gravity, r);
+            reb_free_simulation(r);
+        }
+    }
+}
+
+// Tree walk. reb_calculate_acceleration_for_particle_from_cell() is called once per particle and ghost box.
+
+static void kernel_tree(void){
+    if (!kernel_selected("tree_walk")) return;
+    const int Ns[] = {1000, 10000};
+    const double opening_angles[] = {0.25, 0.5, 1.0};
+    for (int k=0;k<2;k++){
+        for (int a=0;a<3;a++){
+            struct reb_simulation* r = kernel_create_cluster(Ns[k]);
+            r->gravity = REB_GRAVITY_TREE;
+            r->opening_angle2 = opening_angles[a]*opening_angles[a];
+            r->softening = 0.01;
+            reb_configure_box(r, 1000., 1, 1, 1);
+            for (int i=0;i<r->N;i++){
+                reb_tree_add_particle_to_tree(r, i);
+            }
+            reb_tree_update(r);
+            reb_tree_update_gravity_data(r);
+            char parameter[64];
+            sprintf(parameter, "N=%d theta=%.2f", Ns[k], opening_angles[a]);
+            kernel_measure("tree_walk", parameter, "ns/particle", Ns[k], run_gravity, r);
+            reb_free_simulation(r);
+        }
+    }
+}
+
+// WHFast Kepler solver
+
+#define KEPLER_N 64                 // Number of particles with different initial phases
+#define KEPLER_STEPS 32             // Number of steps per particle and call
+
+struct kepler_ctx {
+    struct reb_simulation* r;
+    struct reb_particle initial[KEPLER_N];
+    struct reb_particle p[KEPLER_N];
+    double soa[6][KEPLER_N];        // Positions and velocities for the batched solver
+    double M[KEPLER_N];
+    double dt;
+};
+
+static void run_kepler(void* ctx){
+    struct kepler_ctx* c = ctx;
+    memcpy(c->p, c->initial, sizeof(c->p));
+    for (int s=0;s<KEPLER_STEPS;s++){
+        for (int i=0;i<KEPLER_N;i++){
+            reb_whfast_kepler_solver(c->r, c->p, 1., i, c->dt);
+        }
+    }
+    kernel_sink = c->p[0].x;
+}
+
+// Batched solver as used by WHFast. Bodies that the lanes cannot handle fall back to the scalar solver.
+static void run_kepler_lanes(void* ctx){
+    struct kepler_ctx* c = ctx;
+    for (int i=0;i<KEPLER_N;i++){
+        c->soa[0][i] = c->initial[i].x;
+        c->soa[1][i] = c->initial[i].y;
+        c->soa[2][i] = c->initial[i].z;
+        c->soa[3][i] = c->initial[i].vx;
+        c->soa[4][i] = c->initial[i].vy;
+        c->soa[5][i] = c->initial[i].vz;
+    }
+    const struct reb_particle_soa p_j = {.x=c->soa[0], .y=c->soa[1], .z=c->soa[2], .vx=c->soa[3], .vy=c->soa[4], .vz=c->soa[5]};
+    for (int s=0;s<KEPLER_STEPS;s++){
+        for (int i=0;i<KEPLER_N;i+=WHFAST_BATCH){
+            reb_whfast_kepler_solver_batch_soa(c->r, p_j, c->M+i, i, WHFAST_BATCH, c->dt);
+        }
+    }
+    kernel_sink = c->soa[0][0];
+}
+
+static void kernel_kepler(void){
+    if (!kernel_selected("whfast_kepler_solver")) return;
+    const double es[] = {0.01, 0.5, 0.9, 0.99, 1.5};
+    struct kepler_ctx* c = calloc(1, sizeof(struct kepler_ctx));
+    c->r = reb_create_simulation();
+    c->r->rand_seed = KERNEL_SEED;
+    struct reb_particle primary = {0};
+    primary.m = 1.;
+    for (int i=0;i<KEPLER_N;i++){
+        c->M[i] = 1.;
+    }
+    for (int k=0;k<5;k++){
+        const double a = es[k]<1.?1.:-1.;
+        for (int i=0;i<KEPLER_N;i++){
+            // Bound orbits start at random phases, hyperbolic orbits near pericenter.
+            double f = es[k]<1.?reb_random_uniform(c->r, 0., 2.*M_PI):reb_random_uniform(c->r, -1., 1.);
+            c->initial[i] = reb_tools_orbit_to_particle(1., primary, 0., a, es[k], 0.1, 0., 0., f);
+        }
+        // Every call covers about one orbital period (or the corresponding time for hyperbolic orbits).
+        c->dt = 1.0137*2.*M_PI/KEPLER_STEPS;
+        char parameter[64];
+        sprintf(parameter, "e=%.2f", es[k]);
+        kernel_measure("whfast_kepler_solver", parameter, "ns/call", KEPLER_N*KEPLER_STEPS, run_kepler, c);
+        kernel_measure("whfast_kepler_solver_lanes", parameter, "ns/call", KEPLER_N*KEPLER_STEPS, run_kepler_lanes, c);
+    }
+    reb_free_simulation(c->r);
+    free(c);
+}
+
+// Orbital elements
+
+#define ORBIT_N 1024
+
+struct orbit_ctx {
+    struct reb_particle primary;
+    struct reb_particle p[ORBIT_N];
+};
+
+static void run_particle_to_orbit(void* ctx){
+    struct orbit_ctx* c = ctx;
+    double sum = 0.;
+    for (int i=0;i<ORBIT_N;i++){
+        struct reb_orbit o = reb_tools_particle_to_orbit(1., c->p[i], c->primary);
+        sum += o.a;
+    }
+    kernel_sink = sum;
+}
+
+static void kernel_orbit(void){
+    if (!kernel_selected("particle_to_orbit")) return;
+    struct orbit_ctx* c = calloc(1, sizeof(struct orbit_ctx));
+    struct reb_simulation* r = reb_create_simulation();
+    r->rand_seed = KERNEL_SEED;
+    c->primary.m = 1.;
+    for (int i=0;i<ORBIT_N;i++){
+        double a     = reb_random_uniform(r, 0.5, 5.);
+        double e     = reb_random_uniform(r, 0., 0.9);
+        double inc   = reb_random_uniform(r, 0., 0.5);
+        double Omega = reb_random_uniform(r, 0., 2.*M_PI);
+        double omega = reb_random_uniform(r, 0., 2.*M_PI);
+        double f     = reb_random_uniform(r, 0., 2.*M_PI);
+        c->p[i] = reb_tools_orbit_to_particle(1., c->primary, 0., a, e, inc, Omega, omega, f);
+    }
+    kernel_measure("particle_to_orbit", "", "ns/call", ORBIT_N, run_particle_to_orbit, c);
+    reb_free_simulation(r);
+    free(c);
+}
+
+// Serialization
+
+struct binary_ctx {
+    struct reb_simulation* r;
+    struct reb_simulation* r_copy;
+    char* buf;
+    size_t size;
+};
+
+static void run_output_binary(void* ctx){
+    struct binary_ctx* c = ctx;
+    char* buf;
+    size_t size;
+    reb_output_binary_to_stream(c->r, &buf, &size);
+    kernel_sink = size;
+    free(buf);
+}
+
+static void run_input_field(void* ctx){
+    struct binary_ctx* c = ctx;
+    char* bufp = c->buf;
+    while(reb_input_field(c->r_copy, NULL, NULL, &bufp)){ }
+    kernel_sink = c->r_copy->t;
+}
+
+static void kernel_binary(void){
+    const int Ns[] = {10, 1000};
+    for (int k=0;k<2;k++){
+        struct binary_ctx c;
+        c.r = kernel_create_cluster(Ns[k]);
+        c.r->integrator = REB_INTEGRATOR_WHFAST;
+        c.r->dt = 1e-3;
+        reb_step(c.r);
+        reb_output_binary_to_stream(c.r, &c.buf, &c.size);
+        char parameter[64];
+        sprintf(parameter, "N=%d", Ns[k]);
+        if (kernel_selected("output_binary_to_stream")){
+            kernel_measure("output_binary_to_stream", parameter, "ns/call", 1, run_output_binary, &c);
+        }
+        if (kernel_selected("input_field")){
+            // One call reads all fields of a snapshot into the same simulation.
+            int fields = 0;
+            c.r_copy = reb_create_simulation();
+            char* bufp = c.buf;
+            while(reb_input_field(c.r_copy, NULL, NULL, &bufp)){
+                fields++;
+            }
+            kernel_measure("input_field", parameter, "ns/call", fields+1, run_input_field, &c);
+            reb_free_simulation(c.r_copy);
+        }
+        free(c.buf);
+        reb_free_simulation(c.r);
+    }
+}
+
+int main(int argc, char* argv[]){
+    const char* filename = NULL;
+    kernel_first = 1;
+    while (kernel_first<argc && argv[kernel_first][0]=='-'){
+        if (strcmp(argv[kernel_first], "-n")==0 && kernel_first+1<argc){
+            kernel_samples = atoi(argv[kernel_first+1]);
+        }else if (strcmp(argv[kernel_first], "-o")==0 && kernel_first+1<argc){
+            filename = argv[kernel_first+1];
+        }else{
+            fprintf(stderr, "Usage: %s [-n samples] [-o filename] [kernel ...]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        kernel_first += 2;
+    }
+    if (kernel_samples<1 || kernel_samples>KERNEL_SAMPLES_MAX){
+        fprintf(stderr, "Number of samples must be between 1 and %d.\n", KERNEL_SAMPLES_MAX);
+        return EXIT_FAILURE;
+    }
+    kernel_argc = argc;
+    kernel_argv = argv;
+    kernel_of = stdout;
+    if (filename){
+        kernel_of = fopen(filename, "w");
+        if (kernel_of==NULL){
+            fprintf(stderr, "Can not open file %s.\n", filename);
+            return EXIT_FAILURE;
+        }
+    }
+    int threads = 1;
+#ifdef OPENMP
+    threads = omp_get_max_threads();
+#endif // OPENMP
+
+    fprintf(kernel_of, "{\n");
+    fprintf(kernel_of, "  \"version\": \"%s\",\n", reb_version_str);
+    fprintf(kernel_of, "  \"githash\": \"%s\",\n", reb_githash_str);
+    fprintf(kernel_of, "  \"threads\": %d,\n", threads);
+    fprintf(kernel_of, "  \"samples\": %d,\n", kernel_samples);
+    fprintf(kernel_of, "  \"results\": [");
+    kernel_gravity();
+    kernel_tree();
+    kernel_kepler();
+    kernel_orbit();
+    kernel_binary();
+    fprintf(kernel_of, "\n  ]\n}\n");
+    if (kernel_of!=stdout){
+        fclose(kernel_of);
+    }
+    return EXIT_SUCCESS;
+}
@@ -3,9 +3,9 @@
  *
  * This example demonstrates how to use the profiling tool that
  * comes with REBOUND to find out which parts of your code are 
- * slow. To turn on this option, simple set `PROFILING=1` in 
- * the Makefile.
- * Note that enabeling this option makes REBOUND not thread-safe.
+ * slow. The profiler is turned on with reb_profiling_enable().
+ * The results are printed by reb_output_timing() and can also
+ * be accessed directly in r->profiling.
  */
 #include <stdio.h>
 #include <stdlib.h>
@@ -31,6 +31,7 @@ int main(int argc, char* argv[]) {
     r->softening = 0.1;          // m
     r->dt = 1e-3 * 2. * M_PI / OMEGA; // s
     r->heartbeat = heartbeat;     // function pointer for heartbeat
+    reb_profiling_enable(r);      // turn on the runtime profiler
     // This example uses two root boxes in the x and y direction.
     // Although not necessary in this case, it allows for the parallelization using MPI.
     // See Rein & Liu for a description of what a root box is in this context.
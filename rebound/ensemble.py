@@ -0,0 +1,145 @@
+from ctypes import c_double, c_int, c_void_p, byref
+from .particle import Particle
+from . import clibrebound
+
+class WHFastEnsemble(object):
+    """
+    WHFastEnsemble Class.
+
+    An ensemble holds many replicas of a small system (same number of
+    particles, same timestep) and integrates them in lockstep with WHFast.
+    The replicas are stored in one contiguous block of memory which allows
+    the compiler to vectorize loops over replicas. If REBOUND is compiled
+    with OpenMP, groups of replicas are integrated in parallel.
+
+    Each replica follows exactly the same sequence of floating point
+    operations as the template simulation would with safe_mode=0 and
+    exact_finish_time=0. The template simulation must use WHFast with
+    Jacobi coordinates, the default kernel, and the basic gravity routine.
+    If sim.init_megno() was called on the template simulation, then MEGNO
+    is calculated for every replica.
+
+    Replicas with non-finite coordinates, particles beyond exit_max_distance,
+    or close encounters within exit_min_distance are flagged. Flagged
+    replicas keep being integrated, but their MEGNO values are frozen.
+
+    Examples
+    --------
+
+    >>> sim = rebound.Simulation()
+    >>> sim.add(m=1.)
+    >>> sim.add(m=1e-3, a=1.)
+    >>> sim.add(m=1e-3, a=1.5)
+    >>> sim.integrator = "whfast"
+    >>> sim.dt = 0.05
+    >>> sim.init_megno()
+    >>> ens = rebound.WHFastEnsemble(sim, 100)
+    >>> for k in range(100):
+    >>>     s = sim.copy()
+    >>>     s.particles[2].m = 1e-3*k/100.
+    >>>     ens.set_particles(k, s)
+    >>> ens.integrate(1000.)
+    >>> print(ens.megno())
+
+    """
+    def __init__(self, sim, N_replicas):
+        """
+        Creates an ensemble of N_replicas copies of sim.
+
+        Parameters
+        ----------
+        sim : Simulation
+            Template simulation.
+        N_replicas : int
+            Number of replicas.
+        """
+        clibrebound.reb_create_whfast_ensemble.restype = c_void_p
+        self._e = clibrebound.reb_create_whfast_ensemble(byref(sim), c_int(N_replicas))
+        sim.process_messages()
+        if not self._e:
+            raise RuntimeError("Cannot create WHFast ensemble.")
+        self.N = sim.N - sim.N_var
+        self.N_replicas = N_replicas
+
+    def __del__(self):
+        if getattr(self, "_e", None):
+            clibrebound.reb_free_whfast_ensemble(c_void_p(self._e))
+            self._e = None
+
+    def __len__(self):
+        return self.N_replicas
+
+    def set_particles(self, k, sim):
+        """
+        Sets the particles of replica k to the particles in sim.
+        Should be called before integrating.
+        """
+        if sim.N - sim.N_var != self.N:
+            raise ValueError("The number of particles does not match the ensemble.")
+        if clibrebound.reb_whfast_ensemble_set_particles(c_void_p(self._e), c_int(k), sim._particles) == 0:
+            raise IndexError("Replica index out of range.")
+
+    def particles(self, k):
+        """
+        Returns a list of the particles (inertial coordinates and masses) of replica k.
+        """
+        particles = (Particle*self.N)()
+        if clibrebound.reb_whfast_ensemble_get_particles(c_void_p(self._e), c_int(k), particles) == 0:
+            raise IndexError("Replica index out of range.")
+        return list(particles)
+
+    def integrate(self, tmax):
+        """
+        Integrates all replicas until the time tmax is reached or exceeded
+        (same as exact_finish_time=0).
+        """
+        clibrebound.reb_whfast_ensemble_integrate(c_void_p(self._e), c_double(tmax))
+
+    @property
+    def t(self):
+        """
+        Current time of all replicas.
+        """
+        clibrebound.reb_whfast_ensemble_get_t.restype = c_double
+        return clibrebound.reb_whfast_ensemble_get_t(c_void_p(self._e))
+
+    def status(self):
+        """
+        Returns a list with the status of every replica.
+        0: running, 1: non-finite coordinates, 2: escape, 3: close encounter.
+        """
+        status = (c_int*self.N_replicas)()
+        clibrebound.reb_whfast_ensemble_get_status(c_void_p(self._e), status, None)
+        return list(status)
+
+    def t_exit(self):
+        """
+        Returns a list with the times at which replicas have been flagged (0 if running).
+        """
+        t_exit = (c_double*self.N_replicas)()
+        clibrebound.reb_whfast_ensemble_get_status(c_void_p(self._e), None, t_exit)
+        return list(t_exit)
+
+    def energy_error(self):
+        """
+        Returns a list with the relative energy error of every replica.
+        """
+        dE = (c_double*self.N_replicas)()
+        clibrebound.reb_whfast_ensemble_get_energy_error(c_void_p(self._e), dE)
+        return list(dE)
+
+    def megno(self):
+        """
+        Returns a list with the MEGNO value of every replica.
+        """
+        megno = (c_double*self.N_replicas)()
+        clibrebound.reb_whfast_ensemble_get_megno(c_void_p(self._e), megno, None)
+        return list(megno)
+
+    def lyapunov(self):
+        """
+        Returns a list with the Lyapunov exponent of every replica, same as Simulation.calculate_lyapunov().
+        """
+        lyapunov = (c_double*self.N_replicas)()
+        clibrebound.reb_whfast_ensemble_get_megno(c_void_p(self._e), None, lyapunov)
+        return list(lyapunov)
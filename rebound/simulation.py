@@ -46,6 +46,10 @@ EOS_TYPES = {
         "pmlf4": 0x07,
         "pmlf6": 0x08,
         }
+PROFILING_CATEGORIES = ["integrator", "boundary", "gravity", "collision", "heartbeat",
+        "tree_update", "tree_moments", "force_walk", "encounter_predict", "encounter_step",
+        "kepler", "jump", "collision_search", "collision_resolve", "archive"]
+PROFILING_COUNTERS = ["cycles", "instructions", "cache_misses", "branch_misses"]
 
 # Format: Majorerror, id, message
 BINARY_WARNINGS = [
@@ -381,6 +385,18 @@ class reb_dp7(Structure):
                 ("p5", POINTER(c_double)),
                 ("p6", POINTER(c_double))]
 
+class reb_particle_soa(Structure):
+    _fields_ = [("x", POINTER(c_double)),
+                ("y", POINTER(c_double)),
+                ("z", POINTER(c_double)),
+                ("vx", POINTER(c_double)),
+                ("vy", POINTER(c_double)),
+                ("vz", POINTER(c_double)),
+                ("ax", POINTER(c_double)),
+                ("ay", POINTER(c_double)),
+                ("az", POINTER(c_double)),
+                ("m", POINTER(c_double))]
+
 class reb_ghostbox(Structure):
     _fields_ = [("shiftx", c_double),
                 ("shifty", c_double),
@@ -425,7 +441,8 @@ class reb_simulation_integrator_sei(Structure):
                 ("_sindt", c_double),
                 ("_tandt", c_double),
                 ("_sindtz", c_double),
-                ("_tandtz", c_double)]
+                ("_tandtz", c_double),
+                ("_boundary_checked", c_uint)]
 
 class reb_simulation_integrator_ias15(Structure):
     """
@@ -448,6 +465,10 @@ class reb_simulation_integrator_ias15(Structure):
     :ivar float epsilon_global:          
         Determines how the adaptive timestep is chosen. 
     
+    :ivar int block_levels:          
+        Maximum number of timestep levels. If larger than 1, every particle 
+        uses its own timestep sim.dt/2**level. Default is 0 (global timestep).
+    
     """
     def __repr__(self):
         return '<{0}.{1} object at {2}, epsilon={3}, min_dt={4}>'.format(self.__module__, type(self).__name__, hex(id(self)), self.epsilon, self.min_dt)
@@ -455,6 +476,7 @@ class reb_simulation_integrator_ias15(Structure):
     _fields_ = [("epsilon", c_double),
                 ("min_dt", c_double),
                 ("epsilon_global", c_uint),
+                ("block_levels", c_uint),
                 ("_iterations_max_exceeded", c_ulong),
                 ("_allocatedN", c_int),
                 ("_at", POINTER(c_double)),
@@ -472,6 +494,17 @@ class reb_simulation_integrator_ias15(Structure):
                 ("_er", reb_dp7),
                 ("_map", POINTER(c_int)),
                 ("_map_allocated_n", c_int),
+                ("_arena", POINTER(c_double)),
+                ("_arena_allocatedN", c_int),
+                ("_block_N", c_int),
+                ("_block_level", POINTER(c_int)),
+                ("_block_index", POINTER(c_int)),
+                ("_block_dt_want", POINTER(c_double)),
+                ("_block_dt_last", POINTER(c_double)),
+                ("_block_arena", POINTER(c_double)),
+                ("_block_arena_allocatedN", c_int),
+                ("_dense_N", c_int),
+                ("_dense_t", c_double),
                 ]
 
 class reb_simulation_integrator_saba(Structure):
@@ -586,8 +619,8 @@ class reb_simulation_integrator_whfast(Structure):
                 ("recalculate_coordinates_this_timestep", c_uint),
                 ("safe_mode", c_uint),
                 ("keep_unsynchronized", c_uint),
-                ("_p_jh", POINTER(Particle)),
-                ("_p_temp", POINTER(Particle)),
+                ("_p_jh", reb_particle_soa),
+                ("_p_temp", reb_particle_soa),
                 ("is_synchronized", c_uint),
                 ("_allocatedN", c_uint),
                 ("_allocatedNtmp", c_uint),
@@ -2010,6 +2043,86 @@ class Simulation(Structure):
         clibrebound.reb_tools_angular_momentum.restype = _Vec3d
         return Vec3d(clibrebound.reb_tools_angular_momentum(byref(self)))
 
+    @property
+    def profiling(self):
+        """
+        Get or set the state of the runtime profiler (True or False).
+
+        The profiler measures the wall time spent in different parts of 
+        the code. See profiling_report() for the list of categories.
+        Disabling the profiler discards all measurements.
+        """
+        return bool(self._profiling)
+
+    @profiling.setter
+    def profiling(self, value):
+        if value:
+            clibrebound.reb_profiling_enable(byref(self))
+        else:
+            clibrebound.reb_profiling_disable(byref(self))
+
+    def profiling_reset(self):
+        """
+        Sets all measurements of the runtime profiler to zero.
+        """
+        clibrebound.reb_profiling_reset(byref(self))
+
+    def profiling_enable_counters(self):
+        """
+        Enables the runtime profiler together with hardware performance counters.
+
+        The counters (cycles, instructions, cache misses, and branch misses) 
+        use the Linux perf_event_open interface. They are not available on other 
+        operating systems, on many virtual machines, or if access is restricted 
+        (see /proc/sys/kernel/perf_event_paranoid). In that case, the profiler 
+        only measures times.
+
+        Returns
+        -------
+        A list with the names of the available counters.
+        """
+        clibrebound.reb_profiling_enable_counters(byref(self))
+        p = self._profiling.contents
+        return [name for k, name in enumerate(PROFILING_COUNTERS) if p.counters_fd[k]>=0]
+
+    def profiling_report(self):
+        """
+        Returns the measurements of the runtime profiler, or None if the profiler is disabled.
+
+        The return value is a dictionary. The entry ``elapsed`` is the wall time in seconds 
+        since the profiler was enabled or reset. The entry ``categories`` maps the name of 
+        each category to a dictionary with the ``time`` spent in it (in seconds) and the 
+        number of ``calls``. If hardware counters are enabled (see 
+        profiling_enable_counters()), each category also contains the counts for 
+        ``cycles``, ``instructions``, ``cache_misses``, and ``branch_misses``.
+        Counters which are not available are None.
+        The categories integrator, boundary, gravity, collision, and heartbeat do not 
+        overlap. All other categories are sub-phases of these.
+
+        Examples
+        --------
+        
+        >>> sim = rebound.Simulation()
+        >>> sim.add(m=1.)
+        >>> sim.add(m=1e-3, a=1.)
+        >>> sim.integrator = "whfast"
+        >>> sim.profiling = True
+        >>> sim.integrate(100.)
+        >>> report = sim.profiling_report()
+        >>> print(report["categories"]["kepler"]["calls"])
+        """
+        if not self._profiling:
+            return None
+        clibrebound.reb_profiling_elapsed.restype = c_double
+        p = self._profiling.contents
+        categories = {}
+        for i, name in enumerate(PROFILING_CATEGORIES):
+            categories[name] = {"time": p.time[i], "calls": p.calls[i]}
+            if p.counters_enabled:
+                for k, counter in enumerate(PROFILING_COUNTERS):
+                    categories[name][counter] = p.counters[i][k] if p.counters_fd[k]>=0 else None
+        return {"elapsed": clibrebound.reb_profiling_elapsed(byref(self)), "categories": categories}
+
     def configure_box(self, boxsize, root_nx=1, root_ny=1, root_nz=1):
         """
         Initialize the simulation box.
@@ -2140,6 +2253,40 @@ class Simulation(Structure):
         """
         clibrebound.reb_integrator_synchronize(byref(self))
     
+    def ias15_interpolate(self, t):
+        """
+        Dense output for the IAS15 integrator. 
+
+        Evaluates the polynomials of the last IAS15 timestep and returns the particles 
+        with positions and velocities at time t. The time t needs to lie within the
+        last timestep. This does not require any additional force evaluations and does 
+        not change the state of the simulation.
+
+        Parameters
+        ----------
+        t : float
+            Time at which positions and velocities are calculated.
+
+        Returns
+        -------
+        List of particles at time t.
+        
+        Examples
+        --------
+        
+        >>> sim = rebound.Simulation()
+        >>> sim.add(m=1.)
+        >>> sim.add(m=1e-3, a=1.)
+        >>> sim.step()
+        >>> ps = sim.ias15_interpolate(sim.t-sim.dt_last_done/2.)
+        """
+        particles = (Particle*self.N)()
+        ret_value = clibrebound.reb_integrator_ias15_interpolate(byref(self), c_double(t), particles)
+        self.process_messages()
+        if ret_value == 0:
+            raise RuntimeError("Dense output failed.")
+        return list(particles)
+
     def tree_update(self):
         """
         Call this function to update the tree structure manually after removing particles.
@@ -2296,14 +2443,14 @@ class Variation(Structure):
 
         
 
-class reb_particle_int(Structure):
+class reb_particle_int_soa(Structure):
     _fields_ = [
-                ("x", c_int64),
-                ("y", c_int64),
-                ("z", c_int64),
-                ("vx", c_int64),
-                ("vy", c_int64),
-                ("vz", c_int64),
+                ("x", POINTER(c_int64)),
+                ("y", POINTER(c_int64)),
+                ("z", POINTER(c_int64)),
+                ("vx", POINTER(c_int64)),
+                ("vy", POINTER(c_int64)),
+                ("vz", POINTER(c_int64)),
                 ]
 
 class reb_simulation_integrator_janus(Structure):
@@ -2312,7 +2459,7 @@ class reb_simulation_integrator_janus(Structure):
                 ("scale_vel",c_double),
                 ("order", c_uint),
                 ("recalculate_integer_coordinates_this_timestep", c_uint),
-                ("p_int", POINTER(reb_particle_int)),
+                ("p_int", reb_particle_int_soa),
                 ("_allocated_N",c_uint),
                 ]
 
@@ -2391,6 +2538,11 @@ class reb_simulation_integrator_eos(Structure):
                 ("n",c_uint),
                 ("safe_mode",c_uint),
                 ("is_synchronized",c_uint),
+                ("timing",c_uint),
+                ("walltime_drift",c_double),
+                ("walltime_interaction",c_double),
+                ("force_calculations_done",c_ulonglong),
+                ("_fsal",c_void_p),
                 ]
 
 class reb_simulation_integrator_mercurius(Structure):
@@ -2426,9 +2578,15 @@ class reb_simulation_integrator_mercurius(Structure):
                 ("_allocatedN_additionalforces", c_uint),
                 ("_dcrit_allocatedN", c_uint),
                 ("_dcrit", POINTER(c_double)),
-                ("_particles_backup", POINTER(Particle)),
-                ("_particles_backup_additionalforces", POINTER(Particle)),
+                ("_particles_backup", c_void_p),
+                ("_particles_backup_additionalforces", c_void_p),
                 ("_encounter_map", POINTER(c_int)),
+                ("_encounter_bands", c_void_p),
+                ("_encounter_flags", c_void_p),
+                ("_encounter_flags_allocatedN", c_uint),
+                ("_encounter_cluster", POINTER(c_int)),
+                ("_encounter_pairs", c_void_p),
+                ("_encounter_pairs_allocatedN", c_uint),
                 ("_com_pos", _Vec3d),
                 ("_com_vel", _Vec3d),
                 ]
@@ -2503,6 +2661,8 @@ class reb_simulation_integrator_bs(Structure):
                 ("_previousRejected", c_int),
                 ("_targetIter", c_int),
                 ("_user_ode_needs_nbody", c_int),
+                ("parallel_columns", c_int),
+                ("_columns", c_void_p),
             ]               
 
 class reb_simulation_integrator_tes(Structure):
@@ -2541,13 +2701,23 @@ class reb_simulation_integrator_tes(Structure):
 class timeval(Structure):
     _fields_ = [("tv_sec",c_long),("tv_usec",c_long)]
 
+class reb_profiling(Structure):
+    _fields_ = [("time", c_double*len(PROFILING_CATEGORIES)),
+                ("calls", c_ulonglong*len(PROFILING_CATEGORIES)),
+                ("counters", (c_ulonglong*len(PROFILING_COUNTERS))*len(PROFILING_CATEGORIES)),
+                ("counters_enabled", c_int),
+                ("counters_fd", c_int*len(PROFILING_COUNTERS)),
+                ("time_begin", c_double),
+                ("_time_phase", c_double),
+                ("_counters_phase", c_ulonglong*len(PROFILING_COUNTERS))]
+
 class reb_display_data(Structure):
     _fields_ = [("r", POINTER(Simulation)),
                 ("r_copy", POINTER(Simulation)),
                 ("particle_data", c_void_p),
                 ("orbit_data", c_void_p),
                 ("particles_copy", POINTER(Particle)),
-                ("p_jh_copy", POINTER(Particle)),
+                ("p_jh_copy", POINTER(c_double)),
                 ("allocated_N", c_ulong),
                 ("allocated_N_whfast", c_ulong),
                 ("opengl_enabled", c_int),
@@ -2601,6 +2771,7 @@ Simulation._fields_ = [
                 ("track_energy_offset", c_int),
                 ("energy_offset", c_double),
                 ("walltime", c_double),
+                ("_profiling", POINTER(reb_profiling)),
                 ("python_unit_t",c_uint32),
                 ("python_unit_l",c_uint32),
                 ("python_unit_m",c_uint32),
@@ -2621,6 +2792,10 @@ Simulation._fields_ = [
                 ("collisions_plog", c_double),
                 ("max_radius", c_double*2),
                 ("collisions_Nlog", c_long),
+                ("_collision_bvh", c_void_p),
+                ("_collision_bvh_N", c_int),
+                ("_collision_bvh_allocatedN", c_int),
+                ("_collision_bvh_cost", c_double),
                 ("_calculate_megno", c_int),
                 ("_megno_Ys", c_double),
                 ("_megno_Yss", c_double),
@@ -2656,6 +2831,8 @@ Simulation._fields_ = [
                 ("_odes", POINTER(POINTER(ODE))),
                 ("_odes_N", c_int),
                 ("_odes_allocatedN", c_int),
+                ("_odes_arena", POINTER(c_double)),
+                ("_odes_length", c_uint),
                 ("_odes_warnings", c_int),
                 ("_additional_forces", CFUNCTYPE(None,POINTER(Simulation))),
                 ("_pre_timestep_modifications", CFUNCTYPE(None,POINTER(Simulation))),
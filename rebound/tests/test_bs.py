@@ -1,6 +1,7 @@
 import rebound
 import unittest
 import math
+import os
 import rebound.data
 import warnings
 
@@ -89,6 +90,91 @@ class TestIntegratorBSHarmonic(unittest.TestCase):
         self.assertLess(math.fabs(ode_ho.y[1]),2e-9)
 
 
+    def test_bs_ode_storage(self):
+        sim = rebound.Simulation()
+        sim.integrator = "BS"
+        odes = []
+        for i in range(20):
+            ode = sim.create_ode(length=2, needs_nbody=False)
+            ode.derivatives = derivatives_ho
+            ode.y[0] = 1.+i
+            self.assertEqual(ode.y[1], 0.)
+            odes.append(ode)
+        for i in range(20):
+            self.assertEqual(odes[i].y[0], 1.+i)
+        sim.integrate(2.*math.pi)
+        for i in range(20):
+            self.assertLess(math.fabs(odes[i].y[0]-(1.+i)*math.cos(20.*math.pi)),1e-8*(1.+i))
+        y0 = odes[7].y[0]
+        del sim # ODEs keep their state after the simulation has been freed
+        self.assertEqual(odes[7].y[0], y0)
+
+    def test_bs_ode_stable_y(self):
+        # Pointers to the state of an ODE remain valid if other ODEs are added.
+        sim = rebound.Simulation()
+        sim.integrator = "BS"
+        sim.add(m=1)
+        ode_ho = sim.create_ode(length=2, needs_nbody=False)
+        ode_ho.derivatives = derivatives_ho
+        y = ode_ho.y
+        ode_other = sim.create_ode(length=2, needs_nbody=False)
+        ode_other.derivatives = derivatives_ho
+        y[0] = 1. 
+        y[1] = 0. # zero velocity
+        sim.integrate(math.pi)
+        sim.add(m=1e-3,a=1) # The N-body ODE is recreated
+        sim.integrate(20.*math.pi)
+        self.assertLess(math.fabs(y[0]-1.),2e-10)
+        self.assertLess(math.fabs(y[1]),2e-9)
+        self.assertEqual(ode_ho.y[0], y[0])
+
+    def test_bs_parallel_columns(self):
+        def derivatives_forced(ode, yDot, y, t):
+            p = ode.contents.r.contents.particles[1]
+            yDot[0] = y[1]
+            yDot[1] = -y[0] + p.x
+        def drag(simp):
+            ps = simp.contents.particles
+            ps[2].ax -= 1e-4*ps[2].vx
+            ps[2].ay -= 1e-4*ps[2].vy
+        def ode_force(simp):
+            # The oscillator acts back on a planet. Its current state must be read through the simulation.
+            sim = simp.contents
+            sim.particles[1].ax += 1e-4*sim._odes[0].contents._y1[0]
+        def setup(parallel_columns, gravity, additional_forces):
+            sim = rebound.Simulation()
+            sim.add(m=1)
+            sim.add(m=1e-3,a=1,e=0.123)
+            sim.add(m=1e-3,a=2.6,e=0.323,inc=0.1)
+            sim.add(a=1.8,e=0.2)
+            sim.N_active = 3
+            sim.gravity = gravity
+            sim.integrator = "BS"
+            sim.ri_bs.parallel_columns = parallel_columns
+            sim.additional_forces = additional_forces
+            ode = sim.create_ode(length=2, needs_nbody=True)
+            ode.derivatives = derivatives_forced
+            ode.y[0] = 1.
+            return sim, ode
+        for gravity in ["basic", "compensated"]:
+            for additional_forces in [drag, ode_force]:
+                sim0, ode0 = setup(0, gravity, additional_forces)
+                sim1, ode1 = setup(1, gravity, additional_forces)
+                sim0.integrate(10.)
+                sim1.integrate(10.)
+                self.assertEqual(sim0.steps_done, sim1.steps_done)
+                self.assertEqual(ode0.y[0], ode1.y[0])
+                self.assertEqual(ode0.y[1], ode1.y[1])
+                for i in range(sim0.N):
+                    self.assertEqual(sim0.particles[i].x, sim1.particles[i].x)
+                    self.assertEqual(sim0.particles[i].vy, sim1.particles[i].vy)
+        sim1.save("test.bin")
+        with warnings.catch_warnings():
+            warnings.simplefilter("ignore") # Function pointers are not restored
+            sim2 = rebound.Simulation("test.bin")
+        os.remove("test.bin")
+        self.assertEqual(sim2.ri_bs.parallel_columns, 1)
+
     
 def af(simp):
     sim = simp.contents
@@ -47,6 +47,62 @@ class TestLineTreeCollisions(unittest.TestCase):
         sim.add(r=1,x=0)
         sim.add(r=1,x=2.1,vx=1)
         sim.integrate(10)
+    def test_linetree_find_swept(self):
+        # Should find the collision of a fast particle which crosses
+        # another one during the timestep but overlaps neither at the
+        # beginning nor at the end of the timestep.
+        sim = rebound.Simulation()
+        sim.integrator = "leapfrog"
+        sim.collision  = "linetree"
+        sim.configure_box(100)
+        sim.dt = 1
+        sim.add(r=1,x=0)
+        sim.add(r=1,x=-10,y=1.5,vx=20)
+        sim.add(r=1,x=30,y=30)
+        with self.assertRaises(rebound.Collision) as context:
+            sim.integrate(1)
+    def test_linetree_miss_swept(self):
+        sim = rebound.Simulation()
+        sim.integrator = "leapfrog"
+        sim.collision  = "linetree"
+        sim.configure_box(100)
+        sim.dt = 1
+        sim.add(r=1,x=0)
+        sim.add(r=1,x=-10,y=2.1,vx=20)
+        sim.add(r=1,x=30,y=30)
+        sim.integrate(1)
+    def test_linetree_same_as_line(self):
+        # The swept volume hierarchy should find exactly the same
+        # collisions as testing all pairs.
+        def run(collision):
+            sim = rebound.Simulation()
+            sim.integrator = "leapfrog"
+            sim.collision  = collision
+            sim.configure_box(200)
+            sim.dt = 0.1
+            np.random.seed(1)
+            for i in range(300):
+                sim.add(r=np.random.uniform(0.05,0.3),
+                        x=np.random.uniform(-20,20), y=np.random.uniform(-20,20), z=np.random.uniform(-2,2),
+                        vx=np.random.normal(0,5), vy=np.random.normal(0,5), vz=np.random.normal(0,0.5), hash=i)
+            # A few particles are much faster than all others.
+            for i in range(5):
+                sim.particles[i].vx *= 5.
+            pairs = []
+            def record(sim_pointer, c):
+                # The tree reorders particles, so they are identified by their hash.
+                ps = sim_pointer.contents.particles
+                h1, h2 = ps[c.p1].hash.value, ps[c.p2].hash.value
+                pairs.append((sim_pointer.contents.steps_done, min(h1,h2), max(h1,h2)))
+                return 0
+            sim.collision_resolve = record
+            for i in range(10):
+                sim.step()
+            return set(pairs)
+        pairs_line = run("line")
+        pairs_linetree = run("linetree")
+        self.assertGreater(len(pairs_line),20)
+        self.assertEqual(pairs_line, pairs_linetree)
 
 
 
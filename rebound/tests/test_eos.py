@@ -103,6 +103,39 @@ class TestEOSn(unittest.TestCase):
         Emax = self._run()
         self.assertAlmostEqual(Emax,0.,delta=1.5e-13)
     
+    def test_fsal(self):
+        # The forces at the end of the postprocessor are reused by the next preprocessor
+        def noop(sim):
+            pass
+        sims = [self.sim, self.sim.copy()]
+        for sim in sims:
+            sim.dt = 0.01*(2.*math.pi)
+            sim.integrator = "eos"
+            sim.ri_eos.phi0 = "pmlf4"
+            sim.ri_eos.phi1 = "lf4"
+            sim.ri_eos.safe_mode = 1
+        sims[1].additional_forces = noop
+        for sim in sims:
+            sim.steps(10)
+            sim.particles[2].x += 1e-6 # invalidates forces
+            sim.steps(10)
+        self.assertEqual(sims[0].ri_eos.force_calculations_done, 20*6+2)
+        self.assertEqual(sims[1].ri_eos.force_calculations_done, 20*7)
+        for p0, p1 in zip(sims[0].particles, sims[1].particles):
+            self.assertEqual(p0.x, p1.x)
+            self.assertEqual(p0.vy, p1.vy)
+
+    def test_timing(self):
+        self.sim.dt = 0.01*(2.*math.pi)
+        self.sim.integrator = "eos"
+        self.sim.ri_eos.phi0 = "lf8"
+        self.sim.ri_eos.phi1 = "lf8"
+        self.sim.ri_eos.safe_mode = 0
+        self.sim.ri_eos.timing = 1
+        self.sim.steps(100)
+        self.assertEqual(self.sim.ri_eos.force_calculations_done, 100*17)
+        self.assertGreater(self.sim.ri_eos.walltime_drift, 0.)
+        self.assertGreater(self.sim.ri_eos.walltime_interaction, 0.)
     
 if __name__ == "__main__":
     unittest.main()
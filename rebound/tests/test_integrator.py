@@ -1,4 +1,5 @@
 import rebound
+import ctypes
 import unittest
 import math
 import rebound.data
@@ -26,6 +27,37 @@ class TestIntegratorWHFastHyper(unittest.TestCase):
         ys = 1.234567*100000.
         self.assertAlmostEqual((y-ys)/ys, 0., delta=1e-10)
 
+class TestIntegratorWHFastLanes(unittest.TestCase):
+    def test_whfast_lanes_same_as_scalar(self):
+        # Without variational particles, the Kepler steps are done in batches 
+        # of lanes. With variational particles, every particle is advanced 
+        # by the scalar solver. The particles must end up in the same place.
+        # The last particle is on a hyperbolic orbit and falls back to the 
+        # scalar solver in either case. 
+        for N_active in [-1, 5]:
+            def setup(variation):
+                sim = rebound.Simulation()
+                sim.add(m=1.)
+                for i in range(12):
+                    sim.add(m=1e-5, a=1.+0.4*i, e=0.05+0.02*i, inc=0.01*i, f=0.5*i)
+                sim.add(m=1e-6, x=30., vx=-0.2, vy=0.6)
+                sim.N_active = N_active
+                sim.testparticle_hidewarnings = 1
+                sim.move_to_com()
+                sim.integrator = "whfast"
+                sim.dt = 0.05
+                if variation:
+                    sim.add_variation()
+                return sim
+            sim_lanes = setup(False)
+            sim_scalar = setup(True)
+            sim_lanes.integrate(20.)
+            sim_scalar.integrate(20.)
+            self.assertGreater(sim_scalar.particles[13].e, 1.)
+            for i in range(sim_lanes.N):
+                self.assertEqual(sim_lanes.particles[i].xyz, sim_scalar.particles[i].xyz)
+                self.assertEqual(sim_lanes.particles[i].vxyz, sim_scalar.particles[i].vxyz)
+
 class TestIntegrator2(unittest.TestCase):
     def test_whfast_verylargedt(self):
         sim = rebound.Simulation()
@@ -67,6 +99,61 @@ class TestIntegrator2(unittest.TestCase):
         x1 = sim.energy()
         self.assertAlmostEqual(x0, x1, delta=1e-14)
 
+class TestIntegratorIAS15Block(unittest.TestCase):
+    def setUp(self):
+        self.sim = rebound.Simulation()
+        self.sim.add(m=1.)
+        self.sim.add(m=1e-10, a=0.05, e=0.1)
+        self.sim.add(m=1e-10, a=0.08, e=0.05, inc=0.1)
+        self.sim.add(m=1e-3, a=5.2, e=0.05)
+        self.sim.add(m=3e-4, a=9.5, e=0.05, inc=0.02)
+        for i in range(10):
+            self.sim.add(m=1e-8, a=12.+2.*i, e=0.05, inc=0.01, f=0.7*i)
+        self.sim.move_to_com()
+
+    def tearDown(self):
+        self.sim = None
+
+    def test_ias15_block(self):
+        sim2 = self.sim.copy()
+        self.sim.ri_ias15.block_levels = 16
+        e0 = self.sim.energy()
+        self.sim.integrate(20.)
+        sim2.integrate(20.)
+        e1 = self.sim.energy()
+        self.assertLess(math.fabs((e0-e1)/e1),1e-14)
+        self.assertLess(self.sim.steps_done*100, sim2.steps_done)
+        levels = [self.sim.ri_ias15._block_level[i] for i in range(self.sim.N)]
+        self.assertGreater(levels[1], levels[3])
+        self.assertGreater(levels[3], levels[-1])
+        # The two runs take different timesteps, so their round-off differs. After
+        # about 280 orbits of the innermost particle, they differ by about 3e-11.
+        for i in range(self.sim.N):
+            self.assertAlmostEqual(self.sim.particles[i].x, sim2.particles[i].x, delta=1e-10)
+            self.assertAlmostEqual(self.sim.particles[i].vy, sim2.particles[i].vy, delta=1e-10)
+        with self.assertRaises(RuntimeError):
+            self.sim.ias15_interpolate(self.sim.t)
+
+    def test_ias15_block_copy(self):
+        self.sim.ri_ias15.block_levels = 16
+        self.sim.integrate(10.)
+        sim2 = self.sim.copy()
+        self.sim.integrate(20.)
+        sim2.integrate(20.)
+        for i in range(self.sim.N):
+            self.assertEqual(self.sim.particles[i].x, sim2.particles[i].x)
+            self.assertEqual(self.sim.particles[i].vy, sim2.particles[i].vy)
+
+    def test_ias15_block_unsupported(self):
+        # Falls back to a global timestep
+        sim2 = self.sim.copy()
+        self.sim.ri_ias15.block_levels = 16
+        self.sim.gravity = "compensated"
+        sim2.gravity = "compensated"
+        self.sim.integrate(1.)
+        sim2.integrate(1.)
+        for i in range(self.sim.N):
+            self.assertEqual(self.sim.particles[i].x, sim2.particles[i].x)
 
 class TestIntegrator(unittest.TestCase):
     def setUp(self):
@@ -112,6 +199,60 @@ class TestIntegrator(unittest.TestCase):
         #e1 = self.sim.energy()
         #self.assertLess(math.fabs((e0-e1)/e1),10**13.5)
     
+    def test_ias15_reset(self):
+        self.sim.integrator = "ias15"
+        self.sim.integrate(100.)
+        arena = ctypes.cast(self.sim.ri_ias15._arena, ctypes.c_void_p).value
+        self.assertNotEqual(arena, None)
+        # After a reset, IAS15 starts from scratch but keeps its memory.
+        sim2 = rebound.Simulation()
+        for p in self.sim.particles:
+            sim2.add(p)
+        sim2.t = self.sim.t
+        sim2.dt = self.sim.dt
+        self.sim.integrator_reset()
+        self.sim.integrate(200.)
+        sim2.integrate(200.)
+        self.assertEqual(arena, ctypes.cast(self.sim.ri_ias15._arena, ctypes.c_void_p).value)
+        for i in range(self.sim.N):
+            self.assertEqual(self.sim.particles[i].x, sim2.particles[i].x)
+            self.assertEqual(self.sim.particles[i].vy, sim2.particles[i].vy)
+    
+    def test_ias15_interpolate(self):
+        self.sim.integrator = "ias15"
+        sim2 = self.sim.copy()
+        self.sim.integrate(100., exact_finish_time=0)
+        t = self.sim.t - 0.3*self.sim.dt_last_done
+        particles = self.sim.ias15_interpolate(t)
+        sim2.integrate(t)
+        for i in range(self.sim.N):
+            self.assertAlmostEqual(particles[i].x, sim2.particles[i].x, delta=1e-12)
+            self.assertAlmostEqual(particles[i].vy, sim2.particles[i].vy, delta=1e-12)
+        with self.assertRaises(RuntimeError):
+            self.sim.ias15_interpolate(self.sim.t+self.sim.dt_last_done)
+
+    def test_ias15_interpolate_stale(self):
+        self.sim.integrator = "ias15"
+        self.sim.integrate(100., exact_finish_time=0)
+        t = self.sim.t - 0.3*self.sim.dt_last_done
+        self.sim.ias15_interpolate(t)
+        # Same N and t, but a different particle
+        p = self.sim.particles[5].copy()
+        p.x += 1.
+        self.sim.remove(5)
+        self.sim.add(p)
+        with self.assertRaises(RuntimeError):
+            self.sim.ias15_interpolate(t)
+        sim2 = self.sim.copy()
+        with self.assertRaises(RuntimeError):
+            sim2.ias15_interpolate(t)
+        sim2.integrate(sim2.t+1., exact_finish_time=0)
+        sim3 = sim2.copy()
+        t = sim2.t - 0.5*sim2.dt_last_done
+        ps2 = sim2.ias15_interpolate(t)
+        ps3 = sim3.ias15_interpolate(t)
+        self.assertEqual(ps2[1].x, ps3[1].x)
+
     def test_ias15_compensated(self):
         self.sim.integrator = "ias15"
         self.sim.gravity = "compensated"
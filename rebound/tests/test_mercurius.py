@@ -316,6 +316,199 @@ class TestMercurius(unittest.TestCase):
         self.assertLess(time_mercurius,time_ias15) # faster than ias15
         self.assertEqual(7060.644251181158, sim.particles[5].x) # Check if bitwise unchanged
         
+    def test_encounter_prediction_bands(self):
+        # Pairs whose radial bands do not overlap are skipped in the 
+        # encounter prediction. Compare the flagged particles to the
+        # test of all pairs.
+        import ctypes
+        import numpy as np
+        import random
+        random.seed(2)
+        sim = rebound.Simulation()
+        sim.add(m=1.)
+        sim.add(m=1e-3, a=1., e=0.05)
+        sim.add(m=3e-4, a=1.3, e=0.1, f=2.)
+        sim.add(m=1e-5, a=2., e=0.3, f=4.)
+        for i in range(300):
+            sim.add(m=0., a=random.uniform(0.7,2.2), e=random.uniform(0,0.3), inc=random.uniform(0,0.05), f=random.uniform(0,6.28), omega=random.uniform(0,6.28), Omega=random.uniform(0,6.28))
+        sim.N_active = 4
+        sim.move_to_com()
+        sim.integrator = "mercurius"
+        sim.ri_mercurius.hillfac = 10.
+        sim.dt = 0.05
+        sim.step() # Allocates arrays and calculates switching radii
+        
+        # First half of the next timestep (positions in democratic heliocentric coordinates)
+        clib = rebound.clibrebound
+        clib.reb_integrator_mercurius_inertial_to_dh(ctypes.byref(sim))
+        N, N_active, dt = sim.N, sim.N_active, sim.dt
+        old = np.array([[p.x, p.y, p.z, p.vx, p.vy, p.vz] for p in sim.particles])
+        clib.reb_integrator_mercurius_backup(ctypes.c_void_p(sim.ri_mercurius._particles_backup), sim._particles, ctypes.c_int(N))
+        clib.reb_integrator_mercurius_kepler_step(ctypes.byref(sim), ctypes.c_double(dt))
+        new = np.array([[p.x, p.y, p.z, p.vx, p.vy, p.vz] for p in sim.particles])
+        clib.reb_integrator_mercurius_encounter_predict(ctypes.byref(sim))
+        flagged = set(i for i in range(1,N) if sim.ri_mercurius._encounter_map[i])
+
+        # Test all pairs with at least one active particle
+        dcrit = np.array([sim.ri_mercurius._dcrit[i] for i in range(N)])
+        i, j = np.triu_indices(N, 1)
+        i, j = i[i<N_active], j[i<N_active]
+        dn, do = new[i]-new[j], old[i]-old[j]
+        rn = dn[:,0]*dn[:,0] + dn[:,1]*dn[:,1] + dn[:,2]*dn[:,2]
+        ro = do[:,0]*do[:,0] + do[:,1]*do[:,1] + do[:,2]*do[:,2]
+        drndt = (dn[:,0]*dn[:,3] + dn[:,1]*dn[:,4] + dn[:,2]*dn[:,5])*2.
+        drodt = (do[:,0]*do[:,3] + do[:,1]*do[:,4] + do[:,2]*do[:,5])*2.
+        a = 6.*(ro-rn) + 3.*dt*(drodt+drndt)
+        b = 6.*(rn-ro) - 2.*dt*(2.*drodt+drndt)
+        c = dt*drodt
+        rmin = np.minimum(rn, ro)
+        with np.errstate(divide='ignore', invalid='ignore'):
+            sr = np.sqrt(np.maximum(0., b*b-4.*a*c))
+            for tmin in [(-b+sr)/(2.*a), (-b-sr)/(2.*a)]:
+                rmint = (1.-tmin)*(1.-tmin)*(1.+2.*tmin)*ro + tmin*tmin*(3.-2.*tmin)*rn + tmin*(1.-tmin)*(1.-tmin)*dt*drodt - tmin*tmin*(1.-tmin)*dt*drndt
+                inside = (tmin>0.) & (tmin<1.)
+                rmin[inside] = np.minimum(np.maximum(rmint[inside], 0.), rmin[inside])
+        dcritmax = np.maximum(dcrit[i], dcrit[j])
+        encounter = rmin < dcritmax*(1.21*dcritmax)
+        flagged_all_pairs = set(i[encounter]) | set(j[encounter])
+        flagged_all_pairs.discard(0)
+
+        self.assertGreater(len(flagged), 10)
+        self.assertLess(len(flagged), N//2)
+        self.assertEqual(flagged, flagged_all_pairs)
+
+    @unittest.skipUnless(hasattr(rebound.clibrebound, "reb_omp_set_num_threads"), "requires a library compiled with OpenMP")
+    def test_encounter_prediction_threads(self):
+        # The encounter flags and the results should not depend on the number of threads.
+        import ctypes
+        import random
+        clib = rebound.clibrebound
+        def setup():
+            random.seed(3)
+            sim = rebound.Simulation()
+            sim.add(m=1.)
+            sim.add(m=1e-3, a=1., e=0.05)
+            sim.add(m=3e-4, a=1.3, e=0.1, f=2.)
+            for i in range(100):
+                sim.add(m=1e-7, a=random.uniform(0.8,1.6), e=random.uniform(0,0.2), inc=random.uniform(0,0.05), f=random.uniform(0,6.28), omega=random.uniform(0,6.28))
+            for i in range(200):
+                sim.add(m=0., a=random.uniform(0.8,1.6), e=random.uniform(0,0.2), inc=random.uniform(0,0.05), f=random.uniform(0,6.28), omega=random.uniform(0,6.28))
+            sim.N_active = 103
+            sim.move_to_com()
+            sim.integrator = "mercurius"
+            sim.ri_mercurius.hillfac = 10.
+            sim.dt = 0.05
+            return sim
+        def flags(sim, threads):
+            clib.reb_omp_set_num_threads(threads)
+            clib.reb_integrator_mercurius_encounter_predict(ctypes.byref(sim))
+            return [sim.ri_mercurius._encounter_map[i] for i in range(sim.N)]
+        def run(threads):
+            clib.reb_omp_set_num_threads(threads)
+            sim = setup()
+            sim.integrate(2.)
+            return [(p.x, p.y, p.z, p.vx, p.vy, p.vz) for p in sim.particles]
+        try:
+            sim = setup()
+            sim.step()
+            clib.reb_integrator_mercurius_inertial_to_dh(ctypes.byref(sim))
+            clib.reb_integrator_mercurius_backup(ctypes.c_void_p(sim.ri_mercurius._particles_backup), sim._particles, ctypes.c_int(sim.N))
+            clib.reb_integrator_mercurius_kepler_step(ctypes.byref(sim), ctypes.c_double(sim.dt))
+            flags1 = flags(sim, 1)
+            self.assertGreater(sum(1 for f in flags1 if f), 10)
+            self.assertEqual(flags1, flags(sim, 3))
+            self.assertEqual(run(1), run(3))
+        finally:
+            clib.reb_omp_set_num_threads(os.cpu_count())
+
+    def test_independent_encounters(self):
+        # Three planets are far apart. Each has a test particle passing
+        # close to it, so there are three separate clusters of encounters
+        # in every step. The clusters are integrated independently: each 
+        # test particle ends up exactly where it ends up in a simulation 
+        # without the other two test particles.
+        def run(tps):
+            sim = rebound.Simulation()
+            sim.add(m=1)
+            for a in [1.,2.,3.]:
+                sim.add(m=1e-4, a=a)
+            for k in tps:
+                a = [1.,2.,3.][k]
+                sim.add(a=a*1.03, f=-0.06+0.01*k)
+            sim.N_active = 4
+            sim.move_to_com()
+            sim.integrator = "mercurius"
+            sim.dt = 0.01
+            encounter_steps = 0
+            for i in range(300):
+                sim.step()
+                # Steps in which all test particles are within the 
+                # switching radius of their planet (hillfac=3).
+                if all(sim.particles[4+n]**sim.particles[1+k] < 3.*sim.particles[1+k].rhill for n,k in enumerate(tps)):
+                    encounter_steps += 1
+            return sim, encounter_steps
+        sim, encounter_steps = run([0,1,2])
+        self.assertGreater(encounter_steps,50)
+        for k in range(3):
+            sim_single, encounter_steps = run([k])
+            self.assertEqual(sim.particles[4+k].xyz, sim_single.particles[4].xyz)
+            self.assertEqual(sim.particles[4+k].vxyz, sim_single.particles[4].vxyz)
+            for i in range(4):
+                self.assertEqual(sim.particles[i].xyz, sim_single.particles[i].xyz)
+
+    @unittest.skipUnless(hasattr(rebound.clibrebound, "reb_omp_set_num_threads"), "requires a library compiled with OpenMP")
+    def test_independent_encounters_threads(self):
+        # Two planets far apart are each surrounded by many test particles.
+        # The two large clusters are integrated concurrently if more than
+        # one thread is available. The results should not depend on it.
+        import random
+        clib = rebound.clibrebound
+        def run(threads):
+            clib.reb_omp_set_num_threads(threads)
+            random.seed(4)
+            sim = rebound.Simulation()
+            sim.add(m=1)
+            sim.add(m=1e-4, a=1.)
+            sim.add(m=1e-4, a=3., f=3.)
+            for a, f in [(1.,0.),(3.,3.)]:
+                for i in range(40):
+                    sim.add(a=a*(1.+random.choice([-1,1])*random.uniform(0.035,0.06)), f=f+random.uniform(-0.08,0.08))
+            sim.N_active = 3
+            sim.move_to_com()
+            sim.integrator = "mercurius"
+            sim.dt = 0.01
+            for i in range(20):
+                sim.step()
+            return [(p.x, p.y, p.z, p.vx, p.vy, p.vz) for p in sim.particles]
+        try:
+            self.assertEqual(run(1), run(3))
+        finally:
+            clib.reb_omp_set_num_threads(os.cpu_count())
+
+    def test_star_encounter(self):
+        # An eccentric planet has close pericentre passages with the star
+        # while a test particle has an encounter with another planet.
+        sim = rebound.Simulation()
+        sim.add(m=1.)
+        sim.add(m=1e-3, a=1., e=0.95)
+        sim.add(m=1e-3, a=5., e=0.01, f=2.)
+        sim.add(m=0., a=5., e=0.01, f=2.001)
+        sim.move_to_com()
+        sim.integrator = "mercurius"
+        sim.dt = 0.005
+        E0 = sim.energy()
+        star_encounters = 0
+        while sim.t<30.:
+            sim.step()
+            if sim.particles[1].d<0.1:
+                # Encounters with the star are massive encounters:
+                # the planet keeps its IAS15 trajectory.
+                star_encounters += 1
+                self.assertEqual(sim.ri_mercurius._tponly_encounter,0)
+        self.assertGreater(star_encounters,0)
+        dE = abs((sim.energy() - E0)/E0)
+        self.assertLess(dE,1e-3)
+
 
 
 if __name__ == "__main__":
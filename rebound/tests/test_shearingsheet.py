@@ -60,5 +60,36 @@ class TestShearingSheet(unittest.TestCase):
         with self.assertRaises(RuntimeError):
             sim.remove(0,keepSorted=1)
 
+    def test_fused_boundary(self):
+        # SEI applies the shear boundary conditions in the same pass as the drift
+        # unless post_timestep_modifications is set. Both must agree exactly.
+        def setup():
+            sim = rebound.Simulation()
+            sim.ri_sei.OMEGA = 1.
+            sim.dt = 1e-2
+            sim.configure_box(10.)
+            sim.integrator = "sei"
+            sim.boundary   = "shear"
+            sim.gravity    = "none"
+            np.random.seed(1)
+            for i in range(1000):
+                x = np.random.uniform(low=-5., high=5.)
+                sim.add(m=1., x=x, y=np.random.uniform(low=-5., high=5.), z=np.random.normal(scale=0.1),
+                        vx=np.random.normal(scale=0.5), vy=-1.5*x)
+            return sim
+        sim1 = setup()
+        sim2 = setup()
+        def noop(simp):
+            pass
+        sim2.post_timestep_modifications = noop
+        sim1.integrate(20.)
+        sim2.integrate(20.)
+        for i in range(sim1.N):
+            self.assertEqual(sim1.particles[i].x, sim2.particles[i].x)
+            self.assertEqual(sim1.particles[i].y, sim2.particles[i].y)
+            self.assertEqual(sim1.particles[i].vy, sim2.particles[i].vy)
+            self.assertLessEqual(abs(sim1.particles[i].x), 5.)
+            self.assertLessEqual(abs(sim1.particles[i].y), 5.)
+
 if __name__ == "__main__":
     unittest.main()
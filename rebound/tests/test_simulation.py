@@ -287,6 +287,68 @@ class TestSimulationCollisions(unittest.TestCase):
         self.sim.integrate(1.)
         self.assertAlmostEqual(self.sim.particles[0].x,-1,delta=1e-15)
 
+class TestSimulationProfiling(unittest.TestCase):
+    def setUp(self):
+        self.sim = rebound.Simulation()
+        self.sim.add(m=1.)
+        self.sim.add(m=1e-3, a=1., e=0.1)
+        self.sim.add(m=1e-3, a=2., e=0.1)
+    
+    def tearDown(self):
+        self.sim = None
+
+    def test_disabled(self):
+        self.assertEqual(self.sim.profiling, False)
+        self.assertEqual(self.sim.profiling_report(), None)
+        sim2 = self.sim.copy()
+        sim2.profiling = True
+        self.sim.integrate(10.)
+        sim2.integrate(10.)
+        # Profiling does not change the results
+        self.assertEqual(self.sim.particles[1].x, sim2.particles[1].x)
+
+    def test_whfast(self):
+        self.sim.integrator = "whfast"
+        self.sim.dt = 0.01
+        self.sim.profiling = True
+        self.sim.integrate(10.)
+        report = self.sim.profiling_report()
+        c = report["categories"]
+        self.assertEqual(len(c), 15)
+        self.assertEqual(c["kepler"]["calls"], 2*self.sim.steps_done) # two half drifts in safe mode
+        self.assertEqual(c["gravity"]["calls"], self.sim.steps_done)
+        self.assertEqual(c["encounter_step"]["calls"], 0)
+        exclusive = sum(c[k]["time"] for k in ["integrator", "boundary", "gravity", "collision", "heartbeat"])
+        self.assertLessEqual(exclusive, report["elapsed"])
+        self.assertLessEqual(c["kepler"]["time"], c["integrator"]["time"])
+        self.sim.profiling_reset()
+        self.assertEqual(self.sim.profiling_report()["categories"]["kepler"]["calls"], 0)
+        self.sim.profiling = False
+        self.assertEqual(self.sim.profiling_report(), None)
+
+    def test_ias15(self):
+        self.sim.profiling = True
+        self.sim.integrate(10.)
+        c = self.sim.profiling_report()["categories"]
+        # Force calculations within the integrator step count as gravity
+        self.assertGreater(c["gravity"]["calls"], self.sim.steps_done)
+        self.assertEqual(c["gravity"]["calls"], c["force_walk"]["calls"])
+        self.assertGreaterEqual(c["integrator"]["time"], 0.)
+
+    def test_counters(self):
+        # Counters might not be available (e.g. on virtual machines).
+        # The profiler then only measures times.
+        counters = self.sim.profiling_enable_counters()
+        for counter in counters:
+            self.assertIn(counter, rebound.simulation.PROFILING_COUNTERS)
+        self.assertEqual(self.sim.profiling, True)
+        self.sim.integrate(10.)
+        c = self.sim.profiling_report()["categories"]
+        self.assertGreater(c["gravity"]["calls"], 0)
+        for counter in counters:
+            self.assertGreaterEqual(c["gravity"][counter], 0)
+        if "instructions" in counters:
+            self.assertGreater(c["gravity"]["instructions"], 0)
     
     
 if __name__ == "__main__":
@@ -210,6 +210,35 @@ class TestIntegratorWHFast(unittest.TestCase):
         self.assertLess(abs(o1.a-o3.a),2e-16)
         self.assertLess(abs(o2.a-o4.a),2e-16)
 
+    @unittest.skipUnless(hasattr(rebound.clibrebound, "reb_omp_set_num_threads"), "requires a library compiled with OpenMP")
+    def test_whfast_threads(self):
+        # The coordinate transformations use OpenMP for many particles.
+        # The results should not depend on the number of threads.
+        import os
+        import random
+        clib = rebound.clibrebound
+        def run(coordinates, threads):
+            clib.reb_omp_set_num_threads(threads)
+            random.seed(1)
+            sim = rebound.Simulation()
+            sim.add(m=1.)
+            sim.add(m=1e-3, a=1., e=0.05)
+            sim.add(m=3e-4, a=2., e=0.1, f=2.)
+            sim.add(m=1e-4, a=3.5, e=0.02, f=4.)
+            for i in range(1200):
+                sim.add(a=random.uniform(4.,8.), e=random.uniform(0.,0.1), inc=random.uniform(0.,0.05), f=random.uniform(0.,6.28))
+            sim.N_active = 4
+            sim.integrator = "whfast"
+            sim.ri_whfast.coordinates = coordinates
+            sim.dt = 0.05
+            sim.integrate(1.)
+            return [(p.x, p.y, p.z, p.vx, p.vy, p.vz) for p in sim.particles]
+        try:
+            for coordinates in ["jacobi", "democraticheliocentric", "whds"]:
+                self.assertEqual(run(coordinates, 1), run(coordinates, 3))
+        finally:
+            clib.reb_omp_set_num_threads(os.cpu_count())
+
     def test_whfasthelio_outersolarsystem(self):
         sim = rebound.Simulation()
         rebound.data.add_outer_solar_system(sim)
@@ -302,6 +331,32 @@ class TestIntegratorWHFast(unittest.TestCase):
         self.assertNotEqual(e0,0.)
         e1 = sim.energy()
         self.assertLess(math.fabs((e0-e1)/e1),2.9e-8)
+    
+    def test_whfasthelio_fixed_n(self):
+        # Systems with up to 16 particles use kernels specialized for N. 
+        # A massless test particle forces the generic code path. 
+        # The results must be bitwise identical.
+        for N in [2, 3, 5, 9, 16]:
+            for safe_mode in [1, 0]:
+                sim1 = rebound.Simulation()
+                sim1.add(m=1.)
+                for i in range(1,N):
+                    sim1.add(m=1e-5*i, a=1.+0.3*i, e=0.02*(i%10), inc=0.01*i, f=0.7*i)
+                sim1.move_to_com()
+                sim1.integrator = "whfast"
+                sim1.ri_whfast.coordinates = "democraticheliocentric"
+                sim1.ri_whfast.safe_mode = safe_mode
+                sim1.dt = 0.05
+                sim2 = sim1.copy()
+                sim2.add(m=0., a=50., f=1.)
+                sim2.N_active = N
+                sim1.integrate(50., exact_finish_time=0)
+                sim2.integrate(50., exact_finish_time=0)
+                for i in range(N):
+                    self.assertEqual(sim1.particles[i].x, sim2.particles[i].x)
+                    self.assertEqual(sim1.particles[i].y, sim2.particles[i].y)
+                    self.assertEqual(sim1.particles[i].vx, sim2.particles[i].vx)
+                    self.assertEqual(sim1.particles[i].vz, sim2.particles[i].vz)
 
 
 class TestIntegratorWHFastBackAndForth(unittest.TestCase):
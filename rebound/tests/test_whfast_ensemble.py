@@ -0,0 +1,96 @@
+import rebound
+import unittest
+import math
+import ctypes
+
+def template(corrector=0, megno=False):
+    sim = rebound.Simulation()
+    sim.add(m=1.)
+    sim.add(m=1e-3, a=1., e=0.05, inc=0.02)
+    sim.add(m=2e-3, a=1.6, e=0.1, inc=0.01, f=1.)
+    sim.add(m=1e-4, a=2.7, e=0.2, inc=0.05, f=2.)
+    sim.move_to_com()
+    sim.integrator = "whfast"
+    sim.ri_whfast.safe_mode = 0
+    sim.ri_whfast.corrector = corrector
+    sim.dt = 0.0371
+    if megno:
+        sim.init_megno(seed=1)
+    return sim
+
+def replica(sim, k):
+    s = sim.copy()
+    s.particles[2].m *= 1.+0.1*k
+    s.particles[3].x += 1e-3*k
+    return s
+
+class TestWHFastEnsemble(unittest.TestCase):
+    def compare(self, corrector, megno):
+        sim = template(corrector, megno)
+        N_replicas = 5
+        ens = rebound.WHFastEnsemble(sim, N_replicas)
+        sims = [replica(sim, k) for k in range(N_replicas)]
+        for k in range(N_replicas):
+            ens.set_particles(k, sims[k])
+        for tmax in [10., 47.3]:
+            ens.integrate(tmax)
+            for s in sims:
+                s.integrate(tmax, exact_finish_time=0)
+        self.assertEqual(ens.t, sims[0].t)
+        dE = ens.energy_error()
+        for k in range(N_replicas):
+            s = sims[k]
+            ps = ens.particles(k)
+            for i in range(s.N-s.N_var):
+                self.assertEqual(ps[i].x, s.particles[i].x)
+                self.assertEqual(ps[i].vz, s.particles[i].vz)
+            self.assertLess(dE[k], 1e-5)
+            if megno:
+                self.assertEqual(ens.megno()[k], s.calculate_megno())
+                self.assertEqual(ens.lyapunov()[k], s.calculate_lyapunov())
+        self.assertEqual(ens.status(), [0]*N_replicas)
+
+    def test_plain(self):
+        self.compare(0, False)
+
+    def test_corrector(self):
+        self.compare(11, False)
+
+    def test_megno(self):
+        self.compare(0, True)
+        self.compare(17, True)
+
+    def test_escape(self):
+        sim = template()
+        sim.exit_max_distance = 5.
+        ens = rebound.WHFastEnsemble(sim, 3)
+        s = sim.copy()
+        s.particles[3].vx += 2.
+        ens.set_particles(1, s)
+        ens.integrate(100.)
+        status = ens.status()
+        self.assertEqual(status[0], 0)
+        self.assertEqual(status[1], 2)
+        self.assertEqual(status[2], 0)
+        t_exit = ens.t_exit()
+        self.assertGreater(t_exit[1], 0.)
+        self.assertLess(t_exit[1], 100.)
+
+    def test_null_arrays(self):
+        ens = rebound.WHFastEnsemble(template(), 2)
+        ens.integrate(1.)
+        # NULL pointers are not set
+        cl = rebound.clibrebound
+        cl.reb_whfast_ensemble_get_status(ctypes.c_void_p(ens._e), None, None)
+        cl.reb_whfast_ensemble_get_energy_error(ctypes.c_void_p(ens._e), None)
+        cl.reb_whfast_ensemble_get_megno(ctypes.c_void_p(ens._e), None, None)
+        self.assertLess(max(ens.energy_error()), 1e-4)
+
+    def test_unsupported(self):
+        sim = template()
+        sim.ri_whfast.coordinates = "democraticheliocentric"
+        with self.assertRaises(RuntimeError):
+            rebound.WHFastEnsemble(sim, 2)
+
+if __name__ == "__main__":
+    unittest.main()
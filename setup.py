@@ -30,6 +30,7 @@ libreboundmodule = Extension('librebound',
                     sources = [ 'src/rebound.c',
                                 'src/integrator_ias15.c',
                                 'src/integrator_whfast.c',
+                                'src/integrator_whfast_ensemble.c',
                                 'src/integrator_saba.c',
                                 'src/integrator_mercurius.c',
                                 'src/integrator_eos.c',
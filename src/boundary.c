@@ -82,41 +82,15 @@ void reb_boundary_check(struct reb_simulation* const r){
 			}
 			break;
 		case REB_BOUNDARY_SHEAR:
-		{
-			// The offset of ghostcell is time dependent.
-			const double OMEGA = r->ri_sei.OMEGA;
-			const double offsetp1 = -fmod(-1.5*OMEGA*boxsize.x*r->t+boxsize.y/2.,boxsize.y)-boxsize.y/2.; 
-			const double offsetm1 = -fmod( 1.5*OMEGA*boxsize.x*r->t-boxsize.y/2.,boxsize.y)+boxsize.y/2.; 
-			struct reb_particle* const particles = r->particles;
+			if (r->ri_sei.boundary_checked){
+				// Already applied by the SEI integrator in the same pass as the drift.
+				r->ri_sei.boundary_checked = 0;
+				break;
+			}
 #pragma omp parallel for schedule(guided)
-			for (int i=0;i<N;i++){
-				// Radial
-				while(particles[i].x>boxsize.x/2.){
-					particles[i].x -= boxsize.x;
-					particles[i].y += offsetp1;
-					particles[i].vy += 3./2.*OMEGA*boxsize.x;
-				}
-				while(particles[i].x<-boxsize.x/2.){
-					particles[i].x += boxsize.x;
-					particles[i].y += offsetm1;
-					particles[i].vy -= 3./2.*OMEGA*boxsize.x;
-				}
-				// Azimuthal
-				while(particles[i].y>boxsize.y/2.){
-					particles[i].y -= boxsize.y;
-				}
-				while(particles[i].y<-boxsize.y/2.){
-					particles[i].y += boxsize.y;
-				}
-				// Vertical (there should be no boundary, but periodic makes life easier)
-				while(particles[i].z>boxsize.z/2.){
-					particles[i].z -= boxsize.z;
-				}
-				while(particles[i].z<-boxsize.z/2.){
-					particles[i].z += boxsize.z;
-				}
+			for (int i=0;i<N;i+=REB_BOUNDARY_BLOCK_SIZE){
+				reb_boundary_check_shear(r, i, i+REB_BOUNDARY_BLOCK_SIZE<N ? i+REB_BOUNDARY_BLOCK_SIZE : N);
 			}
-		}
 		break;
 		case REB_BOUNDARY_PERIODIC:
 #pragma omp parallel for schedule(guided)
@@ -148,6 +122,42 @@ void reb_boundary_check(struct reb_simulation* const r){
 
 const static struct reb_ghostbox nan_ghostbox = {.shiftx = 0, .shifty = 0, .shiftz = 0, .shiftvx = 0, .shiftvy = 0, .shiftvz = 0};
 
+void reb_boundary_check_shear(struct reb_simulation* const r, const int start, const int end){
+	const struct reb_vec3d boxsize = r->boxsize;
+	// The offset of ghostcell is time dependent.
+	const double OMEGA = r->ri_sei.OMEGA;
+	const double offsetp1 = -fmod(-1.5*OMEGA*boxsize.x*r->t+boxsize.y/2.,boxsize.y)-boxsize.y/2.; 
+	const double offsetm1 = -fmod( 1.5*OMEGA*boxsize.x*r->t-boxsize.y/2.,boxsize.y)+boxsize.y/2.; 
+	struct reb_particle* const particles = r->particles;
+	for (int i=start;i<end;i++){
+		// Radial
+		while(particles[i].x>boxsize.x/2.){
+			particles[i].x -= boxsize.x;
+			particles[i].y += offsetp1;
+			particles[i].vy += 3./2.*OMEGA*boxsize.x;
+		}
+		while(particles[i].x<-boxsize.x/2.){
+			particles[i].x += boxsize.x;
+			particles[i].y += offsetm1;
+			particles[i].vy -= 3./2.*OMEGA*boxsize.x;
+		}
+		// Azimuthal
+		while(particles[i].y>boxsize.y/2.){
+			particles[i].y -= boxsize.y;
+		}
+		while(particles[i].y<-boxsize.y/2.){
+			particles[i].y += boxsize.y;
+		}
+		// Vertical (there should be no boundary, but periodic makes life easier)
+		while(particles[i].z>boxsize.z/2.){
+			particles[i].z -= boxsize.z;
+		}
+		while(particles[i].z<-boxsize.z/2.){
+			particles[i].z += boxsize.z;
+		}
+	}
+}
+
 struct reb_ghostbox reb_boundary_get_ghostbox(struct reb_simulation* const r, int i, int j, int k){
 	switch(r->boundary){
 		case REB_BOUNDARY_OPEN:
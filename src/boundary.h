@@ -33,6 +33,22 @@
  */
 void reb_boundary_check(struct reb_simulation* r);
 
+/**
+ * @brief Number of particles processed at once by blocked boundary checks.
+ * @details One block of particles fits into the L1 cache.
+ */
+#define REB_BOUNDARY_BLOCK_SIZE 128
+
+/**
+ * @brief Applies shear boundary conditions to particles start to end-1.
+ * @details Integrators can call this on a block of particles they have just 
+ * updated, so that the particles are only loaded once per timestep. 
+ * @param r REBOUND Simulation to consider
+ * @param start Index of the first particle.
+ * @param end Index after the last particle.
+ */
+void reb_boundary_check_shear(struct reb_simulation* const r, const int start, const int end);
+
 /**
  * @brief Creates a ghostbox.
  * @param r REBOUND Simulation to consider
@@ -39,6 +39,7 @@
 #include "rebound.h"
 #include "boundary.h"
 #include "tree.h"
+#include "output.h"
 #ifdef MPI
 #include "communication_mpi.h"
 #endif // MPI
@@ -46,7 +47,9 @@
 #define MAX(a, b) ((a) > (b) ? (a) : (b))    ///< Returns the maximum of a and b
 
 static void reb_tree_get_nearest_neighbour_in_cell(struct reb_simulation* const r, int* collisions_N, struct reb_ghostbox gb, struct reb_ghostbox gbunmod, int ri, double p1_r,  double* nearest_r2, struct reb_collision* collision_nearest, struct reb_treecell* c);
-static void reb_tree_check_for_overlapping_trajectories_in_cell(struct reb_simulation* const r, int* collisions_N, struct reb_ghostbox gb, struct reb_ghostbox gbunmod, int ri, double p1_r, double p1_r_plus_dtv, struct reb_collision* collision_nearest, struct reb_treecell* c, double maxdrift);
+static void reb_collision_bvh_check_for_overlapping_trajectories_in_node(struct reb_simulation* const r, int* collisions_N, struct reb_ghostbox gb, struct reb_ghostbox gbunmod, double p1_r, const double* min, const double* max, struct reb_collision* collision_nearest, int index);
+static void reb_collision_bvh_build(struct reb_simulation* const r);
+static double reb_collision_bvh_refit(struct reb_simulation* const r);
 
 void reb_collision_search(struct reb_simulation* const r){
     int N = r->N - r->N_var;
@@ -65,6 +68,7 @@ void reb_collision_search(struct reb_simulation* const r){
     }
     int collisions_N = 0;
     const struct reb_particle* const particles = r->particles;
+    struct reb_profiling_mark profiling_start = reb_profiling_start(r);
     switch (r->collision){
         case REB_COLLISION_NONE:
         break;
@@ -270,23 +274,24 @@ void reb_collision_search(struct reb_simulation* const r){
         break;
         case REB_COLLISION_LINETREE:
         {
-            // Calculate max drift (can also be stored in tree for further speedup)
-            double vmax2 = 0.;
-            for (int i=0;i<N;i++){
-                struct reb_particle p1 = particles[i];
-                vmax2 = MAX(vmax2, p1.vx*p1.vx + p1.vy*p1.vy + p1.vz*p1.vz);
-            }
-            double maxdrift = r->dt_last_done*sqrt(vmax2);
             // Update and simplify tree. 
-            // Prepare particles for distribution to other nodes. 
+            // This removes particles which left the box.
             reb_tree_update(r);          
+            
+            const int N = r->N - r->N_var;
+            // Refit the bounding volume hierarchy of swept volumes. 
+            // Rebuild it if the number of particles changed or the refitted hierarchy became too loose.
+            if (r->collision_bvh_N != N || reb_collision_bvh_refit(r) > 2.*r->collision_bvh_cost){
+                reb_collision_bvh_build(r);
+            }
+            if (N==0) break;
 
             // Loop over ghost boxes, but only the inner most ring.
             int nghostxcol = (r->nghostx>1?1:r->nghostx);
             int nghostycol = (r->nghosty>1?1:r->nghosty);
             int nghostzcol = (r->nghostz>1?1:r->nghostz);
             const struct reb_particle* const particles = r->particles;
-            const int N = r->N - r->N_var;
+            const double dt_last_done = r->dt_last_done;
             // Loop over all particles
 #pragma omp parallel for schedule(guided)
             for (int i=0;i<N;i++){
@@ -297,9 +302,6 @@ void reb_collision_search(struct reb_simulation* const r){
                 struct reb_collision collision_nearest;
                 collision_nearest.p1 = i;
                 collision_nearest.p2 = -1;
-                double p1_r = p1.r;
-                // Add drift during last timestep
-                double p1_r_plus_dtv = p1_r + r->dt_last_done*sqrt(p1.vx*p1.vx + p1.vy*p1.vy + p1.vz*p1.vz);
                 // Loop over ghost boxes.
                 for (int gbx=-nghostxcol; gbx<=nghostxcol; gbx++){
                 for (int gby=-nghostycol; gby<=nghostycol; gby++){
@@ -313,13 +315,15 @@ void reb_collision_search(struct reb_simulation* const r){
                     gb.shiftvx += p1.vx; 
                     gb.shiftvy += p1.vy; 
                     gb.shiftvz += p1.vz; 
-                    // Loop over all root boxes.
-                    for (int ri=0;ri<r->root_n;ri++){
-                        struct reb_treecell* rootcell = r->tree_root[ri];
-                        if (rootcell!=NULL){
-                            reb_tree_check_for_overlapping_trajectories_in_cell(r, &collisions_N, gb, gbunmod,ri,p1_r,p1_r_plus_dtv,&collision_nearest,rootcell,maxdrift);
-                        }
+                    // Swept volume of the shifted particle during the last timestep.
+                    const double start[3] = {gb.shiftx - dt_last_done*gb.shiftvx, gb.shifty - dt_last_done*gb.shiftvy, gb.shiftz - dt_last_done*gb.shiftvz};
+                    const double end[3] = {gb.shiftx, gb.shifty, gb.shiftz};
+                    double min[3], max[3];
+                    for (int k=0;k<3;k++){
+                        min[k] = MIN(start[k],end[k]) - p1.r;
+                        max[k] = MAX(start[k],end[k]) + p1.r;
                     }
+                    reb_collision_bvh_check_for_overlapping_trajectories_in_node(r, &collisions_N, gb, gbunmod, p1.r, min, max, &collision_nearest, 0);
                 }
                 }
                 }
@@ -332,6 +336,9 @@ void reb_collision_search(struct reb_simulation* const r){
             reb_exit("Collision routine not implemented.");
     }
 
+    reb_profiling_stop(r, REB_PROFILING_CAT_COLLISION_SEARCH, profiling_start);
+    profiling_start = reb_profiling_start(r);
+
     // randomize
     for (int i=0;i<collisions_N;i++){
         int new = rand_r(&(r->rand_seed))%collisions_N;
@@ -453,6 +460,7 @@ void reb_collision_search(struct reb_simulation* const r){
             }
         }
     }
+    reb_profiling_stop(r, REB_PROFILING_CAT_COLLISION_RESOLVE, profiling_start);
 }
 
 /**
@@ -562,67 +570,234 @@ static void reb_tree_get_nearest_neighbour_in_cell(struct reb_simulation* const
 }
 
 
-static void reb_tree_check_for_overlapping_trajectories_in_cell(struct reb_simulation* const r, int* collisions_N, struct reb_ghostbox gb, struct reb_ghostbox gbunmod, int ri, double p1_r, double p1_r_plus_dtv, struct reb_collision* collision_nearest, struct reb_treecell* c, double maxdrift){
+void reb_collision_bvh_delete(struct reb_simulation* const r){
+    free(r->collision_bvh);
+    r->collision_bvh = NULL;
+    r->collision_bvh_allocatedN = 0;
+    r->collision_bvh_N = 0;
+}
+
+/**
+ * @brief Calculates the axis aligned bounding box of the volume swept by a particle during the last timestep.
+ * @details Particles are assumed to move along straight lines (same assumption as in the exact test).
+ */
+static void reb_collision_bvh_set_leaf(const struct reb_simulation* const r, struct reb_bvhnode* const node){
+    const struct reb_particle p = r->particles[node->pt];
+    const double dt_last_done = r->dt_last_done;
+    const double start[3] = {p.x - dt_last_done*p.vx, p.y - dt_last_done*p.vy, p.z - dt_last_done*p.vz};
+    const double end[3] = {p.x, p.y, p.z};
+    for (int k=0;k<3;k++){
+        node->min[k] = MIN(start[k],end[k]) - p.r;
+        node->max[k] = MAX(start[k],end[k]) + p.r;
+    }
+}
+
+/**
+ * @brief Merges the bounding boxes of the two daughters of a node.
+ * @return Surface area of the merged box.
+ */
+static double reb_collision_bvh_merge_daughters(struct reb_bvhnode* const nodes, struct reb_bvhnode* const node){
+    const struct reb_bvhnode* const l = &nodes[node->left];
+    const struct reb_bvhnode* const ri = &nodes[node->right];
+    for (int k=0;k<3;k++){
+        node->min[k] = MIN(l->min[k],ri->min[k]);
+        node->max[k] = MAX(l->max[k],ri->max[k]);
+    }
+    const double wx = node->max[0]-node->min[0];
+    const double wy = node->max[1]-node->min[1];
+    const double wz = node->max[2]-node->min[2];
+    return wx*wy + wy*wz + wz*wx;
+}
+
+static inline double reb_collision_bvh_coordinate(const struct reb_particle p, const int axis){
+    switch (axis){
+        case 0:
+            return p.x;
+        case 1:
+            return p.y;
+        default:
+            return p.z;
+    }
+}
+
+/**
+ * @brief Recursively builds the bounding volume hierarchy using a median split along the longest axis.
+ * @param r REBOUND simulation to operate on
+ * @param pts Array of particle indices belonging to this node. Will be reordered.
+ * @param n Number of particles in this node
+ * @param next Pointer to the index of the next free node
+ * @return Index of the node created
+ */
+static int reb_collision_bvh_build_node(struct reb_simulation* const r, int* pts, int n, int* next){
+    struct reb_bvhnode* const nodes = r->collision_bvh;
+    const int index = (*next)++;
+    struct reb_bvhnode* node = &nodes[index];
+    if (n==1){
+        node->left = -1;
+        node->right = -1;
+        node->pt = pts[0];
+        reb_collision_bvh_set_leaf(r, node);
+        return index;
+    }
+    // Find axis with the largest extent of particle positions
     const struct reb_particle* const particles = r->particles;
-    if (c->pt>=0){     
-        // c is a leaf node
-        if (c->pt != collision_nearest->p1){
-            struct reb_particle p2 = particles[c->pt];
-            double dt_done_last = r->dt_last_done;
-            const double dx1 = gb.shiftx - p2.x; // distance at beginning
-            const double dy1 = gb.shifty - p2.y;
-            const double dz1 = gb.shiftz - p2.z;
-            const double r1 = (dx1*dx1 + dy1*dy1 + dz1*dz1);
-            const double dvx1 = gb.shiftvx - p2.vx; 
-            const double dvy1 = gb.shiftvy - p2.vy;
-            const double dvz1 = gb.shiftvz - p2.vz;
-            const double dx2 = dx1 -dt_done_last*dvx1; // distance at end
-            const double dy2 = dy1 -dt_done_last*dvy1;
-            const double dz2 = dz1 -dt_done_last*dvz1;
-            const double r2 = (dx2*dx2 + dy2*dy2 + dz2*dz2);
-            const double t_closest = (dx1*dvx1 + dy1*dvy1 + dz1*dvz1)/(dvx1*dvx1 + dvy1*dvy1 + dvz1*dvz1);
-
-            double rmin2_ab = MIN(r1,r2);
-            if (t_closest/dt_done_last>=0. && t_closest/dt_done_last<=1.){
-                const double dx3 = dx1-t_closest*dvx1; // closest approach
-                const double dy3 = dy1-t_closest*dvy1;
-                const double dz3 = dz1-t_closest*dvz1;
-                const double r3 = (dx3*dx3 + dy3*dy3 + dz3*dz3);
-                rmin2_ab = MIN(rmin2_ab, r3);
-            }
-            double rsum = p1_r + p2.r;
-            if (rmin2_ab>rsum*rsum) return;
-            collision_nearest->ri = ri;
-            collision_nearest->p2 = c->pt;
-            collision_nearest->gb = gbunmod;
-            // Save collision in collisions array.
-#pragma omp critical
-            {
-                if (r->collisions_allocatedN<=(*collisions_N)){
-                    // Init to 32 if no space has been allocated yet, otherwise double it.
-                    r->collisions_allocatedN = r->collisions_allocatedN ? r->collisions_allocatedN * 2 : 32;
-                    r->collisions = realloc(r->collisions,sizeof(struct reb_collision)*r->collisions_allocatedN);
-                }
-                r->collisions[(*collisions_N)] = *collision_nearest;
-                (*collisions_N)++;
-            }
+    double min[3] = {INFINITY, INFINITY, INFINITY};
+    double max[3] = {-INFINITY, -INFINITY, -INFINITY};
+    for (int i=0;i<n;i++){
+        for (int k=0;k<3;k++){
+            const double x = reb_collision_bvh_coordinate(particles[pts[i]], k);
+            min[k] = MIN(min[k],x);
+            max[k] = MAX(max[k],x);
         }
-    }else{        
-        // c is not a leaf node
-        double dx = gb.shiftx - c->x;
-        double dy = gb.shifty - c->y;
-        double dz = gb.shiftz - c->z;
-        double r2 = dx*dx + dy*dy + dz*dz;
-        double rp  = p1_r_plus_dtv + maxdrift + 0.86602540378443*c->w;
-        // Check if we need to decent into daughter cells
-        if (r2 < rp*rp ){
-            for (int o=0;o<8;o++){
-                struct reb_treecell* d = c->oct[o];
-                if (d!=NULL){
-                    reb_tree_check_for_overlapping_trajectories_in_cell(r, collisions_N, gb,gbunmod,ri,p1_r,p1_r_plus_dtv,collision_nearest,d,maxdrift);
-                }
+    }
+    int axis = 0;
+    if (max[1]-min[1] > max[axis]-min[axis]) axis = 1;
+    if (max[2]-min[2] > max[axis]-min[axis]) axis = 2;
+    // Partially sort particles around the median (quickselect)
+    const int half = n/2;
+    int lo = 0;
+    int hi = n-1;
+    while (lo<hi){
+        const int pivot = pts[(lo+hi)/2];
+        const double xp = reb_collision_bvh_coordinate(particles[pivot], axis);
+        int i = lo;
+        int j = hi;
+        while (i<=j){
+            while (reb_collision_bvh_coordinate(particles[pts[i]], axis) < xp) i++;
+            while (reb_collision_bvh_coordinate(particles[pts[j]], axis) > xp) j--;
+            if (i<=j){
+                const int tmp = pts[i];
+                pts[i] = pts[j];
+                pts[j] = tmp;
+                i++;
+                j--;
             }
         }
+        if (half<=j){
+            hi = j;
+        }else if (half>=i){
+            lo = i;
+        }else{
+            break;
+        }
+    }
+    node->pt = -1;
+    node->left = reb_collision_bvh_build_node(r, pts, half, next);
+    node->right = reb_collision_bvh_build_node(r, pts+half, n-half, next);
+    return index;
+}
+
+/**
+ * @brief Builds the bounding volume hierarchy from scratch.
+ * @details A hierarchy with N leaves has exactly 2N-1 nodes.
+ */
+static void reb_collision_bvh_build(struct reb_simulation* const r){
+    const int N = r->N - r->N_var;
+    r->collision_bvh_N = N;
+    r->collision_bvh_cost = 0.;
+    if (N==0) return;
+    if (r->collision_bvh_allocatedN < 2*N-1){
+        r->collision_bvh_allocatedN = 2*N-1;
+        r->collision_bvh = realloc(r->collision_bvh, sizeof(struct reb_bvhnode)*r->collision_bvh_allocatedN);
+    }
+    int* pts = malloc(sizeof(int)*N);
+    for (int i=0;i<N;i++){
+        pts[i] = i;
+    }
+    int next = 0;
+    reb_collision_bvh_build_node(r, pts, N, &next);
+    free(pts);
+    // Daughters always have a larger index than their parent.
+    // Loop backwards to calculate bounding boxes bottom up.
+    struct reb_bvhnode* const nodes = r->collision_bvh;
+    for (int i=2*N-2;i>=0;i--){
+        if (nodes[i].pt<0){
+            r->collision_bvh_cost += reb_collision_bvh_merge_daughters(nodes, &nodes[i]);
+        }
+    }
+}
+
+/**
+ * @brief Updates the bounding boxes of an existing hierarchy without changing its topology.
+ * @return Summed surface area of all nodes. If this is much larger than after the last rebuild, the hierarchy should be rebuilt.
+ */
+static double reb_collision_bvh_refit(struct reb_simulation* const r){
+    struct reb_bvhnode* const nodes = r->collision_bvh;
+    double cost = 0.;
+    for (int i=2*r->collision_bvh_N-2;i>=0;i--){
+        if (nodes[i].pt>=0){
+            reb_collision_bvh_set_leaf(r, &nodes[i]);
+        }else{
+            cost += reb_collision_bvh_merge_daughters(nodes, &nodes[i]);
+        }
+    }
+    return cost;
+}
+
+/**
+ * @brief Finds all particles in a node or its daughters whose trajectories overlap with the trajectory of a given particle.
+ * @param r REBOUND simulation to work on.
+ * @param collisions_N Pointer to current number of collisions
+ * @param gb (Shifted) position and velocity of the particle.
+ * @param gbunmod Ghostbox unmodified
+ * @param p1_r Radius of the particle (this is not in gb).
+ * @param min Lower corner of the box swept by the (shifted) particle.
+ * @param max Upper corner of the box swept by the (shifted) particle.
+ * @param collision_nearest Pointer to the nearest collision found so far.
+ * @param index Index of the node currently being searched in.
+ */
+static void reb_collision_bvh_check_for_overlapping_trajectories_in_node(struct reb_simulation* const r, int* collisions_N, struct reb_ghostbox gb, struct reb_ghostbox gbunmod, double p1_r, const double* min, const double* max, struct reb_collision* collision_nearest, int index){
+    const struct reb_bvhnode* const node = &(r->collision_bvh[index]);
+    // Swept volumes do not overlap
+    if (min[0]>node->max[0] || max[0]<node->min[0]) return;
+    if (min[1]>node->max[1] || max[1]<node->min[1]) return;
+    if (min[2]>node->max[2] || max[2]<node->min[2]) return;
+    if (node->pt<0){
+        // node is not a leaf node
+        reb_collision_bvh_check_for_overlapping_trajectories_in_node(r, collisions_N, gb, gbunmod, p1_r, min, max, collision_nearest, node->left);
+        reb_collision_bvh_check_for_overlapping_trajectories_in_node(r, collisions_N, gb, gbunmod, p1_r, min, max, collision_nearest, node->right);
+        return;
+    }
+    // node is a leaf node
+    if (node->pt == collision_nearest->p1) return;
+    const struct reb_particle p2 = r->particles[node->pt];
+    const double dt_done_last = r->dt_last_done;
+    const double dx1 = gb.shiftx - p2.x; // distance at end
+    const double dy1 = gb.shifty - p2.y;
+    const double dz1 = gb.shiftz - p2.z;
+    const double r1 = (dx1*dx1 + dy1*dy1 + dz1*dz1);
+    const double dvx1 = gb.shiftvx - p2.vx; 
+    const double dvy1 = gb.shiftvy - p2.vy;
+    const double dvz1 = gb.shiftvz - p2.vz;
+    const double dx2 = dx1 -dt_done_last*dvx1; // distance at beginning
+    const double dy2 = dy1 -dt_done_last*dvy1;
+    const double dz2 = dz1 -dt_done_last*dvz1;
+    const double r2 = (dx2*dx2 + dy2*dy2 + dz2*dz2);
+    const double t_closest = (dx1*dvx1 + dy1*dvy1 + dz1*dvz1)/(dvx1*dvx1 + dvy1*dvy1 + dvz1*dvz1);
+
+    double rmin2_ab = MIN(r1,r2);
+    if (t_closest/dt_done_last>=0. && t_closest/dt_done_last<=1.){
+        const double dx3 = dx1-t_closest*dvx1; // closest approach
+        const double dy3 = dy1-t_closest*dvy1;
+        const double dz3 = dz1-t_closest*dvz1;
+        const double r3 = (dx3*dx3 + dy3*dy3 + dz3*dz3);
+        rmin2_ab = MIN(rmin2_ab, r3);
+    }
+    double rsum = p1_r + p2.r;
+    if (rmin2_ab>rsum*rsum) return;
+    collision_nearest->ri = reb_get_rootbox_for_particle(r, p2);
+    collision_nearest->p2 = node->pt;
+    collision_nearest->gb = gbunmod;
+    // Save collision in collisions array.
+#pragma omp critical
+    {
+        if (r->collisions_allocatedN<=(*collisions_N)){
+            // Init to 32 if no space has been allocated yet, otherwise double it.
+            r->collisions_allocatedN = r->collisions_allocatedN ? r->collisions_allocatedN * 2 : 32;
+            r->collisions = realloc(r->collisions,sizeof(struct reb_collision)*r->collisions_allocatedN);
+        }
+        r->collisions[(*collisions_N)] = *collision_nearest;
+        (*collisions_N)++;
     }
 }
 
@@ -24,9 +24,30 @@
  */
 #ifndef _COLLISIONS_H
 #define _COLLISIONS_H
+
+/**
+ * @brief One node of the bounding volume hierarchy used by REB_COLLISION_LINETREE.
+ * @details Each leaf contains the axis aligned bounding box of the volume swept 
+ * by one particle during the last timestep. Nodes are stored in pre-order, so the 
+ * daughters of a node always have a larger index than the node itself.
+ */
+struct reb_bvhnode {
+    double min[3];  /**< Lower corner of the axis aligned bounding box */
+    double max[3];  /**< Upper corner of the axis aligned bounding box */
+    int left;       /**< Index of the left daughter node, -1 for leaf nodes */
+    int right;      /**< Index of the right daughter node, -1 for leaf nodes */
+    int pt;         /**< Index of the particle in a leaf node, -1 otherwise */
+};
+
 /**
  * @brief Search for collisions and resolve them.
  */
 void reb_collision_search(struct reb_simulation* const r);
 
+/**
+ * @brief Free the bounding volume hierarchy used by the linetree collision search.
+ * @param r REBOUND simulation to operate on
+ */
+void reb_collision_bvh_delete(struct reb_simulation* const r);
+
 #endif // _COLLISIONS_H
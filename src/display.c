@@ -41,6 +41,7 @@
 #include "display.h"
 #include "output.h"
 #include "integrator.h"
+#include "transformations.h"
 #define MAX(a, b) ((a) < (b) ? (b) : (a))       ///< Returns the maximum of a and b
 
 #ifdef OPENGL
@@ -1072,11 +1073,11 @@ int reb_display_copy_data(struct reb_simulation* const r){
         if (r->ri_whfast.allocated_N > data->allocated_N_whfast){
             size_changed = 1;
             data->allocated_N_whfast = r->ri_whfast.allocated_N;
-            data->p_jh_copy = realloc(data->p_jh_copy,data->allocated_N_whfast*sizeof(struct reb_particle));
+            data->p_jh_copy = realloc(data->p_jh_copy,REB_PARTICLE_SOA_FIELDS*data->allocated_N_whfast*sizeof(double));
         }
-        memcpy(data->p_jh_copy, r->ri_whfast.p_jh, data->allocated_N_whfast*sizeof(struct reb_particle));
+        memcpy(data->p_jh_copy, r->ri_whfast.p_jh.x, REB_PARTICLE_SOA_FIELDS*r->ri_whfast.allocated_N*sizeof(double));
     }
-    data->r_copy->ri_whfast.p_jh= data->p_jh_copy;
+    data->r_copy->ri_whfast.p_jh = reb_particle_soa_from_data(data->p_jh_copy, data->r_copy->ri_whfast.allocated_N);
     
     return size_changed;
 }
@@ -39,7 +39,10 @@
 #include "tree.h"
 #include "boundary.h"
 #include "integrator_mercurius.h"
+#include "output.h"
 #define MAX(a, b) ((a) > (b) ? (a) : (b))    ///< Returns the maximum of a and b
+// Starting a parallel region costs more than the force calculation for small encounters.
+#define MERCURIUS_OPENMP_N_MIN 32   // Minimum number of particles in a MERCURIUS encounter for which OpenMP is used.
 
 #ifdef MPI
 #include "communication_mpi.h"
@@ -63,6 +66,7 @@ void reb_calculate_acceleration(struct reb_simulation* r){
         r->gravity = REB_GRAVITY_BASIC;
 
     }
+    const struct reb_profiling_mark profiling_start = reb_profiling_start(r);
     struct reb_particle* const particles = r->particles;
     const int N = r->N;
     const int N_active = r->N_active;
@@ -623,130 +627,133 @@ void reb_calculate_acceleration(struct reb_simulation* r){
                     const int encounterN = r->ri_mercurius.encounterN;
                     const int encounterNactive = r->ri_mercurius.encounterNactive;
                     int* map = r->ri_mercurius.encounter_map;
-#ifndef OPENMP
-                    particles[0].ax = 0; // map[0] is always 0 
-                    particles[0].ay = 0; 
-                    particles[0].az = 0; 
-                    // Acceleration due to star
-                    for (int i=1; i<encounterN; i++){
-                        int mi = map[i];
-                        const double x = particles[mi].x;
-                        const double y = particles[mi].y;
-                        const double z = particles[mi].z;
-                        const double _r = sqrt(x*x + y*y + z*z + softening2);
-                        double prefact = -G/(_r*_r*_r)*m0;
-                        particles[mi].ax    = prefact*x;
-                        particles[mi].ay    = prefact*y;
-                        particles[mi].az    = prefact*z;
-                    }
-                    // We're in a heliocentric coordinate system.
-                    // The star feels no acceleration
-                    // Interactions between active-active
-                    for (int i=2; i<encounterNactive; i++){
-                        int mi = map[i];
-                        for (int j=1; j<i; j++){
-                            int mj = map[j];
-                            const double dx = particles[mi].x - particles[mj].x;
-                            const double dy = particles[mi].y - particles[mj].y;
-                            const double dz = particles[mi].z - particles[mj].z;
-                            const double _r = sqrt(dx*dx + dy*dy + dz*dz + softening2);
-                            const double dcritmax = MAX(dcrit[mi],dcrit[mj]);
-                            const double L = _L(r,_r,dcritmax);
-                            double prefact = G*(1.-L)/(_r*_r*_r);
-                            double prefactj = -prefact*particles[mj].m;
-                            double prefacti = prefact*particles[mi].m;
-                            particles[mi].ax    += prefactj*dx;
-                            particles[mi].ay    += prefactj*dy;
-                            particles[mi].az    += prefactj*dz;
-                            particles[mj].ax    += prefacti*dx;
-                            particles[mj].ay    += prefacti*dy;
-                            particles[mj].az    += prefacti*dz;
+#ifdef OPENMP
+                    if (encounterN>=MERCURIUS_OPENMP_N_MIN){
+                        particles[0].ax = 0; // map[0] is always 0 
+                        particles[0].ay = 0; 
+                        particles[0].az = 0; 
+                        // We're in a heliocentric coordinate system.
+                        // The star feels no acceleration
+    #pragma omp parallel for schedule(guided)
+                        for (int i=1; i<encounterN; i++){
+                            int mi = map[i];
+                            particles[mi].ax = 0; 
+                            particles[mi].ay = 0; 
+                            particles[mi].az = 0; 
+                            // Acceleration due to star
+                            const double x = particles[mi].x;
+                            const double y = particles[mi].y;
+                            const double z = particles[mi].z;
+                            const double _r = sqrt(x*x + y*y + z*z + softening2);
+                            double prefact = -G/(_r*_r*_r)*m0;
+                            particles[mi].ax    += prefact*x;
+                            particles[mi].ay    += prefact*y;
+                            particles[mi].az    += prefact*z;
+                            for (int j=1; j<encounterNactive; j++){
+                                if (i==j) continue;
+                                int mj = map[j];
+                                const double dx = x - particles[mj].x;
+                                const double dy = y - particles[mj].y;
+                                const double dz = z - particles[mj].z;
+                                const double _r = sqrt(dx*dx + dy*dy + dz*dz + softening2);
+                                const double dcritmax = MAX(dcrit[mi],dcrit[mj]);
+                                const double L = _L(r,_r,dcritmax);
+                                double prefact = -G*particles[mj].m*(1.-L)/(_r*_r*_r);
+                                particles[mi].ax    += prefact*dx;
+                                particles[mi].ay    += prefact*dy;
+                                particles[mi].az    += prefact*dz;
+                            }
                         }
-                    }
-                    // Interactions between active-testparticle
-                    const int startitestp = MAX(encounterNactive,2);
-                    for (int i=startitestp; i<encounterN; i++){
-                        int mi = map[i];
-                        for (int j=1; j<encounterNactive; j++){
-                            int mj = map[j];
-                            const double dx = particles[mi].x - particles[mj].x;
-                            const double dy = particles[mi].y - particles[mj].y;
-                            const double dz = particles[mi].z - particles[mj].z;
-                            const double _r = sqrt(dx*dx + dy*dy + dz*dz + softening2);
-                            const double dcritmax = MAX(dcrit[mi],dcrit[mj]);
-                            const double L = _L(r,_r,dcritmax);
-                            double prefact = G*(1.-L)/(_r*_r*_r);
-                            double prefactj = -prefact*particles[mj].m;
-                            particles[mi].ax    += prefactj*dx;
-                            particles[mi].ay    += prefactj*dy;
-                            particles[mi].az    += prefactj*dz;
-                            if (_testparticle_type){
+                        if (_testparticle_type){
+    #pragma omp parallel for schedule(guided)
+                        for (int i=1; i<encounterNactive; i++){
+                            int mi = map[i];
+                            const double x = particles[mi].x;
+                            const double y = particles[mi].y;
+                            const double z = particles[mi].z;
+                            for (int j=encounterNactive; j<encounterN; j++){
+                                int mj = map[j];
+                                const double dx = x - particles[mj].x;
+                                const double dy = y - particles[mj].y;
+                                const double dz = z - particles[mj].z;
+                                const double _r = sqrt(dx*dx + dy*dy + dz*dz + softening2);
+                                const double dcritmax = MAX(dcrit[mi],dcrit[mj]);
+                                const double L = _L(r,_r,dcritmax);
+                                double prefact = -G*particles[mj].m*(1.-L)/(_r*_r*_r);
+                                particles[mi].ax    += prefact*dx;
+                                particles[mi].ay    += prefact*dy;
+                                particles[mi].az    += prefact*dz;
+                            }
+                        }
+                        }
+                    }else
+#endif // OPENMP
+                    {
+                        particles[0].ax = 0; // map[0] is always 0 
+                        particles[0].ay = 0; 
+                        particles[0].az = 0; 
+                        // Acceleration due to star
+                        for (int i=1; i<encounterN; i++){
+                            int mi = map[i];
+                            const double x = particles[mi].x;
+                            const double y = particles[mi].y;
+                            const double z = particles[mi].z;
+                            const double _r = sqrt(x*x + y*y + z*z + softening2);
+                            double prefact = -G/(_r*_r*_r)*m0;
+                            particles[mi].ax    = prefact*x;
+                            particles[mi].ay    = prefact*y;
+                            particles[mi].az    = prefact*z;
+                        }
+                        // We're in a heliocentric coordinate system.
+                        // The star feels no acceleration
+                        // Interactions between active-active
+                        for (int i=2; i<encounterNactive; i++){
+                            int mi = map[i];
+                            for (int j=1; j<i; j++){
+                                int mj = map[j];
+                                const double dx = particles[mi].x - particles[mj].x;
+                                const double dy = particles[mi].y - particles[mj].y;
+                                const double dz = particles[mi].z - particles[mj].z;
+                                const double _r = sqrt(dx*dx + dy*dy + dz*dz + softening2);
+                                const double dcritmax = MAX(dcrit[mi],dcrit[mj]);
+                                const double L = _L(r,_r,dcritmax);
+                                double prefact = G*(1.-L)/(_r*_r*_r);
+                                double prefactj = -prefact*particles[mj].m;
                                 double prefacti = prefact*particles[mi].m;
+                                particles[mi].ax    += prefactj*dx;
+                                particles[mi].ay    += prefactj*dy;
+                                particles[mi].az    += prefactj*dz;
                                 particles[mj].ax    += prefacti*dx;
                                 particles[mj].ay    += prefacti*dy;
                                 particles[mj].az    += prefacti*dz;
                             }
                         }
-                    }
-#else // OPENMP
-                    particles[0].ax = 0; // map[0] is always 0 
-                    particles[0].ay = 0; 
-                    particles[0].az = 0; 
-                    // We're in a heliocentric coordinate system.
-                    // The star feels no acceleration
-#pragma omp parallel for schedule(guided)
-                    for (int i=1; i<encounterN; i++){
-                        int mi = map[i];
-                        particles[mi].ax = 0; 
-                        particles[mi].ay = 0; 
-                        particles[mi].az = 0; 
-                        // Acceleration due to star
-                        const double x = particles[mi].x;
-                        const double y = particles[mi].y;
-                        const double z = particles[mi].z;
-                        const double _r = sqrt(x*x + y*y + z*z + softening2);
-                        double prefact = -G/(_r*_r*_r)*m0;
-                        particles[mi].ax    += prefact*x;
-                        particles[mi].ay    += prefact*y;
-                        particles[mi].az    += prefact*z;
-                        for (int j=1; j<encounterNactive; j++){
-                            if (i==j) continue;
-                            int mj = map[j];
-                            const double dx = x - particles[mj].x;
-                            const double dy = y - particles[mj].y;
-                            const double dz = z - particles[mj].z;
-                            const double _r = sqrt(dx*dx + dy*dy + dz*dz + softening2);
-                            const double dcritmax = MAX(dcrit[mi],dcrit[mj]);
-                            const double L = _L(r,_r,dcritmax);
-                            double prefact = -G*particles[mj].m*(1.-L)/(_r*_r*_r);
-                            particles[mi].ax    += prefact*dx;
-                            particles[mi].ay    += prefact*dy;
-                            particles[mi].az    += prefact*dz;
-                        }
-                    }
-                    if (_testparticle_type){
-#pragma omp parallel for schedule(guided)
-                    for (int i=1; i<encounterNactive; i++){
-                        int mi = map[i];
-                        const double x = particles[mi].x;
-                        const double y = particles[mi].y;
-                        const double z = particles[mi].z;
-                        for (int j=encounterNactive; j<encounterN; j++){
-                            int mj = map[j];
-                            const double dx = x - particles[mj].x;
-                            const double dy = y - particles[mj].y;
-                            const double dz = z - particles[mj].z;
-                            const double _r = sqrt(dx*dx + dy*dy + dz*dz + softening2);
-                            const double dcritmax = MAX(dcrit[mi],dcrit[mj]);
-                            const double L = _L(r,_r,dcritmax);
-                            double prefact = -G*particles[mj].m*(1.-L)/(_r*_r*_r);
-                            particles[mi].ax    += prefact*dx;
-                            particles[mi].ay    += prefact*dy;
-                            particles[mi].az    += prefact*dz;
+                        // Interactions between active-testparticle
+                        const int startitestp = MAX(encounterNactive,2);
+                        for (int i=startitestp; i<encounterN; i++){
+                            int mi = map[i];
+                            for (int j=1; j<encounterNactive; j++){
+                                int mj = map[j];
+                                const double dx = particles[mi].x - particles[mj].x;
+                                const double dy = particles[mi].y - particles[mj].y;
+                                const double dz = particles[mi].z - particles[mj].z;
+                                const double _r = sqrt(dx*dx + dy*dy + dz*dz + softening2);
+                                const double dcritmax = MAX(dcrit[mi],dcrit[mj]);
+                                const double L = _L(r,_r,dcritmax);
+                                double prefact = G*(1.-L)/(_r*_r*_r);
+                                double prefactj = -prefact*particles[mj].m;
+                                particles[mi].ax    += prefactj*dx;
+                                particles[mi].ay    += prefactj*dy;
+                                particles[mi].az    += prefactj*dz;
+                                if (_testparticle_type){
+                                    double prefacti = prefact*particles[mi].m;
+                                    particles[mj].ax    += prefacti*dx;
+                                    particles[mj].ay    += prefacti*dy;
+                                    particles[mj].az    += prefacti*dz;
+                                }
+                            }
                         }
                     }
-                    }
-#endif // OPENMP
                 }
                 break;
                 case 2: // Skipp WHFAST part because of synchronization
@@ -757,7 +764,7 @@ void reb_calculate_acceleration(struct reb_simulation* r){
         default:
             reb_exit("Gravity calculation not yet implemented.");
     }
-
+    reb_profiling_stop(r, REB_PROFILING_CAT_FORCE_WALK, profiling_start);
 }
 
 void reb_calculate_acceleration_var(struct reb_simulation* r){
@@ -36,6 +36,9 @@
 #include "tree.h"
 #include "simulationarchive.h"
 #include "integrator_tes.h"
+#include "transformations.h"
+#include "integrator_janus.h"
+#include "integrator_ias15.h"
 
 #ifdef MPI
 #include "communication_mpi.h"
@@ -88,22 +91,24 @@ void reb_read_dp7(struct reb_dp7* dp7, const int N3, FILE* inf, char **restrict
     }\
     break;
 
-#define CASE_MALLOC(typename, valueref) case REB_BINARY_FIELD_TYPE_##typename: \
+// IAS15 arrays are stored in an arena (see integrator_ias15.c).
+#define CASE_IAS15(typename, valueref) case REB_BINARY_FIELD_TYPE_##typename: \
     {\
-        valueref = malloc(field.size);\
+        reb_integrator_ias15_reserve(r, field.size/sizeof(double));\
         reb_fread(valueref, field.size,1,inf,mem_stream);\
     }\
     break;
 
-#define CASE_MALLOC_DP7(typename, valueref) case REB_BINARY_FIELD_TYPE_##typename: \
+#define CASE_IAS15_BLOCK(typename, valueref) case REB_BINARY_FIELD_TYPE_##typename: \
     {\
-        valueref.p0 = malloc(field.size/7);\
-        valueref.p1 = malloc(field.size/7);\
-        valueref.p2 = malloc(field.size/7);\
-        valueref.p3 = malloc(field.size/7);\
-        valueref.p4 = malloc(field.size/7);\
-        valueref.p5 = malloc(field.size/7);\
-        valueref.p6 = malloc(field.size/7);\
+        reb_integrator_ias15_block_realloc(r, field.size/sizeof(double));\
+        reb_fread(valueref, field.size,1,inf,mem_stream);\
+    }\
+    break;
+
+#define CASE_IAS15_DP7(typename, valueref) case REB_BINARY_FIELD_TYPE_##typename: \
+    {\
+        reb_integrator_ias15_reserve(r, field.size/7/sizeof(double));\
         reb_fread(valueref.p0, field.size/7,1,inf,mem_stream);\
         reb_fread(valueref.p1, field.size/7,1,inf,mem_stream);\
         reb_fread(valueref.p2, field.size/7,1,inf,mem_stream);\
@@ -222,8 +227,11 @@ int reb_input_field(struct reb_simulation* r, FILE* inf, enum reb_input_binary_m
         CASE(IAS15_EPSILON,      &r->ri_ias15.epsilon);
         CASE(IAS15_MINDT,        &r->ri_ias15.min_dt);
         CASE(IAS15_EPSILONGLOBAL,&r->ri_ias15.epsilon_global);
+        CASE(IAS15_BLOCKLEVELS,  &r->ri_ias15.block_levels);
         CASE(IAS15_ITERATIONSMAX,&r->ri_ias15.iterations_max_exceeded);
         CASE(IAS15_ALLOCATEDN,   &r->ri_ias15.allocatedN);
+        CASE(IAS15_DENSEN,       &r->ri_ias15.dense_N);
+        CASE(IAS15_DENSET,       &r->ri_ias15.dense_t);
         CASE(JANUS_SCALEPOS,     &r->ri_janus.scale_pos);
         CASE(JANUS_SCALEVEL,     &r->ri_janus.scale_vel);
         CASE(JANUS_ORDER,        &r->ri_janus.order);
@@ -256,6 +264,7 @@ int reb_input_field(struct reb_simulation* r, FILE* inf, enum reb_input_binary_m
         CASE(BS_FIRSTORLASTSTEP, &r->ri_bs.firstOrLastStep);
         CASE(BS_PREVIOUSREJECTED,&r->ri_bs.previousRejected);
         CASE(BS_TARGETITER,      &r->ri_bs.targetIter);
+        CASE(BS_PARALLELCOLUMNS, &r->ri_bs.parallel_columns);
         // temporary solution for depreciated SABA k and corrector variables.
         // can be removed in future versions
         case 138: 
@@ -303,23 +312,27 @@ int reb_input_field(struct reb_simulation* r, FILE* inf, enum reb_input_binary_m
             }
             break;
         case REB_BINARY_FIELD_TYPE_WHFAST_PJ:
-            if(r->ri_whfast.p_jh){
-                free(r->ri_whfast.p_jh);
-            }
+            reb_particle_soa_free(&r->ri_whfast.p_jh);
             r->ri_whfast.allocated_N = (int)(field.size/sizeof(struct reb_particle));
             if (field.size){
-                r->ri_whfast.p_jh = malloc(field.size);
-                reb_fread(r->ri_whfast.p_jh, field.size,1,inf,mem_stream);
+                // Stored as an array of particles, used as a structure of arrays internally
+                struct reb_particle* p_jh = malloc(field.size);
+                reb_fread(p_jh, field.size,1,inf,mem_stream);
+                reb_particle_soa_realloc(&r->ri_whfast.p_jh, r->ri_whfast.allocated_N);
+                reb_particle_soa_from_particles(r->ri_whfast.p_jh, p_jh, r->ri_whfast.allocated_N);
+                free(p_jh);
             }
             break;
         case REB_BINARY_FIELD_TYPE_JANUS_PINT:
-            if(r->ri_janus.p_int){
-                free(r->ri_janus.p_int);
-            }
+            reb_particle_int_soa_free(&r->ri_janus.p_int);
             r->ri_janus.allocated_N = (int)(field.size/sizeof(struct reb_particle_int));
             if (field.size){
-                r->ri_janus.p_int = malloc(field.size);
-                reb_fread(r->ri_janus.p_int, field.size,1,inf,mem_stream);
+                // Stored as an array of structs, used as a structure of arrays internally
+                struct reb_particle_int* p_int = malloc(field.size);
+                reb_fread(p_int, field.size,1,inf,mem_stream);
+                reb_particle_int_soa_realloc(&r->ri_janus.p_int, r->ri_janus.allocated_N);
+                reb_particle_int_soa_from_particles_int(r->ri_janus.p_int, p_int, r->ri_janus.allocated_N);
+                free(p_int);
             }
             break;
         case REB_BINARY_FIELD_TYPE_VARCONFIG:
@@ -344,19 +357,21 @@ int reb_input_field(struct reb_simulation* r, FILE* inf, enum reb_input_binary_m
                 reb_fread(r->ri_mercurius.dcrit, field.size,1,inf,mem_stream);
             }
             break;
-        CASE_MALLOC(IAS15_AT,     r->ri_ias15.at);
-        CASE_MALLOC(IAS15_X0,     r->ri_ias15.x0);
-        CASE_MALLOC(IAS15_V0,     r->ri_ias15.v0);
-        CASE_MALLOC(IAS15_A0,     r->ri_ias15.a0);
-        CASE_MALLOC(IAS15_CSX,    r->ri_ias15.csx);
-        CASE_MALLOC(IAS15_CSV,    r->ri_ias15.csv);
-        CASE_MALLOC(IAS15_CSA0,   r->ri_ias15.csa0);
-        CASE_MALLOC_DP7(IAS15_G,  r->ri_ias15.g);
-        CASE_MALLOC_DP7(IAS15_B,  r->ri_ias15.b);
-        CASE_MALLOC_DP7(IAS15_CSB,r->ri_ias15.csb);
-        CASE_MALLOC_DP7(IAS15_E,  r->ri_ias15.e);
-        CASE_MALLOC_DP7(IAS15_BR, r->ri_ias15.br);
-        CASE_MALLOC_DP7(IAS15_ER, r->ri_ias15.er);
+        CASE_IAS15(IAS15_AT,     r->ri_ias15.at);
+        CASE_IAS15(IAS15_X0,     r->ri_ias15.x0);
+        CASE_IAS15(IAS15_V0,     r->ri_ias15.v0);
+        CASE_IAS15(IAS15_A0,     r->ri_ias15.a0);
+        CASE_IAS15(IAS15_CSX,    r->ri_ias15.csx);
+        CASE_IAS15(IAS15_CSV,    r->ri_ias15.csv);
+        CASE_IAS15(IAS15_CSA0,   r->ri_ias15.csa0);
+        CASE_IAS15_DP7(IAS15_G,  r->ri_ias15.g);
+        CASE_IAS15_DP7(IAS15_B,  r->ri_ias15.b);
+        CASE_IAS15_DP7(IAS15_CSB,r->ri_ias15.csb);
+        CASE_IAS15_DP7(IAS15_E,  r->ri_ias15.e);
+        CASE_IAS15_DP7(IAS15_BR, r->ri_ias15.br);
+        CASE_IAS15_DP7(IAS15_ER, r->ri_ias15.er);
+        CASE_IAS15_BLOCK(IAS15_BLOCKDTWANT, r->ri_ias15.block_dt_want);
+        CASE_IAS15_BLOCK(IAS15_BLOCKDTLAST, r->ri_ias15.block_dt_last);
         case REB_BINARY_FIELD_TYPE_END:
             return 0;
         case REB_BINARY_FIELD_TYPE_FUNCTIONPOINTERS:
@@ -223,9 +223,8 @@ void reb_integrator_reset(struct reb_simulation* r){
 }
 
 void reb_update_acceleration(struct reb_simulation* r){
-	// This should probably go elsewhere
-	PROFILING_STOP(PROFILING_CAT_INTEGRATOR)
-	PROFILING_START()
+	// Force calculations count as gravity, not as part of the enclosing integrator step
+	const struct reb_profiling_mark profiling_start = reb_profiling_start(r);
 	reb_calculate_acceleration(r);
 	if (r->N_var){
 		reb_calculate_acceleration_var(r);
@@ -237,27 +236,17 @@ void reb_update_acceleration(struct reb_simulation* r){
             // shift pos and velocity so that external forces are calculated in inertial frame
             // Note: Copying avoids degrading floating point performance
             if(r->N>r->ri_mercurius.allocatedN_additionalforces){
-                r->ri_mercurius.particles_backup_additionalforces = realloc(r->ri_mercurius.particles_backup_additionalforces, r->N*sizeof(struct reb_particle));
+                r->ri_mercurius.particles_backup_additionalforces = realloc(r->ri_mercurius.particles_backup_additionalforces, r->N*sizeof(struct reb_vec6d));
                 r->ri_mercurius.allocatedN_additionalforces = r->N;
             }
-            memcpy(r->ri_mercurius.particles_backup_additionalforces,r->particles,r->N*sizeof(struct reb_particle)); 
+            reb_integrator_mercurius_backup(r->ri_mercurius.particles_backup_additionalforces,r->particles,r->N);
             reb_integrator_mercurius_dh_to_inertial(r);
         }
         r->additional_forces(r);
         if (r->integrator==REB_INTEGRATOR_MERCURIUS){
-            struct reb_particle* restrict const particles = r->particles;
-            struct reb_particle* restrict const backup = r->ri_mercurius.particles_backup_additionalforces;
-            for (int i=0;i<r->N;i++){
-                particles[i].x = backup[i].x;
-                particles[i].y = backup[i].y;
-                particles[i].z = backup[i].z;
-                particles[i].vx = backup[i].vx;
-                particles[i].vy = backup[i].vy;
-                particles[i].vz = backup[i].vz;
-            }
+            reb_integrator_mercurius_restore(r->particles,r->ri_mercurius.particles_backup_additionalforces,r->N);
         }
     }
-	PROFILING_STOP(PROFILING_CAT_GRAVITY)
-	PROFILING_START()
+	reb_profiling_stop_nested(r, REB_PROFILING_CAT_GRAVITY, profiling_start);
 }
 
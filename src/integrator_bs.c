@@ -102,12 +102,62 @@ void reb_integrator_bs_update_particles(struct reb_simulation* r, const double*
 }
 
 
-static int tryStep(struct reb_simulation* r, const int Ns, const int k, const int n, const double t0, const double step) {
-    struct reb_ode** odes = r->odes;
+// The arrays of all ODEs in a simulation are stored in a single 64-byte aligned arena. 
+// The arena is divided into blocks: y0, y1, C, y0Dot, yDot, yTmp, scale, and one block for 
+// each row of D. Within each block the arrays of the ODEs are stored back to back in the 
+// order of r->odes. The integrator can therefore loop over the combined state vector of 
+// all ODEs. The arena is rebuilt whenever an ODE is added or removed. 
+// The state y of an ODE is not part of the arena. It is allocated separately so that 
+// pointers to it remain valid when other ODEs are added or removed. The y0 block holds 
+// a copy of the states of all ODEs during a step.
+enum {
+    ODE_BLOCK_Y0 = 0,
+    ODE_BLOCK_Y1,
+    ODE_BLOCK_C,
+    ODE_BLOCK_Y0DOT,
+    ODE_BLOCK_YDOT,
+    ODE_BLOCK_YTMP,
+    ODE_BLOCK_SCALE,
+    ODE_BLOCK_D,    // First row of D, followed by sequence_length-1 more rows
+};
+
+static double* reb_ode_arena_block(const struct reb_simulation* const r, const int block){
+    const size_t stride = (r->odes_length+7)/8*8; // Blocks start at 64 byte boundaries
+    return r->odes_arena + block*stride;
+}
+
+// Workspace for one column of the extrapolation table if the columns are evaluated in parallel.
+// Every column has its own shallow copy of the simulation (with its own particle array) and
+// shallow copies of the ODEs (with their own y1, yDot, and yTmp arrays). The arena and the 
+// arrays y0Dot and scale are shared with the original ODEs and only read while the columns 
+// are evaluated.
+// The copy of the simulation points to the copies of the ODEs. Callbacks such as 
+// additional_forces therefore need to access the ODEs through the simulation passed to them.
+struct reb_bs_column {
+    struct reb_simulation r;
+    struct reb_ode* odes;
+    struct reb_ode** odes_ptr;
+    int odes_allocatedN;
+    double* data;           // Combined y1, yDot, and yTmp arrays of all ODEs (one block each)
+    long data_allocatedN;
+    int success;            // Return value of tryStep
+};
+
+static int tryStep(struct reb_simulation* r, struct reb_ode** odes, struct reb_ode* nbody_ode, const int Ns, const int k, const int n, const double t0, const double step) {
     const double subStep  = step / n;
     double t = t0;
     int needs_nbody = r->ri_bs.user_ode_needs_nbody;
 
+    // The arrays of all ODEs are stored back to back (see reb_ode_arena_update). 
+    // All loops below run over the combined state vector.
+    const unsigned int length = r->odes_length;
+    const double* const y0 = reb_ode_arena_block(r, ODE_BLOCK_Y0);
+    const double* const y0Dot = odes[0]->y0Dot;
+    const double* const scale = odes[0]->scale;
+    double* const y1 = odes[0]->y1;
+    double* const yDot = odes[0]->yDot;
+    double* const yTmp = odes[0]->yTmp;
+
     // LeapFrog Method did not seem to be of any advantage 
     //    switch (method) {
     //        case 0: // LeapFrog
@@ -203,48 +253,31 @@ static int tryStep(struct reb_simulation* r, const int Ns, const int k, const in
     // Modified Midpoint method
     // first substep
     t += subStep;
-    for (int s=0; s < Ns; s++){
-        double* y0 = odes[s]->y;
-        double* y1 = odes[s]->y1;
-        double* y0Dot = odes[s]->y0Dot;
-        const int length = odes[s]->length;
-        for (int i = 0; i < length; ++i) {
-            y1[i] = y0[i] + subStep * y0Dot[i];
-        }
+    for (unsigned int i = 0; i < length; ++i) {
+        y1[i] = y0[i] + subStep * y0Dot[i];
     }
 
     // other substeps
     if (needs_nbody){
-        reb_integrator_bs_update_particles(r, r->ri_bs.nbody_ode->y1);
+        reb_integrator_bs_update_particles(r, nbody_ode->y1);
     }
     for (int s=0; s < Ns; s++){
         odes[s]->derivatives(odes[s], odes[s]->yDot, odes[s]->y1, t);
     }
-    for (int s=0; s < Ns; s++){
-        double* y0 = odes[s]->y;
-        double* yTmp = odes[s]->yTmp;
-        const int length = odes[s]->length;
-        for (int i = 0; i < length; ++i) {
-            yTmp[i] = y0[i];
-        }
+    for (unsigned int i = 0; i < length; ++i) {
+        yTmp[i] = y0[i];
     }
 
     for (int j = 1; j < n; ++j) {  // Note: iterating n substeps, not 2n substeps as in Eq. (9.13)
         t += subStep;
-        for (int s=0; s < Ns; s++){
-            double* y1 = odes[s]->y1;
-            double* yDot = odes[s]->yDot;
-            double* yTmp = odes[s]->yTmp;
-            const int length = odes[s]->length;
-            for (int i = 0; i < length; ++i) {
-                const double middle = y1[i];
-                y1[i]       = yTmp[i] + 2.* subStep * yDot[i];
-                yTmp[i]       = middle;
-            }
+        for (unsigned int i = 0; i < length; ++i) {
+            const double middle = y1[i];
+            y1[i]       = yTmp[i] + 2.* subStep * yDot[i];
+            yTmp[i]       = middle;
         }
 
         if (needs_nbody){
-            reb_integrator_bs_update_particles(r, r->ri_bs.nbody_ode->y1);
+            reb_integrator_bs_update_particles(r, nbody_ode->y1);
         }
         for (int s=0; s < Ns; s++){
             odes[s]->derivatives(odes[s], odes[s]->yDot, odes[s]->y1, t);
@@ -254,17 +287,11 @@ static int tryStep(struct reb_simulation* r, const int Ns, const int k, const in
         if (j <= maxChecks && k < maxIter) {
             double initialNorm = 0.0;
             double deltaNorm = 0.0;
-            for (int s=0; s < Ns; s++){
-                double* yDot = odes[s]->yDot;
-                double* y0Dot = odes[s]->y0Dot;
-                double* scale = odes[s]->scale;
-                const int length = odes[s]->length;
-                for (int l = 0; l < length; ++l) {
-                    const double ratio1 = y0Dot[l] / scale[l];
-                    initialNorm += ratio1 * ratio1;
-                    const double ratio2 = (yDot[l] - y0Dot[l]) / scale[l];
-                    deltaNorm += ratio2 * ratio2;
-                }
+            for (unsigned int l = 0; l < length; ++l) {
+                const double ratio1 = y0Dot[l] / scale[l];
+                initialNorm += ratio1 * ratio1;
+                const double ratio2 = (yDot[l] - y0Dot[l]) / scale[l];
+                deltaNorm += ratio2 * ratio2;
             }
             if (deltaNorm > 4 * MAX(1.0e-15, initialNorm)) {
                 return 0;
@@ -274,40 +301,33 @@ static int tryStep(struct reb_simulation* r, const int Ns, const int k, const in
     }
 
     // correction of the last substep (at t0 + step)
-    for (int s=0; s < Ns; s++){
-        double* y1 = odes[s]->y1;
-        double* yTmp = odes[s]->yTmp;
-        double* yDot = odes[s]->yDot;
-        const int length = odes[s]->length;
-        for (int i = 0; i < length; ++i) {
-            y1[i] = 0.5 * (yTmp[i] + y1[i] + subStep * yDot[i]); // = 0.25*(y_(2n-1) + 2*y_n(2) + y_(2n+1))     Eq (9.13c)
-        }
+    for (unsigned int i = 0; i < length; ++i) {
+        y1[i] = 0.5 * (yTmp[i] + y1[i] + subStep * yDot[i]); // = 0.25*(y_(2n-1) + 2*y_n(2) + y_(2n+1))     Eq (9.13c)
     }
 
     return 1;
 }
 
-static void extrapolate(const struct reb_ode* ode, double * const coeff, const int k) {
+static void extrapolate(const struct reb_ode* ode, const unsigned int length, double * const coeff, const int k) {
     double* const y1 = ode->y1;
     double* const C = ode->C;  // C and D values follow Numerical Recipes 
     double** const D =  ode->D;
-    double const length = ode->length;
     for (int j = 0; j < k; ++j) {
         double xi = coeff[k-j-1];
         double xim1 = coeff[k];
         double facC = xi/(xi-xim1);
         double facD = xim1/(xi-xim1);
-        for (int i = 0; i < length; ++i) {
+        for (unsigned int i = 0; i < length; ++i) {
             double CD = C[i] - D[k - j -1][i];
             C[i] = facC * CD; // Only need to keep one C value
             D[k - j - 1][i] = facD * CD; // Keep all D values for recursion
         }
     }
-    for (int i = 0; i < length; ++i) {
+    for (unsigned int i = 0; i < length; ++i) {
         y1[i] = D[0][i];
     }
     for (int j = 1; j <= k; ++j) {
-        for (int i = 0; i < length; ++i) {
+        for (unsigned int i = 0; i < length; ++i) {
         y1[i] += D[j][i];
         }
     }
@@ -334,19 +354,130 @@ static void nbody_derivatives(struct reb_ode* ode, double* const yDot, const dou
 }
 
 
-void reb_integrator_bs_part1(struct reb_simulation* r){
-    struct reb_ode** odes = r->odes;
-    int Ns = r->odes_N; // Number of ode sets
+static int reb_integrator_bs_parallel_columns_supported(struct reb_simulation* r){
+    // The N-body derivatives are evaluated on a shallow copy of the simulation. Only 
+    // gravity routines which do not share any state other than the particles are supported.
+    if (r->ri_bs.nbody_ode == NULL){
+        return 1;
+    }
+    switch (r->gravity){
+        case REB_GRAVITY_NONE:
+        case REB_GRAVITY_BASIC:
+        case REB_GRAVITY_COMPENSATED:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void reb_integrator_bs_prepare_column(struct reb_simulation* r, struct reb_bs_column* col){
+    // Keep arrays owned by the column, then make a shallow copy of the simulation.
+    struct reb_particle* particles = col->r.particles;
+    int allocatedN = col->r.allocatedN;
+    struct reb_vec3d* gravity_cs = col->r.gravity_cs;
+    int gravity_cs_allocatedN = col->r.gravity_cs_allocatedN;
+    col->r = *r;
+    if (allocatedN < r->N){
+        allocatedN = r->N;
+        particles = realloc(particles, sizeof(struct reb_particle)*allocatedN);
+    }
+    memcpy(particles, r->particles, sizeof(struct reb_particle)*r->N);
+    col->r.particles = particles;
+    col->r.allocatedN = allocatedN;
+    col->r.gravity_cs = gravity_cs;
+    col->r.gravity_cs_allocatedN = gravity_cs_allocatedN;
+    col->r.profiling = NULL; // Columns run in parallel. Their time is included in the BS step.
+    col->r.messages = NULL;  // Each column collects its own messages. They are merged after the step.
+
+    const int Ns = r->odes_N;
+    if (col->odes_allocatedN < Ns){
+        col->odes_allocatedN = Ns;
+        col->odes = realloc(col->odes, sizeof(struct reb_ode)*Ns);
+        col->odes_ptr = realloc(col->odes_ptr, sizeof(struct reb_ode*)*Ns);
+    }
+    // Same layout as the arena: the arrays of all ODEs are stored back to back.
+    const long length = r->odes_length;
+    if (col->data_allocatedN < 3*length){
+        col->data_allocatedN = 3*length;
+        col->data = realloc(col->data, sizeof(double)*col->data_allocatedN);
+    }
+    long offset = 0;
     for (int s=0; s < Ns; s++){
-        const int length = odes[s]->length;
-        double* y0 = odes[s]->y;
-        double* y1 = odes[s]->y1;
-        for (int i = 0; i < length; ++i) {
-            y1[i] = y0[i];
+        struct reb_ode* ode = &col->odes[s];
+        *ode = *r->odes[s];
+        ode->r = &col->r;
+        ode->y1   = col->data + offset;
+        ode->yDot = col->data + length + offset;
+        ode->yTmp = col->data + 2*length + offset;
+        col->odes_ptr[s] = ode;
+        if (r->odes[s] == r->ri_bs.nbody_ode){
+            col->r.ri_bs.nbody_ode = ode;
+        }
+        offset += ode->length;
+    }
+    col->r.odes = col->odes_ptr;
+}
+
+static void reb_integrator_bs_free_columns(struct reb_simulation_integrator_bs* ri_bs){
+    if (ri_bs->columns){
+        for (int k = 0; k < sequence_length; ++k) {
+            struct reb_bs_column* col = &ri_bs->columns[k];
+            free(col->r.particles);
+            free(col->r.gravity_cs);
+            free(col->odes);
+            free(col->odes_ptr);
+            free(col->data);
+        }
+        free(ri_bs->columns);
+        ri_bs->columns = NULL;
+    }
+}
+
+// Runs the modified midpoint integrations for the columns 0 to kmax concurrently.
+// Every column starts from the same state, so the results are identical to 
+// those of the sequential evaluation in reb_integrator_bs_step.
+static void reb_integrator_bs_try_columns(struct reb_simulation* r, const int kmax, const double t, const double dt){
+    struct reb_simulation_integrator_bs* ri_bs = &r->ri_bs;
+    if (ri_bs->columns == NULL){
+        ri_bs->columns = calloc(sequence_length, sizeof(struct reb_bs_column));
+    }
+    const int Ns = r->odes_N;
+    for (int k = 0; k <= kmax; ++k) {
+        reb_integrator_bs_prepare_column(r, &ri_bs->columns[k]);
+    }
+    // Column k requires sequence[k]+1 derivative evaluations (the increments of costPerStep). 
+    // The most expensive columns are handed out first which balances the load between threads.
+#pragma omp parallel for schedule(dynamic,1)
+    for (int c = 0; c <= kmax; ++c) {
+        const int k = kmax - c;
+        struct reb_bs_column* const col = &ri_bs->columns[k];
+        col->success = tryStep(&col->r, col->odes_ptr, col->r.ri_bs.nbody_ode, Ns, k, ri_bs->sequence[k], t, dt);
+    }
+    // Pass on messages in the order of the sequential evaluation.
+    for (int k = 0; k <= kmax; ++k) {
+        struct reb_bs_column* const col = &ri_bs->columns[k];
+        if (col->r.messages){
+            char buf[1024];
+            while (reb_get_next_message(&col->r, buf)){
+                if (buf[0]=='e'){
+                    reb_error(r, buf+1);
+                }else{
+                    reb_warning(r, buf+1);
+                }
+            }
+            free(col->r.messages);
+            col->r.messages = NULL;
         }
     }
 }
 
+void reb_integrator_bs_part1(struct reb_simulation* r){
+    for (int s=0; s < r->odes_N; s++){
+        struct reb_ode* const ode = r->odes[s];
+        memcpy(ode->y1, ode->y, sizeof(double)*ode->length);
+    }
+}
+
 static void allocate_sequence_arrays(struct reb_simulation_integrator_bs* ri_bs){
     ri_bs->sequence        = malloc(sizeof(int)*sequence_length);
     ri_bs->costPerStep     = malloc(sizeof(int)*sequence_length);
@@ -413,6 +544,7 @@ int reb_integrator_bs_step(struct reb_simulation* r, double dt){
 
     int Ns = r->odes_N; // Number of ode sets
     struct reb_ode** odes = r->odes;
+    const unsigned int length = r->odes_length; // Combined length of all ode sets
     double error;
     int reject = 0;
 
@@ -438,6 +570,16 @@ int reb_integrator_bs_step(struct reb_simulation* r, double dt){
         }
     }
 
+    // Copy the states of all ODEs into the arena
+    {
+        double* const y0 = reb_ode_arena_block(r, ODE_BLOCK_Y0);
+        unsigned int offset = 0;
+        for (int s=0; s < Ns; s++){
+            memcpy(y0 + offset, odes[s]->y, sizeof(double)*odes[s]->length);
+            offset += odes[s]->length;
+        }
+    }
+
     // first evaluation, at the beginning of the step
     for (int s=0; s < Ns; s++){
         odes[s]->derivatives(odes[s], odes[s]->y0Dot, odes[s]->y, t);
@@ -445,6 +587,14 @@ int reb_integrator_bs_step(struct reb_simulation* r, double dt){
 
     const int forward = (dt >= 0.);
 
+    // The iteration below never goes beyond column targetIter+1. If requested, all 
+    // columns up to this one are evaluated concurrently before the iteration starts.
+    int kmax = -1;
+    if (ri_bs->parallel_columns && reb_integrator_bs_parallel_columns_supported(r)){
+        kmax = ri_bs->targetIter + 1;
+        reb_integrator_bs_try_columns(r, kmax, t, dt);
+    }
+
     // iterate over several substep sizes
     int k = -1;
     for (int loop = 1; loop; ) {
@@ -452,7 +602,13 @@ int reb_integrator_bs_step(struct reb_simulation* r, double dt){
         ++k;
         
         // modified midpoint integration with the current substep
-        if ( ! tryStep(r, Ns, k, ri_bs->sequence[k], t, dt)) {
+        int success;
+        if (k <= kmax){
+            success = ri_bs->columns[k].success;
+        }else{
+            success = tryStep(r, odes, ri_bs->nbody_ode, Ns, k, ri_bs->sequence[k], t, dt);
+        }
+        if ( ! success) {
 
             // the stability check failed, we reduce the global step
 #if DEBUG
@@ -463,12 +619,14 @@ int reb_integrator_bs_step(struct reb_simulation* r, double dt){
             loop   = 0;
 
         } else {
-            for (int s=0; s < Ns; s++){
-                const int length = odes[s]->length;
-                for (int i = 0; i < length; ++i) {
-                    double CD = odes[s]->y1[i];
-                    odes[s]->C[i] = CD;
-                    odes[s]->D[k][i] = CD;
+            {
+                const double* y1 = (k <= kmax) ? ri_bs->columns[k].odes[0].y1 : odes[0]->y1;
+                double* const C = odes[0]->C;
+                double* const Dk = odes[0]->D[k];
+                for (unsigned int i = 0; i < length; ++i) {
+                    double CD = y1[i];
+                    C[i] = CD;
+                    Dk[i] = CD;
                 }
             }
 
@@ -477,8 +635,8 @@ int reb_integrator_bs_step(struct reb_simulation* r, double dt){
 
                 // extrapolate the state at the end of the step
                 // using last iteration data
+                extrapolate(odes[0], length, ri_bs->coeff, k);
                 for (int s=0; s < Ns; s++){
-                    extrapolate(odes[s], ri_bs->coeff, k);
                     if (odes[s]->getscale){
                         odes[s]->getscale(odes[s], odes[s]->y, odes[s]->y1);
                     }else{
@@ -488,13 +646,10 @@ int reb_integrator_bs_step(struct reb_simulation* r, double dt){
 
                 // estimate the error at the end of the step.
                 error = 0;
-                //long int combined_length = 0;
-                for (int s=0; s < Ns; s++){
-                    const int length = odes[s]->length;
-                    //combined_length += length;
-                    double * C = odes[s]->C;
-                    double * scale = odes[s]->scale;
-                    for (int j = 0; j < length; ++j) {
+                {
+                    const double* const C = odes[0]->C;
+                    const double* const scale = odes[0]->scale;
+                    for (unsigned int j = 0; j < length; ++j) {
                         const double e = C[j] / scale[j];
                         error = MAX(error, e * e);
                     }
@@ -623,11 +778,9 @@ int reb_integrator_bs_step(struct reb_simulation* r, double dt){
 #if DEBUG
         printf("."); 
 #endif
-        // Swap arrays
+        // Copy the new states back to the ODEs
         for (int s=0; s < Ns; s++){
-            double* y_tmp = odes[s]->y;
-            odes[s]->y = odes[s]->y1; 
-            odes[s]->y1 = y_tmp; 
+            memcpy(odes[s]->y, odes[s]->y1, sizeof(double)*odes[s]->length);
             // Check if ODEs need post timestep call
             if (odes[s]->post_timestep){
                 odes[s]->post_timestep(odes[s], odes[s]->y);
@@ -706,6 +859,38 @@ int reb_integrator_bs_step(struct reb_simulation* r, double dt){
     return !reject;
 }
 
+static void reb_ode_arena_update(struct reb_simulation* r){
+    unsigned int length = 0;
+    for (int s=0; s < r->odes_N; s++){
+        length += r->odes[s]->length;
+    }
+    const size_t stride = (length+7)/8*8; // Blocks start at 64 byte boundaries
+    double* arena = NULL;
+    if (stride){
+        if (posix_memalign((void**)&arena, 64, sizeof(double)*stride*(ODE_BLOCK_D+sequence_length))){
+            // The ODEs would be left without arrays. 
+            reb_exit("Cannot allocate memory for ODEs.");
+        }
+    }
+    unsigned int offset = 0;
+    for (int s=0; s < r->odes_N; s++){
+        struct reb_ode* ode = r->odes[s];
+        ode->y1    = arena + ODE_BLOCK_Y1*stride + offset;
+        ode->C     = arena + ODE_BLOCK_C*stride + offset;
+        ode->y0Dot = arena + ODE_BLOCK_Y0DOT*stride + offset;
+        ode->yDot  = arena + ODE_BLOCK_YDOT*stride + offset;
+        ode->yTmp  = arena + ODE_BLOCK_YTMP*stride + offset;
+        ode->scale = arena + ODE_BLOCK_SCALE*stride + offset;
+        for (int k = 0; k < sequence_length; ++k) {
+            ode->D[k] = arena + (ODE_BLOCK_D+k)*stride + offset;
+        }
+        offset += ode->length;
+    }
+    free(r->odes_arena);
+    r->odes_arena = arena;
+    r->odes_length = length;
+}
+
 struct reb_ode* reb_create_ode(struct reb_simulation* r, unsigned int length){
     struct reb_ode* ode = malloc(sizeof(struct reb_ode));
     
@@ -729,18 +914,9 @@ struct reb_ode* reb_create_ode(struct reb_simulation* r, unsigned int length){
     ode->pre_timestep = NULL;
     ode->post_timestep = NULL;
     ode->D   = malloc(sizeof(double*)*(sequence_length));
-    for (int k = 0; k < sequence_length; ++k) {
-        ode->D[k]   = malloc(sizeof(double)*length);
-    }
+    ode->y   = calloc(length, sizeof(double)); // Not part of the arena
 
-    ode->C     = malloc(sizeof(double)*length);
-    ode->y     = malloc(sizeof(double)*length);
-    ode->y1    = malloc(sizeof(double)*length);
-    ode->y0Dot = malloc(sizeof(double)*length);
-    ode->yTmp  = malloc(sizeof(double)*length);
-    ode->yDot  = malloc(sizeof(double)*length);
-
-    ode->scale = malloc(sizeof(double)*length);
+    reb_ode_arena_update(r); // Sets all other arrays
 
     r->ri_bs.firstOrLastStep = 1;
 
@@ -797,28 +973,6 @@ void reb_integrator_bs_synchronize(struct reb_simulation* r){
 }
 
 void reb_free_ode(struct reb_ode* ode){
-    // Free data array
-    free(ode->y1);
-    ode->y1 = NULL;
-    free(ode->C);
-    ode->C = NULL;
-    free(ode->scale);
-    ode->scale = NULL;
-    
-    if (ode->D){
-        for (int k = 0; k < sequence_length; ++k) {
-            ode->D[k] = NULL;
-        }
-        free(ode->D);
-        ode->D = NULL;
-    }
-    free(ode->y0Dot);
-    ode->y0Dot = NULL;
-    free(ode->yTmp);
-    ode->yTmp = NULL;
-    free(ode->yDot);
-    ode->yDot = NULL;
-    
     struct reb_simulation* r = ode->r;
     if (r){ // only do this is ode is in a simulation
         struct reb_simulation_integrator_bs* ri_bs = &r->ri_bs;
@@ -835,10 +989,35 @@ void reb_free_ode(struct reb_ode* ode){
         if (ri_bs->nbody_ode == ode){
             ri_bs->nbody_ode = NULL;
         }
+        // Other arrays are part of the arena
+        reb_ode_arena_update(r);
     }
+    free(ode->y);
+    free(ode->D);
+    ode->D = NULL;
     free(ode);
 }
 
+void reb_integrator_bs_free_odes_arena(struct reb_simulation* r){
+    // ODEs can outlive the simulation. They keep their state.
+    for (int s=0; s < r->odes_N; s++){
+        struct reb_ode* ode = r->odes[s];
+        ode->y1 = NULL;
+        ode->C = NULL;
+        ode->y0Dot = NULL;
+        ode->yDot = NULL;
+        ode->yTmp = NULL;
+        ode->scale = NULL;
+        for (int k = 0; k < sequence_length; ++k) {
+            ode->D[k] = NULL;
+        }
+        ode->r = NULL;
+    }
+    free(r->odes_arena);
+    r->odes_arena = NULL;
+    r->odes_length = 0;
+}
+
 
 
 void reb_integrator_bs_reset(struct reb_simulation* r){
@@ -862,6 +1041,8 @@ void reb_integrator_bs_reset(struct reb_simulation* r){
     ri_bs->costPerTimeUnit = NULL;
     free(ri_bs->optimalStep);
     ri_bs->optimalStep = NULL;
+
+    reb_integrator_bs_free_columns(ri_bs);
     
     
     // Default settings
@@ -872,5 +1053,6 @@ void reb_integrator_bs_reset(struct reb_simulation* r){
     ri_bs->firstOrLastStep  = 1;
     ri_bs->previousRejected = 0;
     ri_bs->targetIter       = 0;
+    ri_bs->parallel_columns = 0;
         
 }
@@ -30,4 +30,5 @@ void reb_integrator_bs_synchronize(struct reb_simulation* r);    ///< Internal f
 void reb_integrator_bs_reset(struct reb_simulation* r);          ///< Internal function used to call a specific integrator
 void reb_integrator_bs_reset_struct(struct reb_simulation_integrator_bs* ri_bs);
 int reb_integrator_bs_step(struct reb_simulation* r, double dt);
+void reb_integrator_bs_free_odes_arena(struct reb_simulation* r); ///< Detaches all ODEs from the simulation before it is freed
 #endif
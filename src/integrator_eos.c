@@ -29,6 +29,7 @@
 #include <math.h>
 #include <time.h>
 #include <string.h>
+#include <sys/time.h>
 #include "rebound.h"
 #include "integrator.h"
 #include "gravity.h"
@@ -63,11 +64,7 @@ static const double plf7_6_4_b[2] = {1.5171479707207228, -2.0342959414414456000}
 static const double plf7_6_4_z[6] = {-0.3346222298730800, 1.0975679907321640, -1.0380887460967830, 0.6234776317921379, -1.1027532063031910, -0.0141183222088869};
 static const double plf7_6_4_y[6] = {-1.6218101180868010, 0.0061709468110142, 0.8348493592472594, -0.0511253369989315, 0.5633782670698199, -0.5};
                 
-static inline void reb_integrator_eos_interaction_shell0(struct reb_simulation* r, double y, double v){
-    // Calculate gravity using standard gravity routine
-    r->gravity_ignore_terms = 2;
-    r->gravity = REB_GRAVITY_BASIC;
-    reb_update_acceleration(r);
+static inline void reb_integrator_eos_kick_shell0(struct reb_simulation* r, double y, double v){
     if (v!=0.){
         reb_calculate_and_apply_jerk(r,v);
     }
@@ -81,6 +78,14 @@ static inline void reb_integrator_eos_interaction_shell0(struct reb_simulation*
     }
 }
 
+static inline void reb_integrator_eos_interaction_shell0(struct reb_simulation* r, double y, double v){
+    // Calculate gravity using standard gravity routine
+    r->gravity_ignore_terms = 2;
+    r->gravity = REB_GRAVITY_BASIC;
+    reb_update_acceleration(r);
+    r->ri_eos.force_calculations_done++;
+    reb_integrator_eos_kick_shell0(r, y, v);
+}
 static inline void reb_integrator_eos_interaction_shell1(struct reb_simulation* r, double y, double v){
     const int N = r->N;
 	const int N_real   = N - r->N_var;
@@ -305,54 +310,144 @@ static inline void reb_integrator_eos_interaction_shell1(struct reb_simulation*
     }
 
 }
-static inline void reb_integrator_eos_preprocessor(struct reb_simulation* const r, double dt, enum REB_EOS_TYPE type, void (*drift_step)(struct reb_simulation* const r, double a), void (*interaction_step)(struct reb_simulation* const r, double y, double v)){
+// Operators of a splitting method
+enum reb_eos_operator {
+    REB_EOS_OPERATOR_NONE = 0,
+    REB_EOS_OPERATOR_DRIFT = 1,
+    REB_EOS_OPERATOR_INTERACTION = 2,
+};
+
+// One stage of a splitting method. The step is a*dt. Modified interaction 
+// steps also apply a jerk of c*dt^3.
+struct reb_eos_stage {
+    enum reb_eos_operator op;
+    double a;
+    double c;
+};
+
+#define REB_EOS_STAGES_MAX 33       ///< LF8 has the most stages
+#define REB_EOS_PROCESSOR_MAX 12    ///< PMLF6 and PLF7_6_4 have the longest processors
+
+// A splitting method. All methods start and end with a drift of a0*dt. 
+// This drift is not part of the stages, so that it can be combined with 
+// the drift of the next step. The stages alternate between interaction and 
+// drift steps, starting and ending with an interaction step. If present, 
+// the preprocessor is applied before the first step, its inverse (the 
+// postprocessor) when synchronizing. 
+struct reb_eos_scheme {
+    double a0;
+    unsigned int N;
+    struct reb_eos_stage stages[REB_EOS_STAGES_MAX];
+    unsigned int N_processor;
+    struct reb_eos_stage processor[REB_EOS_PROCESSOR_MAX];
+};
+
+static void reb_integrator_eos_add(struct reb_eos_stage* const stages, unsigned int* const N, const enum reb_eos_operator op, const double a, const double c){
+    stages[*N].op = op;
+    stages[*N].a = a;
+    stages[*N].c = c;
+    (*N)++;
+}
+
+static void reb_integrator_eos_scheme(struct reb_eos_scheme* const s, const enum REB_EOS_TYPE type){
+    struct reb_eos_stage* const st = s->stages;
+    struct reb_eos_stage* const pr = s->processor;
+    unsigned int* const N = &s->N;
+    unsigned int* const Np = &s->N_processor;
+    const enum reb_eos_operator D = REB_EOS_OPERATOR_DRIFT;
+    const enum reb_eos_operator I = REB_EOS_OPERATOR_INTERACTION;
+    s->N = 0;
+    s->N_processor = 0;
     switch(type){
-        case REB_EOS_PMLF6:
-            for (int i=0;i<6;i++){
-                drift_step(r, dt*pmlf6_z[i]);
-                interaction_step(r, dt*pmlf6_y[i], dt*dt*dt*pmlf6_v[i]);
+        case REB_EOS_LF:
+            s->a0 = 0.5;
+            reb_integrator_eos_add(st, N, I, 1., 0.);
+            break;
+        case REB_EOS_LF4:
+            s->a0 = lf4_a;
+            reb_integrator_eos_add(st, N, I, 2.*lf4_a, 0.);
+            reb_integrator_eos_add(st, N, D, 0.5-lf4_a, 0.);
+            reb_integrator_eos_add(st, N, I, 1.-4.*lf4_a, 0.);
+            reb_integrator_eos_add(st, N, D, 0.5-lf4_a, 0.);
+            reb_integrator_eos_add(st, N, I, 2.*lf4_a, 0.);
+            break;
+        case REB_EOS_LF6:
+            s->a0 = lf6_a[0]*0.5;
+            for (int i=0;i<4;i++){
+                reb_integrator_eos_add(st, N, I, lf6_a[i], 0.);
+                reb_integrator_eos_add(st, N, D, (lf6_a[i]+lf6_a[i+1])*0.5, 0.);
+            }
+            reb_integrator_eos_add(st, N, I, lf6_a[4], 0.);
+            for (int i=3;i>=0;i--){
+                reb_integrator_eos_add(st, N, D, (lf6_a[i]+lf6_a[i+1])*0.5, 0.);
+                reb_integrator_eos_add(st, N, I, lf6_a[i], 0.);
             }
             break;
-        case REB_EOS_PMLF4:
+        case REB_EOS_LF8:
+            s->a0 = lf8_a[0]*0.5;
+            for (int i=0;i<8;i++){
+                reb_integrator_eos_add(st, N, I, lf8_a[i], 0.);
+                reb_integrator_eos_add(st, N, D, (lf8_a[i]+lf8_a[i+1])*0.5, 0.);
+            }
+            reb_integrator_eos_add(st, N, I, lf8_a[8], 0.);
+            for (int i=7;i>=0;i--){
+                reb_integrator_eos_add(st, N, D, (lf8_a[i]+lf8_a[i+1])*0.5, 0.);
+                reb_integrator_eos_add(st, N, I, lf8_a[i], 0.);
+            }
+            break;
+        case REB_EOS_LF4_2:
+            s->a0 = lf4_2_a;
+            reb_integrator_eos_add(st, N, I, 0.5, 0.);
+            reb_integrator_eos_add(st, N, D, 1.-2.*lf4_2_a, 0.);
+            reb_integrator_eos_add(st, N, I, 0.5, 0.);
+            break;
+        case REB_EOS_LF8_6_4:
+            s->a0 = lf8_6_4_a[0];
             for (int i=0;i<3;i++){
-                interaction_step(r, dt*pmlf4_y[i], 0.);
-                drift_step(r, dt*pmlf4_z[i]);
+                reb_integrator_eos_add(st, N, I, lf8_6_4_b[i], 0.);
+                reb_integrator_eos_add(st, N, D, lf8_6_4_a[i+1], 0.);
+            }
+            reb_integrator_eos_add(st, N, I, lf8_6_4_b[3], 0.);
+            for (int i=2;i>=0;i--){
+                reb_integrator_eos_add(st, N, D, lf8_6_4_a[i+1], 0.);
+                reb_integrator_eos_add(st, N, I, lf8_6_4_b[i], 0.);
             }
             break;
         case REB_EOS_PLF7_6_4:
+            s->a0 = plf7_6_4_a[0];
+            reb_integrator_eos_add(st, N, I, plf7_6_4_b[0], 0.);
+            reb_integrator_eos_add(st, N, D, plf7_6_4_a[1], 0.);
+            reb_integrator_eos_add(st, N, I, plf7_6_4_b[1], 0.);
+            reb_integrator_eos_add(st, N, D, plf7_6_4_a[1], 0.);
+            reb_integrator_eos_add(st, N, I, plf7_6_4_b[0], 0.);
             for (int i=0;i<6;i++){
-                drift_step(r, dt*plf7_6_4_z[i]);
-                interaction_step(r, dt*plf7_6_4_y[i], 0.);
+                reb_integrator_eos_add(pr, Np, D, plf7_6_4_z[i], 0.);
+                reb_integrator_eos_add(pr, Np, I, plf7_6_4_y[i], 0.);
             }
             break;
-        default:
-            break;
-    }
-}
-static inline void reb_integrator_eos_postprocessor(struct reb_simulation* const r, double dt, enum REB_EOS_TYPE type, void (*drift_step)(struct reb_simulation* const r, double a), void (*interaction_step)(struct reb_simulation* const r, double y, double v)){
-    switch(type){
-        case REB_EOS_PMLF6:
-            for (int i=5;i>=0;i--){
-                interaction_step(r, -dt*pmlf6_y[i], -dt*dt*dt*pmlf6_v[i]); 
-                drift_step(r, -dt*pmlf6_z[i]);
-             }
-            break;
         case REB_EOS_PMLF4:
-            for (int i=2;i>=0;i--){
-                drift_step(r, -dt*pmlf4_z[i]);
-                interaction_step(r, -dt*pmlf4_y[i], 0.); 
-             }
-            break;
-        case REB_EOS_PLF7_6_4:
-            for (int i=5;i>=0;i--){
-                interaction_step(r, -dt*plf7_6_4_y[i], 0.);
-                drift_step(r, -dt*plf7_6_4_z[i]);
+            s->a0 = 0.5;
+            reb_integrator_eos_add(st, N, I, 1., 1./24.);
+            for (int i=0;i<3;i++){
+                reb_integrator_eos_add(pr, Np, I, pmlf4_y[i], 0.);
+                reb_integrator_eos_add(pr, Np, D, pmlf4_z[i], 0.);
             }
             break;
-        default:
+        case REB_EOS_PMLF6:
+            s->a0 = pmlf6_a[0];
+            reb_integrator_eos_add(st, N, I, pmlf6_b[0], pmlf6_c[0]);
+            reb_integrator_eos_add(st, N, D, pmlf6_a[1], 0.);
+            reb_integrator_eos_add(st, N, I, pmlf6_b[1], pmlf6_c[1]);
+            reb_integrator_eos_add(st, N, D, pmlf6_a[1], 0.);
+            reb_integrator_eos_add(st, N, I, pmlf6_b[0], pmlf6_c[0]);
+            for (int i=0;i<6;i++){
+                reb_integrator_eos_add(pr, Np, D, pmlf6_z[i], 0.);
+                reb_integrator_eos_add(pr, Np, I, pmlf6_y[i], pmlf6_v[i]);
+            }
             break;
     }
 }
+
 static void reb_integrator_eos_drift_shell1(struct reb_simulation* const r, double dt){
     struct reb_particle* restrict const particles = r->particles;
     unsigned int N = r->N;
@@ -363,178 +458,155 @@ static void reb_integrator_eos_drift_shell1(struct reb_simulation* const r, doub
     } 
 }
 
-static void reb_integrator_eos_drift_shell0(struct reb_simulation* const r, double _dt){
-    struct reb_simulation_integrator_eos* const reos = &(r->ri_eos);
-    const int n = reos->n;
-    const double dt = _dt/n;
-    reb_integrator_eos_preprocessor(r, dt, reos->phi1, reb_integrator_eos_drift_shell1, reb_integrator_eos_interaction_shell1);
-    switch(reos->phi1){
-        case REB_EOS_LF:
-            reb_integrator_eos_drift_shell1(r, dt*0.5); 
-            for (int i=0;i<n;i++){
-                reb_integrator_eos_interaction_shell1(r, dt, 0.);
-                if (i<n-1){
-                    reb_integrator_eos_drift_shell1(r, dt);
-                }
-            }
-            reb_integrator_eos_drift_shell1(r, dt*0.5);
-            break;
-        case REB_EOS_LF4:
-            reb_integrator_eos_drift_shell1(r, dt*lf4_a);
-            for (int i=0;i<n;i++){
-                reb_integrator_eos_interaction_shell1(r, dt*2.*lf4_a, 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(0.5-lf4_a));
-                reb_integrator_eos_interaction_shell1(r, dt*(1.-4.*lf4_a), 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(0.5-lf4_a));
-                reb_integrator_eos_interaction_shell1(r, dt*2.*lf4_a, 0.);
-                if (i<n-1){
-                    reb_integrator_eos_drift_shell1(r, dt*2.*lf4_a);
-                }
-            }
-            reb_integrator_eos_drift_shell1(r, dt*lf4_a);
-            break;
-        case REB_EOS_LF6:
-            reb_integrator_eos_drift_shell1(r, dt*lf6_a[0]*0.5);
-            for (int i=0;i<n;i++){
-                reb_integrator_eos_interaction_shell1(r, dt*lf6_a[0], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf6_a[0]+lf6_a[1])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf6_a[1], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf6_a[1]+lf6_a[2])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf6_a[2], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf6_a[2]+lf6_a[3])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf6_a[3], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf6_a[3]+lf6_a[4])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf6_a[4], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf6_a[3]+lf6_a[4])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf6_a[3], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf6_a[2]+lf6_a[3])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf6_a[2], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf6_a[1]+lf6_a[2])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf6_a[1], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf6_a[0]+lf6_a[1])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf6_a[0], 0.);
-                if (i<n-1){
-                    reb_integrator_eos_drift_shell1(r, dt*lf6_a[0]);
-                }
-            }
-            reb_integrator_eos_drift_shell1(r, dt*lf6_a[0]*0.5);
-            break; 
-        case REB_EOS_LF8: 
-            reb_integrator_eos_drift_shell1(r, dt*lf8_a[0]*0.5);
-            for (int i=0;i<n;i++){
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[0], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[0]+lf8_a[1])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[1], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[1]+lf8_a[2])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[2], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[2]+lf8_a[3])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[3], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[3]+lf8_a[4])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[4], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[4]+lf8_a[5])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[5], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[5]+lf8_a[6])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[6], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[6]+lf8_a[7])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[7], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[7]+lf8_a[8])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[8], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[7]+lf8_a[8])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[7], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[6]+lf8_a[7])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[6], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[5]+lf8_a[6])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[5], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[4]+lf8_a[5])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[4], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[3]+lf8_a[4])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[3], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[2]+lf8_a[3])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[2], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[1]+lf8_a[2])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[1], 0.);
-                reb_integrator_eos_drift_shell1(r, dt*(lf8_a[0]+lf8_a[1])*0.5);
-                reb_integrator_eos_interaction_shell1(r, dt*lf8_a[0], 0.);
-                if (i<n-1){
-                    reb_integrator_eos_drift_shell1(r, dt*lf8_a[0]);
-                }
-            }
-            reb_integrator_eos_drift_shell1(r, dt*lf8_a[0]*0.5);
-            break;
-        case REB_EOS_LF4_2: 
-            reb_integrator_eos_drift_shell1(r, dt*lf4_2_a); 
-            for (int i=0;i<n;i++){
-                reb_integrator_eos_interaction_shell1(r, dt*0.5, 0.); 
-                reb_integrator_eos_drift_shell1(r, dt*(1.-2.*lf4_2_a));
-                reb_integrator_eos_interaction_shell1(r, dt*0.5, 0.); 
-                if (i<n-1){
-                    reb_integrator_eos_drift_shell1(r, 2.*dt*lf4_2_a); 
-                }
-            }
-            reb_integrator_eos_drift_shell1(r, dt*lf4_2_a); 
-            break;
-        case REB_EOS_LF8_6_4:
-            reb_integrator_eos_drift_shell1(r, dt*lf8_6_4_a[0]);   
-            for (int i=0;i<n;i++){
-                reb_integrator_eos_interaction_shell1(r, lf8_6_4_b[0]*dt,0);
-                reb_integrator_eos_drift_shell1(r, lf8_6_4_a[1]*dt);   
-                reb_integrator_eos_interaction_shell1(r, lf8_6_4_b[1]*dt,0);
-                reb_integrator_eos_drift_shell1(r, lf8_6_4_a[2]*dt);   
-                reb_integrator_eos_interaction_shell1(r, lf8_6_4_b[2]*dt,0);
-                reb_integrator_eos_drift_shell1(r, lf8_6_4_a[3]*dt);   
-                reb_integrator_eos_interaction_shell1(r, lf8_6_4_b[3]*dt,0);
-                reb_integrator_eos_drift_shell1(r, lf8_6_4_a[3]*dt);   
-                reb_integrator_eos_interaction_shell1(r, lf8_6_4_b[2]*dt,0);
-                reb_integrator_eos_drift_shell1(r, lf8_6_4_a[2]*dt);   
-                reb_integrator_eos_interaction_shell1(r, lf8_6_4_b[1]*dt,0);
-                reb_integrator_eos_drift_shell1(r, lf8_6_4_a[1]*dt);   
-                reb_integrator_eos_interaction_shell1(r, lf8_6_4_b[0]*dt,0);
-                if (i<n-1){
-                    reb_integrator_eos_drift_shell1(r, 2.*dt*lf8_6_4_a[0]);   
-                }
-            }
-            reb_integrator_eos_drift_shell1(r, dt*lf8_6_4_a[0]);   
-            break;
-        case REB_EOS_PMLF4:
-            reb_integrator_eos_drift_shell1(r, dt*0.5); 
-            for (int i=0;i<n;i++){
-                reb_integrator_eos_interaction_shell1(r, dt, dt*dt*dt/24.); 
-                if (i<n-1){
-                    reb_integrator_eos_drift_shell1(r, dt);
-                }
-            }
-            reb_integrator_eos_drift_shell1(r, dt*0.5);
-            break;
-        case REB_EOS_PMLF6:
-            reb_integrator_eos_drift_shell1(r, dt*pmlf6_a[0]); 
-            for (int i=0;i<n;i++){
-                reb_integrator_eos_interaction_shell1(r, dt*pmlf6_b[0], dt*dt*dt*pmlf6_c[0]); 
-                reb_integrator_eos_drift_shell1(r, dt*pmlf6_a[1]);
-                reb_integrator_eos_interaction_shell1(r, dt*pmlf6_b[1], dt*dt*dt*pmlf6_c[1]); 
-                reb_integrator_eos_drift_shell1(r, dt*pmlf6_a[1]);
-                reb_integrator_eos_interaction_shell1(r, dt*pmlf6_b[0], dt*dt*dt*pmlf6_c[0]);
-                if (i<n-1){
-                    reb_integrator_eos_drift_shell1(r, 2.*dt*pmlf6_a[0]);
-                }
-            }
-            reb_integrator_eos_drift_shell1(r, dt*pmlf6_a[0]);
-            break;
-        case REB_EOS_PLF7_6_4:
-            reb_integrator_eos_drift_shell1(r, dt*plf7_6_4_a[0]);   
-            for (int i=0;i<n;i++){
-                reb_integrator_eos_interaction_shell1(r, plf7_6_4_b[0]*dt,0);
-                reb_integrator_eos_drift_shell1(r, plf7_6_4_a[1]*dt);   
-                reb_integrator_eos_interaction_shell1(r, plf7_6_4_b[1]*dt,0);
-                reb_integrator_eos_drift_shell1(r, plf7_6_4_a[1]*dt);   
-                reb_integrator_eos_interaction_shell1(r, plf7_6_4_b[0]*dt,0);
-                if (i<n-1){
-                    reb_integrator_eos_drift_shell1(r, 2.*dt*plf7_6_4_a[0]);   
-                }
+static void reb_integrator_eos_drift_shell0(struct reb_simulation* const r, double _dt, const struct reb_eos_scheme* const s1);
+
+// Operators are not applied immediately but queued. Consecutive interaction
+// steps are combined into one, requiring only one force calculation. 
+// Consecutive drift steps are only combined if the drift is exact (phi1). 
+// For phi0, a drift is itself an approximate phi1 integration and one long 
+// drift is less accurate than two short ones.
+struct reb_eos_queue {
+    const struct reb_eos_scheme* s1;    // phi1 method. Only set if the operators of phi0 are queued.
+    enum reb_eos_operator op;           // Queued operator 
+    double a;                           // Queued step
+    double v;                           // Queued jerk
+    enum reb_eos_operator last;         // Last operator applied
+};
+
+static void reb_integrator_eos_flush(struct reb_simulation* const r, struct reb_eos_queue* const q){
+    if (q->op==REB_EOS_OPERATOR_NONE){
+        return;
+    }
+    if (q->s1==NULL){
+        if (q->op==REB_EOS_OPERATOR_DRIFT){
+            reb_integrator_eos_drift_shell1(r, q->a);
+        }else{
+            reb_integrator_eos_interaction_shell1(r, q->a, q->v);
+        }
+    }else{
+        struct timeval time_beginning;
+        if (r->ri_eos.timing){
+            gettimeofday(&time_beginning,NULL);
+        }
+        if (q->op==REB_EOS_OPERATOR_DRIFT){
+            reb_integrator_eos_drift_shell0(r, q->a, q->s1);
+        }else{
+            reb_integrator_eos_interaction_shell0(r, q->a, q->v);
+        }
+        if (r->ri_eos.timing){
+            struct timeval time_end;
+            gettimeofday(&time_end,NULL);
+            const double walltime = time_end.tv_sec-time_beginning.tv_sec+(time_end.tv_usec-time_beginning.tv_usec)/1e6;
+            if (q->op==REB_EOS_OPERATOR_DRIFT){
+                r->ri_eos.walltime_drift += walltime;
+            }else{
+                r->ri_eos.walltime_interaction += walltime;
             }
-            reb_integrator_eos_drift_shell1(r, dt*plf7_6_4_a[0]);   
-            break;
+        }
+    }
+    q->last = q->op;
+    q->op = REB_EOS_OPERATOR_NONE;
+}
+
+static void reb_integrator_eos_push(struct reb_simulation* const r, struct reb_eos_queue* const q, const enum reb_eos_operator op, const double a, const double v){
+    if (q->op==op && (op==REB_EOS_OPERATOR_INTERACTION || q->s1==NULL)){
+        q->a += a;
+        q->v += v;
+    }else{
+        reb_integrator_eos_flush(r, q);
+        q->op = op;
+        q->a = a;
+        q->v = v;
+    }
+}
+
+static void reb_integrator_eos_push_stages(struct reb_simulation* const r, struct reb_eos_queue* const q, const struct reb_eos_stage* const stages, const unsigned int N, const double dt){
+    for (unsigned int i=0;i<N;i++){
+        reb_integrator_eos_push(r, q, stages[i].op, dt*stages[i].a, dt*dt*dt*stages[i].c);
+    }
+}
+
+static void reb_integrator_eos_push_postprocessor(struct reb_simulation* const r, struct reb_eos_queue* const q, const struct reb_eos_scheme* const s, const double dt){
+    for (int i=s->N_processor-1;i>=0;i--){
+        reb_integrator_eos_push(r, q, s->processor[i].op, -dt*s->processor[i].a, -dt*dt*dt*s->processor[i].c);
+    }
+}
+
+static void reb_integrator_eos_drift_shell0(struct reb_simulation* const r, double _dt, const struct reb_eos_scheme* const s1){
+    const int n = r->ri_eos.n;
+    const double dt = _dt/n;
+    struct reb_eos_queue q = {0};
+    reb_integrator_eos_push_stages(r, &q, s1->processor, s1->N_processor, dt);
+    for (int i=0;i<n;i++){
+        // The last drift of a substep is combined with the first drift of the next one.
+        reb_integrator_eos_push(r, &q, REB_EOS_OPERATOR_DRIFT, dt*s1->a0, 0.);
+        reb_integrator_eos_push_stages(r, &q, s1->stages, s1->N, dt);
+        reb_integrator_eos_push(r, &q, REB_EOS_OPERATOR_DRIFT, dt*s1->a0, 0.);
     }
-    reb_integrator_eos_postprocessor(r, dt, reos->phi1, reb_integrator_eos_drift_shell1, reb_integrator_eos_interaction_shell1);
+    reb_integrator_eos_push_postprocessor(r, &q, s1, dt);
+    reb_integrator_eos_flush(r, &q);
+}
+
+// First same as last (FSAL): If phi0 ends the postprocessor and starts the 
+// preprocessor with an interaction step, then the forces at the beginning 
+// of a step are those calculated at the end of the last synchronization.
+// They are reused unless the particles have been modified in between.
+struct reb_eos_fsal {
+    int N;
+    int allocated_N;
+    int N_active;
+    int N_var;
+    int testparticle_type;
+    double G;
+    double softening;
+    struct reb_particle* particles;
+};
+
+static void reb_integrator_eos_fsal_store(struct reb_simulation* const r){
+    struct reb_simulation_integrator_eos* const reos = &(r->ri_eos);
+    if (reos->fsal==NULL){
+        reos->fsal = calloc(1, sizeof(struct reb_eos_fsal));
+    }
+    struct reb_eos_fsal* const fsal = reos->fsal;
+    if (fsal->allocated_N < r->N){
+        fsal->particles = realloc(fsal->particles, sizeof(struct reb_particle)*r->N);
+        fsal->allocated_N = r->N;
+    }
+    fsal->N = r->N;
+    fsal->N_active = r->N_active;
+    fsal->N_var = r->N_var;
+    fsal->testparticle_type = r->testparticle_type;
+    fsal->G = r->G;
+    fsal->softening = r->softening;
+    memcpy(fsal->particles, r->particles, sizeof(struct reb_particle)*r->N);
+}
+
+static int reb_integrator_eos_fsal_restore(struct reb_simulation* const r){
+    struct reb_eos_fsal* const fsal = r->ri_eos.fsal;
+    if (fsal==NULL || fsal->N==0){
+        return 0;
+    }
+    const int N = fsal->N;
+    // Velocity dependent or time dependent forces cannot be reused.
+    if (r->additional_forces || N!=r->N || fsal->N_active!=r->N_active || fsal->N_var!=r->N_var || fsal->testparticle_type!=r->testparticle_type || fsal->G!=r->G || fsal->softening!=r->softening){
+        fsal->N = 0;
+        return 0;
+    }
+    struct reb_particle* const particles = r->particles;
+    const struct reb_particle* const ps = fsal->particles;
+    for (int i=0;i<N;i++){
+        if (particles[i].x!=ps[i].x || particles[i].y!=ps[i].y || particles[i].z!=ps[i].z || particles[i].m!=ps[i].m){
+            fsal->N = 0;
+            return 0;
+        }
+    }
+    for (int i=0;i<N;i++){
+        particles[i].ax = ps[i].ax;
+        particles[i].ay = ps[i].ay;
+        particles[i].az = ps[i].az;
+    }
+    fsal->N = 0;
+    return 1;
 }
 
 void reb_integrator_eos_part1(struct reb_simulation* r){
@@ -550,125 +622,27 @@ void reb_integrator_eos_part1(struct reb_simulation* r){
 void reb_integrator_eos_part2(struct reb_simulation* const r){
     struct reb_simulation_integrator_eos* const reos = &(r->ri_eos);
     const double dt = r->dt;
+    struct reb_eos_scheme s, s1;
+    reb_integrator_eos_scheme(&s, reos->phi0);
+    reb_integrator_eos_scheme(&s1, reos->phi1);
+    struct reb_eos_queue q = {.s1 = &s1};
 
-    double dtfac = 1.;
     if (reos->is_synchronized){
-        reb_integrator_eos_preprocessor(r, r->dt, reos->phi0, reb_integrator_eos_drift_shell0, reb_integrator_eos_interaction_shell0);
+        unsigned int first = 0;
+        if (s.N_processor && s.processor[0].op==REB_EOS_OPERATOR_INTERACTION && reb_integrator_eos_fsal_restore(r)){
+            r->gravity_ignore_terms = 2;
+            r->gravity = REB_GRAVITY_BASIC;
+            reb_integrator_eos_kick_shell0(r, dt*s.processor[0].a, dt*dt*dt*s.processor[0].c);
+            first = 1;
+        }
+        reb_integrator_eos_push_stages(r, &q, s.processor+first, s.N_processor-first, dt);
+        reb_integrator_eos_push(r, &q, REB_EOS_OPERATOR_DRIFT, dt*s.a0, 0.);
     }else{
-        dtfac = 2.;
-    }
-    switch(reos->phi0){
-        case REB_EOS_LF:
-            reb_integrator_eos_drift_shell0(r, dt*0.5*dtfac);
-            reb_integrator_eos_interaction_shell0(r, dt, 0.);
-            break;
-        case REB_EOS_LF4:
-            reb_integrator_eos_drift_shell0(r, dt*lf4_a*dtfac);
-            reb_integrator_eos_interaction_shell0(r, dt*2.*lf4_a, 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(0.5-lf4_a));
-            reb_integrator_eos_interaction_shell0(r, dt*(1.-4.*lf4_a), 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(0.5-lf4_a));
-            reb_integrator_eos_interaction_shell0(r, dt*2.*lf4_a, 0.);
-            break;
-        case REB_EOS_LF6:
-            reb_integrator_eos_drift_shell0(r, dt*lf6_a[0]*0.5*dtfac);
-            reb_integrator_eos_interaction_shell0(r, dt*lf6_a[0], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf6_a[0]+lf6_a[1])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf6_a[1], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf6_a[1]+lf6_a[2])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf6_a[2], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf6_a[2]+lf6_a[3])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf6_a[3], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf6_a[3]+lf6_a[4])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf6_a[4], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf6_a[3]+lf6_a[4])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf6_a[3], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf6_a[2]+lf6_a[3])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf6_a[2], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf6_a[1]+lf6_a[2])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf6_a[1], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf6_a[0]+lf6_a[1])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf6_a[0], 0.);
-            break; 
-        case REB_EOS_LF8: 
-            reb_integrator_eos_drift_shell0(r, dt*lf8_a[0]*0.5*dtfac);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[0], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[0]+lf8_a[1])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[1], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[1]+lf8_a[2])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[2], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[2]+lf8_a[3])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[3], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[3]+lf8_a[4])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[4], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[4]+lf8_a[5])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[5], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[5]+lf8_a[6])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[6], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[6]+lf8_a[7])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[7], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[7]+lf8_a[8])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[8], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[7]+lf8_a[8])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[7], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[6]+lf8_a[7])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[6], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[5]+lf8_a[6])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[5], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[4]+lf8_a[5])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[4], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[3]+lf8_a[4])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[3], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[2]+lf8_a[3])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[2], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[1]+lf8_a[2])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[1], 0.);
-            reb_integrator_eos_drift_shell0(r, dt*(lf8_a[0]+lf8_a[1])*0.5);
-            reb_integrator_eos_interaction_shell0(r, dt*lf8_a[0], 0.);
-            break;
-        case REB_EOS_LF4_2: 
-            reb_integrator_eos_drift_shell0(r, dt*lf4_2_a*dtfac); 
-            reb_integrator_eos_interaction_shell0(r, dt*0.5, 0.); 
-            reb_integrator_eos_drift_shell0(r, dt*(1.-2.*lf4_2_a));
-            reb_integrator_eos_interaction_shell0(r, dt*0.5, 0.); 
-            break;
-        case REB_EOS_LF8_6_4:
-            reb_integrator_eos_drift_shell0(r, dt*lf8_6_4_a[0]*dtfac);   
-            reb_integrator_eos_interaction_shell0(r, lf8_6_4_b[0]*dt,0);
-            reb_integrator_eos_drift_shell0(r, lf8_6_4_a[1]*dt);   
-            reb_integrator_eos_interaction_shell0(r, lf8_6_4_b[1]*dt,0);
-            reb_integrator_eos_drift_shell0(r, lf8_6_4_a[2]*dt);   
-            reb_integrator_eos_interaction_shell0(r, lf8_6_4_b[2]*dt,0);
-            reb_integrator_eos_drift_shell0(r, lf8_6_4_a[3]*dt);   
-            reb_integrator_eos_interaction_shell0(r, lf8_6_4_b[3]*dt,0);
-            reb_integrator_eos_drift_shell0(r, lf8_6_4_a[3]*dt);   
-            reb_integrator_eos_interaction_shell0(r, lf8_6_4_b[2]*dt,0);
-            reb_integrator_eos_drift_shell0(r, lf8_6_4_a[2]*dt);   
-            reb_integrator_eos_interaction_shell0(r, lf8_6_4_b[1]*dt,0);
-            reb_integrator_eos_drift_shell0(r, lf8_6_4_a[1]*dt);   
-            reb_integrator_eos_interaction_shell0(r, lf8_6_4_b[0]*dt,0);
-            break;
-        case REB_EOS_PMLF4:
-            reb_integrator_eos_drift_shell0(r, dt*0.5*dtfac); 
-            reb_integrator_eos_interaction_shell0(r, dt, dt*dt*dt/24.); 
-            break;
-        case REB_EOS_PMLF6:
-            reb_integrator_eos_drift_shell0(r, dt*pmlf6_a[0]*dtfac); 
-            reb_integrator_eos_interaction_shell0(r, dt*pmlf6_b[0], dt*dt*dt*pmlf6_c[0]); 
-            reb_integrator_eos_drift_shell0(r, dt*pmlf6_a[1]);
-            reb_integrator_eos_interaction_shell0(r, dt*pmlf6_b[1], dt*dt*dt*pmlf6_c[1]); 
-            reb_integrator_eos_drift_shell0(r, dt*pmlf6_a[1]);
-            reb_integrator_eos_interaction_shell0(r, dt*pmlf6_b[0], dt*dt*dt*pmlf6_c[0]);
-            break;
-        case REB_EOS_PLF7_6_4:
-            reb_integrator_eos_drift_shell0(r, dt*plf7_6_4_a[0]*dtfac);   
-            reb_integrator_eos_interaction_shell0(r, plf7_6_4_b[0]*dt,0);
-            reb_integrator_eos_drift_shell0(r, plf7_6_4_a[1]*dt);   
-            reb_integrator_eos_interaction_shell0(r, plf7_6_4_b[1]*dt,0);
-            reb_integrator_eos_drift_shell0(r, plf7_6_4_a[1]*dt);   
-            reb_integrator_eos_interaction_shell0(r, plf7_6_4_b[0]*dt,0);
-            break;
+        // Combine the last drift of the previous step with the first drift of this step.
+        reb_integrator_eos_push(r, &q, REB_EOS_OPERATOR_DRIFT, 2.*dt*s.a0, 0.);
     }
+    reb_integrator_eos_push_stages(r, &q, s.stages, s.N, dt);
+    reb_integrator_eos_flush(r, &q);
 
     reos->is_synchronized = 0;
     if (reos->safe_mode){
@@ -691,34 +665,16 @@ void reb_integrator_eos_synchronize(struct reb_simulation* r){
     struct reb_simulation_integrator_eos* const reos = &(r->ri_eos);
     const double dt = r->dt;
     if (reos->is_synchronized == 0){
-        switch(reos->phi0){
-            case REB_EOS_PMLF4:
-            case REB_EOS_LF:
-                reb_integrator_eos_drift_shell0(r, dt*0.5); 
-                break;
-            case REB_EOS_PMLF6:
-                reb_integrator_eos_drift_shell0(r, dt*pmlf6_a[0]); 
-                break;
-            case REB_EOS_LF4:
-                reb_integrator_eos_drift_shell0(r, dt*lf4_a);
-                break;
-            case REB_EOS_LF4_2:
-                reb_integrator_eos_drift_shell0(r, dt*lf4_2_a); 
-                break;
-            case REB_EOS_PLF7_6_4:
-                reb_integrator_eos_drift_shell0(r, dt*plf7_6_4_a[0]);   
-                break;
-            case REB_EOS_LF8_6_4:
-                reb_integrator_eos_drift_shell0(r, dt*lf8_6_4_a[0]);   
-                break;
-            case REB_EOS_LF6:
-                reb_integrator_eos_drift_shell0(r, dt*lf6_a[0]*0.5);
-                break;
-            case REB_EOS_LF8: 
-                reb_integrator_eos_drift_shell0(r, dt*lf8_a[0]*0.5);
-                break;
+        struct reb_eos_scheme s, s1;
+        reb_integrator_eos_scheme(&s, reos->phi0);
+        reb_integrator_eos_scheme(&s1, reos->phi1);
+        struct reb_eos_queue q = {.s1 = &s1};
+        reb_integrator_eos_push(r, &q, REB_EOS_OPERATOR_DRIFT, dt*s.a0, 0.);
+        reb_integrator_eos_push_postprocessor(r, &q, &s, dt);
+        reb_integrator_eos_flush(r, &q);
+        if (q.last==REB_EOS_OPERATOR_INTERACTION){
+            reb_integrator_eos_fsal_store(r);
         }
-        reb_integrator_eos_postprocessor(r, r->dt, reos->phi0, reb_integrator_eos_drift_shell0, reb_integrator_eos_interaction_shell0);
         reos->is_synchronized = 1;
     }
 }
@@ -729,5 +685,14 @@ void reb_integrator_eos_reset(struct reb_simulation* r){
     r->ri_eos.phi1 = REB_EOS_LF;
     r->ri_eos.safe_mode = 1;
     r->ri_eos.is_synchronized = 1;
+    r->ri_eos.timing = 0;
+    r->ri_eos.walltime_drift = 0.;
+    r->ri_eos.walltime_interaction = 0.;
+    r->ri_eos.force_calculations_done = 0;
+    if (r->ri_eos.fsal){
+        free(r->ri_eos.fsal->particles);
+        free(r->ri_eos.fsal);
+        r->ri_eos.fsal = NULL;
+    }
 }
 
@@ -40,6 +40,9 @@
 #include <math.h>
 #include <time.h>
 #include <string.h>
+#ifdef OPENMP
+#include <omp.h>
+#endif // OPENMP
 // Uncomment the following line to generate numerical constants with extended precision.
 //#define GENERATE_CONSTANTS
 #ifdef GENERATE_CONSTANTS
@@ -53,6 +56,10 @@ void integrator_generate_constants(void);
 #include "integrator.h"
 #include "integrator_ias15.h"
 
+// The loops over the 3N components are short. OpenMP is only used if 
+// the work per loop outweighs the cost of starting a parallel region.
+#define IAS15_OPENMP_N3_MIN 3000  // Minimum number of components (3N) for which OpenMP is used.
+
 /**
  * @brief Struct containing pointers to intermediate values
  */
@@ -77,7 +84,14 @@ static void predict_next_step(double ratio, int N3,  const struct reb_dpconst7 _
 static const double safety_factor           = 0.25; /**< Maximum increase/deacrease of consecutve timesteps. */
 
 // Gauss Radau spacings
-static const double h[8]    = { 0.0, 0.0562625605369221464656521910318, 0.180240691736892364987579942780, 0.352624717113169637373907769648, 0.547153626330555383001448554766, 0.734210177215410531523210605558, 0.885320946839095768090359771030, 0.977520613561287501891174488626};
+#define IAS15_H1 0.0562625605369221464656521910318
+#define IAS15_H2 0.180240691736892364987579942780
+#define IAS15_H3 0.352624717113169637373907769648
+#define IAS15_H4 0.547153626330555383001448554766
+#define IAS15_H5 0.734210177215410531523210605558
+#define IAS15_H6 0.885320946839095768090359771030
+#define IAS15_H7 0.977520613561287501891174488626
+static const double h[8]    = { 0.0, IAS15_H1, IAS15_H2, IAS15_H3, IAS15_H4, IAS15_H5, IAS15_H6, IAS15_H7};
 // Other constants
 static const double rr[28] = {0.0562625605369221464656522, 0.1802406917368923649875799, 0.1239781311999702185219278, 0.3526247171131696373739078, 0.2963621565762474909082556, 0.1723840253762772723863278, 0.5471536263305553830014486, 0.4908910657936332365357964, 0.3669129345936630180138686, 0.1945289092173857456275408, 0.7342101772154105315232106, 0.6779476166784883850575584, 0.5539694854785181665356307, 0.3815854601022408941493028, 0.1870565508848551485217621, 0.8853209468390957680903598, 0.8290583863021736216247076, 0.7050802551022034031027798, 0.5326962297259261307164520, 0.3381673205085403850889112, 0.1511107696236852365671492, 0.9775206135612875018911745, 0.9212580530243653554255223, 0.7972799218243951369035945, 0.6248958964481178645172667, 0.4303669872307321188897259, 0.2433104363458769703679639, 0.0921996667221917338008147};
 static const double c[21] = {-0.0562625605369221464656522, 0.0101408028300636299864818, -0.2365032522738145114532321, -0.0035758977292516175949345, 0.0935376952594620658957485, -0.5891279693869841488271399, 0.0019565654099472210769006, -0.0547553868890686864408084, 0.4158812000823068616886219, -1.1362815957175395318285885, -0.0014365302363708915424460, 0.0421585277212687077072973, -0.3600995965020568122897665, 1.2501507118406910258505441, -1.8704917729329500633517991, 0.0012717903090268677492943, -0.0387603579159067703699046, 0.3609622434528459832253398, -1.4668842084004269643701553, 2.9061362593084293014237913, -2.7558127197720458314421588};
@@ -97,42 +111,72 @@ static double sqrt7(double a){
     return x;
 }
 
-static void free_dp7(struct reb_dp7* dp7){
-    free(dp7->p0);
-    free(dp7->p1);
-    free(dp7->p2);
-    free(dp7->p3);
-    free(dp7->p4);
-    free(dp7->p5);
-    free(dp7->p6);
-    dp7->p0 = NULL;
-    dp7->p1 = NULL;
-    dp7->p2 = NULL;
-    dp7->p3 = NULL;
-    dp7->p4 = NULL;
-    dp7->p5 = NULL;
-    dp7->p6 = NULL;
-}
-static void clear_dp7(struct reb_dp7* const dp7, const int N3){
-    for (int k=0;k<N3;k++){
-        dp7->p0[k] = 0.;
-        dp7->p1[k] = 0.;
-        dp7->p2[k] = 0.;
-        dp7->p3[k] = 0.;
-        dp7->p4[k] = 0.;
-        dp7->p5[k] = 0.;
-        dp7->p6[k] = 0.;
-    }
-}
-static void realloc_dp7(struct reb_dp7* const dp7, const int N3){
-    dp7->p0 = realloc(dp7->p0,sizeof(double)*N3);
-    dp7->p1 = realloc(dp7->p1,sizeof(double)*N3);
-    dp7->p2 = realloc(dp7->p2,sizeof(double)*N3);
-    dp7->p3 = realloc(dp7->p3,sizeof(double)*N3);
-    dp7->p4 = realloc(dp7->p4,sizeof(double)*N3);
-    dp7->p5 = realloc(dp7->p5,sizeof(double)*N3);
-    dp7->p6 = realloc(dp7->p6,sizeof(double)*N3);
-    clear_dp7(dp7,N3);
+// All arrays of IAS15 are stored in a single 64-byte aligned arena. Each array starts 
+// at a 64 byte boundary and has room for arena_allocatedN doubles. The seven arrays of 
+// g, b, csb, e, br and er follow each other, so all of them can be cleared in one pass.
+// The arena is kept by reb_integrator_ias15_reset() and only reallocated when it needs 
+// to grow. MERCURIUS therefore does not allocate memory for every encounter.
+enum {
+    IAS15_ARENA_AT = 0,
+    IAS15_ARENA_X0,
+    IAS15_ARENA_V0,
+    IAS15_ARENA_A0,
+    IAS15_ARENA_CSX,
+    IAS15_ARENA_CSV,
+    IAS15_ARENA_CSA0,
+    IAS15_ARENA_G,              // Seven arrays each
+    IAS15_ARENA_B   = IAS15_ARENA_G+7,
+    IAS15_ARENA_CSB = IAS15_ARENA_B+7,
+    IAS15_ARENA_E   = IAS15_ARENA_CSB+7,
+    IAS15_ARENA_BR  = IAS15_ARENA_E+7,
+    IAS15_ARENA_ER  = IAS15_ARENA_BR+7,
+    IAS15_ARENA_N   = IAS15_ARENA_ER+7,
+};
+
+static void set_dp7(struct reb_dp7* const dp7, double* const arena, const int stride, const int first){
+    dp7->p0 = arena + (first+0)*stride;
+    dp7->p1 = arena + (first+1)*stride;
+    dp7->p2 = arena + (first+2)*stride;
+    dp7->p3 = arena + (first+3)*stride;
+    dp7->p4 = arena + (first+4)*stride;
+    dp7->p5 = arena + (first+5)*stride;
+    dp7->p6 = arena + (first+6)*stride;
+}
+
+// Clears the first N3 entries of the arrays first to last-1.
+static void clear_arena(struct reb_simulation* const r, const int first, const int last, const int N3){
+    const int stride = r->ri_ias15.arena_allocatedN;
+    for (int j=first;j<last;j++){
+        memset(r->ri_ias15.arena + j*stride, 0, sizeof(double)*N3);
+    }
+}
+
+void reb_integrator_ias15_reserve(struct reb_simulation* r, const int N3){
+    if (N3 <= r->ri_ias15.arena_allocatedN){
+        return;
+    }
+    const int stride = (N3+7)/8*8; // Arrays start at 64 byte boundaries
+    double* arena = NULL;
+    if (posix_memalign((void**)&arena, 64, sizeof(double)*stride*IAS15_ARENA_N)){
+        // The callers write N3 values into the arrays.
+        reb_exit("Cannot allocate memory for IAS15.");
+    }
+    free(r->ri_ias15.arena);
+    r->ri_ias15.arena = arena;
+    r->ri_ias15.arena_allocatedN = stride;
+    r->ri_ias15.at   = arena + IAS15_ARENA_AT*stride;
+    r->ri_ias15.x0   = arena + IAS15_ARENA_X0*stride;
+    r->ri_ias15.v0   = arena + IAS15_ARENA_V0*stride;
+    r->ri_ias15.a0   = arena + IAS15_ARENA_A0*stride;
+    r->ri_ias15.csx  = arena + IAS15_ARENA_CSX*stride;
+    r->ri_ias15.csv  = arena + IAS15_ARENA_CSV*stride;
+    r->ri_ias15.csa0 = arena + IAS15_ARENA_CSA0*stride;
+    set_dp7(&(r->ri_ias15.g),   arena, stride, IAS15_ARENA_G);
+    set_dp7(&(r->ri_ias15.b),   arena, stride, IAS15_ARENA_B);
+    set_dp7(&(r->ri_ias15.csb), arena, stride, IAS15_ARENA_CSB);
+    set_dp7(&(r->ri_ias15.e),   arena, stride, IAS15_ARENA_E);
+    set_dp7(&(r->ri_ias15.br),  arena, stride, IAS15_ARENA_BR);
+    set_dp7(&(r->ri_ias15.er),  arena, stride, IAS15_ARENA_ER);
 }
 
 static struct reb_dpconst7 dpcast(struct reb_dp7 dp){
@@ -163,26 +207,10 @@ void reb_integrator_ias15_alloc(struct reb_simulation* r){
         N3 = 3*r->N;
     }
     if (N3 > r->ri_ias15.allocatedN) {
-        realloc_dp7(&(r->ri_ias15.g),N3);
-        realloc_dp7(&(r->ri_ias15.b),N3);
-        realloc_dp7(&(r->ri_ias15.csb),N3);
-        realloc_dp7(&(r->ri_ias15.e),N3);
-        realloc_dp7(&(r->ri_ias15.br),N3);
-        realloc_dp7(&(r->ri_ias15.er),N3);
-        r->ri_ias15.at = realloc(r->ri_ias15.at,sizeof(double)*N3);
-        r->ri_ias15.x0 = realloc(r->ri_ias15.x0,sizeof(double)*N3);
-        r->ri_ias15.v0 = realloc(r->ri_ias15.v0,sizeof(double)*N3);
-        r->ri_ias15.a0 = realloc(r->ri_ias15.a0,sizeof(double)*N3);
-        r->ri_ias15.csx= realloc(r->ri_ias15.csx,sizeof(double)*N3);
-        r->ri_ias15.csv= realloc(r->ri_ias15.csv,sizeof(double)*N3);
-        r->ri_ias15.csa0 = realloc(r->ri_ias15.csa0,sizeof(double)*N3);
-        double* restrict const csx = r->ri_ias15.csx; 
-        double* restrict const csv = r->ri_ias15.csv; 
-        for (int i=0;i<N3;i++){
-            // Kill compensated summation coefficients
-            csx[i] = 0;
-            csv[i] = 0;
-        }
+        reb_integrator_ias15_reserve(r, N3);
+        // Kill compensated summation coefficients and all b, e, g coefficients
+        clear_arena(r, IAS15_ARENA_CSX, IAS15_ARENA_CSV+1, N3);
+        clear_arena(r, IAS15_ARENA_G, IAS15_ARENA_N, N3);
         r->ri_ias15.allocatedN = N3;
     }
     if (N3/3 > r->ri_ias15.map_allocated_N){
@@ -195,42 +223,46 @@ void reb_integrator_ias15_alloc(struct reb_simulation* r){
 
 }
  
-// Does the actual timestep.
-static int reb_integrator_ias15_step(struct reb_simulation* r) {
-    reb_integrator_ias15_alloc(r);
+// Arrays and particles used by the loops of one step.
+// The loops are in the functions below. They are orphaned worksharing constructs. If they are
+// called inside a parallel region, the iterations are shared by the threads. Otherwise they
+// run serially without starting a parallel region.
+struct reb_ias15_step {
+    struct reb_particle* const particles;
+    const int* const map;                       // Particles which are integrated
+    const int N;
+    const int N3;
+    double* const restrict csx;
+    double* const restrict csv;
+    double* const restrict csa0;
+    double* const restrict at;
+    double* const restrict x0;
+    double* const restrict v0;
+    double* const restrict a0;
+    const struct reb_vec3d* const gravity_cs;   // Compensated summation of the gravity (csa0 if not used)
+    const struct reb_dpconst7 g;
+    const struct reb_dpconst7 e;
+    const struct reb_dpconst7 b;
+    const struct reb_dpconst7 csb;
+    const struct reb_dpconst7 er;
+    const struct reb_dpconst7 br;
+};
 
-    struct reb_particle* const particles = r->particles;
-    int N;
-    int* map; // this map allow for integrating only a selection of particles 
-    if (r->integrator==REB_INTEGRATOR_MERCURIUS){// mercurius close encounter
-        N = r->ri_mercurius.encounterN;
-        map = r->ri_mercurius.encounter_map;
-        if (map==NULL){
-            reb_error(r, "Cannot access MERCURIUS map from IAS15.");
-            return 0;
-        }
-    }else{ 
-        N = r->N;
-        map = r->ri_ias15.map; // identity map
-    }
-    const int N3 = 3*N;
-    
-    // reb_update_acceleration(); // Not needed. Forces are already calculated in main routine.
-    
-    double* restrict const csx = r->ri_ias15.csx; 
-    double* restrict const csv = r->ri_ias15.csv; 
-    double* restrict const csa0 = r->ri_ias15.csa0; 
-    double* restrict const at = r->ri_ias15.at; 
-    double* restrict const x0 = r->ri_ias15.x0; 
-    double* restrict const v0 = r->ri_ias15.v0; 
-    double* restrict const a0 = r->ri_ias15.a0; 
-    struct reb_vec3d* gravity_cs = r->gravity_cs; 
-    const struct reb_dpconst7 g  = dpcast(r->ri_ias15.g);
-    const struct reb_dpconst7 e  = dpcast(r->ri_ias15.e);
-    const struct reb_dpconst7 b  = dpcast(r->ri_ias15.b);
-    const struct reb_dpconst7 csb= dpcast(r->ri_ias15.csb);
-    const struct reb_dpconst7 er = dpcast(r->ri_ias15.er);
-    const struct reb_dpconst7 br = dpcast(r->ri_ias15.br);
+// Copies the initial conditions of the particles and predicts g from b.
+static void reb_integrator_ias15_step_begin(const struct reb_ias15_step* const s, const int compensated){
+    struct reb_particle* const particles = s->particles;
+    const int* const map = s->map;
+    const int N = s->N;
+    const int N3 = s->N3;
+    double* restrict const csa0 = s->csa0;
+    double* restrict const x0 = s->x0;
+    double* restrict const v0 = s->v0;
+    double* restrict const a0 = s->a0;
+    const struct reb_vec3d* const gravity_cs = s->gravity_cs;
+    const struct reb_dpconst7 g = s->g;
+    const struct reb_dpconst7 b = s->b;
+    const struct reb_dpconst7 csb = s->csb;
+#pragma omp for
     for(int k=0;k<N;k++) {
         int mk = map[k];
         x0[3*k]   = particles[mk].x;
@@ -243,7 +275,8 @@ static int reb_integrator_ias15_step(struct reb_simulation* r) {
         a0[3*k+1] = particles[mk].ay; 
         a0[3*k+2] = particles[mk].az;
     }
-    if (r->gravity==REB_GRAVITY_COMPENSATED){
+    if (compensated){
+#pragma omp for
         for(int k=0;k<N;k++) {
             int mk = map[k];
             csa0[3*k]   = gravity_cs[mk].x;
@@ -251,11 +284,12 @@ static int reb_integrator_ias15_step(struct reb_simulation* r) {
             csa0[3*k+2] = gravity_cs[mk].z;
         }
     }else{
-        gravity_cs = (struct reb_vec3d*)csa0; // Always 0.
+#pragma omp for
         for(int k=0;k<N3;k++) {
             csa0[k]   = 0;
         }
     }
+#pragma omp for
     for (int k=0;k<N3;k++){
         // Memset might be faster!
         csb.p0[k] = 0.;
@@ -267,6 +301,7 @@ static int reb_integrator_ias15_step(struct reb_simulation* r) {
         csb.p6[k] = 0.;
     }
 
+#pragma omp for
     for(int k=0;k<N3;k++) {
         g.p0[k] = b.p6[k]*d[15] + b.p5[k]*d[10] + b.p4[k]*d[6] + b.p3[k]*d[3]  + b.p2[k]*d[1]  + b.p1[k]*d[0]  + b.p0[k];
         g.p1[k] = b.p6[k]*d[16] + b.p5[k]*d[11] + b.p4[k]*d[7] + b.p3[k]*d[4]  + b.p2[k]*d[2]  + b.p1[k];
@@ -276,6 +311,392 @@ static int reb_integrator_ias15_step(struct reb_simulation* r) {
         g.p5[k] = b.p6[k]*d[20] + b.p5[k];
         g.p6[k] = b.p6[k];
     }
+}
+
+// Sets the particles to their predicted positions (and velocities if velocities=1) at the
+// fraction hn of the timestep dt.
+static void reb_integrator_ias15_step_predict(const struct reb_ias15_step* const s, const double hn, const double dt, const int velocities){
+    struct reb_particle* const particles = s->particles;
+    const int* const map = s->map;
+    const int N = s->N;
+    const int N3 = s->N3;
+    double* restrict const csx = s->csx;
+    double* restrict const csv = s->csv;
+    double* restrict const at = s->at;
+    double* restrict const x0 = s->x0;
+    double* restrict const v0 = s->v0;
+    double* restrict const a0 = s->a0;
+    const struct reb_dpconst7 b = s->b;
+    // The predictors run over all components in flat loops so that they can be vectorized.
+    // The array at is not needed until the forces are calculated and is used as a buffer.
+    // The factors such as 7.*hn/9. are not precomputed per substep. This would change the 
+    // round-off, and results would no longer be bitwise identical to those of earlier versions.
+#pragma omp for
+    for(int k=0;k<N3;k++) {                     // Predict positions at interval n using b values
+        at[k] = -csx[k] + ((((((((b.p6[k]*7.*hn/9. + b.p5[k])*3.*hn/4. + b.p4[k])*5.*hn/7. + b.p3[k])*2.*hn/3. + b.p2[k])*3.*hn/5. + b.p1[k])*hn/2. + b.p0[k])*hn/3. + a0[k])*dt*hn/2. + v0[k])*dt*hn + x0[k];
+    }
+#pragma omp for
+    for(int i=0;i<N;i++) {
+        int mi = map[i];
+        particles[mi].x = at[3*i+0];
+        particles[mi].y = at[3*i+1];
+        particles[mi].z = at[3*i+2];
+    }
+    if (velocities){
+#pragma omp for
+        for(int k=0;k<N3;k++) {                 // Predict velocities at interval n using b values
+            at[k] = -csv[k] + (((((((b.p6[k]*7.*hn/8. + b.p5[k])*6.*hn/7. + b.p4[k])*5.*hn/6. + b.p3[k])*4.*hn/5. + b.p2[k])*3.*hn/4. + b.p1[k])*2.*hn/3. + b.p0[k])*hn/2. + a0[k])*dt*hn + v0[k];
+        }
+#pragma omp for
+        for(int i=0;i<N;i++) {
+            int mi = map[i];
+            particles[mi].vx = at[3*i+0];
+            particles[mi].vy = at[3*i+1];
+            particles[mi].vz = at[3*i+2];
+        }
+    }
+}
+
+// Improves the b and g values with the accelerations at interval n.
+// For n=7, the maxima needed for the predictor corrector error are merged into
+// maxak, maxb6k and predictor_corrector_error. A maximum does not depend on the
+// order of evaluation, so the result does not depend on the number of threads.
+static void reb_integrator_ias15_step_correct(const struct reb_ias15_step* const s, const int n, const int epsilon_global, double* const maxak, double* const maxb6k, double* const predictor_corrector_error){
+    struct reb_particle* const particles = s->particles;
+    const int* const map = s->map;
+    const int N = s->N;
+    const int N3 = s->N3;
+    double* restrict const csa0 = s->csa0;
+    double* restrict const at = s->at;
+    double* restrict const a0 = s->a0;
+    const struct reb_vec3d* const gravity_cs = s->gravity_cs;
+    const struct reb_dpconst7 g = s->g;
+    const struct reb_dpconst7 b = s->b;
+    const struct reb_dpconst7 csb = s->csb;
+#pragma omp for
+    for(int k=0;k<N;++k) {
+        int mk = map[k];
+        at[3*k]   = particles[mk].ax;
+        at[3*k+1] = particles[mk].ay;
+        at[3*k+2] = particles[mk].az;
+    }
+    switch (n) {                            // Improve b and g values
+        case 1:
+#pragma omp for
+            for(int k=0;k<N3;++k) {
+                double tmp = g.p0[k];
+                double gk = at[k];
+                double gk_cs = ((double*)(gravity_cs))[k];
+                add_cs(&gk, &gk_cs, -a0[k]);
+                add_cs(&gk, &gk_cs, csa0[k]);
+                g.p0[k]  = gk/rr[0];
+                add_cs(&(b.p0[k]), &(csb.p0[k]), g.p0[k]-tmp);
+            } break;
+        case 2:
+#pragma omp for
+            for(int k=0;k<N3;++k) {
+                double tmp = g.p1[k];
+                double gk = at[k];
+                double gk_cs = ((double*)(gravity_cs))[k];
+                add_cs(&gk, &gk_cs, -a0[k]);
+                add_cs(&gk, &gk_cs, csa0[k]);
+                g.p1[k] = (gk/rr[1] - g.p0[k])/rr[2];
+                tmp = g.p1[k] - tmp;
+                add_cs(&(b.p0[k]), &(csb.p0[k]), tmp * c[0]);
+                add_cs(&(b.p1[k]), &(csb.p1[k]), tmp);
+            } break;
+        case 3:
+#pragma omp for
+            for(int k=0;k<N3;++k) {
+                double tmp = g.p2[k];
+                double gk = at[k];
+                double gk_cs = ((double*)(gravity_cs))[k];
+                add_cs(&gk, &gk_cs, -a0[k]);
+                add_cs(&gk, &gk_cs, csa0[k]);
+                g.p2[k] = ((gk/rr[3] - g.p0[k])/rr[4] - g.p1[k])/rr[5];
+                tmp = g.p2[k] - tmp;
+                add_cs(&(b.p0[k]), &(csb.p0[k]), tmp * c[1]);
+                add_cs(&(b.p1[k]), &(csb.p1[k]), tmp * c[2]);
+                add_cs(&(b.p2[k]), &(csb.p2[k]), tmp);
+            } break;
+        case 4:
+#pragma omp for
+            for(int k=0;k<N3;++k) {
+                double tmp = g.p3[k];
+                double gk = at[k];
+                double gk_cs = ((double*)(gravity_cs))[k];
+                add_cs(&gk, &gk_cs, -a0[k]);
+                add_cs(&gk, &gk_cs, csa0[k]);
+                g.p3[k] = (((gk/rr[6] - g.p0[k])/rr[7] - g.p1[k])/rr[8] - g.p2[k])/rr[9];
+                tmp = g.p3[k] - tmp;
+                add_cs(&(b.p0[k]), &(csb.p0[k]), tmp * c[3]);
+                add_cs(&(b.p1[k]), &(csb.p1[k]), tmp * c[4]);
+                add_cs(&(b.p2[k]), &(csb.p2[k]), tmp * c[5]);
+                add_cs(&(b.p3[k]), &(csb.p3[k]), tmp);
+            } break;
+        case 5:
+#pragma omp for
+            for(int k=0;k<N3;++k) {
+                double tmp = g.p4[k];
+                double gk = at[k];
+                double gk_cs = ((double*)(gravity_cs))[k];
+                add_cs(&gk, &gk_cs, -a0[k]);
+                add_cs(&gk, &gk_cs, csa0[k]);
+                g.p4[k] = ((((gk/rr[10] - g.p0[k])/rr[11] - g.p1[k])/rr[12] - g.p2[k])/rr[13] - g.p3[k])/rr[14];
+                tmp = g.p4[k] - tmp;
+                add_cs(&(b.p0[k]), &(csb.p0[k]), tmp * c[6]);
+                add_cs(&(b.p1[k]), &(csb.p1[k]), tmp * c[7]);
+                add_cs(&(b.p2[k]), &(csb.p2[k]), tmp * c[8]);
+                add_cs(&(b.p3[k]), &(csb.p3[k]), tmp * c[9]);
+                add_cs(&(b.p4[k]), &(csb.p4[k]), tmp);
+            } break;
+        case 6:
+#pragma omp for
+            for(int k=0;k<N3;++k) {
+                double tmp = g.p5[k];
+                double gk = at[k];
+                double gk_cs = ((double*)(gravity_cs))[k];
+                add_cs(&gk, &gk_cs, -a0[k]);
+                add_cs(&gk, &gk_cs, csa0[k]);
+                g.p5[k] = (((((gk/rr[15] - g.p0[k])/rr[16] - g.p1[k])/rr[17] - g.p2[k])/rr[18] - g.p3[k])/rr[19] - g.p4[k])/rr[20];
+                tmp = g.p5[k] - tmp;
+                add_cs(&(b.p0[k]), &(csb.p0[k]), tmp * c[10]);
+                add_cs(&(b.p1[k]), &(csb.p1[k]), tmp * c[11]);
+                add_cs(&(b.p2[k]), &(csb.p2[k]), tmp * c[12]);
+                add_cs(&(b.p3[k]), &(csb.p3[k]), tmp * c[13]);
+                add_cs(&(b.p4[k]), &(csb.p4[k]), tmp * c[14]);
+                add_cs(&(b.p5[k]), &(csb.p5[k]), tmp);
+            } break;
+        case 7:
+        {
+            double maxak_thread = 0.0;
+            double maxb6ktmp_thread = 0.0;
+            double predictor_corrector_error_thread = 0.0;
+#pragma omp for
+            for(int k=0;k<N3;++k) {
+                double tmp = g.p6[k];
+                double gk = at[k];
+                double gk_cs = ((double*)(gravity_cs))[k];
+                add_cs(&gk, &gk_cs, -a0[k]);
+                add_cs(&gk, &gk_cs, csa0[k]);
+                g.p6[k] = ((((((gk/rr[21] - g.p0[k])/rr[22] - g.p1[k])/rr[23] - g.p2[k])/rr[24] - g.p3[k])/rr[25] - g.p4[k])/rr[26] - g.p5[k])/rr[27];
+                tmp = g.p6[k] - tmp;
+                add_cs(&(b.p0[k]), &(csb.p0[k]), tmp * c[15]);
+                add_cs(&(b.p1[k]), &(csb.p1[k]), tmp * c[16]);
+                add_cs(&(b.p2[k]), &(csb.p2[k]), tmp * c[17]);
+                add_cs(&(b.p3[k]), &(csb.p3[k]), tmp * c[18]);
+                add_cs(&(b.p4[k]), &(csb.p4[k]), tmp * c[19]);
+                add_cs(&(b.p5[k]), &(csb.p5[k]), tmp * c[20]);
+                add_cs(&(b.p6[k]), &(csb.p6[k]), tmp);
+
+                // Monitor change in b.p6[k] relative to at[k]. The predictor corrector scheme is converged if it is close to 0.
+                if (epsilon_global){
+                    const double ak  = fabs(at[k]);
+                    if (isnormal(ak) && ak>maxak_thread){
+                        maxak_thread = ak;
+                    }
+                    const double b6ktmp = fabs(tmp);  // change of b6ktmp coefficient
+                    if (isnormal(b6ktmp) && b6ktmp>maxb6ktmp_thread){
+                        maxb6ktmp_thread = b6ktmp;
+                    }
+                }else{
+                    const double ak  = at[k];
+                    const double b6ktmp = tmp;
+                    const double errork = fabs(b6ktmp/ak);
+                    if (isnormal(errork) && errork>predictor_corrector_error_thread){
+                        predictor_corrector_error_thread = errork;
+                    }
+                }
+            }
+#pragma omp critical
+            {
+                if (maxak_thread>*maxak) *maxak = maxak_thread;
+                if (maxb6ktmp_thread>*maxb6k) *maxb6k = maxb6ktmp_thread;
+                if (predictor_corrector_error_thread>*predictor_corrector_error) *predictor_corrector_error = predictor_corrector_error_thread;
+            }
+            break;
+        }
+    }
+}
+
+// Merges the maxima needed for the error estimate into maxak, maxb6k and integrator_error (see reb_integrator_ias15_step_correct).
+static void reb_integrator_ias15_step_error(const struct reb_ias15_step* const s, const int Nreal, const double dt, const int epsilon_global, double* const maxak, double* const maxb6k, double* const integrator_error){
+    struct reb_particle* const particles = s->particles;
+    const int* const map = s->map;
+    const int N3 = s->N3;
+    double* restrict const at = s->at;
+    const struct reb_dpconst7 b = s->b;
+    double maxak_thread = 0.0;
+    double maxb6k_thread = 0.0;
+    double integrator_error_thread = 0.0;
+    if (epsilon_global){
+#pragma omp for
+        for(int i=0;i<Nreal;i++){ // Looping over all particles and all 3 components of the acceleration.
+            // Note: Before December 2020, N-N_var, was simply N. This change should make timestep choices during
+            // close encounters more stable if variational particles are present.
+            int mi = map[i];
+            const double v2 = particles[mi].vx*particles[mi].vx+particles[mi].vy*particles[mi].vy+particles[mi].vz*particles[mi].vz;
+            const double x2 = particles[mi].x*particles[mi].x+particles[mi].y*particles[mi].y+particles[mi].z*particles[mi].z;
+            // Skip slowly varying accelerations
+            if (fabs(v2*dt*dt/x2) < 1e-16) continue;
+            for(int k=3*i;k<3*(i+1);k++) {
+                const double ak  = fabs(at[k]);
+                if (isnormal(ak) && ak>maxak_thread){
+                    maxak_thread = ak;
+                }
+                const double b6k = fabs(b.p6[k]);
+                if (isnormal(b6k) && b6k>maxb6k_thread){
+                    maxb6k_thread = b6k;
+                }
+            }
+        }
+    }else{
+#pragma omp for
+        for(int k=0;k<N3;k++) {
+            const double ak  = at[k];
+            const double b6k = b.p6[k];
+            const double errork = fabs(b6k/ak);
+            if (isnormal(errork) && errork>integrator_error_thread){
+                integrator_error_thread = errork;
+            }
+        }
+    }
+#pragma omp critical
+    {
+        if (maxak_thread>*maxak) *maxak = maxak_thread;
+        if (maxb6k_thread>*maxb6k) *maxb6k = maxb6k_thread;
+        if (integrator_error_thread>*integrator_error) *integrator_error = integrator_error_thread;
+    }
+}
+
+// Resets the particles to the beginning of a rejected step.
+static void reb_integrator_ias15_step_reject(const struct reb_ias15_step* const s){
+    struct reb_particle* const particles = s->particles;
+    const int* const map = s->map;
+    const int N = s->N;
+    double* restrict const x0 = s->x0;
+    double* restrict const v0 = s->v0;
+    double* restrict const a0 = s->a0;
+#pragma omp for
+    for(int k=0;k<N;++k) {
+        int mk = map[k];
+        particles[mk].x = x0[3*k+0]; // Set inital position
+        particles[mk].y = x0[3*k+1];
+        particles[mk].z = x0[3*k+2];
+
+        particles[mk].vx = v0[3*k+0];    // Set inital velocity
+        particles[mk].vy = v0[3*k+1];
+        particles[mk].vz = v0[3*k+2];
+
+        particles[mk].ax = a0[3*k+0];    // Set inital acceleration
+        particles[mk].ay = a0[3*k+1];
+        particles[mk].az = a0[3*k+2];
+    }
+}
+
+// Finds the new positions and velocities at the end of an accepted step of length dt_done.
+static void reb_integrator_ias15_step_end(const struct reb_ias15_step* const s, const double dt_done){
+    struct reb_particle* const particles = s->particles;
+    const int* const map = s->map;
+    const int N = s->N;
+    const int N3 = s->N3;
+    double* restrict const csx = s->csx;
+    double* restrict const csv = s->csv;
+    double* restrict const x0 = s->x0;
+    double* restrict const v0 = s->v0;
+    double* restrict const a0 = s->a0;
+    const struct reb_dpconst7 b = s->b;
+    // Find new position and velocity values at end of the sequence
+#pragma omp for
+    for(int k=0;k<N3;++k) {
+        // Note: dt_done*dt_done is not precalculated to avoid 
+        //       biased round-off errors when a fixed timestep is used.
+        add_cs(&(x0[k]), &(csx[k]), b.p6[k]/72.*dt_done*dt_done);
+        add_cs(&(x0[k]), &(csx[k]), b.p5[k]/56.*dt_done*dt_done);
+        add_cs(&(x0[k]), &(csx[k]), b.p4[k]/42.*dt_done*dt_done);
+        add_cs(&(x0[k]), &(csx[k]), b.p3[k]/30.*dt_done*dt_done);
+        add_cs(&(x0[k]), &(csx[k]), b.p2[k]/20.*dt_done*dt_done);
+        add_cs(&(x0[k]), &(csx[k]), b.p1[k]/12.*dt_done*dt_done);
+        add_cs(&(x0[k]), &(csx[k]), b.p0[k]/6.*dt_done*dt_done);
+        add_cs(&(x0[k]), &(csx[k]), a0[k]/2.*dt_done*dt_done);
+        add_cs(&(x0[k]), &(csx[k]), v0[k]*dt_done);
+        add_cs(&(v0[k]), &(csv[k]), b.p6[k]/8.*dt_done);
+        add_cs(&(v0[k]), &(csv[k]), b.p5[k]/7.*dt_done);
+        add_cs(&(v0[k]), &(csv[k]), b.p4[k]/6.*dt_done);
+        add_cs(&(v0[k]), &(csv[k]), b.p3[k]/5.*dt_done);
+        add_cs(&(v0[k]), &(csv[k]), b.p2[k]/4.*dt_done);
+        add_cs(&(v0[k]), &(csv[k]), b.p1[k]/3.*dt_done);
+        add_cs(&(v0[k]), &(csv[k]), b.p0[k]/2.*dt_done);
+        add_cs(&(v0[k]), &(csv[k]), a0[k]*dt_done);
+    }
+
+    // Swap particle buffers
+#pragma omp for
+    for(int k=0;k<N;++k) {
+        int mk = map[k];
+        particles[mk].x = x0[3*k+0]; // Set final position
+        particles[mk].y = x0[3*k+1];
+        particles[mk].z = x0[3*k+2];
+
+        particles[mk].vx = v0[3*k+0];    // Set final velocity
+        particles[mk].vy = v0[3*k+1];
+        particles[mk].vz = v0[3*k+2];
+    }
+}
+
+// Does the actual timestep.
+static int reb_integrator_ias15_step(struct reb_simulation* r) {
+    reb_integrator_ias15_alloc(r);
+
+    int N;
+    int* map; // this map allow for integrating only a selection of particles 
+    if (r->integrator==REB_INTEGRATOR_MERCURIUS){// mercurius close encounter
+        N = r->ri_mercurius.encounterN;
+        map = r->ri_mercurius.encounter_map;
+        if (map==NULL){
+            reb_error(r, "Cannot access MERCURIUS map from IAS15.");
+            return 0;
+        }
+    }else{
+        N = r->N;
+        map = r->ri_ias15.map; // identity map
+    }
+    const int N3 = 3*N;
+
+    // reb_update_acceleration(); // Not needed. Forces are already calculated in main routine.
+
+    const int compensated = r->gravity==REB_GRAVITY_COMPENSATED;
+    const struct reb_ias15_step s = {
+        .particles = r->particles,
+        .map = map,
+        .N = N,
+        .N3 = N3,
+        .csx = r->ri_ias15.csx,
+        .csv = r->ri_ias15.csv,
+        .csa0 = r->ri_ias15.csa0,
+        .at = r->ri_ias15.at,
+        .x0 = r->ri_ias15.x0,
+        .v0 = r->ri_ias15.v0,
+        .a0 = r->ri_ias15.a0,
+        .gravity_cs = compensated?r->gravity_cs:(struct reb_vec3d*)r->ri_ias15.csa0, // csa0 is always 0 if not used.
+        .g = dpcast(r->ri_ias15.g),
+        .e = dpcast(r->ri_ias15.e),
+        .b = dpcast(r->ri_ias15.b),
+        .csb = dpcast(r->ri_ias15.csb),
+        .er = dpcast(r->ri_ias15.er),
+        .br = dpcast(r->ri_ias15.br),
+    };
+#ifdef OPENMP
+    // A parallel region is only started if the loops outweigh the cost of starting it. Inside an
+    // active parallel region (e.g. if simulations are integrated in parallel), a nested region is
+    // always started so that the loops do not bind to the enclosing region.
+    const int parallel = N3>=IAS15_OPENMP_N3_MIN || omp_in_parallel();
+    if (parallel){
+#pragma omp parallel
+        reb_integrator_ias15_step_begin(&s, compensated);
+    }else
+#endif // OPENMP
+    reb_integrator_ias15_step_begin(&s, compensated);
 
     double integrator_megno_thisdt = 0.;
     double integrator_megno_thisdt_init = 0.;
@@ -286,7 +707,7 @@ static int reb_integrator_ias15_step(struct reb_simulation* r) {
     double t_beginning = r->t;
     double predictor_corrector_error = 1e300;
     double predictor_corrector_error_last = 2;
-    int iterations = 0; 
+    int iterations = 0;
     // Predictor corrector loop
     // Stops if one of the following conditions is satisfied: 
     //   1) predictor_corrector_error better than 1e-16 
@@ -317,179 +738,34 @@ static int reb_integrator_ias15_step(struct reb_simulation* r) {
             r->t = t_beginning + r->dt * h[n];
 
             // Prepare particles arrays for force calculation
-            for(int i=0;i<N;i++) {                      // Predict positions at interval n using b values
-                int mi = map[i];
-                const int k0 = 3*i+0;
-                const int k1 = 3*i+1;
-                const int k2 = 3*i+2;
-
-                double xk0;
-                double xk1;
-                double xk2;
-                xk0 = -csx[k0] + ((((((((b.p6[k0]*7.*h[n]/9. + b.p5[k0])*3.*h[n]/4. + b.p4[k0])*5.*h[n]/7. + b.p3[k0])*2.*h[n]/3. + b.p2[k0])*3.*h[n]/5. + b.p1[k0])*h[n]/2. + b.p0[k0])*h[n]/3. + a0[k0])*r->dt*h[n]/2. + v0[k0])*r->dt*h[n];
-                xk1 = -csx[k1] + ((((((((b.p6[k1]*7.*h[n]/9. + b.p5[k1])*3.*h[n]/4. + b.p4[k1])*5.*h[n]/7. + b.p3[k1])*2.*h[n]/3. + b.p2[k1])*3.*h[n]/5. + b.p1[k1])*h[n]/2. + b.p0[k1])*h[n]/3. + a0[k1])*r->dt*h[n]/2. + v0[k1])*r->dt*h[n];
-                xk2 = -csx[k2] + ((((((((b.p6[k2]*7.*h[n]/9. + b.p5[k2])*3.*h[n]/4. + b.p4[k2])*5.*h[n]/7. + b.p3[k2])*2.*h[n]/3. + b.p2[k2])*3.*h[n]/5. + b.p1[k2])*h[n]/2. + b.p0[k2])*h[n]/3. + a0[k2])*r->dt*h[n]/2. + v0[k2])*r->dt*h[n];
-                particles[mi].x = xk0 + x0[k0];
-                particles[mi].y = xk1 + x0[k1];
-                particles[mi].z = xk2 + x0[k2];
-            }
-            if (r->calculate_megno || (r->additional_forces && r->force_is_velocity_dependent)){
-                for(int i=0;i<N;i++) {                  // Predict velocities at interval n using b values
-                    int mi = map[i];
-                    const int k0 = 3*i+0;
-                    const int k1 = 3*i+1;
-                    const int k2 = 3*i+2;
-
-                    double vk0;
-                    double vk1;
-                    double vk2;
-                    vk0 =  -csv[k0] + (((((((b.p6[k0]*7.*h[n]/8. + b.p5[k0])*6.*h[n]/7. + b.p4[k0])*5.*h[n]/6. + b.p3[k0])*4.*h[n]/5. + b.p2[k0])*3.*h[n]/4. + b.p1[k0])*2.*h[n]/3. + b.p0[k0])*h[n]/2. + a0[k0])*r->dt*h[n];
-                    vk1 =  -csv[k1] + (((((((b.p6[k1]*7.*h[n]/8. + b.p5[k1])*6.*h[n]/7. + b.p4[k1])*5.*h[n]/6. + b.p3[k1])*4.*h[n]/5. + b.p2[k1])*3.*h[n]/4. + b.p1[k1])*2.*h[n]/3. + b.p0[k1])*h[n]/2. + a0[k1])*r->dt*h[n];
-                    vk2 =  -csv[k2] + (((((((b.p6[k2]*7.*h[n]/8. + b.p5[k2])*6.*h[n]/7. + b.p4[k2])*5.*h[n]/6. + b.p3[k2])*4.*h[n]/5. + b.p2[k2])*3.*h[n]/4. + b.p1[k2])*2.*h[n]/3. + b.p0[k2])*h[n]/2. + a0[k2])*r->dt*h[n];
-                    particles[mi].vx = vk0 + v0[k0];
-                    particles[mi].vy = vk1 + v0[k1];
-                    particles[mi].vz = vk2 + v0[k2];
-                }
-            }
-
+            const double hn = h[n];
+            const double dt = r->dt;
+            const int velocities = r->calculate_megno || (r->additional_forces && r->force_is_velocity_dependent);
+#ifdef OPENMP
+            if (parallel){
+#pragma omp parallel
+                reb_integrator_ias15_step_predict(&s, hn, dt, velocities);
+            }else
+#endif // OPENMP
+            reb_integrator_ias15_step_predict(&s, hn, dt, velocities);
 
             reb_update_acceleration(r);             // Calculate forces at interval n
             if (r->calculate_megno){
                 integrator_megno_thisdt += w[n] * r->t * reb_tools_megno_deltad_delta(r);
             }
 
-            for(int k=0;k<N;++k) {
-                int mk = map[k];
-                at[3*k]   = particles[mk].ax;
-                at[3*k+1] = particles[mk].ay;  
-                at[3*k+2] = particles[mk].az;
-            }
-            switch (n) {                            // Improve b and g values
-                case 1: 
-                    for(int k=0;k<N3;++k) {
-                        double tmp = g.p0[k];
-                        double gk = at[k];
-                        double gk_cs = ((double*)(gravity_cs))[k];
-                        add_cs(&gk, &gk_cs, -a0[k]);
-                        add_cs(&gk, &gk_cs, csa0[k]);
-                        g.p0[k]  = gk/rr[0];
-                        add_cs(&(b.p0[k]), &(csb.p0[k]), g.p0[k]-tmp);
-                    } break;
-                case 2: 
-                    for(int k=0;k<N3;++k) {
-                        double tmp = g.p1[k];
-                        double gk = at[k];
-                        double gk_cs = ((double*)(gravity_cs))[k];
-                        add_cs(&gk, &gk_cs, -a0[k]);
-                        add_cs(&gk, &gk_cs, csa0[k]);
-                        g.p1[k] = (gk/rr[1] - g.p0[k])/rr[2];
-                        tmp = g.p1[k] - tmp;
-                        add_cs(&(b.p0[k]), &(csb.p0[k]), tmp * c[0]);
-                        add_cs(&(b.p1[k]), &(csb.p1[k]), tmp);
-                    } break;
-                case 3: 
-                    for(int k=0;k<N3;++k) {
-                        double tmp = g.p2[k];
-                        double gk = at[k];
-                        double gk_cs = ((double*)(gravity_cs))[k];
-                        add_cs(&gk, &gk_cs, -a0[k]);
-                        add_cs(&gk, &gk_cs, csa0[k]);
-                        g.p2[k] = ((gk/rr[3] - g.p0[k])/rr[4] - g.p1[k])/rr[5];
-                        tmp = g.p2[k] - tmp;
-                        add_cs(&(b.p0[k]), &(csb.p0[k]), tmp * c[1]);
-                        add_cs(&(b.p1[k]), &(csb.p1[k]), tmp * c[2]);
-                        add_cs(&(b.p2[k]), &(csb.p2[k]), tmp);
-                    } break;
-                case 4:
-                    for(int k=0;k<N3;++k) {
-                        double tmp = g.p3[k];
-                        double gk = at[k];
-                        double gk_cs = ((double*)(gravity_cs))[k];
-                        add_cs(&gk, &gk_cs, -a0[k]);
-                        add_cs(&gk, &gk_cs, csa0[k]);
-                        g.p3[k] = (((gk/rr[6] - g.p0[k])/rr[7] - g.p1[k])/rr[8] - g.p2[k])/rr[9];
-                        tmp = g.p3[k] - tmp;
-                        add_cs(&(b.p0[k]), &(csb.p0[k]), tmp * c[3]);
-                        add_cs(&(b.p1[k]), &(csb.p1[k]), tmp * c[4]);
-                        add_cs(&(b.p2[k]), &(csb.p2[k]), tmp * c[5]);
-                        add_cs(&(b.p3[k]), &(csb.p3[k]), tmp);
-                    } break;
-                case 5:
-                    for(int k=0;k<N3;++k) {
-                        double tmp = g.p4[k];
-                        double gk = at[k];
-                        double gk_cs = ((double*)(gravity_cs))[k];
-                        add_cs(&gk, &gk_cs, -a0[k]);
-                        add_cs(&gk, &gk_cs, csa0[k]);
-                        g.p4[k] = ((((gk/rr[10] - g.p0[k])/rr[11] - g.p1[k])/rr[12] - g.p2[k])/rr[13] - g.p3[k])/rr[14];
-                        tmp = g.p4[k] - tmp;
-                        add_cs(&(b.p0[k]), &(csb.p0[k]), tmp * c[6]);
-                        add_cs(&(b.p1[k]), &(csb.p1[k]), tmp * c[7]);
-                        add_cs(&(b.p2[k]), &(csb.p2[k]), tmp * c[8]);
-                        add_cs(&(b.p3[k]), &(csb.p3[k]), tmp * c[9]);
-                        add_cs(&(b.p4[k]), &(csb.p4[k]), tmp);
-                    } break;
-                case 6:
-                    for(int k=0;k<N3;++k) {
-                        double tmp = g.p5[k];
-                        double gk = at[k];
-                        double gk_cs = ((double*)(gravity_cs))[k];
-                        add_cs(&gk, &gk_cs, -a0[k]);
-                        add_cs(&gk, &gk_cs, csa0[k]);
-                        g.p5[k] = (((((gk/rr[15] - g.p0[k])/rr[16] - g.p1[k])/rr[17] - g.p2[k])/rr[18] - g.p3[k])/rr[19] - g.p4[k])/rr[20];
-                        tmp = g.p5[k] - tmp;
-                        add_cs(&(b.p0[k]), &(csb.p0[k]), tmp * c[10]);
-                        add_cs(&(b.p1[k]), &(csb.p1[k]), tmp * c[11]);
-                        add_cs(&(b.p2[k]), &(csb.p2[k]), tmp * c[12]);
-                        add_cs(&(b.p3[k]), &(csb.p3[k]), tmp * c[13]);
-                        add_cs(&(b.p4[k]), &(csb.p4[k]), tmp * c[14]);
-                        add_cs(&(b.p5[k]), &(csb.p5[k]), tmp);
-                    } break;
-                case 7:
-                {
-                    double maxak = 0.0;
-                    double maxb6ktmp = 0.0;
-                    for(int k=0;k<N3;++k) {
-                        double tmp = g.p6[k];
-                        double gk = at[k];
-                        double gk_cs = ((double*)(gravity_cs))[k];
-                        add_cs(&gk, &gk_cs, -a0[k]);
-                        add_cs(&gk, &gk_cs, csa0[k]);
-                        g.p6[k] = ((((((gk/rr[21] - g.p0[k])/rr[22] - g.p1[k])/rr[23] - g.p2[k])/rr[24] - g.p3[k])/rr[25] - g.p4[k])/rr[26] - g.p5[k])/rr[27];
-                        tmp = g.p6[k] - tmp;    
-                        add_cs(&(b.p0[k]), &(csb.p0[k]), tmp * c[15]);
-                        add_cs(&(b.p1[k]), &(csb.p1[k]), tmp * c[16]);
-                        add_cs(&(b.p2[k]), &(csb.p2[k]), tmp * c[17]);
-                        add_cs(&(b.p3[k]), &(csb.p3[k]), tmp * c[18]);
-                        add_cs(&(b.p4[k]), &(csb.p4[k]), tmp * c[19]);
-                        add_cs(&(b.p5[k]), &(csb.p5[k]), tmp * c[20]);
-                        add_cs(&(b.p6[k]), &(csb.p6[k]), tmp);
-                        
-                        // Monitor change in b.p6[k] relative to at[k]. The predictor corrector scheme is converged if it is close to 0.
-                        if (r->ri_ias15.epsilon_global){
-                            const double ak  = fabs(at[k]);
-                            if (isnormal(ak) && ak>maxak){
-                                maxak = ak;
-                            }
-                            const double b6ktmp = fabs(tmp);  // change of b6ktmp coefficient
-                            if (isnormal(b6ktmp) && b6ktmp>maxb6ktmp){
-                                maxb6ktmp = b6ktmp;
-                            }
-                        }else{
-                            const double ak  = at[k];
-                            const double b6ktmp = tmp; 
-                            const double errork = fabs(b6ktmp/ak);
-                            if (isnormal(errork) && errork>predictor_corrector_error){
-                                predictor_corrector_error = errork;
-                            }
-                        }
-                    } 
-                    if (r->ri_ias15.epsilon_global){
-                        predictor_corrector_error = maxb6ktmp/maxak;
-                    }
-                    
-                    break;
-                }
+            const int epsilon_global = r->ri_ias15.epsilon_global;
+            double maxak = 0.0;
+            double maxb6ktmp = 0.0;
+#ifdef OPENMP
+            if (parallel){
+#pragma omp parallel
+                reb_integrator_ias15_step_correct(&s, n, epsilon_global, &maxak, &maxb6ktmp, &predictor_corrector_error);
+            }else
+#endif // OPENMP
+            reb_integrator_ias15_step_correct(&s, n, epsilon_global, &maxak, &maxb6ktmp, &predictor_corrector_error);
+            if (n==7 && epsilon_global){
+                predictor_corrector_error = maxb6ktmp/maxak;
             }
         }
     }
@@ -497,7 +773,7 @@ static int reb_integrator_ias15_step(struct reb_simulation* r) {
     r->t = t_beginning;
     // Find new timestep
     const double dt_done = r->dt;
-    
+
     if (r->ri_ias15.epsilon>0){
         // Estimate error (given by last term in series expansion) 
         // There are two options:
@@ -509,38 +785,18 @@ static int reb_integrator_ias15_step(struct reb_simulation* r) {
         //   This might fail in cases where a particle does not experience any (physical) acceleration besides roundoff errors. 
         double integrator_error = 0.0;
         unsigned int Nreal = N - r->N_var;
-        if (r->ri_ias15.epsilon_global){
-            double maxak = 0.0;
-            double maxb6k = 0.0;
-            for(int i=0;i<Nreal;i++){ // Looping over all particles and all 3 components of the acceleration. 
-                // Note: Before December 2020, N-N_var, was simply N. This change should make timestep choices during
-                // close encounters more stable if variational particles are present.
-                int mi = map[i];
-                const double v2 = particles[mi].vx*particles[mi].vx+particles[mi].vy*particles[mi].vy+particles[mi].vz*particles[mi].vz;
-                const double x2 = particles[mi].x*particles[mi].x+particles[mi].y*particles[mi].y+particles[mi].z*particles[mi].z;
-                // Skip slowly varying accelerations
-                if (fabs(v2*r->dt*r->dt/x2) < 1e-16) continue;
-                for(int k=3*i;k<3*(i+1);k++) { 
-                    const double ak  = fabs(at[k]);
-                    if (isnormal(ak) && ak>maxak){
-                        maxak = ak;
-                    }
-                    const double b6k = fabs(b.p6[k]); 
-                    if (isnormal(b6k) && b6k>maxb6k){
-                        maxb6k = b6k;
-                    }
-                }
-            }
+        const int epsilon_global = r->ri_ias15.epsilon_global;
+        double maxak = 0.0;
+        double maxb6k = 0.0;
+#ifdef OPENMP
+        if (parallel){
+#pragma omp parallel
+            reb_integrator_ias15_step_error(&s, Nreal, r->dt, epsilon_global, &maxak, &maxb6k, &integrator_error);
+        }else
+#endif // OPENMP
+        reb_integrator_ias15_step_error(&s, Nreal, r->dt, epsilon_global, &maxak, &maxb6k, &integrator_error);
+        if (epsilon_global){
             integrator_error = maxb6k/maxak;
-        }else{
-            for(int k=0;k<N3;k++) {
-                const double ak  = at[k];
-                const double b6k = b.p6[k]; 
-                const double errork = fabs(b6k/ak);
-                if (isnormal(errork) && errork>integrator_error){
-                    integrator_error = errork;
-                }
-            }
         }
 
         double dt_new;
@@ -550,62 +806,32 @@ static int reb_integrator_ias15_step(struct reb_simulation* r) {
         }else{                  // In the rare case that the error estimate doesn't give a finite number (e.g. when all forces accidentally cancel up to machine precission).
             dt_new = dt_done/safety_factor; // by default, increase timestep a little
         }
-        
+
         if (fabs(dt_new)<r->ri_ias15.min_dt) dt_new = copysign(r->ri_ias15.min_dt,dt_new);
-        
+
         if (fabs(dt_new/dt_done) < safety_factor) { // New timestep is significantly smaller.
             // Reset particles
-            for(int k=0;k<N;++k) {
-                int mk = map[k];
-                particles[mk].x = x0[3*k+0]; // Set inital position
-                particles[mk].y = x0[3*k+1];
-                particles[mk].z = x0[3*k+2];
-
-                particles[mk].vx = v0[3*k+0];    // Set inital velocity
-                particles[mk].vy = v0[3*k+1];
-                particles[mk].vz = v0[3*k+2];
-                
-                particles[mk].ax = a0[3*k+0];    // Set inital acceleration
-                particles[mk].ay = a0[3*k+1];
-                particles[mk].az = a0[3*k+2];
-            }
+#ifdef OPENMP
+            if (parallel){
+#pragma omp parallel
+                reb_integrator_ias15_step_reject(&s);
+            }else
+#endif // OPENMP
+            reb_integrator_ias15_step_reject(&s);
             r->dt = dt_new;
             if (r->dt_last_done!=0.){       // Do not predict next e/b values if this is the first time step.
                 double ratio = r->dt/r->dt_last_done;
-                predict_next_step(ratio, N3, er, br, e, b);
+                predict_next_step(ratio, N3, s.er, s.br, s.e, s.b);
             }
-            
+
             return 0; // Step rejected. Do again. 
-        }       
+        }
         if (fabs(dt_new/dt_done) > 1.0) {   // New timestep is larger.
             if (dt_new/dt_done > 1./safety_factor) dt_new = dt_done /safety_factor; // Don't increase the timestep by too much compared to the last one.
         }
         r->dt = dt_new;
     }
 
-    // Find new position and velocity values at end of the sequence
-    for(int k=0;k<N3;++k) {
-        // Note: dt_done*dt_done is not precalculated to avoid 
-        //       biased round-off errors when a fixed timestep is used.
-        add_cs(&(x0[k]), &(csx[k]), b.p6[k]/72.*dt_done*dt_done);
-        add_cs(&(x0[k]), &(csx[k]), b.p5[k]/56.*dt_done*dt_done);
-        add_cs(&(x0[k]), &(csx[k]), b.p4[k]/42.*dt_done*dt_done);
-        add_cs(&(x0[k]), &(csx[k]), b.p3[k]/30.*dt_done*dt_done);
-        add_cs(&(x0[k]), &(csx[k]), b.p2[k]/20.*dt_done*dt_done);
-        add_cs(&(x0[k]), &(csx[k]), b.p1[k]/12.*dt_done*dt_done);
-        add_cs(&(x0[k]), &(csx[k]), b.p0[k]/6.*dt_done*dt_done);
-        add_cs(&(x0[k]), &(csx[k]), a0[k]/2.*dt_done*dt_done);
-        add_cs(&(x0[k]), &(csx[k]), v0[k]*dt_done);
-        add_cs(&(v0[k]), &(csv[k]), b.p6[k]/8.*dt_done);
-        add_cs(&(v0[k]), &(csv[k]), b.p5[k]/7.*dt_done);
-        add_cs(&(v0[k]), &(csv[k]), b.p4[k]/6.*dt_done);
-        add_cs(&(v0[k]), &(csv[k]), b.p3[k]/5.*dt_done);
-        add_cs(&(v0[k]), &(csv[k]), b.p2[k]/4.*dt_done);
-        add_cs(&(v0[k]), &(csv[k]), b.p1[k]/3.*dt_done);
-        add_cs(&(v0[k]), &(csv[k]), b.p0[k]/2.*dt_done);
-        add_cs(&(v0[k]), &(csv[k]), a0[k]*dt_done);
-    }
-
     r->t += dt_done;
     r->dt_last_done = dt_done;
 
@@ -614,21 +840,17 @@ static int reb_integrator_ias15_step(struct reb_simulation* r) {
         reb_tools_megno_update(r, dY);
     }
 
-    // Swap particle buffers
-    for(int k=0;k<N;++k) {
-        int mk = map[k];
-        particles[mk].x = x0[3*k+0]; // Set final position
-        particles[mk].y = x0[3*k+1];
-        particles[mk].z = x0[3*k+2];
-
-        particles[mk].vx = v0[3*k+0];    // Set final velocity
-        particles[mk].vy = v0[3*k+1];
-        particles[mk].vz = v0[3*k+2];
-    }
-    copybuffers(e,er,N3);       
-    copybuffers(b,br,N3);       
+#ifdef OPENMP
+    if (parallel){
+#pragma omp parallel
+        reb_integrator_ias15_step_end(&s, dt_done);
+    }else
+#endif // OPENMP
+    reb_integrator_ias15_step_end(&s, dt_done);
+    copybuffers(s.e,s.er,N3);
+    copybuffers(s.b,s.br,N3);
     double ratio = r->dt/dt_done;
-    predict_next_step(ratio, N3, e, b, e, b);
+    predict_next_step(ratio, N3, s.e, s.b, s.e, s.b);
     return 1; // Success.
 }
 
@@ -697,6 +919,588 @@ static void copybuffers(const struct reb_dpconst7 _a, const struct reb_dpconst7
 //  }
 }
 
+/////////////////////////
+//   Block timesteps 
+//
+// If block_levels>1, each particle has its own timestep r->dt/2^level. The particles of one 
+// level are integrated with the same predictor corrector scheme as above, but forces are only 
+// calculated for them. A step of level l first does two steps of level l+1. During these, the 
+// positions of particles on slower levels are given by the position predictors of their 
+// current step. The positions of the faster particles at the substeps of slower levels are 
+// recorded (dense output) and used once the slower levels are integrated. If a particle needs 
+// a smaller timestep, the entire step is rejected and repeated with new levels.
+// Forces are calculated in this file. Only REB_GRAVITY_BASIC without ghost boxes, additional 
+// forces or variational particles is supported. Otherwise a global timestep is used.
+
+#define IAS15_BLOCK_LEVELS_MAX 32
+// Number of arrays (of size 3*N) which are backed up at the beginning of a step.
+#define IAS15_BLOCK_BACKUP_N ((IAS15_ARENA_CSV+1-IAS15_ARENA_X0) + 7 + (IAS15_ARENA_N-IAS15_ARENA_E))
+static const int block_backup_ranges[3][2] = {{IAS15_ARENA_X0, IAS15_ARENA_CSV+1}, {IAS15_ARENA_B, IAS15_ARENA_CSB}, {IAS15_ARENA_E, IAS15_ARENA_N}};
+
+struct reb_ias15_block {
+    struct reb_simulation* r;
+    int levels;                                 // Number of levels
+    int offset[IAS15_BLOCK_LEVELS_MAX+1];       // Level l consists of block_index[offset[l]] to block_index[offset[l+1]-1]
+    double t[IAS15_BLOCK_LEVELS_MAX];           // Beginning of the current step of each level
+    double dt[IAS15_BLOCK_LEVELS_MAX];          // Timestep of each level
+};
+
+static int reb_integrator_ias15_block_supported(const struct reb_simulation* const r){
+    return r->ri_ias15.block_levels>1 && r->ri_ias15.epsilon>0 && r->integrator==REB_INTEGRATOR_IAS15
+        && r->gravity==REB_GRAVITY_BASIC && r->additional_forces==NULL && r->N_var==0
+        && r->nghostx==0 && r->nghosty==0 && r->nghostz==0;
+}
+
+void reb_integrator_ias15_block_realloc(struct reb_simulation* r, const int N){
+    struct reb_simulation_integrator_ias15* const ri = &(r->ri_ias15);
+    ri->block_level   = realloc(ri->block_level,   sizeof(int)*N);
+    ri->block_index   = realloc(ri->block_index,   sizeof(int)*N);
+    ri->block_dt_want = realloc(ri->block_dt_want, sizeof(double)*N);
+    ri->block_dt_last = realloc(ri->block_dt_last, sizeof(double)*N);
+    ri->block_N = N;
+}
+
+static void reb_integrator_ias15_block_alloc(struct reb_simulation* const r, const int levels){
+    struct reb_simulation_integrator_ias15* const ri = &(r->ri_ias15);
+    const int N = r->N;
+    const int size = 3*N*(IAS15_BLOCK_BACKUP_N + 7*levels);
+    if (size > ri->block_arena_allocatedN){
+        ri->block_arena = realloc(ri->block_arena, sizeof(double)*size);
+        ri->block_arena_allocatedN = size;
+    }
+    if (ri->block_N != N){
+        const int N_old = ri->block_N<N?ri->block_N:N;
+        reb_integrator_ias15_block_realloc(r, N);
+        // New particles start with the smallest timestep any particle wants.
+        double dt_want = fabs(r->dt);
+        for (int i=0;i<N_old;i++){
+            if (ri->block_dt_want[i]<dt_want) dt_want = ri->block_dt_want[i];
+        }
+        for (int i=N_old;i<N;i++){
+            ri->block_dt_want[i] = dt_want;
+            ri->block_dt_last[i] = r->dt_last_done;
+        }
+    }
+}
+
+// Copies the state of IAS15 into the block arena (restore=0) or back (restore=1).
+static void reb_integrator_ias15_block_backup(struct reb_simulation* const r, const int restore){
+    const int stride = r->ri_ias15.arena_allocatedN;
+    const int N3 = 3*r->ri_ias15.block_N;
+    double* backup = r->ri_ias15.block_arena;
+    for (int m=0;m<3;m++){
+        for (int j=block_backup_ranges[m][0];j<block_backup_ranges[m][1];j++){
+            double* const a = r->ri_ias15.arena + j*stride;
+            if (restore){
+                memcpy(a, backup, sizeof(double)*N3);
+            }else{
+                memcpy(backup, a, sizeof(double)*N3);
+            }
+            backup += N3;
+        }
+    }
+}
+
+// Positions of the particles on faster levels at substep n of level l.
+static double* reb_integrator_ias15_block_rec(struct reb_simulation* const r, const int l, const int n){
+    const int N3 = 3*r->ri_ias15.block_N;
+    return r->ri_ias15.block_arena + (IAS15_BLOCK_BACKUP_N + 7*l + n-1)*N3;
+}
+
+// Largest timestep for which every particle fits on one of the levels.
+static double reb_integrator_ias15_block_dt(const struct reb_simulation* const r, const int levels){
+    const double* const dt_want = r->ri_ias15.block_dt_want;
+    double dt_max = 0.;
+    double dt_min = INFINITY;
+    for (int i=0;i<r->N;i++){
+        if (dt_want[i]>dt_max) dt_max = dt_want[i];
+        if (dt_want[i]<dt_min) dt_min = dt_want[i];
+    }
+    const double dt_limit = ldexp(dt_min, levels-1);
+    return dt_max<dt_limit?dt_max:dt_limit;
+}
+
+// Predicted position component k at the fraction s of the timestep dt (see position predictor above).
+static inline double reb_integrator_ias15_block_predict_k(const struct reb_simulation_integrator_ias15* const ri, const int k, const double s, const double dt){
+    const struct reb_dp7 b = ri->b;
+    return -ri->csx[k] + ((((((((b.p6[k]*7.*s/9. + b.p5[k])*3.*s/4. + b.p4[k])*5.*s/7. + b.p3[k])*2.*s/3. + b.p2[k])*3.*s/5. + b.p1[k])*s/2. + b.p0[k])*s/3. + ri->a0[k])*dt*s/2. + ri->v0[k])*dt*s + ri->x0[k];
+}
+
+// Sets the positions of the particles block_index[start] to block_index[end-1] to their predicted positions.
+static void reb_integrator_ias15_block_predict(struct reb_simulation* const r, const int start, const int end, const double s, const double dt){
+    const struct reb_simulation_integrator_ias15* const ri = &(r->ri_ias15);
+    struct reb_particle* const particles = r->particles;
+    for (int p=start;p<end;p++){
+        const int i = ri->block_index[p];
+        particles[i].x = reb_integrator_ias15_block_predict_k(ri, 3*i+0, s, dt);
+        particles[i].y = reb_integrator_ias15_block_predict_k(ri, 3*i+1, s, dt);
+        particles[i].z = reb_integrator_ias15_block_predict_k(ri, 3*i+2, s, dt);
+    }
+}
+
+// Sets the positions of all particles on levels slower than l to their predicted positions at time t.
+static void reb_integrator_ias15_block_predict_slower(const struct reb_ias15_block* const bl, const int l, const double t){
+    for (int m=0;m<l;m++){
+        if (bl->offset[m]==bl->offset[m+1]) continue;
+        const double s = (t - bl->t[m])/bl->dt[m];
+        reb_integrator_ias15_block_predict(bl->r, bl->offset[m], bl->offset[m+1], s, bl->dt[m]);
+    }
+}
+
+// Calculates the gravitational acceleration of the particles idx[0] to idx[n-1] due to all particles.
+// Same as REB_GRAVITY_BASIC.
+static void reb_integrator_ias15_block_forces(struct reb_simulation* const r, const int* const idx, const int n){
+    struct reb_particle* const particles = r->particles;
+    const int N = r->N;
+    const int _N_active = (r->N_active==-1)?N:r->N_active;
+    const int _testparticle_type = r->testparticle_type;
+    const double G = r->G;
+    const double softening2 = r->softening*r->softening;
+#pragma omp parallel for
+    for (int p=0;p<n;p++){
+        const int i = idx[p];
+        // Test particles only act on active particles if testparticle_type is 1.
+        const int jmax = (_testparticle_type && i<_N_active)?N:_N_active;
+        double ax = 0.;
+        double ay = 0.;
+        double az = 0.;
+        for (int j=0;j<jmax;j++){
+            if (i==j) continue;
+            const double dx = particles[i].x - particles[j].x;
+            const double dy = particles[i].y - particles[j].y;
+            const double dz = particles[i].z - particles[j].z;
+            const double _r = sqrt(dx*dx + dy*dy + dz*dz + softening2);
+            const double prefact = -G/(_r*_r*_r)*particles[j].m;
+            ax += prefact*dx;
+            ay += prefact*dy;
+            az += prefact*dz;
+        }
+        particles[i].ax = ax;
+        particles[i].ay = ay;
+        particles[i].az = az;
+    }
+}
+
+static struct reb_dpconst7 dpshift(struct reb_dp7 dp, const int k){
+    struct reb_dpconst7 dpc = {
+        .p0 = dp.p0+k, 
+        .p1 = dp.p1+k, 
+        .p2 = dp.p2+k, 
+        .p3 = dp.p3+k, 
+        .p4 = dp.p4+k, 
+        .p5 = dp.p5+k, 
+        .p6 = dp.p6+k, 
+    };
+    return dpc;
+}
+
+// Does one step for the particles on level l. Returns 0 if the step is rejected.
+static int reb_integrator_ias15_block_step_level(struct reb_ias15_block* const bl, const int l){
+    struct reb_simulation* const r = bl->r;
+    struct reb_simulation_integrator_ias15* const ri = &(r->ri_ias15);
+    struct reb_particle* const particles = r->particles;
+    const int* const index = ri->block_index;
+    const int start = bl->offset[l];
+    const int end = bl->offset[l+1];
+    const int end_all = bl->offset[bl->levels];
+    const double t_beginning = bl->t[l];
+    const double dt = bl->dt[l];
+    
+    double* restrict const csx = ri->csx; 
+    double* restrict const csv = ri->csv; 
+    double* restrict const at = ri->at; 
+    double* restrict const x0 = ri->x0; 
+    double* restrict const v0 = ri->v0; 
+    double* restrict const a0 = ri->a0; 
+    double* const g[7]   = {ri->g.p0, ri->g.p1, ri->g.p2, ri->g.p3, ri->g.p4, ri->g.p5, ri->g.p6};
+    double* const b[7]   = {ri->b.p0, ri->b.p1, ri->b.p2, ri->b.p3, ri->b.p4, ri->b.p5, ri->b.p6};
+    double* const csb[7] = {ri->csb.p0, ri->csb.p1, ri->csb.p2, ri->csb.p3, ri->csb.p4, ri->csb.p5, ri->csb.p6};
+
+    for (int p=start;p<end;p++){
+        const int i = index[p];
+        for (int k=3*i;k<3*i+3;k++){
+            for (int j=0;j<7;j++){
+                csb[j][k] = 0.;
+            }
+            g[0][k] = b[6][k]*d[15] + b[5][k]*d[10] + b[4][k]*d[6] + b[3][k]*d[3]  + b[2][k]*d[1]  + b[1][k]*d[0]  + b[0][k];
+            g[1][k] = b[6][k]*d[16] + b[5][k]*d[11] + b[4][k]*d[7] + b[3][k]*d[4]  + b[2][k]*d[2]  + b[1][k];
+            g[2][k] = b[6][k]*d[17] + b[5][k]*d[12] + b[4][k]*d[8] + b[3][k]*d[5]  + b[2][k];
+            g[3][k] = b[6][k]*d[18] + b[5][k]*d[13] + b[4][k]*d[9] + b[3][k];
+            g[4][k] = b[6][k]*d[19] + b[5][k]*d[14] + b[4][k];
+            g[5][k] = b[6][k]*d[20] + b[5][k];
+            g[6][k] = b[6][k];
+        }
+    }
+
+    double predictor_corrector_error = 1e300;
+    double predictor_corrector_error_last = 2;
+    int iterations = 0; 
+    // Predictor corrector loop (same stopping criteria as above)
+    while(1){
+        if(predictor_corrector_error<1e-16){
+            break;
+        }
+        if(iterations > 2 && predictor_corrector_error_last <= predictor_corrector_error){
+            break;
+        }
+        if (iterations>=12){
+            ri->iterations_max_exceeded++;
+            const int integrator_iterations_warning = 10;
+            if (ri->iterations_max_exceeded==integrator_iterations_warning ){
+                reb_warning(r, "At least 10 predictor corrector loops in IAS15 did not converge. This is typically an indication of the timestep being too large.");
+            }
+            break;
+        }
+        predictor_corrector_error_last = predictor_corrector_error;
+        predictor_corrector_error = 0;
+        iterations++;
+
+        for(int n=1;n<8;n++) {
+            const double t = t_beginning + dt * h[n];
+            reb_integrator_ias15_block_predict(r, start, end, h[n], dt);
+            reb_integrator_ias15_block_predict_slower(bl, l, t);
+            if (end<end_all){
+                const double* const rec = reb_integrator_ias15_block_rec(r, l, n);
+                for (int p=end;p<end_all;p++){
+                    const int i = index[p];
+                    particles[i].x = rec[3*i+0];
+                    particles[i].y = rec[3*i+1];
+                    particles[i].z = rec[3*i+2];
+                }
+            }
+            reb_integrator_ias15_block_forces(r, index+start, end-start);
+
+            // Improve b and g values. Same as above with the loops over j unrolled.
+            const double* const rrn = rr + (n-1)*n/2;
+            const double* const cn = c + (n-2)*(n-1)/2;
+            double maxak = 0.0;
+            double maxb6ktmp = 0.0;
+            for (int p=start;p<end;p++){
+                const int i = index[p];
+                at[3*i+0] = particles[i].ax;
+                at[3*i+1] = particles[i].ay;
+                at[3*i+2] = particles[i].az;
+                for (int k=3*i;k<3*i+3;k++){
+                    double gk = at[k];
+                    double gk_cs = 0.;
+                    add_cs(&gk, &gk_cs, -a0[k]);
+                    add_cs(&gk, &gk_cs, 0.); // csa0 is always 0 for REB_GRAVITY_BASIC
+                    double gn = gk/rrn[0];
+                    for (int j=0;j<n-1;j++){
+                        gn = (gn - g[j][k])/rrn[j+1];
+                    }
+                    const double tmp = gn - g[n-1][k];
+                    g[n-1][k] = gn;
+                    for (int j=0;j<n-1;j++){
+                        add_cs(&(b[j][k]), &(csb[j][k]), tmp * cn[j]);
+                    }
+                    add_cs(&(b[n-1][k]), &(csb[n-1][k]), tmp);
+                    if (n==7){
+                        if (ri->epsilon_global){
+                            const double ak  = fabs(at[k]);
+                            if (isnormal(ak) && ak>maxak){
+                                maxak = ak;
+                            }
+                            const double b6ktmp = fabs(tmp);
+                            if (isnormal(b6ktmp) && b6ktmp>maxb6ktmp){
+                                maxb6ktmp = b6ktmp;
+                            }
+                        }else{
+                            const double errork = fabs(tmp/at[k]);
+                            if (isnormal(errork) && errork>predictor_corrector_error){
+                                predictor_corrector_error = errork;
+                            }
+                        }
+                    }
+                }
+            }
+            if (n==7 && ri->epsilon_global){
+                predictor_corrector_error = maxb6ktmp/maxak;
+            }
+        }
+    }
+
+    // Estimate the error and find the new timestep of each particle individually.
+    int rejected = 0;
+    for (int p=start;p<end;p++){
+        const int i = index[p];
+        double maxak = 0.0;
+        double maxb6k = 0.0;
+        for (int k=3*i;k<3*i+3;k++){
+            const double ak  = fabs(at[k]);
+            if (isnormal(ak) && ak>maxak){
+                maxak = ak;
+            }
+            const double b6k = fabs(b[6][k]); 
+            if (isnormal(b6k) && b6k>maxb6k){
+                maxb6k = b6k;
+            }
+        }
+        const double integrator_error = maxb6k/maxak;
+        double dt_new = fabs(dt)/safety_factor;
+        if (isnormal(integrator_error)){
+            const double dt_error = sqrt7(ri->epsilon/integrator_error)*fabs(dt);
+            if (dt_error<dt_new) dt_new = dt_error;
+        }
+        if (dt_new<ri->min_dt) dt_new = ri->min_dt;
+        ri->block_dt_want[i] = dt_new;
+        if (dt_new < safety_factor*fabs(dt)){
+            rejected = 1;
+        }
+    }
+    if (rejected){
+        return 0;
+    }
+
+    // Record positions at the substeps of slower levels which fall into this step.
+    for (int m=0;m<l;m++){
+        for (int n=1;n<8;n++){
+            const double s = (bl->t[m] + bl->dt[m]*h[n] - t_beginning)/dt;
+            if (s<=0. || s>1.) continue;
+            double* const rec = reb_integrator_ias15_block_rec(r, m, n);
+            for (int p=start;p<end;p++){
+                const int i = index[p];
+                for (int k=3*i;k<3*i+3;k++){
+                    rec[k] = reb_integrator_ias15_block_predict_k(ri, k, s, dt);
+                }
+            }
+        }
+    }
+
+    // Find new position and velocity values at end of the sequence (same as above).
+    for (int p=start;p<end;p++){
+        const int i = index[p];
+        for (int k=3*i;k<3*i+3;k++){
+            add_cs(&(x0[k]), &(csx[k]), b[6][k]/72.*dt*dt);
+            add_cs(&(x0[k]), &(csx[k]), b[5][k]/56.*dt*dt);
+            add_cs(&(x0[k]), &(csx[k]), b[4][k]/42.*dt*dt);
+            add_cs(&(x0[k]), &(csx[k]), b[3][k]/30.*dt*dt);
+            add_cs(&(x0[k]), &(csx[k]), b[2][k]/20.*dt*dt);
+            add_cs(&(x0[k]), &(csx[k]), b[1][k]/12.*dt*dt);
+            add_cs(&(x0[k]), &(csx[k]), b[0][k]/6.*dt*dt);
+            add_cs(&(x0[k]), &(csx[k]), a0[k]/2.*dt*dt);
+            add_cs(&(x0[k]), &(csx[k]), v0[k]*dt);
+            add_cs(&(v0[k]), &(csv[k]), b[6][k]/8.*dt);
+            add_cs(&(v0[k]), &(csv[k]), b[5][k]/7.*dt);
+            add_cs(&(v0[k]), &(csv[k]), b[4][k]/6.*dt);
+            add_cs(&(v0[k]), &(csv[k]), b[3][k]/5.*dt);
+            add_cs(&(v0[k]), &(csv[k]), b[2][k]/4.*dt);
+            add_cs(&(v0[k]), &(csv[k]), b[1][k]/3.*dt);
+            add_cs(&(v0[k]), &(csv[k]), b[0][k]/2.*dt);
+            add_cs(&(v0[k]), &(csv[k]), a0[k]*dt);
+        }
+        // The next step of this particle has the same length unless the levels change.
+        copybuffers(dpshift(ri->e,3*i), dpshift(ri->er,3*i), 3);
+        copybuffers(dpshift(ri->b,3*i), dpshift(ri->br,3*i), 3);
+        predict_next_step(1., 3, dpshift(ri->er,3*i), dpshift(ri->br,3*i), dpshift(ri->e,3*i), dpshift(ri->b,3*i));
+    }
+    return 1;
+}
+
+// Integrates all particles on level l and faster levels from t0 to t0+dt. Returns 0 if a step is rejected.
+static int reb_integrator_ias15_block_step_levels(struct reb_ias15_block* const bl, const int l, const double t0, const double dt, const int a0_ready){
+    struct reb_simulation* const r = bl->r;
+    struct reb_simulation_integrator_ias15* const ri = &(r->ri_ias15);
+    struct reb_particle* const particles = r->particles;
+    const int* const index = ri->block_index;
+    const int start = bl->offset[l];
+    const int end = bl->offset[bl->levels];
+    if (start==end){
+        return 1; // No particles on this or faster levels
+    }
+    bl->t[l] = t0;
+    bl->dt[l] = dt;
+    if (!a0_ready){
+        // Accelerations at the beginning of the step. Particles on this and faster levels are at t0.
+        for (int p=start;p<end;p++){
+            const int i = index[p];
+            particles[i].x = ri->x0[3*i+0];
+            particles[i].y = ri->x0[3*i+1];
+            particles[i].z = ri->x0[3*i+2];
+        }
+        reb_integrator_ias15_block_predict_slower(bl, l, t0);
+        reb_integrator_ias15_block_forces(r, index+start, end-start);
+        for (int p=start;p<end;p++){
+            const int i = index[p];
+            ri->a0[3*i+0] = particles[i].ax;
+            ri->a0[3*i+1] = particles[i].ay;
+            ri->a0[3*i+2] = particles[i].az;
+        }
+    }
+    if (bl->offset[l+1]<end){
+        if (!reb_integrator_ias15_block_step_levels(bl, l+1, t0, dt/2., 1)) return 0;
+        if (!reb_integrator_ias15_block_step_levels(bl, l+1, t0+dt/2., dt/2., 0)) return 0;
+    }
+    if (bl->offset[l+1]==start){
+        return 1; // No particles on this level
+    }
+    return reb_integrator_ias15_block_step_level(bl, l);
+}
+
+// Does one step of length r->dt with block timesteps. Returns 0 if the step is rejected.
+static int reb_integrator_ias15_block_step(struct reb_simulation* r){
+    struct reb_simulation_integrator_ias15* const ri = &(r->ri_ias15);
+    const int N = r->N;
+    const int cleared = ri->allocatedN < 3*N; // All b and e values are set to 0 in reb_integrator_ias15_alloc.
+    reb_integrator_ias15_alloc(r);
+    struct reb_ias15_block bl = {.r = r};
+    bl.levels = ri->block_levels<IAS15_BLOCK_LEVELS_MAX?ri->block_levels:IAS15_BLOCK_LEVELS_MAX;
+    reb_integrator_ias15_block_alloc(r, bl.levels);
+    struct reb_particle* const particles = r->particles;
+    int* const level = ri->block_level;
+    int* const index = ri->block_index;
+
+    // Positions of slower particles are only predicted well once they have done a step. 
+    // Until then, all particles use the same timestep.
+    for (int i=0;i<N;i++){
+        if (cleared){
+            ri->block_dt_last[i] = 0.;
+        }
+        if (ri->block_dt_last[i]==0.){
+            bl.levels = 1;
+        }
+    }
+    if (bl.levels==1){
+        const double dt_min = reb_integrator_ias15_block_dt(r, 1);
+        if (fabs(r->dt)>dt_min){
+            r->dt = copysign(dt_min, r->dt);
+        }
+    }
+
+    // Put every particle on the slowest level on which its timestep is not larger than the one it wants.
+    int count[IAS15_BLOCK_LEVELS_MAX] = {0};
+    for (int i=0;i<N;i++){
+        int l = 0;
+        double dt = fabs(r->dt);
+        while (l<bl.levels-1 && dt>ri->block_dt_want[i]){
+            dt /= 2.;
+            l++;
+        }
+        level[i] = l;
+        count[l]++;
+    }
+    bl.offset[0] = 0;
+    for (int l=0;l<bl.levels;l++){
+        bl.offset[l+1] = bl.offset[l] + count[l];
+        count[l] = bl.offset[l];
+    }
+    for (int i=0;i<N;i++){
+        index[count[level[i]]++] = i;
+    }
+
+    for (int i=0;i<N;i++){
+        // Predict b values for the new timestep (does nothing if the timestep did not change).
+        if (ri->block_dt_last[i]!=0.){
+            const double ratio = ldexp(r->dt, -level[i])/ri->block_dt_last[i];
+            predict_next_step(ratio, 3, dpshift(ri->er,3*i), dpshift(ri->br,3*i), dpshift(ri->e,3*i), dpshift(ri->b,3*i));
+        }
+        ri->x0[3*i+0] = particles[i].x;
+        ri->x0[3*i+1] = particles[i].y;
+        ri->x0[3*i+2] = particles[i].z;
+        ri->v0[3*i+0] = particles[i].vx;
+        ri->v0[3*i+1] = particles[i].vy;
+        ri->v0[3*i+2] = particles[i].vz;
+        ri->a0[3*i+0] = particles[i].ax;
+        ri->a0[3*i+1] = particles[i].ay;
+        ri->a0[3*i+2] = particles[i].az;
+    }
+    reb_integrator_ias15_block_backup(r, 0);
+
+    if (!reb_integrator_ias15_block_step_levels(&bl, 0, r->t, r->dt, 1)){
+        // Reset particles and try again with smaller timesteps.
+        reb_integrator_ias15_block_backup(r, 1);
+        for (int i=0;i<N;i++){
+            particles[i].x  = ri->x0[3*i+0];
+            particles[i].y  = ri->x0[3*i+1];
+            particles[i].z  = ri->x0[3*i+2];
+            particles[i].vx = ri->v0[3*i+0];
+            particles[i].vy = ri->v0[3*i+1];
+            particles[i].vz = ri->v0[3*i+2];
+            particles[i].ax = ri->a0[3*i+0];
+            particles[i].ay = ri->a0[3*i+1];
+            particles[i].az = ri->a0[3*i+2];
+        }
+        r->dt = copysign(reb_integrator_ias15_block_dt(r, bl.levels), r->dt);
+        return 0;
+    }
+
+    for (int i=0;i<N;i++){
+        particles[i].x  = ri->x0[3*i+0];
+        particles[i].y  = ri->x0[3*i+1];
+        particles[i].z  = ri->x0[3*i+2];
+        particles[i].vx = ri->v0[3*i+0];
+        particles[i].vy = ri->v0[3*i+1];
+        particles[i].vz = ri->v0[3*i+2];
+        ri->block_dt_last[i] = ldexp(r->dt, -level[i]);
+    }
+    r->t += r->dt;
+    r->dt_last_done = r->dt;
+    r->dt = copysign(reb_integrator_ias15_block_dt(r, bl.levels), r->dt);
+    return 1;
+}
+
+int reb_integrator_ias15_interpolate(struct reb_simulation* const r, const double t, struct reb_particle* const particles){
+    if (r->integrator != REB_INTEGRATOR_IAS15){
+        reb_error(r, "Dense output is only available for the IAS15 integrator.");
+        return 0;
+    }
+    const int N = r->N;
+    const int N3 = 3*N;
+    const double dt = r->dt_last_done;
+    if (reb_integrator_ias15_block_supported(r)){
+        reb_error(r, "Dense output is not available with block timesteps.");
+        return 0;
+    }
+    // The stored step is only valid if the particles have not been changed since.
+    int valid = dt!=0. && r->ri_ias15.x0!=NULL && r->ri_ias15.allocatedN>=N3 && r->ri_ias15.dense_N==N && r->ri_ias15.dense_t==r->t;
+    for (int i=0;valid && i<N;i++){
+        const struct reb_particle p = r->particles[i];
+        const double* const x0 = r->ri_ias15.x0+3*i;
+        const double* const v0 = r->ri_ias15.v0+3*i;
+        valid = p.x==x0[0] && p.y==x0[1] && p.z==x0[2] && p.vx==v0[0] && p.vy==v0[1] && p.vz==v0[2];
+    }
+    if (!valid){
+        reb_error(r, "Dense output requires at least one IAS15 timestep with the current set of particles.");
+        return 0;
+    }
+    // Fraction of the last timestep. 
+    const double s = (t - (r->t - dt))/dt;
+    if (s<0. || s>1.){
+        reb_error(r, "Dense output is only available within the last timestep.");
+        return 0;
+    }
+    // After a step, x0 and v0 contain the positions and velocities at the end of the step, 
+    // a0 contains the accelerations at the beginning and br the b coefficients of the step.
+    // The polynomials are evaluated relative to the end of the step:
+    //   v(s) = v(1) + dt*(V(s)-V(1))
+    //   x(s) = x(1) + dt*(s-1)*(v(1)-dt*V(1)) + dt^2*(X(s)-X(1))
+    // where V and X are the velocity and position predictors without the initial values.
+    const double* restrict const x0 = r->ri_ias15.x0; 
+    const double* restrict const v0 = r->ri_ias15.v0; 
+    const double* restrict const a0 = r->ri_ias15.a0; 
+    const struct reb_dp7 b = r->ri_ias15.br;
+    memcpy(particles, r->particles, sizeof(struct reb_particle)*N);
+    for(int i=0;i<N;i++) {
+        double xv[6];
+        for (int j=0;j<3;j++){
+            const int k = 3*i+j;
+            const double X1 = (((((((b.p6[k]*7./9. + b.p5[k])*3./4. + b.p4[k])*5./7. + b.p3[k])*2./3. + b.p2[k])*3./5. + b.p1[k])/2. + b.p0[k])/3. + a0[k])/2.;
+            const double Xs = (((((((b.p6[k]*7.*s/9. + b.p5[k])*3.*s/4. + b.p4[k])*5.*s/7. + b.p3[k])*2.*s/3. + b.p2[k])*3.*s/5. + b.p1[k])*s/2. + b.p0[k])*s/3. + a0[k])*s*s/2.;
+            const double V1 = (((((((b.p6[k]*7./8. + b.p5[k])*6./7. + b.p4[k])*5./6. + b.p3[k])*4./5. + b.p2[k])*3./4. + b.p1[k])*2./3. + b.p0[k])/2. + a0[k]);
+            const double Vs = (((((((b.p6[k]*7.*s/8. + b.p5[k])*6.*s/7. + b.p4[k])*5.*s/6. + b.p3[k])*4.*s/5. + b.p2[k])*3.*s/4. + b.p1[k])*2.*s/3. + b.p0[k])*s/2. + a0[k])*s;
+            xv[j]   = x0[k] + dt*(s-1.)*(v0[k]-dt*V1) + dt*dt*(Xs-X1);
+            xv[j+3] = v0[k] + dt*(Vs-V1);
+        }
+        particles[i].x  = xv[0];
+        particles[i].y  = xv[1];
+        particles[i].z  = xv[2];
+        particles[i].vx = xv[3];
+        particles[i].vy = xv[4];
+        particles[i].vz = xv[5];
+    }
+    return 1;
+}
+
 // Do nothing here. This is only used in a leapfrog-like DKD integrator. IAS15 performs one complete timestep.
 void reb_integrator_ias15_part1(struct reb_simulation* r){
     r->gravity_ignore_terms = 0;
@@ -707,7 +1511,16 @@ void reb_integrator_ias15_part2(struct reb_simulation* r){
     integrator_generate_constants();
 #endif  // GENERATE_CONSTANTS
     // Try until a step was successful.
+    if (reb_integrator_ias15_block_supported(r)){
+        while(!reb_integrator_ias15_block_step(r));
+        return;
+    }
     while(!reb_integrator_ias15_step(r));
+    if (r->integrator==REB_INTEGRATOR_IAS15){
+        // Remember the state after the step for dense output
+        r->ri_ias15.dense_N = r->N;
+        r->ri_ias15.dense_t = r->t;
+    }
 }
 
 void reb_integrator_ias15_synchronize(struct reb_simulation* r){
@@ -715,48 +1528,51 @@ void reb_integrator_ias15_synchronize(struct reb_simulation* r){
 void reb_integrator_ias15_clear(struct reb_simulation* r){
     const int N3 = r->ri_ias15.allocatedN;
     if (N3){
-        clear_dp7(&(r->ri_ias15.g),N3);
-        clear_dp7(&(r->ri_ias15.e),N3);
-        clear_dp7(&(r->ri_ias15.b),N3);
-        clear_dp7(&(r->ri_ias15.csb),N3);
-        clear_dp7(&(r->ri_ias15.er),N3);
-        clear_dp7(&(r->ri_ias15.br),N3);
-        
-        double* restrict const csx = r->ri_ias15.csx; 
-        double* restrict const csv = r->ri_ias15.csv; 
-        for (int i=0;i<N3;i++){
-            // Kill compensated summation coefficients
-            csx[i] = 0;
-            csv[i] = 0;
-        }
+        // Kill compensated summation coefficients and all b, e, g coefficients
+        clear_arena(r, IAS15_ARENA_CSX, IAS15_ARENA_CSV+1, N3);
+        clear_arena(r, IAS15_ARENA_G, IAS15_ARENA_N, N3);
     }
 }
 
 void reb_integrator_ias15_reset(struct reb_simulation* r){
+    // Memory is kept for the next time IAS15 is used (see reb_integrator_ias15_free).
     r->ri_ias15.allocatedN  = 0;
-    r->ri_ias15.map_allocated_N  = 0;
-    free_dp7(&(r->ri_ias15.g));
-    free_dp7(&(r->ri_ias15.e));
-    free_dp7(&(r->ri_ias15.b));
-    free_dp7(&(r->ri_ias15.csb));
-    free_dp7(&(r->ri_ias15.er));
-    free_dp7(&(r->ri_ias15.br));
-    free(r->ri_ias15.at);
-    r->ri_ias15.at =  NULL;
-    free(r->ri_ias15.x0);
-    r->ri_ias15.x0 =  NULL;
-    free(r->ri_ias15.v0);
-    r->ri_ias15.v0 =  NULL;
-    free(r->ri_ias15.a0);
-    r->ri_ias15.a0 =  NULL;
-    free(r->ri_ias15.csx);
-    r->ri_ias15.csx=  NULL;
-    free(r->ri_ias15.csv);
-    r->ri_ias15.csv=  NULL;
-    free(r->ri_ias15.csa0);
-    r->ri_ias15.csa0 =  NULL;
+    r->ri_ias15.dense_N     = 0;
+}
+
+void reb_integrator_ias15_free(struct reb_simulation* r){
+    reb_integrator_ias15_reset(r);
+    free(r->ri_ias15.arena);
+    r->ri_ias15.arena = NULL;
+    r->ri_ias15.arena_allocatedN = 0;
+    r->ri_ias15.at = NULL;
+    r->ri_ias15.x0 = NULL;
+    r->ri_ias15.v0 = NULL;
+    r->ri_ias15.a0 = NULL;
+    r->ri_ias15.csx = NULL;
+    r->ri_ias15.csv = NULL;
+    r->ri_ias15.csa0 = NULL;
+    memset(&(r->ri_ias15.g),   0, sizeof(struct reb_dp7));
+    memset(&(r->ri_ias15.b),   0, sizeof(struct reb_dp7));
+    memset(&(r->ri_ias15.csb), 0, sizeof(struct reb_dp7));
+    memset(&(r->ri_ias15.e),   0, sizeof(struct reb_dp7));
+    memset(&(r->ri_ias15.br),  0, sizeof(struct reb_dp7));
+    memset(&(r->ri_ias15.er),  0, sizeof(struct reb_dp7));
     free(r->ri_ias15.map);
-    r->ri_ias15.map =  NULL;
+    r->ri_ias15.map = NULL;
+    r->ri_ias15.map_allocated_N = 0;
+    free(r->ri_ias15.block_level);
+    free(r->ri_ias15.block_index);
+    free(r->ri_ias15.block_dt_want);
+    free(r->ri_ias15.block_dt_last);
+    free(r->ri_ias15.block_arena);
+    r->ri_ias15.block_level = NULL;
+    r->ri_ias15.block_index = NULL;
+    r->ri_ias15.block_dt_want = NULL;
+    r->ri_ias15.block_dt_last = NULL;
+    r->ri_ias15.block_arena = NULL;
+    r->ri_ias15.block_arena_allocatedN = 0;
+    r->ri_ias15.block_N = 0;
 }
 
 #ifdef GENERATE_CONSTANTS
@@ -28,4 +28,7 @@ void reb_integrator_ias15_part1(struct reb_simulation* r);         ///< Internal
 void reb_integrator_ias15_synchronize(struct reb_simulation* r);   ///< Internal function used to call a specific integrator
 void reb_integrator_ias15_clear(struct reb_simulation* r);         ///< Internal function used to call a specific integrator
 void reb_integrator_ias15_alloc(struct reb_simulation* r);         ///< Internal function, alloctes memory for IAS15 
+void reb_integrator_ias15_reserve(struct reb_simulation* r, const int N3); ///< Internal function, makes sure the arena has room for N3 doubles per array
+void reb_integrator_ias15_free(struct reb_simulation* r);          ///< Internal function, frees the arena
+void reb_integrator_ias15_block_realloc(struct reb_simulation* r, const int N); ///< Internal function, resizes the per particle arrays used for block timesteps
 #endif
@@ -125,44 +125,110 @@ static double gg(struct reb_janus_scheme s, unsigned int stage){
 }
 
 
-static void to_int(struct reb_particle_int* psi, struct reb_particle* ps, unsigned int N, double scale_pos, double scale_vel){
+void reb_particle_int_soa_realloc(struct reb_particle_int_soa* const p, const unsigned int N){
+    REB_PARTICLE_INT_TYPE* data = realloc(p->x, sizeof(REB_PARTICLE_INT_TYPE)*6*N);
+    p->x  = data;
+    p->y  = data+1*N;
+    p->z  = data+2*N;
+    p->vx = data+3*N;
+    p->vy = data+4*N;
+    p->vz = data+5*N;
+}
+
+void reb_particle_int_soa_free(struct reb_particle_int_soa* const p){
+    free(p->x);
+    memset(p, 0, sizeof(struct reb_particle_int_soa));
+}
+
+void reb_particle_int_soa_to_particles_int(struct reb_particle_int* const psi, const struct reb_particle_int_soa p, const unsigned int N){
+    for(unsigned int i=0; i<N; i++){ 
+        psi[i].x  = p.x[i];
+        psi[i].y  = p.y[i];
+        psi[i].z  = p.z[i];
+        psi[i].vx = p.vx[i];
+        psi[i].vy = p.vy[i];
+        psi[i].vz = p.vz[i];
+    }
+}
+
+void reb_particle_int_soa_from_particles_int(const struct reb_particle_int_soa p, const struct reb_particle_int* const psi, const unsigned int N){
     for(unsigned int i=0; i<N; i++){ 
-        psi[i].x = ps[i].x/scale_pos; 
-        psi[i].y = ps[i].y/scale_pos; 
-        psi[i].z = ps[i].z/scale_pos; 
-        psi[i].vx = ps[i].vx/scale_vel; 
-        psi[i].vy = ps[i].vy/scale_vel; 
-        psi[i].vz = ps[i].vz/scale_vel; 
+        p.x[i]  = psi[i].x;
+        p.y[i]  = psi[i].y;
+        p.z[i]  = psi[i].z;
+        p.vx[i] = psi[i].vx;
+        p.vy[i] = psi[i].vy;
+        p.vz[i] = psi[i].vz;
     }
 }
-static void to_double(struct reb_particle* ps, struct reb_particle_int* psi, unsigned int N, double scale_pos, double scale_vel){
+
+// The integer coordinates are stored as a structure of arrays. The loops below 
+// operate on one component at a time and contain no dependencies between 
+// iterations so that the compiler can vectorize them.
+
+static void to_int(struct reb_particle_int_soa psi, struct reb_particle* ps, unsigned int N, double scale_pos, double scale_vel){
+    for(unsigned int i=0; i<N; i++){ 
+        psi.x[i] = ps[i].x/scale_pos; 
+        psi.y[i] = ps[i].y/scale_pos; 
+        psi.z[i] = ps[i].z/scale_pos; 
+        psi.vx[i] = ps[i].vx/scale_vel; 
+        psi.vy[i] = ps[i].vy/scale_vel; 
+        psi.vz[i] = ps[i].vz/scale_vel; 
+    }
+}
+
+static void to_double_pos(struct reb_particle* ps, const struct reb_particle_int_soa psi, unsigned int N, double scale_pos){
+    const REB_PARTICLE_INT_TYPE* restrict const x = psi.x;
+    const REB_PARTICLE_INT_TYPE* restrict const y = psi.y;
+    const REB_PARTICLE_INT_TYPE* restrict const z = psi.z;
     for(unsigned int i=0; i<N; i++){ 
-        ps[i].x = ((double)psi[i].x)*scale_pos; 
-        ps[i].y = ((double)psi[i].y)*scale_pos; 
-        ps[i].z = ((double)psi[i].z)*scale_pos; 
-        ps[i].vx = ((double)psi[i].vx)*scale_vel; 
-        ps[i].vy = ((double)psi[i].vy)*scale_vel; 
-        ps[i].vz = ((double)psi[i].vz)*scale_vel; 
+        ps[i].x = ((double)x[i])*scale_pos; 
+        ps[i].y = ((double)y[i])*scale_pos; 
+        ps[i].z = ((double)z[i])*scale_pos; 
+    }
+}
+
+static void to_double_vel(struct reb_particle* ps, const struct reb_particle_int_soa psi, unsigned int N, double scale_vel){
+    const REB_PARTICLE_INT_TYPE* restrict const vx = psi.vx;
+    const REB_PARTICLE_INT_TYPE* restrict const vy = psi.vy;
+    const REB_PARTICLE_INT_TYPE* restrict const vz = psi.vz;
+    for(unsigned int i=0; i<N; i++){ 
+        ps[i].vx = ((double)vx[i])*scale_vel; 
+        ps[i].vy = ((double)vy[i])*scale_vel; 
+        ps[i].vz = ((double)vz[i])*scale_vel; 
+    }
+}
+
+static void to_double(struct reb_particle* ps, const struct reb_particle_int_soa psi, unsigned int N, double scale_pos, double scale_vel){
+    to_double_pos(ps, psi, N, scale_pos);
+    to_double_vel(ps, psi, N, scale_vel);
+}
+
+static void drift_component(REB_PARTICLE_INT_TYPE* restrict const x, const REB_PARTICLE_INT_TYPE* restrict const v, const unsigned int N, const double dt, const double scale_pos, const double scale_vel){
+    for(unsigned int i=0; i<N; i++){
+        x[i] += (REB_PARTICLE_INT_TYPE)(dt*(double)v[i]*scale_vel/scale_pos) ;
     }
 }
 
 static void drift(struct reb_simulation* r, double dt, double scale_pos, double scale_vel){
     struct reb_simulation_integrator_janus* ri_janus = &(r->ri_janus);
     const unsigned int N = r->N;
-    for(unsigned int i=0; i<N; i++){
-        ri_janus->p_int[i].x += (REB_PARTICLE_INT_TYPE)(dt*(double)ri_janus->p_int[i].vx*scale_vel/scale_pos) ;
-        ri_janus->p_int[i].y += (REB_PARTICLE_INT_TYPE)(dt*(double)ri_janus->p_int[i].vy*scale_vel/scale_pos) ;
-        ri_janus->p_int[i].z += (REB_PARTICLE_INT_TYPE)(dt*(double)ri_janus->p_int[i].vz*scale_vel/scale_pos) ;
-    }
+    drift_component(ri_janus->p_int.x, ri_janus->p_int.vx, N, dt, scale_pos, scale_vel);
+    drift_component(ri_janus->p_int.y, ri_janus->p_int.vy, N, dt, scale_pos, scale_vel);
+    drift_component(ri_janus->p_int.z, ri_janus->p_int.vz, N, dt, scale_pos, scale_vel);
 }
 
 static void kick(struct reb_simulation* r, double dt, double scale_vel){
     struct reb_simulation_integrator_janus* ri_janus = &(r->ri_janus);
     const unsigned int N = r->N;
+    const struct reb_particle* restrict const particles = r->particles;
+    REB_PARTICLE_INT_TYPE* restrict const vx = ri_janus->p_int.vx;
+    REB_PARTICLE_INT_TYPE* restrict const vy = ri_janus->p_int.vy;
+    REB_PARTICLE_INT_TYPE* restrict const vz = ri_janus->p_int.vz;
     for(unsigned int i=0; i<N; i++){
-        ri_janus->p_int[i].vx += (REB_PARTICLE_INT_TYPE)(dt*r->particles[i].ax/scale_vel) ;
-        ri_janus->p_int[i].vy += (REB_PARTICLE_INT_TYPE)(dt*r->particles[i].ay/scale_vel) ;
-        ri_janus->p_int[i].vz += (REB_PARTICLE_INT_TYPE)(dt*r->particles[i].az/scale_vel) ;
+        vx[i] += (REB_PARTICLE_INT_TYPE)(dt*particles[i].ax/scale_vel) ;
+        vy[i] += (REB_PARTICLE_INT_TYPE)(dt*particles[i].ay/scale_vel) ;
+        vz[i] += (REB_PARTICLE_INT_TYPE)(dt*particles[i].az/scale_vel) ;
     }
 }
 
@@ -175,7 +241,7 @@ void reb_integrator_janus_part1(struct reb_simulation* r){
     const double scale_pos  = ri_janus->scale_pos;
     if (ri_janus->allocated_N != N){
         ri_janus->allocated_N = N;
-        ri_janus->p_int = realloc(ri_janus->p_int, sizeof(struct reb_particle_int)*N);
+        reb_particle_int_soa_realloc(&ri_janus->p_int, N);
         ri_janus->recalculate_integer_coordinates_this_timestep = 1;
     }
     
@@ -239,10 +305,16 @@ void reb_integrator_janus_part2(struct reb_simulation* r){
             reb_error(r,"Order not supported in JANUS.");
     }
    
+    // Gravity only requires positions. Velocities are only converted if 
+    // additional forces, which might depend on them, are present.
+    const int needs_vel = r->additional_forces!=NULL;
     kick(r,gg(s,0)*dt, scale_vel);
     for (unsigned int i=1; i<s.stages; i++){
         drift(r,(gg(s,i-1)+gg(s,i))*dt/2.,scale_pos,scale_vel);
-        to_double(r->particles, r->ri_janus.p_int, N, scale_pos, scale_vel); 
+        to_double_pos(r->particles, r->ri_janus.p_int, N, scale_pos); 
+        if (needs_vel){
+            to_double_vel(r->particles, r->ri_janus.p_int, N, scale_vel); 
+        }
         reb_update_acceleration(r);
         kick(r,gg(s,i)*dt, scale_vel);
     }
@@ -268,8 +340,5 @@ void reb_integrator_janus_reset(struct reb_simulation* r){
     ri_janus->order = 2;
     ri_janus->scale_pos = 1e-16;
     ri_janus->scale_vel = 1e-16;
-    if (ri_janus->p_int){
-        free(ri_janus->p_int);
-        ri_janus->p_int = NULL;
-    }
+    reb_particle_int_soa_free(&ri_janus->p_int);
 }
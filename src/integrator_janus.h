@@ -28,5 +28,9 @@ void reb_integrator_janus_part1(struct reb_simulation* r);		///< Internal functi
 void reb_integrator_janus_part2(struct reb_simulation* r);		///< Internal function used to call a specific integrator
 void reb_integrator_janus_synchronize(struct reb_simulation* r);	///< Internal function used to call a specific integrator
 void reb_integrator_janus_reset(struct reb_simulation* r);		///< Internal function used to call a specific integrator
+void reb_particle_int_soa_realloc(struct reb_particle_int_soa* const p, const unsigned int N);  ///< Internal function (Reallocates all arrays for N particles)
+void reb_particle_int_soa_free(struct reb_particle_int_soa* const p);  ///< Internal function (Frees all arrays)
+void reb_particle_int_soa_to_particles_int(struct reb_particle_int* const psi, const struct reb_particle_int_soa p, const unsigned int N);  ///< Internal function (Used for binary files)
+void reb_particle_int_soa_from_particles_int(const struct reb_particle_int_soa p, const struct reb_particle_int* const psi, const unsigned int N);  ///< Internal function (Used for binary files)
 
 #endif
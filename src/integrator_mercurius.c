@@ -38,8 +38,13 @@
 #include "integrator_ias15.h"
 #include "integrator_whfast.h"
 #include "collision.h"
+#include "output.h"
+#ifdef OPENMP
+#include <omp.h>
+#endif // OPENMP
 #define MIN(a, b) ((a) > (b) ? (b) : (a))    ///< Returns the minimum of a and b
 #define MAX(a, b) ((a) > (b) ? (a) : (b))    ///< Returns the maximum of a and b
+#define MERCURIUS_OPENMP_CLUSTER_N_MIN 32   // Minimum number of particles in a cluster of encounters which is integrated concurrently with other clusters.
 
 double reb_integrator_mercurius_L_mercury(const struct reb_simulation* const r, double d, double dcrit){
     // This is the changeover function used by the Mercury integrator.
@@ -170,86 +175,242 @@ void reb_integrator_mercurius_dh_to_inertial(struct reb_simulation* r){
 }
 
 
-static void reb_mercurius_encounter_predict(struct reb_simulation* const r){
+void reb_integrator_mercurius_backup(struct reb_vec6d* restrict backup, const struct reb_particle* restrict particles, const int N){
+    // Only positions and velocities change during the Kepler step.
+    // Copying these instead of the full particle structures halves the memory traffic.
+    for (int i=0;i<N;i++){
+        backup[i].x  = particles[i].x;
+        backup[i].y  = particles[i].y;
+        backup[i].z  = particles[i].z;
+        backup[i].vx = particles[i].vx;
+        backup[i].vy = particles[i].vy;
+        backup[i].vz = particles[i].vz;
+    }
+}
+
+void reb_integrator_mercurius_restore(struct reb_particle* restrict particles, const struct reb_vec6d* restrict backup, const int N){
+    for (int i=0;i<N;i++){
+        particles[i].x  = backup[i].x;
+        particles[i].y  = backup[i].y;
+        particles[i].z  = backup[i].z;
+        particles[i].vx = backup[i].vx;
+        particles[i].vy = backup[i].vy;
+        particles[i].vz = backup[i].vz;
+    }
+}
+
+static int reb_mercurius_band_compare(const void* a, const void* b){
+    const double rmin_a = ((const struct reb_mercurius_band*)a)->rmin;
+    const double rmin_b = ((const struct reb_mercurius_band*)b)->rmin;
+    if (rmin_a < rmin_b) return -1;
+    if (rmin_a > rmin_b) return 1;
+    // Sort by index if edges are the same to make the order reproducible.
+    return ((const struct reb_mercurius_band*)a)->index - ((const struct reb_mercurius_band*)b)->index;
+}
+
+static int reb_mercurius_encounter_predict_pair(struct reb_simulation* const r, const int i, const int j){
+    // Returns 1 if particles i and j have a close encounter during the timestep.
+    // The distance is interpolated with a cubic Hermite polynomial between the 
+    // states before and after the Kepler step.
+    struct reb_particle* const particles = r->particles;
+    const struct reb_vec6d* const particles_backup = r->ri_mercurius.particles_backup;
+    const double* const dcrit = r->ri_mercurius.dcrit;
+    const double dt = r->dt;
+    const double dxn = particles[i].x - particles[j].x;
+    const double dyn = particles[i].y - particles[j].y;
+    const double dzn = particles[i].z - particles[j].z;
+    const double dvxn = particles[i].vx - particles[j].vx;
+    const double dvyn = particles[i].vy - particles[j].vy;
+    const double dvzn = particles[i].vz - particles[j].vz;
+    const double rn = (dxn*dxn + dyn*dyn + dzn*dzn);
+    const double dxo = particles_backup[i].x - particles_backup[j].x;
+    const double dyo = particles_backup[i].y - particles_backup[j].y;
+    const double dzo = particles_backup[i].z - particles_backup[j].z;
+    const double dvxo = particles_backup[i].vx - particles_backup[j].vx;
+    const double dvyo = particles_backup[i].vy - particles_backup[j].vy;
+    const double dvzo = particles_backup[i].vz - particles_backup[j].vz;
+    const double ro = (dxo*dxo + dyo*dyo + dzo*dzo);
+
+    const double drndt = (dxn*dvxn+dyn*dvyn+dzn*dvzn)*2.;
+    const double drodt = (dxo*dvxo+dyo*dvyo+dzo*dvzo)*2.;
+
+    const double a = 6.*(ro-rn)+3.*dt*(drodt+drndt); 
+    const double b = 6.*(rn-ro)-2.*dt*(2.*drodt+drndt); 
+    const double c = dt*drodt; 
+
+    double rmin = MIN(rn,ro);
+
+    const double s = b*b-4.*a*c;
+    const double sr = sqrt(MAX(0.,s));
+    const double tmin1 = (-b + sr)/(2.*a); 
+    const double tmin2 = (-b - sr)/(2.*a); 
+    if (tmin1>0. && tmin1<1.){
+        const double rmin1 = (1.-tmin1)*(1.-tmin1)*(1.+2.*tmin1)*ro
+                             + tmin1*tmin1*(3.-2.*tmin1)*rn
+                             + tmin1*(1.-tmin1)*(1.-tmin1)*dt*drodt
+                             - tmin1*tmin1*(1.-tmin1)*dt*drndt;
+        rmin = MIN(MAX(rmin1,0.),rmin);
+    }
+    if (tmin2>0. && tmin2<1.){
+        const double rmin2 = (1.-tmin2)*(1.-tmin2)*(1.+2.*tmin2)*ro
+                             + tmin2*tmin2*(3.-2.*tmin2)*rn
+                             + tmin2*(1.-tmin2)*(1.-tmin2)*dt*drodt
+                             - tmin2*tmin2*(1.-tmin2)*dt*drndt;
+        rmin = MIN(MAX(rmin2,0.),rmin);
+    }
+
+    double dcritmax2 = MAX(dcrit[i],dcrit[j]);
+    dcritmax2 *= 1.21*dcritmax2;
+    return rmin < dcritmax2;
+}
+
+static int reb_mercurius_band_search(const struct reb_mercurius_band* const bands, const int N, const double rmin, const int inclusive){
+    // Returns the index of the first band in the sorted array bands with an
+    // inner edge larger than rmin (or equal to rmin if inclusive is set). 
+    int lo = 0;
+    int hi = N;
+    while (lo<hi){
+        const int mid = lo + (hi-lo)/2;
+        if (bands[mid].rmin<rmin || (!inclusive && bands[mid].rmin==rmin)){
+            lo = mid+1;
+        }else{
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void reb_mercurius_encounter_pairs_add(struct reb_mercurius_encounter_pairs* const pairs, const int i, const int j){
+    if (pairs->allocatedN<=pairs->N){
+        // Init to 32 if no space has been allocated yet, otherwise double it.
+        pairs->allocatedN = pairs->allocatedN ? pairs->allocatedN * 2 : 32;
+        pairs->ij = realloc(pairs->ij, sizeof(int)*2*pairs->allocatedN);
+    }
+    pairs->ij[2*pairs->N]   = i;
+    pairs->ij[2*pairs->N+1] = j;
+    pairs->N++;
+}
+
+static inline void reb_mercurius_encounter_predict_bands(struct reb_simulation* const r, const struct reb_mercurius_band* const a, const struct reb_mercurius_band* const b, const int N_active, unsigned char* const flags, struct reb_mercurius_encounter_pairs* const pairs, unsigned int* const tponly_encounter){
+    // Bands a and b overlap. At least one of them belongs to an active particle.
+    const int i = MIN(a->index, b->index);
+    const int j = MAX(a->index, b->index);
+    if (reb_mercurius_encounter_predict_pair(r, i, j)){
+        flags[i] = 1;
+        flags[j] = 1;
+        reb_mercurius_encounter_pairs_add(pairs, i, j);
+        if (j<N_active){ // Two massive particles have a close encounter
+            *tponly_encounter = 0;
+        }
+    }
+}
+
+void reb_integrator_mercurius_encounter_predict(struct reb_simulation* const r){
     // This function predicts close encounters during the timestep
     // It makes use of the old and new position and velocities obtained
     // after the Kepler step.
     struct reb_simulation_integrator_mercurius* rim = &(r->ri_mercurius);
     struct reb_particle* const particles = r->particles;
-    struct reb_particle* const particles_backup = rim->particles_backup;
+    const struct reb_vec6d* const particles_backup = rim->particles_backup;
+    struct reb_mercurius_band* const bands = rim->encounter_bands;
     const double* const dcrit = rim->dcrit;
     const int N = r->N;
-    const int N_active = r->N_active==-1?r->N:r->N_active;
+    const int N_active = r->N_active==-1?r->N:MIN(r->N_active,r->N);
     const double dt = r->dt;
-    rim->encounterN = 1;
-    rim->encounter_map[0] = 1;
+    unsigned int tponly_encounter = 1;
     if (r->testparticle_type==1){
-        rim->tponly_encounter = 0; // testparticles affect massive particles
-    }else{
-        rim->tponly_encounter = 1;
+        tponly_encounter = 0; // testparticles affect massive particles
     }
-    for (int i=1; i<N; i++){
-        rim->encounter_map[i] = 0;
+    
+    // Every thread flags particles in its own array and records the pairs 
+    // it finds in its own list. The arrays are merged after the pair loop. 
+#ifdef OPENMP
+    const int N_threads = omp_get_max_threads();
+#else // OPENMP
+    const int N_threads = 1;
+#endif // OPENMP
+    if (rim->encounter_flags_allocatedN < (unsigned int)(N*N_threads)){
+        rim->encounter_flags_allocatedN = N*N_threads;
+        rim->encounter_flags = realloc(rim->encounter_flags, sizeof(unsigned char)*rim->encounter_flags_allocatedN);
+    }
+    memset(rim->encounter_flags, 0, sizeof(unsigned char)*N*N_threads);
+    if (rim->encounter_pairs_allocatedN < (unsigned int)N_threads){
+        rim->encounter_pairs = realloc(rim->encounter_pairs, sizeof(struct reb_mercurius_encounter_pairs)*N_threads);
+        for (unsigned int t=rim->encounter_pairs_allocatedN; t<(unsigned int)N_threads; t++){
+            rim->encounter_pairs[t].ij = NULL;
+            rim->encounter_pairs[t].allocatedN = 0;
+        }
+        rim->encounter_pairs_allocatedN = N_threads;
+    }
+    for (unsigned int t=0; t<rim->encounter_pairs_allocatedN; t++){
+        rim->encounter_pairs[t].N = 0;
+    }
+
+    // Culling stage. 
+    // Each particle sweeps a band in heliocentric distance during the timestep.
+    // The interpolated distance squared of two particles with a radial separation G
+    // at the beginning and at the end of the timestep is bounded from below by
+    // G*(G - 16/27*dt*(v_i+v_j)), where v_i and v_j are upper limits on the speed. 
+    // If the bands are inflated by 1.1*dcrit+16/27*dt*v (we use 0.6 to allow for
+    // round-off), then pairs whose bands do not overlap cannot trigger the exact 
+    // test below and can be skipped.
+    // Test particles do not encounter each other. The bands of active particles
+    // and of test particles are therefore sorted separately, and only the active
+    // bands are swept. Pairs of test particles are never visited.
+#pragma omp parallel for
+    for (int i=0; i<N; i++){
+        const double ro = sqrt(particles_backup[i].x*particles_backup[i].x + particles_backup[i].y*particles_backup[i].y + particles_backup[i].z*particles_backup[i].z);
+        const double rn = sqrt(particles[i].x*particles[i].x + particles[i].y*particles[i].y + particles[i].z*particles[i].z);
+        const double vo2 = particles_backup[i].vx*particles_backup[i].vx + particles_backup[i].vy*particles_backup[i].vy + particles_backup[i].vz*particles_backup[i].vz;
+        const double vn2 = particles[i].vx*particles[i].vx + particles[i].vy*particles[i].vy + particles[i].vz*particles[i].vz;
+        const double inflate = 1.1*dcrit[i] + 0.6*fabs(dt)*sqrt(MAX(vo2,vn2));
+        bands[i].rmin = MIN(ro,rn) - inflate;
+        bands[i].rmax = MAX(ro,rn) + inflate;
+        bands[i].index = i;
     }
-    for (int i=0; i<N_active; i++){
-        for (int j=i+1; j<N; j++){
-            const double dxn = particles[i].x - particles[j].x;
-            const double dyn = particles[i].y - particles[j].y;
-            const double dzn = particles[i].z - particles[j].z;
-            const double dvxn = particles[i].vx - particles[j].vx;
-            const double dvyn = particles[i].vy - particles[j].vy;
-            const double dvzn = particles[i].vz - particles[j].vz;
-            const double rn = (dxn*dxn + dyn*dyn + dzn*dzn);
-            const double dxo = particles_backup[i].x - particles_backup[j].x;
-            const double dyo = particles_backup[i].y - particles_backup[j].y;
-            const double dzo = particles_backup[i].z - particles_backup[j].z;
-            const double dvxo = particles_backup[i].vx - particles_backup[j].vx;
-            const double dvyo = particles_backup[i].vy - particles_backup[j].vy;
-            const double dvzo = particles_backup[i].vz - particles_backup[j].vz;
-            const double ro = (dxo*dxo + dyo*dyo + dzo*dzo);
-
-            const double drndt = (dxn*dvxn+dyn*dvyn+dzn*dvzn)*2.;
-            const double drodt = (dxo*dvxo+dyo*dvyo+dzo*dvzo)*2.;
-
-            const double a = 6.*(ro-rn)+3.*dt*(drodt+drndt); 
-            const double b = 6.*(rn-ro)-2.*dt*(2.*drodt+drndt); 
-            const double c = dt*drodt; 
-
-            double rmin = MIN(rn,ro);
-
-            const double s = b*b-4.*a*c;
-            const double sr = sqrt(MAX(0.,s));
-            const double tmin1 = (-b + sr)/(2.*a); 
-            const double tmin2 = (-b - sr)/(2.*a); 
-            if (tmin1>0. && tmin1<1.){
-                const double rmin1 = (1.-tmin1)*(1.-tmin1)*(1.+2.*tmin1)*ro
-                                     + tmin1*tmin1*(3.-2.*tmin1)*rn
-                                     + tmin1*(1.-tmin1)*(1.-tmin1)*dt*drodt
-                                     - tmin1*tmin1*(1.-tmin1)*dt*drndt;
-                rmin = MIN(MAX(rmin1,0.),rmin);
+    qsort(bands, N_active, sizeof(struct reb_mercurius_band), reb_mercurius_band_compare);
+    qsort(bands+N_active, N-N_active, sizeof(struct reb_mercurius_band), reb_mercurius_band_compare);
+    const struct reb_mercurius_band* const bands_test = bands+N_active;
+
+#pragma omp parallel for schedule(guided) reduction(&:tponly_encounter)
+    for (int k=0; k<N; k++){
+#ifdef OPENMP
+        unsigned char* const flags = rim->encounter_flags + N*omp_get_thread_num();
+        struct reb_mercurius_encounter_pairs* const pairs = rim->encounter_pairs + omp_get_thread_num();
+#else // OPENMP
+        unsigned char* const flags = rim->encounter_flags;
+        struct reb_mercurius_encounter_pairs* const pairs = rim->encounter_pairs;
+#endif // OPENMP
+        const double rmin = bands[k].rmin;
+        const double rmax = bands[k].rmax;
+        if (k<N_active){
+            // Active particles with a later inner edge.
+            for (int l=k+1; l<N_active && bands[l].rmin<=rmax; l++){
+                reb_mercurius_encounter_predict_bands(r, bands+k, bands+l, N_active, flags, pairs, &tponly_encounter);
+            }
+            // Test particles with the same or a larger inner edge.
+            for (int l=reb_mercurius_band_search(bands_test, N-N_active, rmin, 1); l<N-N_active && bands_test[l].rmin<=rmax; l++){
+                reb_mercurius_encounter_predict_bands(r, bands+k, bands_test+l, N_active, flags, pairs, &tponly_encounter);
             }
-            if (tmin2>0. && tmin2<1.){
-                const double rmin2 = (1.-tmin2)*(1.-tmin2)*(1.+2.*tmin2)*ro
-                                     + tmin2*tmin2*(3.-2.*tmin2)*rn
-                                     + tmin2*(1.-tmin2)*(1.-tmin2)*dt*drodt
-                                     - tmin2*tmin2*(1.-tmin2)*dt*drndt;
-                rmin = MIN(MAX(rmin2,0.),rmin);
+        }else{
+            // Active particles with a larger inner edge.
+            for (int l=reb_mercurius_band_search(bands, N_active, rmin, 0); l<N_active && bands[l].rmin<=rmax; l++){
+                reb_mercurius_encounter_predict_bands(r, bands+k, bands+l, N_active, flags, pairs, &tponly_encounter);
             }
+        }
+    }
 
-            double dcritmax2 = MAX(dcrit[i],dcrit[j]);
-            dcritmax2 *= 1.21*dcritmax2;
-            if (rmin < dcritmax2){
-                if (rim->encounter_map[i]==0){
-                    rim->encounter_map[i] = i;
-                    rim->encounterN++;
-                }
-                if (rim->encounter_map[j]==0){
-                    rim->encounter_map[j] = j;
-                    rim->encounterN++;
-                }
-                if (j<N_active){ // Two massive particles have a close encounter
-                    rim->tponly_encounter = 0;
-                }
+    // Merge flags. The result does not depend on the number of threads.
+    rim->tponly_encounter = tponly_encounter;
+    rim->encounterN = 1;
+    rim->encounter_map[0] = 1;
+    for (int i=1; i<N; i++){
+        rim->encounter_map[i] = 0;
+        for (int t=0; t<N_threads; t++){
+            if (rim->encounter_flags[t*N+i]){
+                rim->encounter_map[i] = i;
+                rim->encounterN++;
+                break;
             }
         }
     }
@@ -295,11 +456,190 @@ void reb_integrator_mercurius_com_step(struct reb_simulation* const r, double dt
 void reb_integrator_mercurius_kepler_step(struct reb_simulation* const r, double dt){
     struct reb_particle* restrict const particles = r->particles;
     const int N = r->N;
-    for (int i=1;i<N;i++){
-        reb_whfast_kepler_solver(r,particles,r->G*particles[0].m,i,dt); // in dh
+    double M[WHFAST_BATCH];
+    for (int l=0;l<WHFAST_BATCH;l++){
+        M[l] = r->G*particles[0].m;
+    }
+    for (int i=1;i<N;i+=WHFAST_BATCH){
+        reb_whfast_kepler_solver_batch(r,particles,M,i,MIN(WHFAST_BATCH,N-i),dt); // in dh
+    }
+}
+
+static int reb_mercurius_cluster_find(int* const parent, int i){
+    // Find root with path halving
+    while (parent[i]!=i){
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+static int reb_mercurius_encounter_find_clusters(struct reb_simulation* const r){
+    // Partitions the particles flagged by reb_integrator_mercurius_encounter_predict into 
+    // clusters which do not interact with each other during the timestep. 
+    // Two particles are in the same cluster if they are connected by a chain 
+    // of close encounters. The central object is not part of any cluster.
+    // Returns the number of clusters. Cluster ids are stored in encounter_cluster 
+    // (-1 for particles not having an encounter) and are numbered in order of
+    // the smallest particle index in each cluster.
+    struct reb_simulation_integrator_mercurius* rim = &(r->ri_mercurius);
+    int* const cluster = rim->encounter_cluster;
+    unsigned char* const massive_encounter = rim->encounter_flags; // reused
+    const int N = r->N;
+    const int N_active = r->N_active==-1?r->N:r->N_active;
+
+    for (int i=0; i<N; i++){
+        cluster[i] = i;
+        massive_encounter[i] = 0;
+    }
+    // Join the pairs found by reb_integrator_mercurius_encounter_predict.
+    // The resulting clusters do not depend on the order of the pairs. 
+    for (unsigned int t=0; t<rim->encounter_pairs_allocatedN; t++){
+        const struct reb_mercurius_encounter_pairs* const pairs = rim->encounter_pairs + t;
+        for (unsigned int p=0; p<pairs->N; p++){
+            const int i = pairs->ij[2*p];
+            const int j = pairs->ij[2*p+1];
+            if (i==0){
+                // Encounters with the central object count as massive encounters, 
+                // but the central object does not join any cluster.
+                if (j<N_active){
+                    massive_encounter[j] = 1;
+                }
+                continue;
+            }
+            if (j<N_active){
+                massive_encounter[i] = 1;
+                massive_encounter[j] = 1;
+            }
+            const int ri = reb_mercurius_cluster_find(cluster, i);
+            const int rj = reb_mercurius_cluster_find(cluster, j);
+            // The root is always the particle with the smallest index
+            if (ri<rj){
+                cluster[rj] = ri;
+            }else{
+                cluster[ri] = rj;
+            }
+        }
+    }
+    for (int i=0; i<N; i++){
+        cluster[i] = reb_mercurius_cluster_find(cluster, i);
+    }
+    // Roots come before the other members of their cluster. 
+    // Overwrite roots with cluster ids in increasing index order.
+    int clusterN = 0;
+    cluster[0] = -1;
+    for (int i=1; i<N; i++){
+        if (rim->encounter_map[i]==0){
+            cluster[i] = -1;
+        }else if (cluster[i]==i){
+            cluster[i] = clusterN++;
+        }else{
+            cluster[i] = cluster[cluster[i]];
+        }
     }
+    return clusterN;
 }
 
+static void reb_mercurius_encounter_sort_clusters(struct reb_simulation* const r, const int clusterN, int* const members, int* const offset){
+    // Counting sort of all particles by cluster id. Members of cluster c are
+    // members[offset[c]] ... members[offset[c+1]-1], in increasing index order.
+    const int* const cluster = r->ri_mercurius.encounter_cluster;
+    for (int c=0; c<=clusterN; c++){
+        offset[c] = 0;
+    }
+    for (int i=1; i<r->N; i++){
+        if (cluster[i]>=0){
+            offset[cluster[i]+1]++;
+        }
+    }
+    for (int c=0; c<clusterN; c++){
+        offset[c+1] += offset[c];
+    }
+    for (int i=1; i<r->N; i++){
+        if (cluster[i]>=0){
+            members[offset[cluster[i]]++] = i;
+        }
+    }
+    for (int c=clusterN; c>0; c--){
+        offset[c] = offset[c-1];
+    }
+    offset[0] = 0;
+}
+
+#ifdef OPENMP
+// Integrates the members of one cluster with IAS15 on a copy of the simulation.
+// The copy has its own particles (the central object followed by the members),
+// its own IAS15 arrays and its own message buffer. The copy is stored in rc so that
+// its messages can be passed on afterwards. Clusters can thus be integrated
+// concurrently. This is only used if there are no collisions and no
+// post_timestep_modifications, which act on the whole simulation. The result is
+// identical to that of the sequential integration in reb_mercurius_encounter_step.
+static void reb_mercurius_encounter_step_cluster(struct reb_simulation* const r, struct reb_simulation* const rc, const int* const members, const int n, const unsigned int tponly, const double _dt){
+    struct reb_simulation_integrator_mercurius* const rim = &(r->ri_mercurius);
+    struct reb_particle* const particles = malloc(sizeof(struct reb_particle)*(n+1));
+    int* const map = malloc(sizeof(int)*(n+1));
+    double* const dcrit = malloc(sizeof(double)*(n+1));
+    particles[0] = r->particles[0];
+    dcrit[0] = rim->dcrit[0];
+    map[0] = 0;
+    int Nactive = 1;
+    for (int k=0; k<n; k++){
+        const int i = members[k];
+        particles[k+1] = r->particles[i];
+        dcrit[k+1] = rim->dcrit[i];
+        map[k+1] = k+1;
+        if (r->N_active==-1 || i<r->N_active){
+            Nactive++;
+        }
+    }
+
+    *rc = *r;
+    rc->particles = particles;
+    rc->N = n+1;
+    rc->allocatedN = n+1;
+    rc->N_active = r->N_active==-1?-1:Nactive;
+    rc->profiling = NULL; // Clusters run in parallel. Their time is included in the encounter step.
+    rc->messages = NULL;
+    rc->ri_mercurius.encounter_map = map;
+    rc->ri_mercurius.encounterN = n+1;
+    rc->ri_mercurius.encounterNactive = Nactive;
+    rc->ri_mercurius.tponly_encounter = tponly;
+    rc->ri_mercurius.dcrit = dcrit;
+    memset(&rc->ri_ias15, 0, sizeof(struct reb_simulation_integrator_ias15));
+    rc->ri_ias15.epsilon = r->ri_ias15.epsilon;
+    rc->ri_ias15.min_dt = r->ri_ias15.min_dt;
+    rc->ri_ias15.epsilon_global = r->ri_ias15.epsilon_global;
+    rc->ri_ias15.block_levels = r->ri_ias15.block_levels;
+
+    const double t_needed = r->t + _dt; 
+    rc->dt = 0.0001*_dt; // start with a small timestep.
+    while(rc->t < t_needed && fabs(rc->dt/r->dt)>1e-14 ){
+        const struct reb_particle star = particles[0]; // backup velocity
+        particles[0].vx = 0; // star does not move in dh 
+        particles[0].vy = 0;
+        particles[0].vz = 0;
+        reb_update_acceleration(rc);
+        reb_integrator_ias15_part2(rc);
+        particles[0].vx = star.vx;
+        particles[0].vy = star.vy;
+        particles[0].vz = star.vz;
+        if (rc->t+rc->dt >  t_needed){
+            rc->dt = t_needed-rc->t;
+        }
+    }
+
+    for (int k=0; k<n; k++){
+        r->particles[members[k]] = particles[k+1];
+    }
+#pragma omp atomic
+    r->ri_ias15.iterations_max_exceeded += rc->ri_ias15.iterations_max_exceeded;
+    reb_integrator_ias15_free(rc);
+    free(particles);
+    free(map);
+    free(dcrit);
+}
+#endif // OPENMP
+
 static void reb_mercurius_encounter_step(struct reb_simulation* const r, const double _dt){
     // Only particles having a close encounter are integrated by IAS15.
     struct reb_simulation_integrator_mercurius* rim = &(r->ri_mercurius);
@@ -307,21 +647,32 @@ static void reb_mercurius_encounter_step(struct reb_simulation* const r, const d
         return; // If there are no particles (other than the star) having a close encounter, then there is nothing to do.
     }
 
-    int i_enc = 0;
-    rim->encounterNactive = 0;
-    for (unsigned int i=0; i<r->N; i++){
-        if(rim->encounter_map[i]){  
-            struct reb_particle tmp = r->particles[i];      // Copy for potential use for tponly_encounter
-            r->particles[i] = rim->particles_backup[i];     // Use coordinates before whfast step
-            rim->encounter_map[i_enc] = i;
-            i_enc++;
+    // Independent clusters of encounters are integrated separately, each 
+    // with its own IAS15 timestep. A slow, close encounter thus does 
+    // not force small timesteps onto all other encounters.
+    const int clusterN = reb_mercurius_encounter_find_clusters(r);
+    int* const cluster = rim->encounter_cluster;
+    const unsigned char* const massive_encounter = rim->encounter_flags;
+    unsigned int* const cluster_tponly = malloc(sizeof(unsigned int)*clusterN);
+    int* const members = malloc(sizeof(int)*r->N);
+    int* const offset = malloc(sizeof(int)*(clusterN+1));
+    for (int c=0; c<clusterN; c++){
+        cluster_tponly[c] = r->testparticle_type==0;
+    }
+
+    reb_integrator_mercurius_restore(r->particles, rim->particles_backup, 1);
+    for (unsigned int i=1; i<r->N; i++){
+        if (cluster[i]>=0){
+            struct reb_vec6d tmp;                           // Copy for potential use for tponly_encounter
+            reb_integrator_mercurius_backup(&tmp, r->particles+i, 1);
+            reb_integrator_mercurius_restore(r->particles+i, rim->particles_backup+i, 1); // Use coordinates before whfast step
+            if (massive_encounter[i]){
+                cluster_tponly[cluster[i]] = 0;
+            }
             if (r->N_active==-1 || i<r->N_active){
-                rim->encounterNactive++;
-                if (rim->tponly_encounter){
-                    rim->particles_backup[i] = tmp;         // Make copy of particles after the kepler step.
+                rim->particles_backup[i] = tmp;             // Make copy of particles after the kepler step.
                                                             // used to restore the massive objects' states in the case
                                                             // of only massless test-particle encounters
-                }
             }
         }
     }
@@ -332,66 +683,159 @@ static void reb_mercurius_encounter_step(struct reb_simulation* const r, const d
     const double old_dt = r->dt;
     const double old_t = r->t;
     double t_needed = r->t + _dt; 
+
+    int sorted_N = r->N;
+    reb_mercurius_encounter_sort_clusters(r, clusterN, members, offset);
+    unsigned char* const cluster_done = calloc(clusterN, sizeof(unsigned char));
+#ifdef OPENMP
+    if (omp_get_max_threads()>1 && !omp_in_parallel() && r->collision==REB_COLLISION_NONE && r->post_timestep_modifications==NULL){
+        // Large clusters are integrated concurrently. IAS15 synchronizes the threads 
+        // several times per substep, which only pays off if the clusters are large.
+        int* const large = malloc(sizeof(int)*clusterN);
+        int large_N = 0;
+        for (int c=0; c<clusterN; c++){
+            if (offset[c+1]-offset[c]+1 >= MERCURIUS_OPENMP_CLUSTER_N_MIN){
+                large[large_N++] = c;
+            }
+        }
+        if (large_N>1){
+            struct reb_simulation* const cluster_r = malloc(sizeof(struct reb_simulation)*large_N);
+#pragma omp parallel for schedule(dynamic,1)
+            for (int l=0; l<large_N; l++){
+                const int c = large[l];
+                reb_mercurius_encounter_step_cluster(r, &cluster_r[l], members+offset[c], offset[c+1]-offset[c], cluster_tponly[c], _dt);
+            }
+            // Messages are passed on in cluster order.
+            for (int l=0; l<large_N; l++){
+                const int c = large[l];
+                if (cluster_r[l].messages){
+                    char buf[1024];
+                    while (reb_get_next_message(&cluster_r[l], buf)){
+                        if (buf[0]=='e'){
+                            reb_error(r, buf+1);
+                        }else{
+                            reb_warning(r, buf+1);
+                        }
+                    }
+                    free(cluster_r[l].messages);
+                }
+                if (cluster_tponly[c]){
+                    // Reset the massive bodies to their post Kepler step state
+                    for (int k=offset[c]; k<offset[c+1]; k++){
+                        const int i = members[k];
+                        if (r->N_active==-1 || i<r->N_active){
+                            reb_integrator_mercurius_restore(r->particles+i, rim->particles_backup+i, 1);
+                        }
+                    }
+                }
+                cluster_done[c] = 1;
+            }
+            free(cluster_r);
+        }
+        free(large);
+    }
+#endif // OPENMP
+    for (int c=0; c<clusterN; c++){
+        if (cluster_done[c]){
+            continue; // Integrated concurrently above
+        }
+        if (sorted_N != r->N){
+            // Particles were removed in a collision. Cluster ids have been shifted.
+            sorted_N = r->N;
+            reb_mercurius_encounter_sort_clusters(r, clusterN, members, offset);
+        }
+        if (offset[c]==offset[c+1]){
+            continue; // All particles in this cluster have been removed 
+        }
         
-    reb_integrator_ias15_reset(r);
-    
-    r->dt = 0.0001*_dt; // start with a small timestep.
-    
-    while(r->t < t_needed && fabs(r->dt/old_dt)>1e-14 ){
-        struct reb_particle star = r->particles[0]; // backup velocity
-        r->particles[0].vx = 0; // star does not move in dh 
-        r->particles[0].vy = 0;
-        r->particles[0].vz = 0;
-        reb_update_acceleration(r);
-        reb_integrator_ias15_part2(r);
-        r->particles[0].vx = star.vx; // restore every timestep for collisions
-        r->particles[0].vy = star.vy;
-        r->particles[0].vz = star.vz;
-        
-        if (r->t+r->dt >  t_needed){
-            r->dt = t_needed-r->t;
+        int i_enc = 0;
+        rim->encounter_map[i_enc++] = 0;
+        rim->encounterNactive = 1;
+        for (int k=offset[c]; k<offset[c+1]; k++){
+            const int i = members[k];
+            rim->encounter_map[i_enc++] = i;
+            if (r->N_active==-1 || i<r->N_active){
+                rim->encounterNactive++;
+            }
         }
+        rim->encounterN = i_enc;
+        rim->tponly_encounter = cluster_tponly[c];
+        
+        r->t = old_t;
+        reb_integrator_ias15_reset(r);
+        
+        r->dt = 0.0001*_dt; // start with a small timestep.
+        
+        while(r->t < t_needed && fabs(r->dt/old_dt)>1e-14 ){
+            struct reb_particle star = r->particles[0]; // backup velocity
+            r->particles[0].vx = 0; // star does not move in dh 
+            r->particles[0].vy = 0;
+            r->particles[0].vz = 0;
+            reb_update_acceleration(r);
+            reb_integrator_ias15_part2(r);
+            r->particles[0].vx = star.vx; // restore every timestep for collisions
+            r->particles[0].vy = star.vy;
+            r->particles[0].vz = star.vz;
+            
+            if (r->t+r->dt >  t_needed){
+                r->dt = t_needed-r->t;
+            }
 
-        // Search and resolve collisions
-        reb_collision_search(r);
-
-        // Do any additional post_timestep_modifications.
-        // Note: post_timestep_modifications is called here but also
-        // at the end of the full timestep. The function thus needs
-        // to be implemented with care as not to do the same 
-        // modification multiple times. To do that, check the value of
-        // r->ri_mercurius.mode
-        if (r->post_timestep_modifications){
-            r->post_timestep_modifications(r);
-        }
+            // Search and resolve collisions
+            reb_collision_search(r);
 
-        star.vx = r->particles[0].vx; // keep track of changed star velocity for later collisions
-        star.vy = r->particles[0].vy;
-        star.vz = r->particles[0].vz;
-        if (r->particles[0].x !=0 || r->particles[0].y !=0 || r->particles[0].z !=0){
-            // Collision with star occured
-            // Shift all particles back to heliocentric coordinates
-            // Ignore stars velocity:
-            //   - will not be used after this
-            //   - com velocity is unchained. this velocity will be used
-            //     to reconstruct star's velocity later.
-            for (int i=r->N-1; i>=0; i--){
-                r->particles[i].x -= r->particles[0].x;
-                r->particles[i].y -= r->particles[0].y;
-                r->particles[i].z -= r->particles[0].z;
+            // Do any additional post_timestep_modifications.
+            // Note: post_timestep_modifications is called here but also
+            // at the end of the full timestep. The function thus needs
+            // to be implemented with care as not to do the same 
+            // modification multiple times. To do that, check the value of
+            // r->ri_mercurius.mode
+            if (r->post_timestep_modifications){
+                r->post_timestep_modifications(r);
+            }
+
+            star.vx = r->particles[0].vx; // keep track of changed star velocity for later collisions
+            star.vy = r->particles[0].vy;
+            star.vz = r->particles[0].vz;
+            if (r->particles[0].x !=0 || r->particles[0].y !=0 || r->particles[0].z !=0){
+                // Collision with star occured
+                // Shift all particles back to heliocentric coordinates
+                // Ignore stars velocity:
+                //   - will not be used after this
+                //   - com velocity is unchained. this velocity will be used
+                //     to reconstruct star's velocity later.
+                //   - post Kepler backups of this and all pending clusters
+                //     are shifted too, so they are restored consistently.
+                for (int i=r->N-1; i>=1; i--){
+                    if (cluster[i]>=c){
+                        rim->particles_backup[i].x -= r->particles[0].x;
+                        rim->particles_backup[i].y -= r->particles[0].y;
+                        rim->particles_backup[i].z -= r->particles[0].z;
+                    }
+                }
+                for (int i=r->N-1; i>=0; i--){
+                    r->particles[i].x -= r->particles[0].x;
+                    r->particles[i].y -= r->particles[0].y;
+                    r->particles[i].z -= r->particles[0].z;
+                }
             }
         }
-    }
 
-    // if only test particles encountered massive bodies, reset the
-    // massive body coordinates to their post Kepler step state
-    if(rim->tponly_encounter){
-        for (int i=1;i<rim->encounterNactive;i++){
-            unsigned int mi = rim->encounter_map[i];
-            r->particles[mi] = rim->particles_backup[mi];
+        // if only test particles encountered massive bodies, reset the
+        // massive body coordinates to their post Kepler step state
+        if(rim->tponly_encounter){
+            for (int i=1;i<rim->encounterNactive;i++){
+                unsigned int mi = rim->encounter_map[i];
+                reb_integrator_mercurius_restore(r->particles+mi, rim->particles_backup+mi, 1);
+            }
         }
     }
 
+    free(cluster_tponly);
+    free(cluster_done);
+    free(members);
+    free(offset);
+
     // Reset constant for global particles
     r->t = old_t;
     r->dt = old_dt;
@@ -448,8 +892,10 @@ void reb_integrator_mercurius_part1(struct reb_simulation* r){
     if (rim->allocatedN<N){
         // These arrays are only used within one timestep. 
         // Can be recreated without loosing bit-wise reproducibility
-        rim->particles_backup   = realloc(rim->particles_backup,sizeof(struct reb_particle)*N);
+        rim->particles_backup   = realloc(rim->particles_backup,sizeof(struct reb_vec6d)*N);
         rim->encounter_map      = realloc(rim->encounter_map,sizeof(int)*N);
+        rim->encounter_bands    = realloc(rim->encounter_bands,sizeof(struct reb_mercurius_band)*N);
+        rim->encounter_cluster  = realloc(rim->encounter_cluster,sizeof(int)*N);
         rim->allocatedN = N;
     }
     if (rim->safe_mode || rim->recalculate_coordinates_this_timestep){
@@ -502,7 +948,9 @@ void reb_integrator_mercurius_part2(struct reb_simulation* const r){
     }else{
         reb_integrator_mercurius_interaction_step(r,r->dt);
     }
+    struct reb_profiling_mark profiling_start = reb_profiling_start(r);
     reb_integrator_mercurius_jump_step(r,r->dt/2.);
+    reb_profiling_stop(r, REB_PROFILING_CAT_JUMP, profiling_start);
     reb_integrator_mercurius_com_step(r,r->dt); 
     
     // Make copy of particles before the kepler step.
@@ -510,14 +958,22 @@ void reb_integrator_mercurius_part2(struct reb_simulation* const r){
     // Result will be used in encounter prediction.
     // Particles having a close encounter will be overwritten 
     // later by encounter step.
-    memcpy(rim->particles_backup,r->particles,N*sizeof(struct reb_particle)); 
+    reb_integrator_mercurius_backup(rim->particles_backup,r->particles,N);
+    profiling_start = reb_profiling_start(r);
     reb_integrator_mercurius_kepler_step(r,r->dt);
+    reb_profiling_stop(r, REB_PROFILING_CAT_KEPLER, profiling_start);
 
-    reb_mercurius_encounter_predict(r);
+    profiling_start = reb_profiling_start(r);
+    reb_integrator_mercurius_encounter_predict(r);
+    reb_profiling_stop(r, REB_PROFILING_CAT_ENCOUNTER_PREDICT, profiling_start);
    
+    profiling_start = reb_profiling_start(r);
     reb_mercurius_encounter_step(r,r->dt);
+    reb_profiling_stop(r, REB_PROFILING_CAT_ENCOUNTER_STEP, profiling_start);
     
+    profiling_start = reb_profiling_start(r);
     reb_integrator_mercurius_jump_step(r,r->dt/2.);
+    reb_profiling_stop(r, REB_PROFILING_CAT_JUMP, profiling_start);
         
     rim->is_synchronized = 0;
     if (rim->safe_mode){
@@ -562,6 +1018,19 @@ void reb_integrator_mercurius_reset(struct reb_simulation* r){
     r->ri_mercurius.particles_backup_additionalforces = NULL;
     free(r->ri_mercurius.encounter_map);
     r->ri_mercurius.encounter_map = NULL;
+    free(r->ri_mercurius.encounter_bands);
+    r->ri_mercurius.encounter_bands = NULL;
+    free(r->ri_mercurius.encounter_flags);
+    r->ri_mercurius.encounter_flags = NULL;
+    r->ri_mercurius.encounter_flags_allocatedN = 0;
+    free(r->ri_mercurius.encounter_cluster);
+    r->ri_mercurius.encounter_cluster = NULL;
+    for (unsigned int t=0;t<r->ri_mercurius.encounter_pairs_allocatedN;t++){
+        free(r->ri_mercurius.encounter_pairs[t].ij);
+    }
+    free(r->ri_mercurius.encounter_pairs);
+    r->ri_mercurius.encounter_pairs = NULL;
+    r->ri_mercurius.encounter_pairs_allocatedN = 0;
     r->ri_mercurius.allocatedN = 0;
     r->ri_mercurius.allocatedN_additionalforces = 0;
     // dcrit array
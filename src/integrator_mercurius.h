@@ -30,5 +30,8 @@ void reb_integrator_mercurius_synchronize(struct reb_simulation* r);    ///< Int
 void reb_integrator_mercurius_reset(struct reb_simulation* r);          ///< Internal function used to call a specific integrator
 void reb_integrator_mercurius_inertial_to_dh(struct reb_simulation* r); ///< Internal in-place coordinate transformation
 void reb_integrator_mercurius_dh_to_inertial(struct reb_simulation* r); ///< Internal in-place coordinate transformation
+void reb_integrator_mercurius_backup(struct reb_vec6d* backup, const struct reb_particle* particles, int N);  ///< Internal function to save positions and velocities
+void reb_integrator_mercurius_restore(struct reb_particle* particles, const struct reb_vec6d* backup, int N); ///< Internal function to restore positions and velocities
+void reb_integrator_mercurius_encounter_predict(struct reb_simulation* r); ///< Internal function to flag particles having a close encounter during the Kepler step
 double reb_integrator_mercurius_calculate_dcrit_for_particle(struct reb_simulation* r, unsigned int i); ///< Internal function for calculating dcrit in reb_add_local
 #endif
@@ -39,6 +39,7 @@
 #include "integrator.h"
 #include "integrator_whfast.h"
 #include "integrator_saba.h"
+#include "transformations.h"
 
 #define MAX(a, b) ((a) < (b) ? (b) : (a))   ///< Returns the maximum of a and b
 #define MIN(a, b) ((a) > (b) ? (b) : (a))   ///< Returns the minimum of a and b
@@ -130,22 +131,22 @@ const static double reb_saba_cc[4] = {
 
 static void reb_saba_corrector_step(struct reb_simulation* r, double cc){
     struct reb_simulation_integrator_whfast* const ri_whfast = &(r->ri_whfast);
-    struct reb_particle* const p_j = ri_whfast->p_jh;
+    const struct reb_particle_soa p_j = ri_whfast->p_jh;
 	struct reb_particle* const particles = r->particles;
     const int N = r->N;
     switch (r->ri_saba.type/0x100){
         case 1: // modified kick
             // Calculate normal kick
-            reb_transformations_jacobi_to_inertial_pos(particles, p_j, particles, N, N);
+            reb_transformations_jacobi_to_inertial_pos_soa(particles, p_j, particles, N, N);
             reb_update_acceleration(r);
             // Calculate jerk
             reb_whfast_calculate_jerk(r);
 
             for (int i=0; i<N; i++){
                 const double prefact = r->dt*r->dt;
-                particles[i].ax = prefact*p_j[i].ax; 
-                particles[i].ay = prefact*p_j[i].ay; 
-                particles[i].az = prefact*p_j[i].az; 
+                particles[i].ax = prefact*p_j.ax[i]; 
+                particles[i].ay = prefact*p_j.ay[i]; 
+                particles[i].az = prefact*p_j.az[i]; 
             }
             reb_whfast_interaction_step(r,cc*r->dt);
             break;
@@ -154,41 +155,46 @@ static void reb_saba_corrector_step(struct reb_simulation* r, double cc){
             // Need temporary array to store old positions
             if (ri_whfast->allocated_Ntemp != N){
                 ri_whfast->allocated_Ntemp = N;
-                ri_whfast->p_temp = realloc(ri_whfast->p_temp,sizeof(struct reb_particle)*N);
+                reb_particle_soa_realloc(&ri_whfast->p_temp, N);
             }
-            struct reb_particle* p_temp = ri_whfast->p_temp;
+            const struct reb_particle_soa p_temp = ri_whfast->p_temp;
 
             // Calculate normal kick
-            reb_transformations_jacobi_to_inertial_pos(particles, p_j, particles, N, N);
+            reb_transformations_jacobi_to_inertial_pos_soa(particles, p_j, particles, N, N);
             reb_update_acceleration(r);
-            reb_transformations_inertial_to_jacobi_acc(particles, p_j, particles, N, N);
+            reb_transformations_inertial_to_jacobi_acc_soa(particles, p_j, particles, N, N);
 
             // make copy of original positions and accelerations
-            memcpy(p_temp,p_j,r->N*sizeof(struct reb_particle));
+            memcpy(p_temp.x,p_j.x,N*sizeof(double));
+            memcpy(p_temp.y,p_j.y,N*sizeof(double));
+            memcpy(p_temp.z,p_j.z,N*sizeof(double));
+            memcpy(p_temp.ax,p_j.ax,N*sizeof(double));
+            memcpy(p_temp.ay,p_j.ay,N*sizeof(double));
+            memcpy(p_temp.az,p_j.az,N*sizeof(double));
 
             // WHT96 Eq 10.6
             const double prefac1 = r->dt*r->dt/12.; 
             for (unsigned int i=1;i<N;i++){
-                p_j[i].x += prefac1 * p_temp[i].ax;
-                p_j[i].y += prefac1 * p_temp[i].ay;
-                p_j[i].z += prefac1 * p_temp[i].az;
+                p_j.x[i] += prefac1 * p_temp.ax[i];
+                p_j.y[i] += prefac1 * p_temp.ay[i];
+                p_j.z[i] += prefac1 * p_temp.az[i];
             }
            
             // recalculate kick 
-            reb_transformations_jacobi_to_inertial_pos(particles, p_j, particles, N, N);
+            reb_transformations_jacobi_to_inertial_pos_soa(particles, p_j, particles, N, N);
             reb_update_acceleration(r);
-            reb_transformations_inertial_to_jacobi_acc(particles, p_j, particles, N, N);
+            reb_transformations_inertial_to_jacobi_acc_soa(particles, p_j, particles, N, N);
 
             const double prefact = cc*r->dt*12.;
             for (unsigned int i=1;i<N;i++){
                 // Lazy implementer's commutator
-                p_j[i].vx += prefact*(p_j[i].ax - p_temp[i].ax);
-                p_j[i].vy += prefact*(p_j[i].ay - p_temp[i].ay);
-                p_j[i].vz += prefact*(p_j[i].az - p_temp[i].az);
+                p_j.vx[i] += prefact*(p_j.ax[i] - p_temp.ax[i]);
+                p_j.vy[i] += prefact*(p_j.ay[i] - p_temp.ay[i]);
+                p_j.vz[i] += prefact*(p_j.az[i] - p_temp.az[i]);
                 // reset positions
-                p_j[i].x = p_temp[i].x;
-                p_j[i].y = p_temp[i].y;
-                p_j[i].z = p_temp[i].z;
+                p_j.x[i] = p_temp.x[i];
+                p_j.y[i] = p_temp.y[i];
+                p_j.z[i] = p_temp.z[i];
             }
             }
             break;
@@ -265,10 +271,10 @@ void reb_integrator_saba_synchronize(struct reb_simulation* const r){
     struct reb_simulation_integrator_whfast* const ri_whfast = &(r->ri_whfast);
     struct reb_simulation_integrator_saba* const ri_saba = &(r->ri_saba);
     int type = ri_saba->type;
-        struct reb_particle* sync_pj  = NULL;
+        double* sync_pj  = NULL;
         if (ri_saba->keep_unsynchronized){
-            sync_pj = malloc(sizeof(struct reb_particle)*r->N);
-            memcpy(sync_pj,r->ri_whfast.p_jh,r->N*sizeof(struct reb_particle));
+            sync_pj = malloc(sizeof(double)*REB_PARTICLE_SOA_FIELDS*ri_whfast->allocated_N);
+            memcpy(sync_pj,ri_whfast->p_jh.x,sizeof(double)*REB_PARTICLE_SOA_FIELDS*ri_whfast->allocated_N);
         }
     if (ri_saba->is_synchronized == 0){
         const int N = r->N;
@@ -279,9 +285,9 @@ void reb_integrator_saba_synchronize(struct reb_simulation* const r){
             reb_whfast_kepler_step(r, reb_saba_c[type%0x100][0]*r->dt);
             reb_whfast_com_step(r, reb_saba_c[type%0x100][0]*r->dt);
         }
-        reb_transformations_jacobi_to_inertial_posvel(r->particles, ri_whfast->p_jh, r->particles, N, N);
+        reb_transformations_jacobi_to_inertial_posvel_soa(r->particles, ri_whfast->p_jh, r->particles, N, N);
         if (ri_saba->keep_unsynchronized){
-            memcpy(r->ri_whfast.p_jh,sync_pj,r->N*sizeof(struct reb_particle));
+            memcpy(ri_whfast->p_jh.x,sync_pj,sizeof(double)*REB_PARTICLE_SOA_FIELDS*ri_whfast->allocated_N);
             free(sync_pj);
         }else{
             ri_saba->is_synchronized = 1;
@@ -296,7 +302,7 @@ void reb_integrator_saba_part2(struct reb_simulation* const r){
     const int type = ri_saba->type;
     const int stages = reb_saba_stages(type);
     const int N = r->N;
-    if (ri_whfast->p_jh==NULL){
+    if (ri_whfast->p_jh.x==NULL){
         // Non recoverable error occured earlier. 
         // Skipping rest of integration to avoid segmentation fault.
         return;
@@ -318,7 +324,7 @@ void reb_integrator_saba_part2(struct reb_simulation* const r){
             if (j>(stages-1)/2){
                 i = stages-j-1;
             }
-            reb_transformations_jacobi_to_inertial_pos(particles, ri_whfast->p_jh, particles, N, N);
+            reb_transformations_jacobi_to_inertial_pos_soa(particles, ri_whfast->p_jh, particles, N, N);
             reb_update_acceleration(r);
             reb_whfast_interaction_step(r, reb_saba_d[type%0x100][i]*r->dt);
         }
@@ -82,13 +82,23 @@ void reb_integrator_sei_part2(struct reb_simulation* r){
 	const int N = r->N;
 	struct reb_particle* const particles = r->particles;
 	const struct reb_simulation_integrator_sei ri_sei = r->ri_sei;
-#pragma omp parallel for schedule(guided)
-	for (int i=0;i<N;i++){
-		operator_phi1(r->dt, &(particles[i]));
-		operator_H012(r->dt, ri_sei, &(particles[i]));
-	}
 	r->t+=r->dt/2.;
 	r->dt_last_done = r->dt;
+	// Apply shear boundary conditions block by block while the particles are still
+	// in cache. Nothing may modify particles between here and reb_boundary_check().
+	const int boundary = r->boundary==REB_BOUNDARY_SHEAR && r->post_timestep_modifications==NULL && r->N_var==0;
+#pragma omp parallel for schedule(guided)
+	for (int b=0;b<N;b+=REB_BOUNDARY_BLOCK_SIZE){
+		const int end = b+REB_BOUNDARY_BLOCK_SIZE<N ? b+REB_BOUNDARY_BLOCK_SIZE : N;
+		for (int i=b;i<end;i++){
+			operator_phi1(r->dt, &(particles[i]));
+			operator_H012(r->dt, ri_sei, &(particles[i]));
+		}
+		if (boundary){
+			reb_boundary_check_shear(r, b, end);
+		}
+	}
+	r->ri_sei.boundary_checked = boundary;
 }
 
 void reb_integrator_sei_synchronize(struct reb_simulation* r){
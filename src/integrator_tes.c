@@ -42,7 +42,8 @@
 #define PI 3.141592653589793238462643383279
 #define PI_SQ_X4 (4.0*PI*PI)
 #define MAX_NEWTON_ITERATIONS 50
-#define STUMPF_ITERATIONS 13 
+#define STUMPF_ITERATIONS 13
+#define OPENMP_N_MIN 32           // Minimum number of particles for which OpenMP is used. 
 
 // Coefficients
 static const double hArr[9] = {0.0, 0.0562625605369221464656521910318, 0.180240691736892364987579942780, 0.352624717113169637373907769648, 0.547153626330555383001448554766, 0.734210177215410531523210605558, 0.885320946839095768090359771030, 0.977520613561287501891174488626, 1.0};
@@ -445,6 +446,43 @@ static void reb_dhem_rhs(struct reb_simulation* r, double const * __restrict__ c
   }
   
   const double istart = 1;
+#ifdef OPENMP
+  if(n >= OPENMP_N_MIN)
+  {
+    // Each thread sums all interactions of one body, O(N^2).
+    #pragma omp parallel for
+    for(uint32_t i = istart; i < n; i++)
+    {
+        const double GM = G*m[i];
+        double sx = 0;
+        double sy = 0;
+        double sz = 0;
+        for(uint32_t j = istart; j < n; j++)
+        {
+            if(j == i) continue;
+            const double GMM = GM*m[j];
+            const double dx = Q[3*j+0] - Q[3*i+0];
+            const double dy = Q[3*j+1] - Q[3*i+1];
+            const double dz = Q[3*j+2] - Q[3*i+2];
+
+            const double sepNorm = sqrt(dx*dx+dy*dy+dz*dz);
+            const double sepNorm2 = sepNorm*sepNorm;
+            const double sepNorm3 = sepNorm2*sepNorm;
+
+            const double GMM_SepNorm3Inv = (GMM/sepNorm3);
+
+            sx += dx*GMM_SepNorm3Inv;
+            sy += dy*GMM_SepNorm3Inv;
+            sz += dz*GMM_SepNorm3Inv;
+        }
+        dP_dot[3*i+0] += sx;
+        dP_dot[3*i+1] += sy;
+        dP_dot[3*i+2] += sz;
+    }
+  }
+  else
+#endif // OPENMP
+  // Serial, O(1/2*N^2)
   for(uint32_t i = istart; i < n; i++)
   {
       const double GM = G*m[i];
@@ -1615,26 +1653,30 @@ static void reb_calc_osc_orbits(struct reb_simulation* r, double **Xosc_map,
       dt = h*(h_array[stage]-t_last_rebasis); 
     }
 
-    double C[4] = {0.0, 0.0, 0.0, 0.0};
+    // Calculate the dt value and wrap around the orbital period.
+    // Each body uses dt wrapped around the periods of all previous bodies.
     for(int32_t i = 1; i < r->N; i++)
     {  
-      // Calculate the dt value and wrap around the orbital period.
       dt = fmod(dt, p_uVars->period[i]);
+      p_uVars->dt[i] = dt;
+    }
 
+    // The Kepler problems of all bodies are independent.
+    #pragma omp parallel for if(r->N >= OPENMP_N_MIN)
+    for(int32_t i = 1; i < r->N; i++)
+    {    
       // Calculate our step since last time we were called and update storage of tLast.
       double h = t - p_uVars->tLast[i];
       p_uVars->tLast[i] = t;
 
-      reb_solve_for_universal_anomaly(r, dt, h, i, C);
+      double C[4] = {0.0, 0.0, 0.0, 0.0};
+      reb_solve_for_universal_anomaly(r, p_uVars->dt[i], h, i, C);
 
       p_uVars->C.c0[i] = C[0];
       p_uVars->C.c1[i] = C[1];
       p_uVars->C.c2[i] = C[2];
       p_uVars->C.c3[i] = C[3];
-    }
 
-    for(int32_t i = 1; i < r->N; i++)
-    {    
       double * Qout = Xosc_map[stage];
       double * Pout = &Qout[3*r->N];      
       const double X = p_uVars->X[i];
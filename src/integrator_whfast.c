@@ -40,6 +40,8 @@
 #include "boundary.h"
 #include "integrator.h"
 #include "integrator_whfast.h"
+#include "transformations.h"
+#include "output.h"
 
 #define MAX(a, b) ((a) < (b) ? (b) : (a))   ///< Returns the maximum of a and b
 #define MIN(a, b) ((a) > (b) ? (b) : (a))   ///< Returns the minimum of a and b
@@ -161,8 +163,10 @@ static void stiefel_Gs3(double *restrict Gs, double beta, double X) {
 #define WHFAST_NMAX_NEWT  32    ///< Maximum number of iterations for Newton's method
 /************************************
  * Keplerian motion for one planet  */
-void reb_whfast_kepler_solver(const struct reb_simulation* const r, struct reb_particle* const restrict p_j, const double M, unsigned int i, double _dt){
-    const struct reb_particle p1 = p_j[i];
+int reb_whfast_kepler_solver_particle(struct reb_particle* const restrict p, struct reb_particle* const* const dp, const int dp_N, const double M, const double _dt){
+    // Returns 1 if the timestep is larger than the orbital period.
+    const struct reb_particle p1 = *p;
+    int period_exceeded = 0;
 
     const double r0 = sqrt(p1.x*p1.x + p1.y*p1.y + p1.z*p1.z);
     const double r0i = 1./r0;
@@ -180,11 +184,8 @@ void reb_whfast_kepler_solver(const struct reb_simulation* const r, struct reb_p
         const double sqrt_beta = sqrt(beta);
         invperiod = sqrt_beta*beta/(2.*M_PI*M);
         X_per_period = 2.*M_PI/sqrt_beta;
-        if (fabs(_dt)*invperiod>1. && r->ri_whfast.timestep_warning == 0){
-            // Ignoring const qualifiers. This warning should not have any effect on
-            // other parts of the code, nor is it vital to show it.
-            ((struct reb_simulation* const)r)->ri_whfast.timestep_warning++;
-            reb_warning((struct reb_simulation* const)r,"WHFast convergence issue. Timestep is larger than at least one orbital period.");
+        if (fabs(_dt)*invperiod>1.){
+            period_exceeded = 1;
         }
         //X = _dt*invperiod*X_per_period; // first order guess 
         const double dtr0i = _dt*r0i;
@@ -303,20 +304,18 @@ void reb_whfast_kepler_solver(const struct reb_simulation* const r, struct reb_p
     double fd = -M*Gs[1]*r0i*ri; 
     double gd = -M*Gs[2]*ri; 
         
-    p_j[i].x += f*p1.x + g*p1.vx;
-    p_j[i].y += f*p1.y + g*p1.vy;
-    p_j[i].z += f*p1.z + g*p1.vz;
+    p->x += f*p1.x + g*p1.vx;
+    p->y += f*p1.y + g*p1.vy;
+    p->z += f*p1.z + g*p1.vz;
         
-    p_j[i].vx += fd*p1.x + gd*p1.vx;
-    p_j[i].vy += fd*p1.y + gd*p1.vy;
-    p_j[i].vz += fd*p1.z + gd*p1.vz;
+    p->vx += fd*p1.x + gd*p1.vx;
+    p->vy += fd*p1.y + gd*p1.vy;
+    p->vz += fd*p1.z + gd*p1.vz;
 
     //Variations
-    for (int v=0;v<r->var_config_N;v++){
-        struct reb_variational_configuration const vc = r->var_config[v];
-        const int index = vc.index;
+    for (int v=0;v<dp_N;v++){
         stiefel_Gs(Gs, beta, X);    // Recalculate (to get Gs[4] and Gs[5])
-        struct reb_particle dp1 = p_j[i+index];
+        struct reb_particle dp1 = *dp[v];
         double dr0 = (dp1.x*p1.x + dp1.y*p1.y + dp1.z*p1.z)*r0i;
         double dbeta = -2.*M*dr0*r0i*r0i - 2.* (dp1.vx*p1.vx + dp1.vy*p1.vy + dp1.vz*p1.vz);
         double deta0 = dp1.x*p1.vx + dp1.y*p1.vy + dp1.z*p1.vz
@@ -336,106 +335,451 @@ void reb_whfast_kepler_solver(const struct reb_simulation* const r, struct reb_p
         double dfd = -M*dG1*r0i*ri + M*Gs[1]*(dr0*r0i+dr*ri)*r0i*ri;
         double dgd = -M*dG2*ri + M*Gs[2]*dr*ri*ri;
     
-        p_j[i+index].x += f*dp1.x + g*dp1.vx + df*p1.x + dg*p1.vx;
-        p_j[i+index].y += f*dp1.y + g*dp1.vy + df*p1.y + dg*p1.vy;
-        p_j[i+index].z += f*dp1.z + g*dp1.vz + df*p1.z + dg*p1.vz;
+        dp[v]->x += f*dp1.x + g*dp1.vx + df*p1.x + dg*p1.vx;
+        dp[v]->y += f*dp1.y + g*dp1.vy + df*p1.y + dg*p1.vy;
+        dp[v]->z += f*dp1.z + g*dp1.vz + df*p1.z + dg*p1.vz;
 
-        p_j[i+index].vx += fd*dp1.x + gd*dp1.vx + dfd*p1.x + dgd*p1.vx;
-        p_j[i+index].vy += fd*dp1.y + gd*dp1.vy + dfd*p1.y + dgd*p1.vy;
-        p_j[i+index].vz += fd*dp1.z + gd*dp1.vz + dfd*p1.z + dgd*p1.vz;
+        dp[v]->vx += fd*dp1.x + gd*dp1.vx + dfd*p1.x + dgd*p1.vx;
+        dp[v]->vy += fd*dp1.y + gd*dp1.vy + dfd*p1.y + dgd*p1.vy;
+        dp[v]->vz += fd*dp1.z + gd*dp1.vz + dfd*p1.z + dgd*p1.vz;
     }
+    return period_exceeded;
+}
+
+static void reb_whfast_kepler_solver_warning(const struct reb_simulation* const r){
+    if (r->ri_whfast.timestep_warning == 0){
+        // Ignoring const qualifiers. This warning should not have any effect on
+        // other parts of the code, nor is it vital to show it.
+        ((struct reb_simulation* const)r)->ri_whfast.timestep_warning++;
+        reb_warning((struct reb_simulation* const)r,"WHFast convergence issue. Timestep is larger than at least one orbital period.");
+    }
+}
+
+void reb_whfast_kepler_solver(const struct reb_simulation* const r, struct reb_particle* const restrict p_j, const double M, unsigned int i, double _dt){
+    struct reb_particle* dp[r->var_config_N+1];
+    for (int v=0;v<r->var_config_N;v++){
+        dp[v] = &p_j[i+r->var_config[v].index];
+    }
+    if (reb_whfast_kepler_solver_particle(&p_j[i], dp, r->var_config_N, M, _dt)){
+        reb_whfast_kepler_solver_warning(r);
+    }
+}
 
+void reb_whfast_kepler_solver_soa(const struct reb_simulation* const r, const struct reb_particle_soa p_j, const double M, unsigned int i, double _dt){
+    // Copies particle i and its variational particles, then uses the same solver as above.
+    struct reb_particle p = {.x=p_j.x[i], .y=p_j.y[i], .z=p_j.z[i], .vx=p_j.vx[i], .vy=p_j.vy[i], .vz=p_j.vz[i]};
+    struct reb_particle dps[r->var_config_N+1];
+    struct reb_particle* dp[r->var_config_N+1];
+    for (int v=0;v<r->var_config_N;v++){
+        const unsigned int j = i+r->var_config[v].index;
+        dps[v] = (struct reb_particle){.x=p_j.x[j], .y=p_j.y[j], .z=p_j.z[j], .vx=p_j.vx[j], .vy=p_j.vy[j], .vz=p_j.vz[j]};
+        dp[v] = &dps[v];
+    }
+    if (reb_whfast_kepler_solver_particle(&p, dp, r->var_config_N, M, _dt)){
+        reb_whfast_kepler_solver_warning(r);
+    }
+    p_j.x[i]  = p.x;  p_j.y[i]  = p.y;  p_j.z[i]  = p.z;
+    p_j.vx[i] = p.vx; p_j.vy[i] = p.vy; p_j.vz[i] = p.vz;
+    for (int v=0;v<r->var_config_N;v++){
+        const unsigned int j = i+r->var_config[v].index;
+        p_j.x[j]  = dps[v].x;  p_j.y[j]  = dps[v].y;  p_j.z[j]  = dps[v].z;
+        p_j.vx[j] = dps[v].vx; p_j.vy[j] = dps[v].vy; p_j.vz[j] = dps[v].vz;
+    }
+}
+
+// Forces inlining so that functions called with compile time constant arguments get specialized.
+#ifdef __GNUC__
+#define WHFAST_FIXED_N_INLINE static inline __attribute__((always_inline))
+#else
+#define WHFAST_FIXED_N_INLINE static inline
+#endif
+
+/************************************
+ * Keplerian motion for a batch of 
+ * planets. The batch is stored as a
+ * structure of arrays so that the 
+ * loops over the bodies in a batch 
+ * can be vectorized.               */
+WHFAST_FIXED_N_INLINE void stumpff_cs3_batch(double cs[4][WHFAST_BATCH], const double* restrict zin, const unsigned int Nb) {
+    // Same operations as stumpff_cs3 for every lane. 
+    double z[WHFAST_BATCH];
+    unsigned int n[WHFAST_BATCH];
+    unsigned int nmax_batch = 0;
+    for (unsigned int l=0;l<Nb;l++){
+        z[l] = zin[l];
+        n[l] = 0;
+        while(fabs(z[l])>0.1){
+            z[l] = z[l]/4.;
+            n[l]++;
+        }
+        nmax_batch = MAX(nmax_batch, n[l]);
+    }
+    const int nmax = 13;
+    double c_odd[WHFAST_BATCH];
+    double c_even[WHFAST_BATCH];
+    for (unsigned int l=0;l<Nb;l++){
+        c_odd[l]  = invfactorial[nmax];
+        c_even[l] = invfactorial[nmax-1];
+    }
+    for(int np=nmax-2;np>=3;np-=2){
+        for (unsigned int l=0;l<Nb;l++){
+            c_odd[l]  = invfactorial[np]    - z[l] *c_odd[l];
+            c_even[l] = invfactorial[np-1]  - z[l] *c_even[l];
+        }
+    }
+    for (unsigned int l=0;l<Nb;l++){
+        cs[3][l] = c_odd[l];
+        cs[2][l] = c_even[l];
+        cs[1][l] = invfactorial[1]  - z[l] *c_odd[l];
+        cs[0][l] = invfactorial[0]  - z[l] *c_even[l];
+    }
+    // Lanes which needed fewer reductions are masked out.
+    for (unsigned int k=nmax_batch;k>0;k--){ 
+        for (unsigned int l=0;l<Nb;l++){
+            const double cs3 = (cs[2][l]+cs[0][l]*cs[3][l])*0.25;
+            const double cs2 = cs[1][l]*cs[1][l]*0.5;
+            const double cs1 = cs[0][l]*cs[1][l];
+            const double cs0 = 2.*cs[0][l]*cs[0][l]-1.;
+            const int active = n[l]>=k;
+            cs[3][l] = active ? cs3 : cs[3][l];
+            cs[2][l] = active ? cs2 : cs[2][l];
+            cs[1][l] = active ? cs1 : cs[1][l];
+            cs[0][l] = active ? cs0 : cs[0][l];
+        }
+    }
+}
+
+WHFAST_FIXED_N_INLINE void stiefel_Gs3_batch(double Gs[4][WHFAST_BATCH], const double* restrict beta, const double* restrict X, const unsigned int Nb) {
+    double z[WHFAST_BATCH];
+    double X2[WHFAST_BATCH];
+    for (unsigned int l=0;l<Nb;l++){
+        X2[l] = X[l]*X[l];
+        z[l] = beta[l]*X2[l];
+    }
+    stumpff_cs3_batch(Gs, z, Nb);
+    for (unsigned int l=0;l<Nb;l++){
+        Gs[1][l] *= X[l]; 
+        Gs[2][l] *= X2[l]; 
+        Gs[3][l] *= X2[l]*X[l];
+    }
+}
+
+WHFAST_FIXED_N_INLINE void reb_whfast_kepler_solver_lanes_inline(const struct reb_whfast_lanes p, const struct reb_whfast_lanes dp, const double* const restrict M, const unsigned int Nb, const double _dt, int* const restrict fallback){
+    // Solves Kepler's equation for Nb<=WHFAST_BATCH bodies stored as a structure of arrays
+    // with central masses M[0]...M[Nb-1] simultaneously. If dp.x is not NULL, the variational 
+    // particles dp are evolved along with p. Elliptic orbits which converge with Newton's 
+    // method are updated in place. All other lanes (hyperbolic orbits, timesteps comparable 
+    // to the orbital period, convergence issues) are flagged in fallback and left unchanged.
+    // These need to be advanced with reb_whfast_kepler_solver_particle. The results are 
+    // bitwise identical to those of reb_whfast_kepler_solver_particle.
+    double x[WHFAST_BATCH], y[WHFAST_BATCH], z[WHFAST_BATCH];
+    double vx[WHFAST_BATCH], vy[WHFAST_BATCH], vz[WHFAST_BATCH];
+    double r0[WHFAST_BATCH], r0i[WHFAST_BATCH], eta0[WHFAST_BATCH], zeta0[WHFAST_BATCH];
+    double beta[WHFAST_BATCH] = {0.};
+    double X[WHFAST_BATCH] = {0.};
+    double oldX[WHFAST_BATCH], oldX2[WHFAST_BATCH], X_per_period[WHFAST_BATCH];
+    double ri[WHFAST_BATCH];
+    double G1[WHFAST_BATCH] = {0.};
+    double G2[WHFAST_BATCH] = {0.};
+    double G3[WHFAST_BATCH] = {0.};
+    double Gs[4][WHFAST_BATCH];
+    int done[WHFAST_BATCH];
+
+    for (unsigned int l=0;l<Nb;l++){
+        x[l] = p.x[l]; y[l] = p.y[l]; z[l] = p.z[l];
+        vx[l] = p.vx[l]; vy[l] = p.vy[l]; vz[l] = p.vz[l];
+        r0[l] = sqrt(x[l]*x[l] + y[l]*y[l] + z[l]*z[l]);
+        r0i[l] = 1./r0[l];
+        const double v2 =  vx[l]*vx[l] + vy[l]*vy[l] + vz[l]*vz[l];
+        beta[l] = 2.*M[l]*r0i[l] - v2;
+        eta0[l] = x[l]*vx[l] + y[l]*vy[l] + z[l]*vz[l];
+        zeta0[l] = M[l] - beta[l]*r0[l];
+        fallback[l] = 0;
+        if (beta[l]>0.){
+            const double sqrt_beta = sqrt(beta[l]);
+            const double invperiod = sqrt_beta*beta[l]/(2.*M_PI*M[l]);
+            X_per_period[l] = 2.*M_PI/sqrt_beta;
+            if (fabs(_dt)*invperiod>1.){
+                fallback[l] = 1; // Scalar solver issues a warning and uses bisection if needed
+            }
+            const double dtr0i = _dt*r0i[l];
+            X[l] = dtr0i * (1. - dtr0i*eta0[l]*0.5*r0i[l]); // second order guess
+        }else{
+            fallback[l] = 1; // Hyperbolic orbit
+            X_per_period[l] = 0.;
+            X[l] = 0.;
+        }
+    }
+
+    // Lanes which are done are masked out by evaluating the Stiefel functions 
+    // at X=0. Their results are not used, and a non-finite X in a lane which 
+    // has fallen back would keep the argument reduction from terminating.
+    double Xm[WHFAST_BATCH], betam[WHFAST_BATCH];
+
+    // Do one Newton step
+    for (unsigned int l=0;l<Nb;l++){
+        Xm[l] = fallback[l] ? 0. : X[l];
+        betam[l] = fallback[l] ? 0. : beta[l];
+    }
+    stiefel_Gs3_batch(Gs, betam, Xm, Nb);
+    for (unsigned int l=0;l<Nb;l++){
+        oldX[l] = X[l];
+        const double eta0Gs1zeta0Gs2 = eta0[l]*Gs[1][l] + zeta0[l]*Gs[2][l];
+        ri[l] = 1./(r0[l] + eta0Gs1zeta0Gs2);
+        X[l]  = ri[l]*(X[l]*eta0Gs1zeta0Gs2-eta0[l]*Gs[2][l]-zeta0[l]*Gs[3][l]+_dt);
+        if (fastabs(X[l]-oldX[l]) > 0.01*X_per_period[l] || !isfinite(X[l])){
+            fallback[l] = 1; // Quartic solver
+        }
+        oldX2[l] = nan("");
+        done[l] = fallback[l];
+    }
+
+    // Newton's method with masked convergence
+    for (int n_hg=1;n_hg<WHFAST_NMAX_NEWT;n_hg++){
+        int all_done = 1;
+        for (unsigned int l=0;l<Nb;l++){
+            all_done &= done[l];
+        }
+        if (all_done){
+            break;
+        }
+        for (unsigned int l=0;l<Nb;l++){
+            Xm[l] = done[l] ? 0. : X[l];
+            betam[l] = done[l] ? 0. : beta[l];
+        }
+        stiefel_Gs3_batch(Gs, betam, Xm, Nb);
+        for (unsigned int l=0;l<Nb;l++){
+            const double eta0Gs1zeta0Gs2 = eta0[l]*Gs[1][l] + zeta0[l]*Gs[2][l];
+            const double rin = 1./(r0[l] + eta0Gs1zeta0Gs2);
+            const double Xn  = rin*(X[l]*eta0Gs1zeta0Gs2-eta0[l]*Gs[2][l]-zeta0[l]*Gs[3][l]+_dt);
+            if (!done[l]){
+                oldX2[l] = oldX[l];
+                oldX[l] = X[l];
+                X[l] = Xn;
+                ri[l] = rin;
+                G1[l] = Gs[1][l];
+                G2[l] = Gs[2][l];
+                G3[l] = Gs[3][l];
+                if (X[l]==oldX[l]||X[l]==oldX2[l]){
+                    done[l] = 1; // Converged
+                }else if (!isfinite(X[l])){
+                    done[l] = 1; // Diverged. Scalar solver handles this lane.
+                    fallback[l] = 1;
+                }
+            }
+        }
+    }
+
+    for (unsigned int l=0;l<Nb;l++){
+        if (!done[l]){
+            fallback[l] = 1; // Not converged. Scalar solver uses bisection.
+        }
+        if (fallback[l]){
+            continue;
+        }
+        // Note: These are not the traditional f and g functions.
+        const double f = -M[l]*G2[l]*r0i[l];
+        const double g = _dt - M[l]*G3[l];
+        const double fd = -M[l]*G1[l]*r0i[l]*ri[l]; 
+        const double gd = -M[l]*G2[l]*ri[l]; 
+        
+        p.x[l] += f*x[l] + g*vx[l];
+        p.y[l] += f*y[l] + g*vy[l];
+        p.z[l] += f*z[l] + g*vz[l];
+        
+        p.vx[l] += fd*x[l] + gd*vx[l];
+        p.vy[l] += fd*y[l] + gd*vy[l];
+        p.vz[l] += fd*z[l] + gd*vz[l];
+
+        if (dp.x){
+            double Gs6[6];
+            stiefel_Gs(Gs6, beta[l], X[l]);
+            const double dx = dp.x[l], dy = dp.y[l], dz = dp.z[l];
+            const double dvx = dp.vx[l], dvy = dp.vy[l], dvz = dp.vz[l];
+            const double dr0 = (dx*x[l] + dy*y[l] + dz*z[l])*r0i[l];
+            const double dbeta = -2.*M[l]*dr0*r0i[l]*r0i[l] - 2.* (dvx*vx[l] + dvy*vy[l] + dvz*vz[l]);
+            const double deta0 = dx*vx[l] + dy*vy[l] + dz*vz[l]
+                     + x[l]*dvx + y[l]*dvy + z[l]*dvz;
+            const double dzeta0 = -beta[l]*dr0 - r0[l]*dbeta;
+            const double G3beta = 0.5*(3.*Gs6[5]-X[l]*Gs6[4]);
+            const double G2beta = 0.5*(2.*Gs6[4]-X[l]*Gs6[3]);
+            const double G1beta = 0.5*(Gs6[3]-X[l]*Gs6[2]);
+            const double tbeta = eta0[l]*G2beta + zeta0[l]*G3beta;
+            const double dX = -1.*ri[l]*(X[l]*dr0 + Gs6[2]*deta0+Gs6[3]*dzeta0+tbeta*dbeta);
+            const double dG1 = Gs6[0]*dX + G1beta*dbeta; 
+            const double dG2 = Gs6[1]*dX + G2beta*dbeta;
+            const double dG3 = Gs6[2]*dX + G3beta*dbeta;
+            const double dr = dr0 + Gs6[1]*deta0 + Gs6[2]*dzeta0 + eta0[l]*dG1 + zeta0[l]*dG2;
+            const double df = M[l]*Gs6[2]*dr0*r0i[l]*r0i[l] - M[l]*dG2*r0i[l];
+            const double dg = -M[l]*dG3;
+            const double dfd = -M[l]*dG1*r0i[l]*ri[l] + M[l]*Gs6[1]*(dr0*r0i[l]+dr*ri[l])*r0i[l]*ri[l];
+            const double dgd = -M[l]*dG2*ri[l] + M[l]*Gs6[2]*dr*ri[l]*ri[l];
+
+            dp.x[l] += f*dx + g*dvx + df*x[l] + dg*vx[l];
+            dp.y[l] += f*dy + g*dvy + df*y[l] + dg*vy[l];
+            dp.z[l] += f*dz + g*dvz + df*z[l] + dg*vz[l];
+
+            dp.vx[l] += fd*dx + gd*dvx + dfd*x[l] + dgd*vx[l];
+            dp.vy[l] += fd*dy + gd*dvy + dfd*y[l] + dgd*vy[l];
+            dp.vz[l] += fd*dz + gd*dvz + dfd*z[l] + dgd*vz[l];
+        }
+    }
+}
+
+void reb_whfast_kepler_solver_lanes(const struct reb_whfast_lanes p, const struct reb_whfast_lanes dp, const double* const restrict M, const unsigned int Nb, const double _dt, int* const restrict fallback){
+    reb_whfast_kepler_solver_lanes_inline(p, dp, M, Nb, _dt, fallback);
+}
+
+void reb_whfast_kepler_solver_batch(const struct reb_simulation* const r, struct reb_particle* const restrict p_j, const double* const restrict M, const unsigned int i0, const unsigned int Nb, const double _dt){
+    // Solves Kepler's equation for the particles i0...i0+Nb-1 (Nb<=WHFAST_BATCH) with
+    // central masses M[0]...M[Nb-1] simultaneously. The results are bitwise identical 
+    // to those of reb_whfast_kepler_solver.
+    if (r->var_config_N){
+        for (unsigned int l=0;l<Nb;l++){
+            reb_whfast_kepler_solver(r, p_j, M[l], i0+l, _dt);
+        }
+        return;
+    }
+    double x[WHFAST_BATCH], y[WHFAST_BATCH], z[WHFAST_BATCH];
+    double vx[WHFAST_BATCH], vy[WHFAST_BATCH], vz[WHFAST_BATCH];
+    int fallback[WHFAST_BATCH];
+    for (unsigned int l=0;l<Nb;l++){
+        x[l] = p_j[i0+l].x; y[l] = p_j[i0+l].y; z[l] = p_j[i0+l].z;
+        vx[l] = p_j[i0+l].vx; vy[l] = p_j[i0+l].vy; vz[l] = p_j[i0+l].vz;
+    }
+    const struct reb_whfast_lanes p = {.x=x, .y=y, .z=z, .vx=vx, .vy=vy, .vz=vz};
+    const struct reb_whfast_lanes dp = {0};
+    reb_whfast_kepler_solver_lanes(p, dp, M, Nb, _dt, fallback);
+    for (unsigned int l=0;l<Nb;l++){
+        if (fallback[l]){
+            reb_whfast_kepler_solver(r, p_j, M[l], i0+l, _dt);
+            continue;
+        }
+        p_j[i0+l].x = x[l]; p_j[i0+l].y = y[l]; p_j[i0+l].z = z[l];
+        p_j[i0+l].vx = vx[l]; p_j[i0+l].vy = vy[l]; p_j[i0+l].vz = vz[l];
+    }
+}
+
+void reb_whfast_kepler_solver_batch_soa(const struct reb_simulation* const r, const struct reb_particle_soa p_j, const double* const restrict M, const unsigned int i0, const unsigned int Nb, const double _dt){
+    // Same as reb_whfast_kepler_solver_batch but the lanes operate directly on the arrays in p_j.
+    if (r->var_config_N){
+        for (unsigned int l=0;l<Nb;l++){
+            reb_whfast_kepler_solver_soa(r, p_j, M[l], i0+l, _dt);
+        }
+        return;
+    }
+    int fallback[WHFAST_BATCH];
+    const struct reb_whfast_lanes p = {.x=p_j.x+i0, .y=p_j.y+i0, .z=p_j.z+i0, .vx=p_j.vx+i0, .vy=p_j.vy+i0, .vz=p_j.vz+i0};
+    const struct reb_whfast_lanes dp = {0};
+    reb_whfast_kepler_solver_lanes(p, dp, M, Nb, _dt, fallback);
+    for (unsigned int l=0;l<Nb;l++){
+        if (fallback[l]){
+            // Lanes flagged for fallback have not been modified.
+            reb_whfast_kepler_solver_soa(r, p_j, M[l], i0+l, _dt);
+        }
+    }
 }
 
 /***************************** 
  * Interaction Hamiltonian  */
+static void reb_whfast_jacobi_kick(struct reb_simulation* const r, const struct reb_particle_soa p_j, const unsigned int i, const double eta, const double _dt){
+    // Eq 132
+    const double G = r->G;
+    const double softening = r->softening;
+    const double x = p_j.x[i];
+    const double y = p_j.y[i];
+    const double z = p_j.z[i];
+    p_j.vx[i] += _dt * p_j.ax[i];
+    p_j.vy[i] += _dt * p_j.ay[i];
+    p_j.vz[i] += _dt * p_j.az[i];
+    if (r->gravity != REB_GRAVITY_JACOBI){ 
+        // If Jacobi terms have not been added in update_acceleration, then add them here:
+        if (i>1){
+            const double rj2i = 1./(x*x + y*y + z*z + softening*softening);
+            const double rji  = sqrt(rj2i);
+            const double rj3iM = rji*rj2i*G*eta;
+            const double prefac1 = _dt*rj3iM;
+            p_j.vx[i] += prefac1*x;
+            p_j.vy[i] += prefac1*y;
+            p_j.vz[i] += prefac1*z;
+            for(int v=0;v<r->var_config_N;v++){
+                struct reb_variational_configuration const vc = r->var_config[v];
+                const int index = vc.index;
+                double rj5M = rj3iM*rj2i;
+                double rdr = p_j.x[i+index]*x + p_j.y[i+index]*y + p_j.z[i+index]*z;
+                double prefac2 = -_dt*3.*rdr*rj5M;
+                p_j.vx[i+index] += prefac1*p_j.x[i+index] + prefac2*x;
+                p_j.vy[i+index] += prefac1*p_j.y[i+index] + prefac2*y;
+                p_j.vz[i+index] += prefac1*p_j.z[i+index] + prefac2*z;
+            }
+        }
+        for(int v=0;v<r->var_config_N;v++){
+            struct reb_variational_configuration const vc = r->var_config[v];
+            const int index = vc.index;
+            p_j.vx[i+index] += _dt * p_j.ax[i+index];
+            p_j.vy[i+index] += _dt * p_j.ay[i+index];
+            p_j.vz[i+index] += _dt * p_j.az[i+index];
+        }
+    }
+}
+
 void reb_whfast_interaction_step(struct reb_simulation* const r, const double _dt){
     const unsigned int N_real = r->N-r->N_var;
     const int N_active = (r->N_active==-1 || r->testparticle_type ==1)?N_real:r->N_active;
-    const double G = r->G;
     struct reb_particle* particles = r->particles;
     const double m0 = particles[0].m;
     struct reb_simulation_integrator_whfast* const ri_whfast = &(r->ri_whfast);
-    struct reb_particle* const p_j = ri_whfast->p_jh;
+    const struct reb_particle_soa p_j = ri_whfast->p_jh;
     switch (ri_whfast->coordinates){
         case REB_WHFAST_COORDINATES_JACOBI:
             {
-            const double softening = r->softening;
             for (int v=0;v<r->var_config_N;v++){
                 struct reb_variational_configuration const vc = r->var_config[v];
-                reb_transformations_inertial_to_jacobi_acc(particles+vc.index, p_j+vc.index, particles, N_real, N_active);
+                reb_transformations_inertial_to_jacobi_acc_soa(particles+vc.index, reb_particle_soa_offset(p_j, vc.index), particles, N_real, N_active);
             }
-            reb_transformations_inertial_to_jacobi_acc(particles, p_j, particles, N_real, N_active);
+            reb_transformations_inertial_to_jacobi_acc_soa(particles, p_j, particles, N_real, N_active);
+            // The interior mass eta only changes for active particles. 
+            // Test particles all see the same eta and can be kicked in parallel.
             double eta = m0;
-            for (unsigned int i=1;i<N_real;i++){
-                // Eq 132
-                const struct reb_particle pji = p_j[i];
-                if (i<N_active){
-                    eta += pji.m;
-                }
-                p_j[i].vx += _dt * pji.ax;
-                p_j[i].vy += _dt * pji.ay;
-                p_j[i].vz += _dt * pji.az;
-                if (r->gravity != REB_GRAVITY_JACOBI){ 
-                    // If Jacobi terms have not been added in update_acceleration, then add them here:
-                    if (i>1){
-                        const double rj2i = 1./(pji.x*pji.x + pji.y*pji.y + pji.z*pji.z + softening*softening);
-                        const double rji  = sqrt(rj2i);
-                        const double rj3iM = rji*rj2i*G*eta;
-                        const double prefac1 = _dt*rj3iM;
-                        p_j[i].vx += prefac1*pji.x;
-                        p_j[i].vy += prefac1*pji.y;
-                        p_j[i].vz += prefac1*pji.z;
-                        for(int v=0;v<r->var_config_N;v++){
-                            struct reb_variational_configuration const vc = r->var_config[v];
-                            const int index = vc.index;
-                            double rj5M = rj3iM*rj2i;
-                            double rdr = p_j[i+index].x*pji.x + p_j[i+index].y*pji.y + p_j[i+index].z*pji.z;
-                            double prefac2 = -_dt*3.*rdr*rj5M;
-                            p_j[i+index].vx += prefac1*p_j[i+index].x + prefac2*pji.x;
-                            p_j[i+index].vy += prefac1*p_j[i+index].y + prefac2*pji.y;
-                            p_j[i+index].vz += prefac1*p_j[i+index].z + prefac2*pji.z;
-                        }
-                    }
-                    for(int v=0;v<r->var_config_N;v++){
-                        struct reb_variational_configuration const vc = r->var_config[v];
-                        const int index = vc.index;
-                        p_j[i+index].vx += _dt * p_j[i+index].ax;
-                        p_j[i+index].vy += _dt * p_j[i+index].ay;
-                        p_j[i+index].vz += _dt * p_j[i+index].az;
-                    }
-                }
+            for (unsigned int i=1;i<N_active;i++){
+                eta += p_j.m[i];
+                reb_whfast_jacobi_kick(r, p_j, i, eta, _dt);
+            }
+#pragma omp parallel for 
+            for (unsigned int i=MAX(N_active,1);i<N_real;i++){
+                reb_whfast_jacobi_kick(r, p_j, i, eta, _dt);
             }
             }
             break;
         case REB_WHFAST_COORDINATES_DEMOCRATICHELIOCENTRIC:
 #pragma omp parallel for 
             for (unsigned int i=1;i<N_real;i++){
-                p_j[i].vx += _dt*particles[i].ax;
-                p_j[i].vy += _dt*particles[i].ay;
-                p_j[i].vz += _dt*particles[i].az;
+                p_j.vx[i] += _dt*particles[i].ax;
+                p_j.vy[i] += _dt*particles[i].ay;
+                p_j.vz[i] += _dt*particles[i].az;
             }
             break;
         case REB_WHFAST_COORDINATES_WHDS:
 #pragma omp parallel for 
             for (unsigned int i=1;i<N_active;i++){
                 const double mi = particles[i].m;
-                p_j[i].vx += _dt*(m0+mi)*particles[i].ax/m0;
-                p_j[i].vy += _dt*(m0+mi)*particles[i].ay/m0;
-                p_j[i].vz += _dt*(m0+mi)*particles[i].az/m0;
+                p_j.vx[i] += _dt*(m0+mi)*particles[i].ax/m0;
+                p_j.vy[i] += _dt*(m0+mi)*particles[i].ay/m0;
+                p_j.vz[i] += _dt*(m0+mi)*particles[i].az/m0;
             }
 #pragma omp parallel for 
             for (unsigned int i=N_active;i<N_real;i++){
-                p_j[i].vx += _dt*particles[i].ax;
-                p_j[i].vy += _dt*particles[i].ay;
-                p_j[i].vz += _dt*particles[i].az;
+                p_j.vx[i] += _dt*particles[i].ax;
+                p_j.vy[i] += _dt*particles[i].ay;
+                p_j.vz[i] += _dt*particles[i].az;
             }
             break;
     };
 }
 void reb_whfast_jump_step(const struct reb_simulation* const r, const double _dt){
+    const struct reb_profiling_mark profiling_start = reb_profiling_start(r);
     const struct reb_simulation_integrator_whfast* const ri_whfast = &(r->ri_whfast);
-    struct reb_particle* const p_h = r->ri_whfast.p_jh;
+    const struct reb_particle_soa p_h = r->ri_whfast.p_jh;
     const int N_real = r->N - r->N_var;
     const int N_active = (r->N_active==-1 || r->testparticle_type ==1)?N_real:r->N_active;
     const double m0 = r->particles[0].m;
@@ -445,179 +789,391 @@ void reb_whfast_jump_step(const struct reb_simulation* const r, const double _dt
             break;
         case REB_WHFAST_COORDINATES_DEMOCRATICHELIOCENTRIC:
             {
+            // Summed serially so that the result does not depend on the number of threads.
             double px=0, py=0, pz=0;
-#pragma omp parallel for reduction (+:px), reduction (+:py), reduction (+:pz)
             for(int i=1;i<N_active;i++){
                 const double m = r->particles[i].m;
-                px += m * p_h[i].vx;
-                py += m * p_h[i].vy;
-                pz += m * p_h[i].vz;
+                px += m * p_h.vx[i];
+                py += m * p_h.vy[i];
+                pz += m * p_h.vz[i];
             }
 #pragma omp parallel for 
             for(int i=1;i<N_real;i++){
-                p_h[i].x += _dt * (px/m0);
-                p_h[i].y += _dt * (py/m0);
-                p_h[i].z += _dt * (pz/m0);
+                p_h.x[i] += _dt * (px/m0);
+                p_h.y[i] += _dt * (py/m0);
+                p_h.z[i] += _dt * (pz/m0);
             }
             }
             break;
         case REB_WHFAST_COORDINATES_WHDS:
             {
+            // Summed serially so that the result does not depend on the number of threads.
             double px=0, py=0, pz=0;
-#pragma omp parallel for reduction (+:px), reduction (+:py), reduction (+:pz)
             for(int i=1;i<N_active;i++){
                 const double m = r->particles[i].m;
-                px += m * p_h[i].vx / (m0+m);
-                py += m * p_h[i].vy / (m0+m);
-                pz += m * p_h[i].vz / (m0+m);
+                px += m * p_h.vx[i] / (m0+m);
+                py += m * p_h.vy[i] / (m0+m);
+                pz += m * p_h.vz[i] / (m0+m);
              }
 #pragma omp parallel for 
             for(int i=1;i<N_active;i++){
                 const double m = r->particles[i].m;
-                p_h[i].x += _dt * (px - (m * p_h[i].vx / (m0+m)) );
-                p_h[i].y += _dt * (py - (m * p_h[i].vy / (m0+m)) );
-                p_h[i].z += _dt * (pz - (m * p_h[i].vz / (m0+m)) );
+                p_h.x[i] += _dt * (px - (m * p_h.vx[i] / (m0+m)) );
+                p_h.y[i] += _dt * (py - (m * p_h.vy[i] / (m0+m)) );
+                p_h.z[i] += _dt * (pz - (m * p_h.vz[i] / (m0+m)) );
             }
 #pragma omp parallel for 
             for(int i=N_active;i<N_real;i++){
-                p_h[i].x += _dt * px;
-                p_h[i].y += _dt * py;
-                p_h[i].z += _dt * pz;
+                p_h.x[i] += _dt * px;
+                p_h.y[i] += _dt * py;
+                p_h.z[i] += _dt * pz;
             }
             }
             break;
     };
+    reb_profiling_stop(r, REB_PROFILING_CAT_JUMP, profiling_start);
 }
 
 /***************************** 
  * DKD Scheme                */
 
 void reb_whfast_kepler_step(const struct reb_simulation* const r, const double _dt){
+    const struct reb_profiling_mark profiling_start = reb_profiling_start(r);
     const double m0 = r->particles[0].m;
     const double G = r->G;
     const unsigned int N_real = r->N-r->N_var;
     const int N_active = (r->N_active==-1 || r->testparticle_type ==1)?N_real:r->N_active;
     const int coordinates = r->ri_whfast.coordinates;
-    struct reb_particle* const p_j = r->ri_whfast.p_jh;
-    double eta = m0;
+    const struct reb_particle_soa p_j = r->ri_whfast.p_jh;
+    const int N_batches = N_real>1 ? (N_real-2)/WHFAST_BATCH + 1 : 0; // Particle 0 is not included
     switch (coordinates){
         case REB_WHFAST_COORDINATES_JACOBI:
+            {
+            // Batches containing active particles accumulate the interior mass eta.
+            // Once eta is final, the remaining batches are independent.
+            double eta = m0;
+            int b_active = 0;
+            for (;b_active<N_batches && 1+b_active*WHFAST_BATCH<N_active;b_active++){
+                const unsigned int i0 = 1+b_active*WHFAST_BATCH;
+                const unsigned int Nb = MIN(WHFAST_BATCH, N_real-i0);
+                double M[WHFAST_BATCH];
+                for (unsigned int l=0;l<Nb;l++){
+                    if (i0+l<N_active){
+                        eta += p_j.m[i0+l];
+                    }
+                    M[l] = eta*G;
+                }
+                reb_whfast_kepler_solver_batch_soa(r, p_j, M, i0, Nb, _dt);
+            }
 #pragma omp parallel for 
-            for (unsigned int i=1;i<N_real;i++){
-                if (i<N_active){
-                    eta += p_j[i].m;
+            for (int b=b_active;b<N_batches;b++){
+                const unsigned int i0 = 1+b*WHFAST_BATCH;
+                const unsigned int Nb = MIN(WHFAST_BATCH, N_real-i0);
+                double M[WHFAST_BATCH];
+                for (unsigned int l=0;l<Nb;l++){
+                    M[l] = eta*G;
                 }
-                reb_whfast_kepler_solver(r, p_j, eta*G, i, _dt);
+                reb_whfast_kepler_solver_batch_soa(r, p_j, M, i0, Nb, _dt);
+            }
             }
             break;
         case REB_WHFAST_COORDINATES_DEMOCRATICHELIOCENTRIC:
 #pragma omp parallel for 
-            for (unsigned int i=1;i<N_real;i++){
-                reb_whfast_kepler_solver(r, p_j, eta*G, i, _dt); //  eta = m0
+            for (int b=0;b<N_batches;b++){
+                const unsigned int i0 = 1+b*WHFAST_BATCH;
+                const unsigned int Nb = MIN(WHFAST_BATCH, N_real-i0);
+                double M[WHFAST_BATCH];
+                for (unsigned int l=0;l<Nb;l++){
+                    M[l] = m0*G;
+                }
+                reb_whfast_kepler_solver_batch_soa(r, p_j, M, i0, Nb, _dt);
             }
             break;
         case REB_WHFAST_COORDINATES_WHDS:
 #pragma omp parallel for 
-            for (unsigned int i=1;i<N_real;i++){
-                if (i<N_active){
-                    eta = m0+p_j[i].m;
-                }else{
-                    eta = m0;
+            for (int b=0;b<N_batches;b++){
+                const unsigned int i0 = 1+b*WHFAST_BATCH;
+                const unsigned int Nb = MIN(WHFAST_BATCH, N_real-i0);
+                double M[WHFAST_BATCH];
+                for (unsigned int l=0;l<Nb;l++){
+                    if (i0+l<N_active){
+                        M[l] = (m0+p_j.m[i0+l])*G;
+                    }else{
+                        M[l] = m0*G;
+                    }
                 }
-                reb_whfast_kepler_solver(r, p_j, eta*G, i, _dt);
+                reb_whfast_kepler_solver_batch_soa(r, p_j, M, i0, Nb, _dt);
             }
             break;
     };
+    reb_profiling_stop(r, REB_PROFILING_CAT_KEPLER, profiling_start);
 }
 
 void reb_whfast_com_step(const struct reb_simulation* const r, const double _dt){
-    struct reb_particle* const p_j = r->ri_whfast.p_jh;
-    p_j[0].x += _dt*p_j[0].vx;
-    p_j[0].y += _dt*p_j[0].vy;
-    p_j[0].z += _dt*p_j[0].vz;
+    const struct reb_particle_soa p_j = r->ri_whfast.p_jh;
+    p_j.x[0] += _dt*p_j.vx[0];
+    p_j.y[0] += _dt*p_j.vy[0];
+    p_j.z[0] += _dt*p_j.vz[0];
+}
+
+/*****************************
+ * Fixed-N kernels for
+ * democratic heliocentric
+ * coordinates               */
+
+// The kernels below are written for a generic N but only ever called with a
+// compile time constant N (see WHFAST_FIXED_N_KERNELS). This allows the compiler
+// to fully unroll all loops, including those of the batched Kepler solver, and 
+// to keep the state in registers. They perform exactly the same floating point 
+// operations as the generic code path.
+
+// Returns the number of particles if the fixed-N kernels can be used, 0 otherwise.
+static unsigned int reb_whfast_fixed_n(const struct reb_simulation* const r){
+    const int N_real = r->N-r->N_var;
+    const int N_active = (r->N_active==-1 || r->testparticle_type==1)?N_real:r->N_active;
+    if (r->ri_whfast.coordinates == REB_WHFAST_COORDINATES_DEMOCRATICHELIOCENTRIC
+            && r->ri_whfast.kernel == REB_WHFAST_KERNEL_DEFAULT
+            && r->N_var == 0 && N_active == N_real
+            && N_real >= 2 && N_real <= WHFAST_FIXED_N_MAX){
+        return N_real;
+    }
+    return 0;
 }
 
-static void reb_whfast_corrector_Z(struct reb_simulation* r, const double a, const double b){
+// Same as reb_whfast_kepler_step, reb_whfast_com_step, reb_whfast_jump_step (if jump=1),
+// and reb_transformations_democraticheliocentric_to_inertial_posvel.
+WHFAST_FIXED_N_INLINE void reb_whfast_fixed_n_drift(struct reb_simulation* const r, const int N, const double _dt, const int jump, const double _dt_jump){
+    struct reb_particle* restrict const particles = r->particles;
+    const struct reb_particle_soa p_h = r->ri_whfast.p_jh;
+    const double m0 = particles[0].m;
+    double x[WHFAST_FIXED_N_MAX], y[WHFAST_FIXED_N_MAX], z[WHFAST_FIXED_N_MAX];
+    double vx[WHFAST_FIXED_N_MAX], vy[WHFAST_FIXED_N_MAX], vz[WHFAST_FIXED_N_MAX];
+    double M[WHFAST_FIXED_N_MAX];
+    int fallback[WHFAST_FIXED_N_MAX];
+    for (int i=1;i<N;i++){
+        x[i] = p_h.x[i]; y[i] = p_h.y[i]; z[i] = p_h.z[i];
+        vx[i] = p_h.vx[i]; vy[i] = p_h.vy[i]; vz[i] = p_h.vz[i];
+        M[i] = m0*r->G;
+    }
+    for (int i0=1;i0<N;i0+=WHFAST_BATCH){
+        const unsigned int Nb = MIN(WHFAST_BATCH, N-i0);
+        const struct reb_whfast_lanes p = {.x=x+i0, .y=y+i0, .z=z+i0, .vx=vx+i0, .vy=vy+i0, .vz=vz+i0};
+        const struct reb_whfast_lanes dp = {0};
+        reb_whfast_kepler_solver_lanes_inline(p, dp, M+i0, Nb, _dt, fallback+i0);
+    }
+    for (int i=1;i<N;i++){
+        if (fallback[i]){
+            reb_whfast_kepler_solver_soa(r, p_h, M[i], i, _dt);
+            x[i] = p_h.x[i]; y[i] = p_h.y[i]; z[i] = p_h.z[i];
+            vx[i] = p_h.vx[i]; vy[i] = p_h.vy[i]; vz[i] = p_h.vz[i];
+        }
+    }
+    p_h.x[0] += _dt*p_h.vx[0];
+    p_h.y[0] += _dt*p_h.vy[0];
+    p_h.z[0] += _dt*p_h.vz[0];
+    if (jump){
+        double px=0, py=0, pz=0;
+        for (int i=1;i<N;i++){
+            const double m = particles[i].m;
+            px += m * vx[i];
+            py += m * vy[i];
+            pz += m * vz[i];
+        }
+        for (int i=1;i<N;i++){
+            x[i] += _dt_jump * (px/m0);
+            y[i] += _dt_jump * (py/m0);
+            z[i] += _dt_jump * (pz/m0);
+        }
+    }
+    for (int i=1;i<N;i++){
+        p_h.x[i] = x[i]; p_h.y[i] = y[i]; p_h.z[i] = z[i];
+        p_h.vx[i] = vx[i]; p_h.vy[i] = vy[i]; p_h.vz[i] = vz[i];
+    }
+
+    // Transformation to inertial coordinates
+    const double mtot = p_h.m[0];
+    double x0 = 0., y0 = 0., z0 = 0.;
+    for (int i=1;i<N;i++){
+        const double m = p_h.m[i];
+        x0 += x[i]*m/mtot;
+        y0 += y[i]*m/mtot;
+        z0 += z[i]*m/mtot;
+        particles[i].m = m; // in case of merger/mass change
+    }
+    particles[0].x = p_h.x[0] - x0;
+    particles[0].y = p_h.y[0] - y0;
+    particles[0].z = p_h.z[0] - z0;
+    for (int i=1;i<N;i++){
+        particles[i].x = x[i]+particles[0].x;
+        particles[i].y = y[i]+particles[0].y;
+        particles[i].z = z[i]+particles[0].z;
+        particles[i].vx = vx[i]+p_h.vx[0];
+        particles[i].vy = vy[i]+p_h.vy[0];
+        particles[i].vz = vz[i]+p_h.vz[0];
+    }
+    const double m0_inertial = particles[0].m;
+    double vx0 = 0., vy0 = 0., vz0 = 0.;
+    for (int i=1;i<N;i++){
+        const double m = particles[i].m;
+        vx0 += vx[i]*m/m0_inertial;
+        vy0 += vy[i]*m/m0_inertial;
+        vz0 += vz[i]*m/m0_inertial;
+    }
+    particles[0].vx = p_h.vx[0] - vx0;
+    particles[0].vy = p_h.vy[0] - vy0;
+    particles[0].vz = p_h.vz[0] - vz0;
+}
+
+// Same as reb_whfast_interaction_step followed by reb_whfast_jump_step.
+WHFAST_FIXED_N_INLINE void reb_whfast_fixed_n_kick(struct reb_simulation* const r, const int N, const double _dt, const double _dt_jump){
+    const struct reb_particle* restrict const particles = r->particles;
+    const struct reb_particle_soa p_h = r->ri_whfast.p_jh;
+    const double m0 = particles[0].m;
+    double vx[WHFAST_FIXED_N_MAX], vy[WHFAST_FIXED_N_MAX], vz[WHFAST_FIXED_N_MAX];
+    double px=0, py=0, pz=0;
+    for (int i=1;i<N;i++){
+        vx[i] = p_h.vx[i] + _dt*particles[i].ax;
+        vy[i] = p_h.vy[i] + _dt*particles[i].ay;
+        vz[i] = p_h.vz[i] + _dt*particles[i].az;
+        const double m = particles[i].m;
+        px += m * vx[i];
+        py += m * vy[i];
+        pz += m * vz[i];
+    }
+    for (int i=1;i<N;i++){
+        p_h.vx[i] = vx[i];
+        p_h.vy[i] = vy[i];
+        p_h.vz[i] = vz[i];
+        p_h.x[i] += _dt_jump * (px/m0);
+        p_h.y[i] += _dt_jump * (py/m0);
+        p_h.z[i] += _dt_jump * (pz/m0);
+    }
+}
+
+#define WHFAST_FIXED_N_KERNELS(N) \
+static void reb_whfast_fixed_n_drift_##N(struct reb_simulation* const r, const double _dt, const int jump, const double _dt_jump){ \
+    reb_whfast_fixed_n_drift(r, N, _dt, jump, _dt_jump); \
+} \
+static void reb_whfast_fixed_n_kick_##N(struct reb_simulation* const r, const double _dt, const double _dt_jump){ \
+    reb_whfast_fixed_n_kick(r, N, _dt, _dt_jump); \
+}
+WHFAST_FIXED_N_KERNELS(2)
+WHFAST_FIXED_N_KERNELS(3)
+WHFAST_FIXED_N_KERNELS(4)
+WHFAST_FIXED_N_KERNELS(5)
+WHFAST_FIXED_N_KERNELS(6)
+WHFAST_FIXED_N_KERNELS(7)
+WHFAST_FIXED_N_KERNELS(8)
+WHFAST_FIXED_N_KERNELS(9)
+WHFAST_FIXED_N_KERNELS(10)
+WHFAST_FIXED_N_KERNELS(11)
+WHFAST_FIXED_N_KERNELS(12)
+WHFAST_FIXED_N_KERNELS(13)
+WHFAST_FIXED_N_KERNELS(14)
+WHFAST_FIXED_N_KERNELS(15)
+WHFAST_FIXED_N_KERNELS(16)
+
+static void (*const reb_whfast_fixed_n_drift_kernels[WHFAST_FIXED_N_MAX+1])(struct reb_simulation* const r, const double _dt, const int jump, const double _dt_jump) = {
+    NULL, NULL,
+    reb_whfast_fixed_n_drift_2,  reb_whfast_fixed_n_drift_3,  reb_whfast_fixed_n_drift_4,  reb_whfast_fixed_n_drift_5,
+    reb_whfast_fixed_n_drift_6,  reb_whfast_fixed_n_drift_7,  reb_whfast_fixed_n_drift_8,  reb_whfast_fixed_n_drift_9,
+    reb_whfast_fixed_n_drift_10, reb_whfast_fixed_n_drift_11, reb_whfast_fixed_n_drift_12, reb_whfast_fixed_n_drift_13,
+    reb_whfast_fixed_n_drift_14, reb_whfast_fixed_n_drift_15, reb_whfast_fixed_n_drift_16,
+};
+
+static void (*const reb_whfast_fixed_n_kick_kernels[WHFAST_FIXED_N_MAX+1])(struct reb_simulation* const r, const double _dt, const double _dt_jump) = {
+    NULL, NULL,
+    reb_whfast_fixed_n_kick_2,  reb_whfast_fixed_n_kick_3,  reb_whfast_fixed_n_kick_4,  reb_whfast_fixed_n_kick_5,
+    reb_whfast_fixed_n_kick_6,  reb_whfast_fixed_n_kick_7,  reb_whfast_fixed_n_kick_8,  reb_whfast_fixed_n_kick_9,
+    reb_whfast_fixed_n_kick_10, reb_whfast_fixed_n_kick_11, reb_whfast_fixed_n_kick_12, reb_whfast_fixed_n_kick_13,
+    reb_whfast_fixed_n_kick_14, reb_whfast_fixed_n_kick_15, reb_whfast_fixed_n_kick_16,
+};
+
+static void reb_whfast_corrector_Z(void* const state, const double a, const double b){
+    struct reb_simulation* const r = state;
     struct reb_simulation_integrator_whfast* const ri_whfast = &(r->ri_whfast);
     struct reb_particle* restrict const particles = r->particles;
     const int N_real = r->N-r->N_var;
     const int N_active = (r->N_active==-1 || r->testparticle_type==1)?N_real:r->N_active;
     reb_whfast_kepler_step(r, a);
-    reb_transformations_jacobi_to_inertial_pos(particles, ri_whfast->p_jh, particles, N_real, N_active);
+    reb_transformations_jacobi_to_inertial_pos_soa(particles, ri_whfast->p_jh, particles, N_real, N_active);
     for (int v=0;v<r->var_config_N;v++){
         struct reb_variational_configuration const vc = r->var_config[v];
-        reb_transformations_jacobi_to_inertial_pos(particles+vc.index, ri_whfast->p_jh+vc.index, particles, N_real, N_active);
+        reb_transformations_jacobi_to_inertial_pos_soa(particles+vc.index, reb_particle_soa_offset(ri_whfast->p_jh, vc.index), particles, N_real, N_active);
     }
     reb_update_acceleration(r);
     reb_whfast_interaction_step(r, -b);
     reb_whfast_kepler_step(r, -2.*a);
-    reb_transformations_jacobi_to_inertial_pos(particles, ri_whfast->p_jh, particles, N_real, N_active);
+    reb_transformations_jacobi_to_inertial_pos_soa(particles, ri_whfast->p_jh, particles, N_real, N_active);
     for (int v=0;v<r->var_config_N;v++){
         struct reb_variational_configuration const vc = r->var_config[v];
-        reb_transformations_jacobi_to_inertial_pos(particles+vc.index, ri_whfast->p_jh+vc.index, particles, N_real, N_active);
+        reb_transformations_jacobi_to_inertial_pos_soa(particles+vc.index, reb_particle_soa_offset(ri_whfast->p_jh, vc.index), particles, N_real, N_active);
     }
     reb_update_acceleration(r);
     reb_whfast_interaction_step(r, b);
     reb_whfast_kepler_step(r, a);
 }
 
-void reb_whfast_apply_corrector(struct reb_simulation* r, double inv, int order){
-    const double dt = r->dt;
+void reb_whfast_apply_corrector_sequence(void* const state, void (*Z)(void* const state, const double a, const double b), const double dt, const double inv, const int order){
     if (order==3){
         // Third order corrector
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_1*dt,-inv*reb_whfast_corrector_b_31*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_1*dt,inv*reb_whfast_corrector_b_31*dt);
+        Z(state, reb_whfast_corrector_a_1*dt,-inv*reb_whfast_corrector_b_31*dt);
+        Z(state, -reb_whfast_corrector_a_1*dt,inv*reb_whfast_corrector_b_31*dt);
     }
     if (order==5){
         // Fifth order corrector
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_2*dt,-inv*reb_whfast_corrector_b_51*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_1*dt,-inv*reb_whfast_corrector_b_52*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_1*dt,inv*reb_whfast_corrector_b_52*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_2*dt,inv*reb_whfast_corrector_b_51*dt);
+        Z(state, -reb_whfast_corrector_a_2*dt,-inv*reb_whfast_corrector_b_51*dt);
+        Z(state, -reb_whfast_corrector_a_1*dt,-inv*reb_whfast_corrector_b_52*dt);
+        Z(state, reb_whfast_corrector_a_1*dt,inv*reb_whfast_corrector_b_52*dt);
+        Z(state, reb_whfast_corrector_a_2*dt,inv*reb_whfast_corrector_b_51*dt);
     }
     if (order==7){
         // Seventh order corrector
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_3*dt,-inv*reb_whfast_corrector_b_71*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_2*dt,-inv*reb_whfast_corrector_b_72*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_1*dt,-inv*reb_whfast_corrector_b_73*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_1*dt,inv*reb_whfast_corrector_b_73*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_2*dt,inv*reb_whfast_corrector_b_72*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_3*dt,inv*reb_whfast_corrector_b_71*dt);
+        Z(state, -reb_whfast_corrector_a_3*dt,-inv*reb_whfast_corrector_b_71*dt);
+        Z(state, -reb_whfast_corrector_a_2*dt,-inv*reb_whfast_corrector_b_72*dt);
+        Z(state, -reb_whfast_corrector_a_1*dt,-inv*reb_whfast_corrector_b_73*dt);
+        Z(state, reb_whfast_corrector_a_1*dt,inv*reb_whfast_corrector_b_73*dt);
+        Z(state, reb_whfast_corrector_a_2*dt,inv*reb_whfast_corrector_b_72*dt);
+        Z(state, reb_whfast_corrector_a_3*dt,inv*reb_whfast_corrector_b_71*dt);
     }
     if (order==11){
         // Eleventh order corrector
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_5*dt,-inv*reb_whfast_corrector_b_111*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_4*dt,-inv*reb_whfast_corrector_b_112*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_3*dt,-inv*reb_whfast_corrector_b_113*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_2*dt,-inv*reb_whfast_corrector_b_114*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_1*dt,-inv*reb_whfast_corrector_b_115*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_1*dt,inv*reb_whfast_corrector_b_115*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_2*dt,inv*reb_whfast_corrector_b_114*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_3*dt,inv*reb_whfast_corrector_b_113*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_4*dt,inv*reb_whfast_corrector_b_112*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_5*dt,inv*reb_whfast_corrector_b_111*dt);
+        Z(state, -reb_whfast_corrector_a_5*dt,-inv*reb_whfast_corrector_b_111*dt);
+        Z(state, -reb_whfast_corrector_a_4*dt,-inv*reb_whfast_corrector_b_112*dt);
+        Z(state, -reb_whfast_corrector_a_3*dt,-inv*reb_whfast_corrector_b_113*dt);
+        Z(state, -reb_whfast_corrector_a_2*dt,-inv*reb_whfast_corrector_b_114*dt);
+        Z(state, -reb_whfast_corrector_a_1*dt,-inv*reb_whfast_corrector_b_115*dt);
+        Z(state, reb_whfast_corrector_a_1*dt,inv*reb_whfast_corrector_b_115*dt);
+        Z(state, reb_whfast_corrector_a_2*dt,inv*reb_whfast_corrector_b_114*dt);
+        Z(state, reb_whfast_corrector_a_3*dt,inv*reb_whfast_corrector_b_113*dt);
+        Z(state, reb_whfast_corrector_a_4*dt,inv*reb_whfast_corrector_b_112*dt);
+        Z(state, reb_whfast_corrector_a_5*dt,inv*reb_whfast_corrector_b_111*dt);
     }
     if (order==17){
         // Seventeenth order corrector
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_8*dt,-inv*reb_whfast_corrector_b_171*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_7*dt,-inv*reb_whfast_corrector_b_172*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_6*dt,-inv*reb_whfast_corrector_b_173*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_5*dt,-inv*reb_whfast_corrector_b_174*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_4*dt,-inv*reb_whfast_corrector_b_175*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_3*dt,-inv*reb_whfast_corrector_b_176*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_2*dt,-inv*reb_whfast_corrector_b_177*dt);
-        reb_whfast_corrector_Z(r, -reb_whfast_corrector_a_1*dt,-inv*reb_whfast_corrector_b_178*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_1*dt,inv*reb_whfast_corrector_b_178*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_2*dt,inv*reb_whfast_corrector_b_177*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_3*dt,inv*reb_whfast_corrector_b_176*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_4*dt,inv*reb_whfast_corrector_b_175*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_5*dt,inv*reb_whfast_corrector_b_174*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_6*dt,inv*reb_whfast_corrector_b_173*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_7*dt,inv*reb_whfast_corrector_b_172*dt);
-        reb_whfast_corrector_Z(r, reb_whfast_corrector_a_8*dt,inv*reb_whfast_corrector_b_171*dt);
+        Z(state, -reb_whfast_corrector_a_8*dt,-inv*reb_whfast_corrector_b_171*dt);
+        Z(state, -reb_whfast_corrector_a_7*dt,-inv*reb_whfast_corrector_b_172*dt);
+        Z(state, -reb_whfast_corrector_a_6*dt,-inv*reb_whfast_corrector_b_173*dt);
+        Z(state, -reb_whfast_corrector_a_5*dt,-inv*reb_whfast_corrector_b_174*dt);
+        Z(state, -reb_whfast_corrector_a_4*dt,-inv*reb_whfast_corrector_b_175*dt);
+        Z(state, -reb_whfast_corrector_a_3*dt,-inv*reb_whfast_corrector_b_176*dt);
+        Z(state, -reb_whfast_corrector_a_2*dt,-inv*reb_whfast_corrector_b_177*dt);
+        Z(state, -reb_whfast_corrector_a_1*dt,-inv*reb_whfast_corrector_b_178*dt);
+        Z(state, reb_whfast_corrector_a_1*dt,inv*reb_whfast_corrector_b_178*dt);
+        Z(state, reb_whfast_corrector_a_2*dt,inv*reb_whfast_corrector_b_177*dt);
+        Z(state, reb_whfast_corrector_a_3*dt,inv*reb_whfast_corrector_b_176*dt);
+        Z(state, reb_whfast_corrector_a_4*dt,inv*reb_whfast_corrector_b_175*dt);
+        Z(state, reb_whfast_corrector_a_5*dt,inv*reb_whfast_corrector_b_174*dt);
+        Z(state, reb_whfast_corrector_a_6*dt,inv*reb_whfast_corrector_b_173*dt);
+        Z(state, reb_whfast_corrector_a_7*dt,inv*reb_whfast_corrector_b_172*dt);
+        Z(state, reb_whfast_corrector_a_8*dt,inv*reb_whfast_corrector_b_171*dt);
     }
 }
 
+void reb_whfast_apply_corrector(struct reb_simulation* r, double inv, int order){
+    reb_whfast_apply_corrector_sequence(r, reb_whfast_corrector_Z, r->dt, inv, order);
+}
+
 static void reb_whfast_operator_C(struct reb_simulation* const r, double a, double b){
     reb_whfast_kepler_step(r, a);   
     
@@ -626,7 +1182,7 @@ static void reb_whfast_operator_C(struct reb_simulation* const r, double a, doub
     const int N = r->N;
     const int N_real = r->N-r->N_var;
     const int N_active = (r->N_active==-1 || r->testparticle_type==1)?N_real:r->N_active;
-    reb_transformations_jacobi_to_inertial_pos(particles, ri_whfast->p_jh, particles, N, N_active);
+    reb_transformations_jacobi_to_inertial_pos_soa(particles, ri_whfast->p_jh, particles, N, N_active);
     reb_update_acceleration(r);
     reb_whfast_interaction_step(r, b);
     
@@ -654,7 +1210,7 @@ void reb_whfast_calculate_jerk(struct reb_simulation* r){
     // Assume particles.a calculated.
 	struct reb_particle* const particles = r->particles;
 	const int N = r->N;
-    struct reb_particle* jerk = r->ri_whfast.p_jh; // Used as a temporary buffer for accelerations
+    const struct reb_particle_soa jerk = r->ri_whfast.p_jh; // Used as a temporary buffer for accelerations
 	const double G = r->G;
     double Rjx = 0.; // com
     double Rjy = 0.;
@@ -664,9 +1220,9 @@ void reb_whfast_calculate_jerk(struct reb_simulation* r){
     double Ajy = 0.;
     double Ajz = 0.;
     for (int j=0; j<N; j++){
-        jerk[j].ax = 0; 
-        jerk[j].ay = 0; 
-        jerk[j].az = 0; 
+        jerk.ax[j] = 0; 
+        jerk.ay[j] = 0; 
+        jerk.az[j] = 0; 
         for (int i=0; i<j+1; i++){
             //////////////////
             // Jacobi Term
@@ -686,15 +1242,15 @@ void reb_whfast_calculate_jerk(struct reb_simulation* r){
                 const double dr = sqrt(Qkx*Qkx + Qky*Qky + Qkz*Qkz);
                 
                 const double prefact2 = G*dQkrj /(dr*dr*dr);
-                jerk[i].ax    += prefact2*dax;
-                jerk[i].ay    += prefact2*day;
-                jerk[i].az    += prefact2*daz;
+                jerk.ax[i]    += prefact2*dax;
+                jerk.ay[i]    += prefact2*day;
+                jerk.az[i]    += prefact2*daz;
                 
                 const double alphasum = dax*Qkx + day*Qky + daz*Qkz;
                 const double prefact1 = 3.*alphasum*prefact2/(dr*dr);
-                jerk[i].ax    -= prefact1*Qkx; 
-                jerk[i].ay    -= prefact1*Qky;
-                jerk[i].az    -= prefact1*Qkz; 
+                jerk.ax[i]    -= prefact1*Qkx; 
+                jerk.ay[i]    -= prefact1*Qky;
+                jerk.az[i]    -= prefact1*Qkz; 
             }
             /////////////////
             // Direct Term
@@ -713,21 +1269,21 @@ void reb_whfast_calculate_jerk(struct reb_simulation* r){
                 const double prefact2 = G /(dr*dr*dr);
                 const double prefact2i = prefact2*particles[i].m;
                 const double prefact2j = prefact2*particles[j].m;
-                jerk[j].ax    -= dax*prefact2i;
-                jerk[j].ay    -= day*prefact2i;
-                jerk[j].az    -= daz*prefact2i;
-                jerk[i].ax    += dax*prefact2j;
-                jerk[i].ay    += day*prefact2j;
-                jerk[i].az    += daz*prefact2j;
+                jerk.ax[j]    -= dax*prefact2i;
+                jerk.ay[j]    -= day*prefact2i;
+                jerk.az[j]    -= daz*prefact2i;
+                jerk.ax[i]    += dax*prefact2j;
+                jerk.ay[i]    += day*prefact2j;
+                jerk.az[i]    += daz*prefact2j;
                 const double prefact1 = 3.*alphasum*prefact2 /(dr*dr);
                 const double prefact1i = prefact1*particles[i].m;
                 const double prefact1j = prefact1*particles[j].m;
-                jerk[j].ax    += dx*prefact1i;
-                jerk[j].ay    += dy*prefact1i;
-                jerk[j].az    += dz*prefact1i;
-                jerk[i].ax    -= dx*prefact1j;
-                jerk[i].ay    -= dy*prefact1j;
-                jerk[i].az    -= dz*prefact1j;
+                jerk.ax[j]    += dx*prefact1i;
+                jerk.ay[j]    += dy*prefact1i;
+                jerk.az[j]    += dz*prefact1i;
+                jerk.ax[i]    -= dx*prefact1j;
+                jerk.ay[i]    -= dy*prefact1j;
+                jerk.az[i]    -= dz*prefact1j;
             }
         }
         Ajx += particles[j].ax*particles[j].m;
@@ -755,9 +1311,8 @@ int reb_integrator_whfast_init(struct reb_simulation* const r){
     }
     struct reb_simulation_integrator_whfast* const ri_whfast = &(r->ri_whfast);
 #if defined(_OPENMP)
-    if (ri_whfast->coordinates!=REB_WHFAST_COORDINATES_DEMOCRATICHELIOCENTRIC
-        && ri_whfast->coordinates!=REB_WHFAST_COORDINATES_WHDS){
-        reb_error(r,"WHFast when used with OpenMP requires REB_WHFAST_COORDINATES_WHDS or REB_WHFAST_COORDINATES_DEMOCRATICHELIOCENTRIC\n");
+    if (ri_whfast->kernel != REB_WHFAST_KERNEL_DEFAULT){
+        reb_error(r,"WHFast when used with OpenMP requires the default kernel.\n");
         return 1; // Error
     }
 #endif
@@ -800,7 +1355,7 @@ int reb_integrator_whfast_init(struct reb_simulation* const r){
     const int N = r->N;
     if (ri_whfast->allocated_N != N){
         ri_whfast->allocated_N = N;
-        ri_whfast->p_jh = realloc(ri_whfast->p_jh,sizeof(struct reb_particle)*N);
+        reb_particle_soa_realloc(&ri_whfast->p_jh, N);
         ri_whfast->recalculate_coordinates_this_timestep = 1;
     }
     return 0;
@@ -815,17 +1370,17 @@ void reb_integrator_whfast_from_inertial(struct reb_simulation* const r){
     
     switch (ri_whfast->coordinates){
         case REB_WHFAST_COORDINATES_JACOBI:
-            reb_transformations_inertial_to_jacobi_posvel(particles, ri_whfast->p_jh, particles, N_real, N_active);
+            reb_transformations_inertial_to_jacobi_posvel_soa(particles, ri_whfast->p_jh, particles, N_real, N_active);
             for (int v=0;v<r->var_config_N;v++){
                 struct reb_variational_configuration const vc = r->var_config[v];
-                reb_transformations_inertial_to_jacobi_posvel(particles+vc.index, ri_whfast->p_jh+vc.index, particles, N_real, N_active);
+                reb_transformations_inertial_to_jacobi_posvel_soa(particles+vc.index, reb_particle_soa_offset(ri_whfast->p_jh, vc.index), particles, N_real, N_active);
             }
             break;
         case REB_WHFAST_COORDINATES_DEMOCRATICHELIOCENTRIC:
-            reb_transformations_inertial_to_democraticheliocentric_posvel(particles, ri_whfast->p_jh, N_real, N_active);
+            reb_transformations_inertial_to_democraticheliocentric_posvel_soa(particles, ri_whfast->p_jh, N_real, N_active);
             break;
         case REB_WHFAST_COORDINATES_WHDS:
-            reb_transformations_inertial_to_whds_posvel(particles, ri_whfast->p_jh, N_real, N_active);
+            reb_transformations_inertial_to_whds_posvel_soa(particles, ri_whfast->p_jh, N_real, N_active);
             break;
     };
 }
@@ -841,25 +1396,25 @@ void reb_integrator_whfast_to_inertial(struct reb_simulation* const r){
     if (r->force_is_velocity_dependent){
         switch (ri_whfast->coordinates){
             case REB_WHFAST_COORDINATES_JACOBI:
-                reb_transformations_jacobi_to_inertial_posvel(particles, ri_whfast->p_jh, particles, N_real, N_active);
+                reb_transformations_jacobi_to_inertial_posvel_soa(particles, ri_whfast->p_jh, particles, N_real, N_active);
                 break;
             case REB_WHFAST_COORDINATES_DEMOCRATICHELIOCENTRIC:
-                reb_transformations_democraticheliocentric_to_inertial_posvel(particles, ri_whfast->p_jh, N_real, N_active);
+                reb_transformations_democraticheliocentric_to_inertial_posvel_soa(particles, ri_whfast->p_jh, N_real, N_active);
                 break;
             case REB_WHFAST_COORDINATES_WHDS:
-                reb_transformations_whds_to_inertial_posvel(particles, ri_whfast->p_jh, N_real, N_active);
+                reb_transformations_whds_to_inertial_posvel_soa(particles, ri_whfast->p_jh, N_real, N_active);
                 break;
         };
     }else{
         switch (ri_whfast->coordinates){
             case REB_WHFAST_COORDINATES_JACOBI:
-                reb_transformations_jacobi_to_inertial_posvel(particles, ri_whfast->p_jh, particles, N_real, N_active);
+                reb_transformations_jacobi_to_inertial_posvel_soa(particles, ri_whfast->p_jh, particles, N_real, N_active);
                 break;
             case REB_WHFAST_COORDINATES_DEMOCRATICHELIOCENTRIC:
-                reb_transformations_democraticheliocentric_to_inertial_posvel(particles, ri_whfast->p_jh, N_real, N_active);
+                reb_transformations_democraticheliocentric_to_inertial_posvel_soa(particles, ri_whfast->p_jh, N_real, N_active);
                 break;
             case REB_WHFAST_COORDINATES_WHDS:
-                reb_transformations_whds_to_inertial_posvel(particles, ri_whfast->p_jh, N_real, N_active);
+                reb_transformations_whds_to_inertial_posvel_soa(particles, ri_whfast->p_jh, N_real, N_active);
                 break;
         };
     }
@@ -911,6 +1466,15 @@ void reb_integrator_whfast_part1(struct reb_simulation* const r){
         reb_integrator_whfast_from_inertial(r);
         ri_whfast->recalculate_coordinates_this_timestep = 0;
     }
+    const unsigned int N_fixed = reb_whfast_fixed_n(r);
+    if (N_fixed){
+        // Combined DRIFT, jump and transformation for small N
+        const struct reb_profiling_mark profiling_start = reb_profiling_start(r);
+        reb_whfast_fixed_n_drift_kernels[N_fixed](r, ri_whfast->is_synchronized?r->dt/2.:r->dt, 1, r->dt/2.);
+        reb_profiling_stop(r, REB_PROFILING_CAT_KEPLER, profiling_start);
+        r->t+=r->dt/2.;
+        return;
+    }
     if (ri_whfast->is_synchronized){
         // First half DRIFT step
         if (ri_whfast->corrector){
@@ -948,13 +1512,13 @@ void reb_integrator_whfast_part1(struct reb_simulation* const r){
     // If other coordinates are used, the code will raise an exception in part1 of the integrator.
     for (int v=0;v<r->var_config_N;v++){
         struct reb_variational_configuration const vc = r->var_config[v];
-        ri_whfast->p_jh[vc.index].x += r->dt/2.*ri_whfast->p_jh[vc.index].vx;
-        ri_whfast->p_jh[vc.index].y += r->dt/2.*ri_whfast->p_jh[vc.index].vy;
-        ri_whfast->p_jh[vc.index].z += r->dt/2.*ri_whfast->p_jh[vc.index].vz;
+        ri_whfast->p_jh.x[vc.index] += r->dt/2.*ri_whfast->p_jh.vx[vc.index];
+        ri_whfast->p_jh.y[vc.index] += r->dt/2.*ri_whfast->p_jh.vy[vc.index];
+        ri_whfast->p_jh.z[vc.index] += r->dt/2.*ri_whfast->p_jh.vz[vc.index];
         if (r->force_is_velocity_dependent){
-            reb_transformations_jacobi_to_inertial_posvel(particles+vc.index, ri_whfast->p_jh+vc.index, particles, N_real, N_active);
+            reb_transformations_jacobi_to_inertial_posvel_soa(particles+vc.index, reb_particle_soa_offset(ri_whfast->p_jh, vc.index), particles, N_real, N_active);
         }else{
-            reb_transformations_jacobi_to_inertial_pos(particles+vc.index, ri_whfast->p_jh+vc.index, particles, N_real, N_active);
+            reb_transformations_jacobi_to_inertial_pos_soa(particles+vc.index, reb_particle_soa_offset(ri_whfast->p_jh, vc.index), particles, N_real, N_active);
         }
     }
 
@@ -970,49 +1534,57 @@ void reb_integrator_whfast_synchronize(struct reb_simulation* const r){
     if (ri_whfast->is_synchronized == 0){
         const int N_real = r->N-r->N_var;
         const int N_active = (r->N_active==-1 || r->testparticle_type==1)?N_real:r->N_active;
-        struct reb_particle* sync_pj  = NULL;
+        double* sync_pj  = NULL;
         if (ri_whfast->keep_unsynchronized){
-            sync_pj = malloc(sizeof(struct reb_particle)*r->N);
-            memcpy(sync_pj,r->ri_whfast.p_jh,r->N*sizeof(struct reb_particle));
+            sync_pj = malloc(sizeof(double)*REB_PARTICLE_SOA_FIELDS*ri_whfast->allocated_N);
+            memcpy(sync_pj,ri_whfast->p_jh.x,sizeof(double)*REB_PARTICLE_SOA_FIELDS*ri_whfast->allocated_N);
         }
-        switch (ri_whfast->kernel){
-            case REB_WHFAST_KERNEL_DEFAULT: 
-            case REB_WHFAST_KERNEL_MODIFIEDKICK: 
-            case REB_WHFAST_KERNEL_LAZY: 
-                reb_whfast_kepler_step(r, r->dt/2.);    
-                reb_whfast_com_step(r, r->dt/2.);
-                break;
-            case REB_WHFAST_KERNEL_COMPOSITION:
-                reb_whfast_kepler_step(r, 3.*r->dt/8.);   
-                reb_whfast_com_step(r, 3.*r->dt/8.);
-                break;
-            default:
-                reb_error(r, "WHFast kernel not implemented.");
-                return;
-        };
-        if (ri_whfast->corrector2){
-            reb_whfast_apply_corrector2(r, -1.);
-        }
-        if (ri_whfast->corrector){
-            reb_whfast_apply_corrector(r, -1., ri_whfast->corrector);
-        }
-        switch (ri_whfast->coordinates){
-            case REB_WHFAST_COORDINATES_JACOBI:
-                reb_transformations_jacobi_to_inertial_posvel(r->particles, ri_whfast->p_jh, r->particles, N_real, N_active);
-                break;
-            case REB_WHFAST_COORDINATES_DEMOCRATICHELIOCENTRIC:
-                reb_transformations_democraticheliocentric_to_inertial_posvel(r->particles, ri_whfast->p_jh, N_real, N_active);
-                break;
-            case REB_WHFAST_COORDINATES_WHDS:
-                reb_transformations_whds_to_inertial_posvel(r->particles, ri_whfast->p_jh, N_real, N_active);
-                break;
-        };
-        for (int v=0;v<r->var_config_N;v++){
-            struct reb_variational_configuration const vc = r->var_config[v];
-            reb_transformations_jacobi_to_inertial_posvel(r->particles+vc.index, ri_whfast->p_jh+vc.index, r-> particles, N_real, N_active);
+        const unsigned int N_fixed = reb_whfast_fixed_n(r);
+        if (N_fixed){
+            // Combined DRIFT and transformation for small N
+            const struct reb_profiling_mark profiling_start = reb_profiling_start(r);
+            reb_whfast_fixed_n_drift_kernels[N_fixed](r, r->dt/2., 0, 0.);
+            reb_profiling_stop(r, REB_PROFILING_CAT_KEPLER, profiling_start);
+        }else{
+            switch (ri_whfast->kernel){
+                case REB_WHFAST_KERNEL_DEFAULT: 
+                case REB_WHFAST_KERNEL_MODIFIEDKICK: 
+                case REB_WHFAST_KERNEL_LAZY: 
+                    reb_whfast_kepler_step(r, r->dt/2.);    
+                    reb_whfast_com_step(r, r->dt/2.);
+                    break;
+                case REB_WHFAST_KERNEL_COMPOSITION:
+                    reb_whfast_kepler_step(r, 3.*r->dt/8.);   
+                    reb_whfast_com_step(r, 3.*r->dt/8.);
+                    break;
+                default:
+                    reb_error(r, "WHFast kernel not implemented.");
+                    return;
+            };
+            if (ri_whfast->corrector2){
+                reb_whfast_apply_corrector2(r, -1.);
+            }
+            if (ri_whfast->corrector){
+                reb_whfast_apply_corrector(r, -1., ri_whfast->corrector);
+            }
+            switch (ri_whfast->coordinates){
+                case REB_WHFAST_COORDINATES_JACOBI:
+                    reb_transformations_jacobi_to_inertial_posvel_soa(r->particles, ri_whfast->p_jh, r->particles, N_real, N_active);
+                    break;
+                case REB_WHFAST_COORDINATES_DEMOCRATICHELIOCENTRIC:
+                    reb_transformations_democraticheliocentric_to_inertial_posvel_soa(r->particles, ri_whfast->p_jh, N_real, N_active);
+                    break;
+                case REB_WHFAST_COORDINATES_WHDS:
+                    reb_transformations_whds_to_inertial_posvel_soa(r->particles, ri_whfast->p_jh, N_real, N_active);
+                    break;
+            };
+            for (int v=0;v<r->var_config_N;v++){
+                struct reb_variational_configuration const vc = r->var_config[v];
+                reb_transformations_jacobi_to_inertial_posvel_soa(r->particles+vc.index, reb_particle_soa_offset(ri_whfast->p_jh, vc.index), r-> particles, N_real, N_active);
+            }
         }
         if (ri_whfast->keep_unsynchronized){
-            memcpy(r->ri_whfast.p_jh,sync_pj,r->N*sizeof(struct reb_particle));
+            memcpy(ri_whfast->p_jh.x,sync_pj,sizeof(double)*REB_PARTICLE_SOA_FIELDS*ri_whfast->allocated_N);
             free(sync_pj);
         }else{
             ri_whfast->is_synchronized = 1;
@@ -1023,30 +1595,35 @@ void reb_integrator_whfast_synchronize(struct reb_simulation* const r){
 void reb_integrator_whfast_part2(struct reb_simulation* const r){
     struct reb_simulation_integrator_whfast* const ri_whfast = &(r->ri_whfast);
     struct reb_particle* restrict const particles = r->particles;
-    struct reb_particle* const p_j = ri_whfast->p_jh;
+    const struct reb_particle_soa p_j = ri_whfast->p_jh;
     const double dt = r->dt;
     const int N = r->N;
     const int N_real = r->N-r->N_var;
     const int N_active = (r->N_active==-1 || r->testparticle_type==1)?N_real:r->N_active;
-    if (p_j==NULL){
+    if (p_j.x==NULL){
         // Non recoverable error occured earlier. 
         // Skipping rest of integration to avoid segmentation fault.
         return;
     }
     
+    const unsigned int N_fixed = reb_whfast_fixed_n(r);
     switch (ri_whfast->kernel){
         case REB_WHFAST_KERNEL_DEFAULT: 
-            reb_whfast_interaction_step(r, dt);
-            reb_whfast_jump_step(r,dt/2.);
+            if (N_fixed){
+                reb_whfast_fixed_n_kick_kernels[N_fixed](r, dt, dt/2.);
+            }else{
+                reb_whfast_interaction_step(r, dt);
+                reb_whfast_jump_step(r,dt/2.);
+            }
             break;
         case REB_WHFAST_KERNEL_MODIFIEDKICK: 
             // p_jh used as a temporary buffer for "jerk"
             reb_whfast_calculate_jerk(r);
             for (int i=0; i<N; i++){
                 const double prefact = dt*dt/12.;
-                particles[i].ax += prefact*p_j[i].ax; 
-                particles[i].ay += prefact*p_j[i].ay; 
-                particles[i].az += prefact*p_j[i].az; 
+                particles[i].ax += prefact*p_j.ax[i]; 
+                particles[i].ay += prefact*p_j.ay[i]; 
+                particles[i].az += prefact*p_j.az[i]; 
             }
             reb_whfast_interaction_step(r, dt);
             break;
@@ -1056,28 +1633,28 @@ void reb_integrator_whfast_part2(struct reb_simulation* const r){
             reb_whfast_kepler_step(r, -dt/4.);   
             reb_whfast_com_step(r, -dt/4.);
             
-            reb_transformations_jacobi_to_inertial_pos(particles, p_j, particles, N, N_active);
+            reb_transformations_jacobi_to_inertial_pos_soa(particles, p_j, particles, N, N_active);
             reb_update_acceleration(r);
             reb_whfast_interaction_step(r, dt/6.);
             
             reb_whfast_kepler_step(r, dt/8.);   
             reb_whfast_com_step(r, dt/8.);
             
-            reb_transformations_jacobi_to_inertial_pos(particles, p_j, particles, N, N_active);
+            reb_transformations_jacobi_to_inertial_pos_soa(particles, p_j, particles, N, N_active);
             reb_update_acceleration(r);
             reb_whfast_interaction_step(r, dt);
             
             reb_whfast_kepler_step(r, -dt/8.);   
             reb_whfast_com_step(r, -dt/8.);
             
-            reb_transformations_jacobi_to_inertial_pos(particles, p_j, particles, N, N_active);
+            reb_transformations_jacobi_to_inertial_pos_soa(particles, p_j, particles, N, N_active);
             reb_update_acceleration(r);
             reb_whfast_interaction_step(r, -dt/6.);
             
             reb_whfast_kepler_step(r, dt/4.);   
             reb_whfast_com_step(r, dt/4.);
             
-            reb_transformations_jacobi_to_inertial_pos(particles, p_j, particles, N, N_active);
+            reb_transformations_jacobi_to_inertial_pos_soa(particles, p_j, particles, N, N_active);
             reb_update_acceleration(r);
             reb_whfast_interaction_step(r, dt/6.);
             break;
@@ -1086,35 +1663,40 @@ void reb_integrator_whfast_part2(struct reb_simulation* const r){
             // Need temporary array to store old positions
             if (ri_whfast->allocated_Ntemp != N){
                 ri_whfast->allocated_Ntemp = N;
-                ri_whfast->p_temp = realloc(ri_whfast->p_temp,sizeof(struct reb_particle)*N);
+                reb_particle_soa_realloc(&ri_whfast->p_temp, N);
             }
-            struct reb_particle* p_temp = ri_whfast->p_temp;
+            const struct reb_particle_soa p_temp = ri_whfast->p_temp;
 
             // Calculate normal kick
             // Accelertions were already calculated before part2 gets called
-            reb_transformations_inertial_to_jacobi_acc(r->particles, p_j, r->particles, N, N_active);
+            reb_transformations_inertial_to_jacobi_acc_soa(r->particles, p_j, r->particles, N, N_active);
 
             // make copy of original positions
-            memcpy(p_temp,p_j,r->N*sizeof(struct reb_particle));
+            memcpy(p_temp.x,p_j.x,N*sizeof(double));
+            memcpy(p_temp.y,p_j.y,N*sizeof(double));
+            memcpy(p_temp.z,p_j.z,N*sizeof(double));
+            memcpy(p_temp.ax,p_j.ax,N*sizeof(double));
+            memcpy(p_temp.ay,p_j.ay,N*sizeof(double));
+            memcpy(p_temp.az,p_j.az,N*sizeof(double));
 
             // WHT Eq 10.6
             for (unsigned int i=1;i<N;i++){
                 const double prefac1 = dt*dt/12.; 
-                p_j[i].x += prefac1 * p_temp[i].ax;
-                p_j[i].y += prefac1 * p_temp[i].ay;
-                p_j[i].z += prefac1 * p_temp[i].az;
+                p_j.x[i] += prefac1 * p_temp.ax[i];
+                p_j.y[i] += prefac1 * p_temp.ay[i];
+                p_j.z[i] += prefac1 * p_temp.az[i];
             }
            
             // recalculate kick 
-            reb_transformations_jacobi_to_inertial_pos(particles, p_j, particles, N, N_active);
+            reb_transformations_jacobi_to_inertial_pos_soa(particles, p_j, particles, N, N_active);
             reb_update_acceleration(r);
             reb_whfast_interaction_step(r, dt);
 
             for (unsigned int i=1;i<N;i++){
                 // reset positions
-                p_j[i].x = p_temp[i].x;
-                p_j[i].y = p_temp[i].y;
-                p_j[i].z = p_temp[i].z;
+                p_j.x[i] = p_temp.x[i];
+                p_j.y[i] = p_temp.y[i];
+                p_j.z[i] = p_temp.z[i];
             }
             }
             break;
@@ -1134,10 +1716,10 @@ void reb_integrator_whfast_part2(struct reb_simulation* const r){
     if (r->var_config_N){
         // Need to have x,v,a synchronized to calculate ddot/d for MEGNO. 
         const int N_real = r->N-r->N_var;
-        struct reb_particle* sync_pj  = NULL;
+        double* sync_pj  = NULL;
         if (ri_whfast->keep_unsynchronized){ // cache the p_j and set back at the end
-            sync_pj = malloc(sizeof(struct reb_particle)*r->N);
-            memcpy(sync_pj,p_j,r->N*sizeof(struct reb_particle));
+            sync_pj = malloc(sizeof(double)*REB_PARTICLE_SOA_FIELDS*ri_whfast->allocated_N);
+            memcpy(sync_pj,p_j.x,sizeof(double)*REB_PARTICLE_SOA_FIELDS*ri_whfast->allocated_N);
             ri_whfast->keep_unsynchronized=0; // synchronize will revert the p_j to midstep if keep_unsync=0. 
             reb_integrator_whfast_synchronize(r);
             ri_whfast->keep_unsynchronized=1; // Manually avoid synchronize reverting the p_j and do it ourselves when we're done
@@ -1152,10 +1734,10 @@ void reb_integrator_whfast_part2(struct reb_simulation* const r){
             struct reb_particle* const particles_var1 = particles + vc.index;
             const int index = vc.index;
             // Centre of mass
-            p_j[index].x += r->dt/2.*p_j[index].vx;
-            p_j[index].y += r->dt/2.*p_j[index].vy;
-            p_j[index].z += r->dt/2.*p_j[index].vz;
-            reb_transformations_jacobi_to_inertial_posvel(particles_var1, p_j+index, particles, N_real, N_active);
+            p_j.x[index] += r->dt/2.*p_j.vx[index];
+            p_j.y[index] += r->dt/2.*p_j.vy[index];
+            p_j.z[index] += r->dt/2.*p_j.vz[index];
+            reb_transformations_jacobi_to_inertial_posvel_soa(particles_var1, reb_particle_soa_offset(p_j, index), particles, N_real, N_active);
             if (r->calculate_megno){
                 reb_calculate_acceleration_var(r);
                 const double dx = particles[0].x - particles[1].x;
@@ -1198,7 +1780,7 @@ void reb_integrator_whfast_part2(struct reb_simulation* const r){
             reb_tools_megno_update(r, dY);
         }
         if (ri_whfast->keep_unsynchronized){
-            memcpy(p_j,sync_pj,r->N*sizeof(struct reb_particle));
+            memcpy(p_j.x,sync_pj,sizeof(double)*REB_PARTICLE_SOA_FIELDS*ri_whfast->allocated_N);
             free(sync_pj);
             ri_whfast->is_synchronized=0;
         }
@@ -1219,12 +1801,6 @@ void reb_integrator_whfast_reset(struct reb_simulation* const r){
     ri_whfast->allocated_Ntemp = 0;
     ri_whfast->timestep_warning = 0;
     ri_whfast->recalculate_coordinates_but_not_synchronized_warning = 0;
-    if (ri_whfast->p_jh){
-        free(ri_whfast->p_jh);
-        ri_whfast->p_jh = NULL;
-    }
-    if (ri_whfast->p_temp){
-        free(ri_whfast->p_temp);
-        ri_whfast->p_temp = NULL;
-    }
+    reb_particle_soa_free(&ri_whfast->p_jh);
+    reb_particle_soa_free(&ri_whfast->p_temp);
 }
@@ -27,10 +27,31 @@
 
 #include "rebound.h"
 
+#define WHFAST_BATCH 8    ///< Number of bodies in one batch of the Kepler solver
+#define WHFAST_FIXED_N_MAX 16    ///< Largest number of particles handled by the fixed-N kernels (democratic heliocentric coordinates)
+
+/**
+ * @brief Positions and velocities of up to WHFAST_BATCH bodies, stored as a structure of arrays.
+ */
+struct reb_whfast_lanes {
+    double* x;
+    double* y;
+    double* z;
+    double* vx;
+    double* vy;
+    double* vz;
+};
+
 void reb_integrator_whfast_part1(struct reb_simulation* r);		///< Internal function used to call a specific integrator
 void reb_integrator_whfast_part2(struct reb_simulation* r);		///< Internal function used to call a specific integrator
 void reb_integrator_whfast_synchronize(struct reb_simulation* r);	///< Internal function used to call a specific integrator
 void reb_whfast_kepler_solver(const struct reb_simulation* const r, struct reb_particle* const restrict p_j, const double M, unsigned int i, double _dt);   ///< Internal function (Main WHFast Kepler Solver)
+int reb_whfast_kepler_solver_particle(struct reb_particle* const restrict p, struct reb_particle* const* const dp, const int dp_N, const double M, const double _dt);   ///< Internal function (Kepler solver for one particle and dp_N variational particles)
+void reb_whfast_kepler_solver_lanes(const struct reb_whfast_lanes p, const struct reb_whfast_lanes dp, const double* const restrict M, const unsigned int Nb, const double _dt, int* const restrict fallback);   ///< Internal function (Kepler solver for up to WHFAST_BATCH bodies stored as a structure of arrays)
+void reb_whfast_kepler_solver_soa(const struct reb_simulation* const r, const struct reb_particle_soa p_j, const double M, unsigned int i, double _dt);   ///< Internal function (Same as reb_whfast_kepler_solver but for a structure of arrays)
+void reb_whfast_kepler_solver_batch(const struct reb_simulation* const r, struct reb_particle* const restrict p_j, const double* const restrict M, const unsigned int i0, const unsigned int Nb, const double _dt);   ///< Internal function (Kepler solver for up to WHFAST_BATCH particles at once)
+void reb_whfast_kepler_solver_batch_soa(const struct reb_simulation* const r, const struct reb_particle_soa p_j, const double* const restrict M, const unsigned int i0, const unsigned int Nb, const double _dt);   ///< Internal function (Same as reb_whfast_kepler_solver_batch but for a structure of arrays)
 void reb_whfast_calculate_jerk(struct reb_simulation* r);       ///< Calculates "jerk" term
+void reb_whfast_apply_corrector_sequence(void* const state, void (*Z)(void* const state, const double a, const double b), const double dt, const double inv, const int order);   ///< Internal function (Applies the symplectic corrector of a given order using the operator Z)
 
 #endif
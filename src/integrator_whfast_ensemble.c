@@ -0,0 +1,1012 @@
+/**
+ * @file    integrator_whfast_ensemble.c
+ * @brief   WHFast integration of an ensemble of independent systems.
+ * @details This file implements an ensemble version of the WHFast
+ * integrator. Many replicas of a small planetary system (same number
+ * of bodies, same timestep) are stored in one structure of arrays and
+ * advanced in lockstep. The innermost loops run over replicas which
+ * allows the compiler to vectorize them. Each replica follows exactly
+ * the same sequence of floating point operations as a reb_simulation
+ * using WHFast with Jacobi coordinates, the standard kernel and
+ * safe_mode=0. Symplectic correctors and MEGNO are supported.
+ *
+ * @section LICENSE
+ * This file is part of rebound.
+ *
+ * rebound is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * rebound is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rebound.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "rebound.h"
+#include "integrator_whfast.h"
+#include "integrator_whfast_ensemble.h"
+
+#define MIN(a, b) ((a) > (b) ? (b) : (a))   ///< Returns the minimum of a and b
+#define MAX(a, b) ((a) < (b) ? (b) : (a))   ///< Returns the maximum of a and b
+
+// Positions, velocities and accelerations. Element i*N_replicas+k belongs to particle i of replica k.
+struct reb_whfast_ensemble_soa {
+    double* x;
+    double* y;
+    double* z;
+    double* vx;
+    double* vy;
+    double* vz;
+    double* ax;
+    double* ay;
+    double* az;
+};
+
+struct reb_whfast_ensemble {
+    int N;                                  // Number of particles per replica
+    int N_replicas;                         // Number of replicas
+    int megno;                              // Set to 1 if variational particles and MEGNO are integrated
+    int corrector;                          // Order of the symplectic corrector (0 = off)
+    int is_synchronized;                    // Set to 1 if the Jacobi coordinates are synchronized
+    int recalculate_coordinates;            // Set to 1 if the Jacobi coordinates need to be recalculated from the inertial ones
+    int timestep_warning;                   // Number of times the timestep exceeded an orbital period
+    double t;                               // Current time (same for all replicas)
+    double dt;                              // Timestep
+    double G;                               // Gravitational constant
+    double softening;                       // Gravitational softening parameter
+    double exit_max_distance;               // Flag replicas with particles beyond this distance (0 = off)
+    double exit_min_distance;               // Flag replicas with particle pairs closer than this distance (0 = off)
+    double* data;                           // Single allocation holding all arrays of doubles below
+    int* data_int;                          // Single allocation holding all arrays of ints below
+    struct reb_whfast_ensemble_soa p;       // Inertial coordinates
+    struct reb_whfast_ensemble_soa p_j;     // Jacobi coordinates
+    struct reb_whfast_ensemble_soa dp;      // Variational particles, inertial coordinates
+    struct reb_whfast_ensemble_soa dp_j;    // Variational particles, Jacobi coordinates
+    double* m;                              // Masses
+    double* dm;                             // Masses of variational particles
+    double* mtot;                           // Total mass of each replica (mass of Jacobi particle 0)
+    double* E0;                             // Initial energy of each replica
+    double* t_exit;                         // Time at which a replica has been flagged
+    double* megno_Ys;                       // Running MEGNO sums, same as in reb_simulation
+    double* megno_Yss;
+    double* megno_cov_Yt;
+    double* megno_var_t;
+    double* megno_mean_t;
+    double* megno_mean_Y;
+    int* status;                            // Status of each replica (enum REB_WHFAST_ENSEMBLE_STATUS)
+    int* megno_n;
+};
+
+// Range of replicas k0...k1-1 processed by one thread.
+struct reb_whfast_ensemble_chunk {
+    struct reb_whfast_ensemble* e;
+    int k0;
+    int k1;
+    int warnings;   // Number of times the timestep exceeded an orbital period
+};
+
+/*****************************
+ * Coordinate transformations */
+
+static void reb_whfast_ensemble_inertial_to_jacobi_posvel(const struct reb_whfast_ensemble* const e, const struct reb_whfast_ensemble_soa p, const struct reb_whfast_ensemble_soa p_j, const int k0, const int k1){
+    const int N = e->N;
+    const int R = e->N_replicas;
+    const double* const m = e->m;
+    double eta[WHFAST_ENSEMBLE_CHUNK];
+    double s_x[WHFAST_ENSEMBLE_CHUNK], s_y[WHFAST_ENSEMBLE_CHUNK], s_z[WHFAST_ENSEMBLE_CHUNK];
+    double s_vx[WHFAST_ENSEMBLE_CHUNK], s_vy[WHFAST_ENSEMBLE_CHUNK], s_vz[WHFAST_ENSEMBLE_CHUNK];
+    for (int k=k0;k<k1;k++){
+        const int l = k-k0;
+        eta[l] = m[k];
+        s_x[l] = eta[l] * p.x[k];
+        s_y[l] = eta[l] * p.y[k];
+        s_z[l] = eta[l] * p.z[k];
+        s_vx[l] = eta[l] * p.vx[k];
+        s_vy[l] = eta[l] * p.vy[k];
+        s_vz[l] = eta[l] * p.vz[k];
+    }
+    for (int i=1;i<N;i++){
+        for (int k=k0;k<k1;k++){
+            const int l = k-k0;
+            const int ik = i*R+k;
+            const double ei = 1./eta[l];
+            eta[l] += m[ik];
+            const double pme = eta[l]*ei;
+            p_j.x[ik] = p.x[ik] - s_x[l]*ei;
+            p_j.y[ik] = p.y[ik] - s_y[l]*ei;
+            p_j.z[ik] = p.z[ik] - s_z[l]*ei;
+            p_j.vx[ik] = p.vx[ik] - s_vx[l]*ei;
+            p_j.vy[ik] = p.vy[ik] - s_vy[l]*ei;
+            p_j.vz[ik] = p.vz[ik] - s_vz[l]*ei;
+            s_x[l]  = s_x[l]  * pme + m[ik]*p_j.x[ik] ;
+            s_y[l]  = s_y[l]  * pme + m[ik]*p_j.y[ik] ;
+            s_z[l]  = s_z[l]  * pme + m[ik]*p_j.z[ik] ;
+            s_vx[l] = s_vx[l] * pme + m[ik]*p_j.vx[ik];
+            s_vy[l] = s_vy[l] * pme + m[ik]*p_j.vy[ik];
+            s_vz[l] = s_vz[l] * pme + m[ik]*p_j.vz[ik];
+        }
+    }
+    for (int k=k0;k<k1;k++){
+        const int l = k-k0;
+        const double Mtotali = 1./eta[l];
+        e->mtot[k] = eta[l];
+        p_j.x[k] = s_x[l] * Mtotali;
+        p_j.y[k] = s_y[l] * Mtotali;
+        p_j.z[k] = s_z[l] * Mtotali;
+        p_j.vx[k] = s_vx[l] * Mtotali;
+        p_j.vy[k] = s_vy[l] * Mtotali;
+        p_j.vz[k] = s_vz[l] * Mtotali;
+    }
+}
+
+static void reb_whfast_ensemble_inertial_to_jacobi_acc(const struct reb_whfast_ensemble* const e, const struct reb_whfast_ensemble_soa p, const struct reb_whfast_ensemble_soa p_j, const int k0, const int k1){
+    // The acceleration of Jacobi particle 0 is not needed and therefore not calculated.
+    const int N = e->N;
+    const int R = e->N_replicas;
+    const double* const m = e->m;
+    double eta[WHFAST_ENSEMBLE_CHUNK];
+    double s_ax[WHFAST_ENSEMBLE_CHUNK], s_ay[WHFAST_ENSEMBLE_CHUNK], s_az[WHFAST_ENSEMBLE_CHUNK];
+    for (int k=k0;k<k1;k++){
+        const int l = k-k0;
+        eta[l] = m[k];
+        s_ax[l] = eta[l] * p.ax[k];
+        s_ay[l] = eta[l] * p.ay[k];
+        s_az[l] = eta[l] * p.az[k];
+    }
+    for (int i=1;i<N;i++){
+        for (int k=k0;k<k1;k++){
+            const int l = k-k0;
+            const int ik = i*R+k;
+            const double ei = 1./eta[l];
+            eta[l] += m[ik];
+            const double pme = eta[l]*ei;
+            p_j.ax[ik] = p.ax[ik] - s_ax[l]*ei;
+            p_j.ay[ik] = p.ay[ik] - s_ay[l]*ei;
+            p_j.az[ik] = p.az[ik] - s_az[l]*ei;
+            s_ax[l] = s_ax[l] * pme + m[ik]*p_j.ax[ik];
+            s_ay[l] = s_ay[l] * pme + m[ik]*p_j.ay[ik];
+            s_az[l] = s_az[l] * pme + m[ik]*p_j.az[ik];
+        }
+    }
+}
+
+static void reb_whfast_ensemble_jacobi_to_inertial(const struct reb_whfast_ensemble* const e, const struct reb_whfast_ensemble_soa p, const struct reb_whfast_ensemble_soa p_j, const int velocities, const int k0, const int k1){
+    // Converts positions and, if velocities is 1, velocities.
+    const int N = e->N;
+    const int R = e->N_replicas;
+    const double* const m = e->m;
+    double eta[WHFAST_ENSEMBLE_CHUNK];
+    double s_x[WHFAST_ENSEMBLE_CHUNK], s_y[WHFAST_ENSEMBLE_CHUNK], s_z[WHFAST_ENSEMBLE_CHUNK];
+    double s_vx[WHFAST_ENSEMBLE_CHUNK], s_vy[WHFAST_ENSEMBLE_CHUNK], s_vz[WHFAST_ENSEMBLE_CHUNK];
+    for (int k=k0;k<k1;k++){
+        const int l = k-k0;
+        eta[l] = e->mtot[k];
+        s_x[l] = p_j.x[k] * eta[l];
+        s_y[l] = p_j.y[k] * eta[l];
+        s_z[l] = p_j.z[k] * eta[l];
+    }
+    if (velocities){
+        for (int k=k0;k<k1;k++){
+            const int l = k-k0;
+            s_vx[l] = p_j.vx[k] * eta[l];
+            s_vy[l] = p_j.vy[k] * eta[l];
+            s_vz[l] = p_j.vz[k] * eta[l];
+        }
+    }
+    for (int i=N-1;i>0;i--){
+        for (int k=k0;k<k1;k++){
+            const int l = k-k0;
+            const int ik = i*R+k;
+            const double ei = 1./eta[l];
+            s_x[l]  = (s_x[l]  - m[ik] * p_j.x[ik] ) * ei;
+            s_y[l]  = (s_y[l]  - m[ik] * p_j.y[ik] ) * ei;
+            s_z[l]  = (s_z[l]  - m[ik] * p_j.z[ik] ) * ei;
+            p.x[ik]  = p_j.x[ik]  + s_x[l] ;
+            p.y[ik]  = p_j.y[ik]  + s_y[l] ;
+            p.z[ik]  = p_j.z[ik]  + s_z[l] ;
+            if (velocities){
+                s_vx[l] = (s_vx[l] - m[ik] * p_j.vx[ik]) * ei;
+                s_vy[l] = (s_vy[l] - m[ik] * p_j.vy[ik]) * ei;
+                s_vz[l] = (s_vz[l] - m[ik] * p_j.vz[ik]) * ei;
+                p.vx[ik] = p_j.vx[ik] + s_vx[l];
+                p.vy[ik] = p_j.vy[ik] + s_vy[l];
+                p.vz[ik] = p_j.vz[ik] + s_vz[l];
+            }
+            eta[l] -= m[ik];
+            s_x[l]  *= eta[l];
+            s_y[l]  *= eta[l];
+            s_z[l]  *= eta[l];
+            if (velocities){
+                s_vx[l] *= eta[l];
+                s_vy[l] *= eta[l];
+                s_vz[l] *= eta[l];
+            }
+        }
+    }
+    for (int k=k0;k<k1;k++){
+        const int l = k-k0;
+        const double mi = 1./eta[l];
+        p.x[k]  = s_x[l]  * mi;
+        p.y[k]  = s_y[l]  * mi;
+        p.z[k]  = s_z[l]  * mi;
+        if (velocities){
+            p.vx[k] = s_vx[l] * mi;
+            p.vy[k] = s_vy[l] * mi;
+            p.vz[k] = s_vz[l] * mi;
+        }
+    }
+}
+
+static void reb_whfast_ensemble_from_inertial(struct reb_whfast_ensemble* const e, const int k0, const int k1){
+    reb_whfast_ensemble_inertial_to_jacobi_posvel(e, e->p, e->p_j, k0, k1);
+    if (e->megno){
+        reb_whfast_ensemble_inertial_to_jacobi_posvel(e, e->dp, e->dp_j, k0, k1);
+    }
+}
+
+static void reb_whfast_ensemble_to_inertial_pos(struct reb_whfast_ensemble* const e, const int k0, const int k1){
+    reb_whfast_ensemble_jacobi_to_inertial(e, e->p, e->p_j, 0, k0, k1);
+    if (e->megno){
+        reb_whfast_ensemble_jacobi_to_inertial(e, e->dp, e->dp_j, 0, k0, k1);
+    }
+}
+
+/*****************************
+ * Gravity                    */
+
+static void reb_whfast_ensemble_gravity(struct reb_whfast_ensemble* const e, const int k0, const int k1){
+    // Same as REB_GRAVITY_BASIC with gravity_ignore_terms=1.
+    const int N = e->N;
+    const int R = e->N_replicas;
+    const double G = e->G;
+    const double softening2 = e->softening*e->softening;
+    const double* const m = e->m;
+    const struct reb_whfast_ensemble_soa p = e->p;
+    for (int i=0;i<N;i++){
+        for (int k=k0;k<k1;k++){
+            p.ax[i*R+k] = 0.;
+            p.ay[i*R+k] = 0.;
+            p.az[i*R+k] = 0.;
+        }
+    }
+    for (int i=2;i<N;i++){
+    for (int j=0;j<i;j++){
+        for (int k=k0;k<k1;k++){
+            const int ik = i*R+k;
+            const int jk = j*R+k;
+            const double dx = p.x[ik] - p.x[jk];
+            const double dy = p.y[ik] - p.y[jk];
+            const double dz = p.z[ik] - p.z[jk];
+            const double _r = sqrt(dx*dx + dy*dy + dz*dz + softening2);
+            const double prefact = G/(_r*_r*_r);
+            const double prefactj = -prefact*m[jk];
+            const double prefacti = prefact*m[ik];
+            p.ax[ik] += prefactj*dx;
+            p.ay[ik] += prefactj*dy;
+            p.az[ik] += prefactj*dz;
+            p.ax[jk] += prefacti*dx;
+            p.ay[jk] += prefacti*dy;
+            p.az[jk] += prefacti*dz;
+        }
+    }
+    }
+}
+
+static void reb_whfast_ensemble_gravity_var(struct reb_whfast_ensemble* const e, const int k0, const int k1){
+    // Same as the first order variational equations for REB_GRAVITY_BASIC with gravity_ignore_terms=1.
+    const int N = e->N;
+    const int R = e->N_replicas;
+    const double G = e->G;
+    const double* const m = e->m;
+    const double* const dm = e->dm;
+    const struct reb_whfast_ensemble_soa p = e->p;
+    const struct reb_whfast_ensemble_soa dp = e->dp;
+    for (int i=0;i<N;i++){
+        for (int k=k0;k<k1;k++){
+            dp.ax[i*R+k] = 0.;
+            dp.ay[i*R+k] = 0.;
+            dp.az[i*R+k] = 0.;
+        }
+    }
+    for (int i=2;i<N;i++){
+    for (int j=0;j<i;j++){
+        for (int k=k0;k<k1;k++){
+            const int ik = i*R+k;
+            const int jk = j*R+k;
+            const double dx = p.x[ik] - p.x[jk];
+            const double dy = p.y[ik] - p.y[jk];
+            const double dz = p.z[ik] - p.z[jk];
+            const double r2 = dx*dx + dy*dy + dz*dz;
+            const double _r  = sqrt(r2);
+            const double r3inv = 1./(r2*_r);
+            const double r5inv = 3.*r3inv/r2;
+            const double ddx = dp.x[ik] - dp.x[jk];
+            const double ddy = dp.y[ik] - dp.y[jk];
+            const double ddz = dp.z[ik] - dp.z[jk];
+            const double Gmi = G * m[ik];
+            const double Gmj = G * m[jk];
+
+            // Variational equations
+            const double dxdx = dx*dx*r5inv - r3inv;
+            const double dydy = dy*dy*r5inv - r3inv;
+            const double dzdz = dz*dz*r5inv - r3inv;
+            const double dxdy = dx*dy*r5inv;
+            const double dxdz = dx*dz*r5inv;
+            const double dydz = dy*dz*r5inv;
+            const double dax =   ddx * dxdx + ddy * dxdy + ddz * dxdz;
+            const double day =   ddx * dxdy + ddy * dydy + ddz * dydz;
+            const double daz =   ddx * dxdz + ddy * dydz + ddz * dzdz;
+
+            // Variational mass contributions
+            const double dGmi = G*dm[ik];
+            const double dGmj = G*dm[jk];
+
+            dp.ax[ik] += Gmj * dax - dGmj*r3inv*dx;
+            dp.ay[ik] += Gmj * day - dGmj*r3inv*dy;
+            dp.az[ik] += Gmj * daz - dGmj*r3inv*dz;
+
+            dp.ax[jk] -= Gmi * dax - dGmi*r3inv*dx;
+            dp.ay[jk] -= Gmi * day - dGmi*r3inv*dy;
+            dp.az[jk] -= Gmi * daz - dGmi*r3inv*dz;
+        }
+    }
+    }
+}
+
+static void reb_whfast_ensemble_update_acceleration(struct reb_whfast_ensemble* const e, const int k0, const int k1){
+    reb_whfast_ensemble_gravity(e, k0, k1);
+    if (e->megno){
+        reb_whfast_ensemble_gravity_var(e, k0, k1);
+    }
+}
+
+/*****************************
+ * Operators                  */
+
+static int reb_whfast_ensemble_kepler_step(struct reb_whfast_ensemble* const e, const double _dt, const int k0, const int k1){
+    // Returns the number of times the timestep exceeded an orbital period.
+    const int N = e->N;
+    const int R = e->N_replicas;
+    const double G = e->G;
+    const double* const m = e->m;
+    const struct reb_whfast_ensemble_soa p_j = e->p_j;
+    const struct reb_whfast_ensemble_soa dp_j = e->dp_j;
+    int warnings = 0;
+    double eta[WHFAST_ENSEMBLE_CHUNK];
+    for (int k=k0;k<k1;k++){
+        eta[k-k0] = m[k];
+    }
+    for (int i=1;i<N;i++){
+        double M[WHFAST_ENSEMBLE_CHUNK];
+        for (int k=k0;k<k1;k++){
+            eta[k-k0] += m[i*R+k];
+            M[k-k0] = eta[k-k0]*G;
+        }
+        for (int b0=k0;b0<k1;b0+=WHFAST_BATCH){
+            const unsigned int Nb = MIN(WHFAST_BATCH, k1-b0);
+            const int ik = i*R+b0;
+            const struct reb_whfast_lanes lanes = {.x=p_j.x+ik, .y=p_j.y+ik, .z=p_j.z+ik, .vx=p_j.vx+ik, .vy=p_j.vy+ik, .vz=p_j.vz+ik};
+            struct reb_whfast_lanes dlanes = {0};
+            if (e->megno){
+                dlanes = (struct reb_whfast_lanes){.x=dp_j.x+ik, .y=dp_j.y+ik, .z=dp_j.z+ik, .vx=dp_j.vx+ik, .vy=dp_j.vy+ik, .vz=dp_j.vz+ik};
+            }
+            int fallback[WHFAST_BATCH];
+            reb_whfast_kepler_solver_lanes(lanes, dlanes, M+(b0-k0), Nb, _dt, fallback);
+            for (unsigned int l=0;l<Nb;l++){
+                if (!fallback[l]) continue;
+                struct reb_particle p1 = {.x=lanes.x[l], .y=lanes.y[l], .z=lanes.z[l], .vx=lanes.vx[l], .vy=lanes.vy[l], .vz=lanes.vz[l]};
+                struct reb_particle dp1 = {0};
+                struct reb_particle* dp1_ptr = &dp1;
+                if (e->megno){
+                    dp1 = (struct reb_particle){.x=dlanes.x[l], .y=dlanes.y[l], .z=dlanes.z[l], .vx=dlanes.vx[l], .vy=dlanes.vy[l], .vz=dlanes.vz[l]};
+                }
+                warnings += reb_whfast_kepler_solver_particle(&p1, &dp1_ptr, e->megno, M[b0-k0+l], _dt);
+                lanes.x[l] = p1.x; lanes.y[l] = p1.y; lanes.z[l] = p1.z;
+                lanes.vx[l] = p1.vx; lanes.vy[l] = p1.vy; lanes.vz[l] = p1.vz;
+                if (e->megno){
+                    dlanes.x[l] = dp1.x; dlanes.y[l] = dp1.y; dlanes.z[l] = dp1.z;
+                    dlanes.vx[l] = dp1.vx; dlanes.vy[l] = dp1.vy; dlanes.vz[l] = dp1.vz;
+                }
+            }
+        }
+    }
+    return warnings;
+}
+
+static void reb_whfast_ensemble_com_step(struct reb_whfast_ensemble* const e, const double _dt, const int k0, const int k1){
+    const struct reb_whfast_ensemble_soa p_j = e->p_j;
+    for (int k=k0;k<k1;k++){
+        p_j.x[k] += _dt*p_j.vx[k];
+        p_j.y[k] += _dt*p_j.vy[k];
+        p_j.z[k] += _dt*p_j.vz[k];
+    }
+}
+
+static void reb_whfast_ensemble_var_com_step(struct reb_whfast_ensemble* const e, const double _dt, const int k0, const int k1){
+    const struct reb_whfast_ensemble_soa dp_j = e->dp_j;
+    for (int k=k0;k<k1;k++){
+        dp_j.x[k] += _dt*dp_j.vx[k];
+        dp_j.y[k] += _dt*dp_j.vy[k];
+        dp_j.z[k] += _dt*dp_j.vz[k];
+    }
+}
+
+static void reb_whfast_ensemble_interaction_step(struct reb_whfast_ensemble* const e, const double _dt, const int k0, const int k1){
+    const int N = e->N;
+    const int R = e->N_replicas;
+    const double G = e->G;
+    const double softening = e->softening;
+    const double* const m = e->m;
+    const struct reb_whfast_ensemble_soa p_j = e->p_j;
+    const struct reb_whfast_ensemble_soa dp_j = e->dp_j;
+    if (e->megno){
+        reb_whfast_ensemble_inertial_to_jacobi_acc(e, e->dp, dp_j, k0, k1);
+    }
+    reb_whfast_ensemble_inertial_to_jacobi_acc(e, e->p, p_j, k0, k1);
+    double eta[WHFAST_ENSEMBLE_CHUNK];
+    for (int k=k0;k<k1;k++){
+        eta[k-k0] = m[k];
+    }
+    for (int i=1;i<N;i++){
+        // Eq 132
+        for (int k=k0;k<k1;k++){
+            const int ik = i*R+k;
+            eta[k-k0] += m[ik];
+            p_j.vx[ik] += _dt * p_j.ax[ik];
+            p_j.vy[ik] += _dt * p_j.ay[ik];
+            p_j.vz[ik] += _dt * p_j.az[ik];
+            if (i>1){
+                const double pjx = p_j.x[ik];
+                const double pjy = p_j.y[ik];
+                const double pjz = p_j.z[ik];
+                const double rj2i = 1./(pjx*pjx + pjy*pjy + pjz*pjz + softening*softening);
+                const double rji  = sqrt(rj2i);
+                const double rj3iM = rji*rj2i*G*eta[k-k0];
+                const double prefac1 = _dt*rj3iM;
+                p_j.vx[ik] += prefac1*pjx;
+                p_j.vy[ik] += prefac1*pjy;
+                p_j.vz[ik] += prefac1*pjz;
+                if (e->megno){
+                    double rj5M = rj3iM*rj2i;
+                    double rdr = dp_j.x[ik]*pjx + dp_j.y[ik]*pjy + dp_j.z[ik]*pjz;
+                    double prefac2 = -_dt*3.*rdr*rj5M;
+                    dp_j.vx[ik] += prefac1*dp_j.x[ik] + prefac2*pjx;
+                    dp_j.vy[ik] += prefac1*dp_j.y[ik] + prefac2*pjy;
+                    dp_j.vz[ik] += prefac1*dp_j.z[ik] + prefac2*pjz;
+                }
+            }
+            if (e->megno){
+                dp_j.vx[ik] += _dt * dp_j.ax[ik];
+                dp_j.vy[ik] += _dt * dp_j.ay[ik];
+                dp_j.vz[ik] += _dt * dp_j.az[ik];
+            }
+        }
+    }
+}
+
+static void reb_whfast_ensemble_corrector_Z(void* const state, const double a, const double b){
+    struct reb_whfast_ensemble_chunk* const c = state;
+    struct reb_whfast_ensemble* const e = c->e;
+    c->warnings += reb_whfast_ensemble_kepler_step(e, a, c->k0, c->k1);
+    reb_whfast_ensemble_to_inertial_pos(e, c->k0, c->k1);
+    reb_whfast_ensemble_update_acceleration(e, c->k0, c->k1);
+    reb_whfast_ensemble_interaction_step(e, -b, c->k0, c->k1);
+    c->warnings += reb_whfast_ensemble_kepler_step(e, -2.*a, c->k0, c->k1);
+    reb_whfast_ensemble_to_inertial_pos(e, c->k0, c->k1);
+    reb_whfast_ensemble_update_acceleration(e, c->k0, c->k1);
+    reb_whfast_ensemble_interaction_step(e, b, c->k0, c->k1);
+    c->warnings += reb_whfast_ensemble_kepler_step(e, a, c->k0, c->k1);
+}
+
+static void reb_whfast_ensemble_synchronize_chunk(struct reb_whfast_ensemble_chunk* const c, int* const is_synchronized){
+    struct reb_whfast_ensemble* const e = c->e;
+    if (*is_synchronized == 0){
+        c->warnings += reb_whfast_ensemble_kepler_step(e, e->dt/2., c->k0, c->k1);
+        reb_whfast_ensemble_com_step(e, e->dt/2., c->k0, c->k1);
+        if (e->corrector){
+            reb_whfast_apply_corrector_sequence(c, reb_whfast_ensemble_corrector_Z, e->dt, -1., e->corrector);
+        }
+        reb_whfast_ensemble_jacobi_to_inertial(e, e->p, e->p_j, 1, c->k0, c->k1);
+        if (e->megno){
+            reb_whfast_ensemble_jacobi_to_inertial(e, e->dp, e->dp_j, 1, c->k0, c->k1);
+        }
+        *is_synchronized = 1;
+    }
+}
+
+/*****************************
+ * MEGNO                      */
+
+static void reb_whfast_ensemble_megno_update(struct reb_whfast_ensemble* const e, const double t, const int k0, const int k1){
+    // Requires synchronized positions, velocities and accelerations.
+    // Same as the MEGNO update in reb_integrator_whfast_part2.
+    const int N = e->N;
+    const int R = e->N_replicas;
+    const double dt = e->dt;
+    const double G = e->G;
+    const struct reb_whfast_ensemble_soa p = e->p;
+    const struct reb_whfast_ensemble_soa dp = e->dp;
+    reb_whfast_ensemble_gravity_var(e, k0, k1);
+    // Add the interaction between particles 0 and 1 which is part of the Kepler step
+    for (int k=k0;k<k1;k++){
+        const double dx = p.x[k] - p.x[R+k];
+        const double dy = p.y[k] - p.y[R+k];
+        const double dz = p.z[k] - p.z[R+k];
+        const double r2 = dx*dx + dy*dy + dz*dz + e->softening*e->softening;
+        const double _r  = sqrt(r2);
+        const double r3inv = 1./(r2*_r);
+        const double r5inv = 3.*r3inv/r2;
+        const double ddx = dp.x[k] - dp.x[R+k];
+        const double ddy = dp.y[k] - dp.y[R+k];
+        const double ddz = dp.z[k] - dp.z[R+k];
+        const double Gmi = G * e->m[k];
+        const double Gmj = G * e->m[R+k];
+        const double dax =   ddx * ( dx*dx*r5inv - r3inv )
+                   + ddy * ( dx*dy*r5inv )
+                   + ddz * ( dx*dz*r5inv );
+        const double day =   ddx * ( dy*dx*r5inv )
+                   + ddy * ( dy*dy*r5inv - r3inv )
+                   + ddz * ( dy*dz*r5inv );
+        const double daz =   ddx * ( dz*dx*r5inv )
+                   + ddy * ( dz*dy*r5inv )
+                   + ddz * ( dz*dz*r5inv - r3inv );
+        dp.ax[k] += Gmj * dax;
+        dp.ay[k] += Gmj * day;
+        dp.az[k] += Gmj * daz;
+        dp.ax[R+k] -= Gmi * dax;
+        dp.ay[R+k] -= Gmi * day;
+        dp.az[R+k] -= Gmi * daz;
+    }
+    double deltad[WHFAST_ENSEMBLE_CHUNK] = {0.};
+    double delta2[WHFAST_ENSEMBLE_CHUNK] = {0.};
+    for (int i=0;i<N;i++){
+        for (int k=k0;k<k1;k++){
+            const int l = k-k0;
+            const int ik = i*R+k;
+            deltad[l] += dp.vx[ik] * dp.x[ik]; 
+            deltad[l] += dp.vy[ik] * dp.y[ik]; 
+            deltad[l] += dp.vz[ik] * dp.z[ik]; 
+            deltad[l] += dp.ax[ik] * dp.vx[ik]; 
+            deltad[l] += dp.ay[ik] * dp.vy[ik]; 
+            deltad[l] += dp.az[ik] * dp.vz[ik]; 
+            delta2[l] += dp.x[ik]  * dp.x[ik]; 
+            delta2[l] += dp.y[ik]  * dp.y[ik];
+            delta2[l] += dp.z[ik]  * dp.z[ik];
+            delta2[l] += dp.vx[ik] * dp.vx[ik]; 
+            delta2[l] += dp.vy[ik] * dp.vy[ik];
+            delta2[l] += dp.vz[ik] * dp.vz[ik];
+        }
+    }
+    for (int k=k0;k<k1;k++){
+        if (e->status[k]){
+            continue; // MEGNO is frozen once a replica has been flagged
+        }
+        const int l = k-k0;
+        const double dY = dt * 2. * t * (deltad[l]/delta2[l]);
+        // Same as reb_tools_megno_update
+        e->megno_Ys[k] += dY;
+        const double Y = e->megno_Ys[k]/t;
+        e->megno_Yss[k] += Y * dt;
+        e->megno_n[k]++;
+        const double n = (double)e->megno_n[k];
+        const double _d_t = t - e->megno_mean_t[k];
+        e->megno_mean_t[k] += _d_t/n;
+        const double megno = (t==0.)?0.:e->megno_Yss[k]/t;
+        const double _d_Y = megno - e->megno_mean_Y[k];
+        e->megno_mean_Y[k] += _d_Y/n;
+        e->megno_cov_Yt[k] += (n-1.)/n 
+                        *(t-e->megno_mean_t[k])
+                        *(megno-e->megno_mean_Y[k]);
+        e->megno_var_t[k]  += (n-1.)/n 
+                        *(t-e->megno_mean_t[k])
+                        *(t-e->megno_mean_t[k]);
+    }
+}
+
+static void reb_whfast_ensemble_var_rescale(struct reb_whfast_ensemble* const e, const int k0, const int k1){
+    // Same as reb_var_rescale. Rescales variational particles of replicas whose
+    // coordinates approach floating point limits (>1e100).
+    const int N = e->N;
+    const int R = e->N_replicas;
+    const struct reb_whfast_ensemble_soa dp = e->dp;
+    for (int k=k0;k<k1;k++){
+        double scale = 0;
+        for (int i=0;i<N;i++){
+            const int ik = i*R+k;
+            scale = MAX(fabs(dp.x[ik]), scale);
+            scale = MAX(fabs(dp.y[ik]), scale);
+            scale = MAX(fabs(dp.z[ik]), scale);
+            scale = MAX(fabs(dp.vx[ik]), scale);
+            scale = MAX(fabs(dp.vy[ik]), scale);
+            scale = MAX(fabs(dp.vz[ik]), scale);
+        }
+        if (scale > 1e100){
+            for (int i=0;i<N;i++){
+                const int ik = i*R+k;
+                dp.x[ik] /= scale;
+                dp.y[ik] /= scale;
+                dp.z[ik] /= scale;
+                dp.vx[ik] /= scale;
+                dp.vy[ik] /= scale;
+                dp.vz[ik] /= scale;
+            }
+            reb_whfast_ensemble_from_inertial(e, k, k+1);
+        }
+    }
+}
+
+/*****************************
+ * Exit conditions            */
+
+static void reb_whfast_ensemble_check_exit(struct reb_whfast_ensemble* const e, const double t, const int k0, const int k1){
+    const int N = e->N;
+    const int R = e->N_replicas;
+    const struct reb_whfast_ensemble_soa p = e->p;
+    const double max2 = e->exit_max_distance * e->exit_max_distance;
+    const double min2 = e->exit_min_distance * e->exit_min_distance;
+    for (int k=k0;k<k1;k++){
+        if (e->status[k]){
+            continue;
+        }
+        int status = REB_WHFAST_ENSEMBLE_RUNNING;
+        for (int i=0;i<N;i++){
+            const int ik = i*R+k;
+            if (!isfinite(p.x[ik]) || !isfinite(p.y[ik]) || !isfinite(p.z[ik]) || !isfinite(p.vx[ik]) || !isfinite(p.vy[ik]) || !isfinite(p.vz[ik])){
+                status = REB_WHFAST_ENSEMBLE_NAN;
+                break;
+            }
+            if (e->exit_max_distance){
+                const double r2 = p.x[ik]*p.x[ik] + p.y[ik]*p.y[ik] + p.z[ik]*p.z[ik];
+                if (r2>max2){
+                    status = REB_WHFAST_ENSEMBLE_ESCAPE;
+                }
+            }
+            if (e->exit_min_distance){
+                for (int j=0;j<i;j++){
+                    const int jk = j*R+k;
+                    const double x = p.x[ik]-p.x[jk];
+                    const double y = p.y[ik]-p.y[jk];
+                    const double z = p.z[ik]-p.z[jk];
+                    const double r2 = x*x + y*y + z*z;
+                    if (r2<min2){
+                        status = REB_WHFAST_ENSEMBLE_ENCOUNTER;
+                    }
+                }
+            }
+        }
+        if (status){
+            e->status[k] = status;
+            e->t_exit[k] = t;
+        }
+    }
+}
+
+/*****************************
+ * Main integration loop      */
+
+static void reb_whfast_ensemble_integrate_chunk(struct reb_whfast_ensemble_chunk* const c, const long N_steps){
+    // Same sequence of operations as reb_integrator_whfast_part1, reb_calculate_acceleration 
+    // and reb_integrator_whfast_part2 with safe_mode=0, followed by a synchronization. 
+    struct reb_whfast_ensemble* const e = c->e;
+    const double dt = e->dt;
+    const int k0 = c->k0;
+    const int k1 = c->k1;
+    int is_synchronized = e->is_synchronized;
+    double t = e->t;
+    if (e->recalculate_coordinates){
+        reb_whfast_ensemble_from_inertial(e, k0, k1);
+    }
+    for (long n=0;n<N_steps;n++){
+        if (is_synchronized){
+            // First half DRIFT step
+            if (e->corrector){
+                reb_whfast_apply_corrector_sequence(c, reb_whfast_ensemble_corrector_Z, dt, 1., e->corrector);
+            }
+            c->warnings += reb_whfast_ensemble_kepler_step(e, dt/2., k0, k1);
+            reb_whfast_ensemble_com_step(e, dt/2., k0, k1);
+        }else{
+            // Combined DRIFT step
+            c->warnings += reb_whfast_ensemble_kepler_step(e, dt, k0, k1);
+            reb_whfast_ensemble_com_step(e, dt, k0, k1);
+        }
+        reb_whfast_ensemble_jacobi_to_inertial(e, e->p, e->p_j, 1, k0, k1);
+        if (e->megno){
+            reb_whfast_ensemble_var_com_step(e, dt/2., k0, k1);
+            reb_whfast_ensemble_jacobi_to_inertial(e, e->dp, e->dp_j, 0, k0, k1);
+        }
+        t += dt/2.;
+
+        reb_whfast_ensemble_update_acceleration(e, k0, k1);
+
+        // KICK step
+        reb_whfast_ensemble_interaction_step(e, dt, k0, k1);
+        is_synchronized = 0;
+        t += dt/2.;
+
+        if (e->megno){
+            // Need to have x,v,a synchronized to calculate ddot/d for MEGNO. 
+            reb_whfast_ensemble_synchronize_chunk(c, &is_synchronized);
+            reb_whfast_ensemble_var_com_step(e, dt/2., k0, k1);
+            reb_whfast_ensemble_jacobi_to_inertial(e, e->dp, e->dp_j, 1, k0, k1);
+            reb_whfast_ensemble_megno_update(e, t, k0, k1);
+            reb_whfast_ensemble_var_rescale(e, k0, k1);
+        }
+        reb_whfast_ensemble_check_exit(e, t, k0, k1);
+    }
+    reb_whfast_ensemble_synchronize_chunk(c, &is_synchronized);
+}
+
+/*****************************
+ * Public functions           */
+
+static double reb_whfast_ensemble_energy(const struct reb_whfast_ensemble* const e, const int k){
+    // Same as reb_tools_energy.
+    const int N = e->N;
+    const int R = e->N_replicas;
+    const struct reb_whfast_ensemble_soa p = e->p;
+    const double* const m = e->m;
+    double e_kin = 0.;
+    double e_pot = 0.;
+    for (int i=0;i<N;i++){
+        const int ik = i*R+k;
+        e_kin += 0.5 * m[ik] * (p.vx[ik]*p.vx[ik] + p.vy[ik]*p.vy[ik] + p.vz[ik]*p.vz[ik]);
+    }
+    for (int i=0;i<N;i++){
+        const int ik = i*R+k;
+        for (int j=i+1;j<N;j++){
+            const int jk = j*R+k;
+            double dx = p.x[ik] - p.x[jk];
+            double dy = p.y[ik] - p.y[jk];
+            double dz = p.z[ik] - p.z[jk];
+            e_pot -= e->G*m[jk]*m[ik]/sqrt(dx*dx + dy*dy + dz*dz);
+        }
+    }
+    return e_kin + e_pot;
+}
+
+struct reb_whfast_ensemble* reb_create_whfast_ensemble(struct reb_simulation* const r, const int N_replicas){
+    const struct reb_simulation_integrator_whfast* const ri_whfast = &(r->ri_whfast);
+    const int N_real = r->N - r->N_var;
+    if (N_replicas<1){
+        reb_error(r, "The number of replicas in a WHFast ensemble must be at least 1.");
+        return NULL;
+    }
+    if (N_real<1){
+        reb_error(r, "The simulation used to create a WHFast ensemble does not contain any particles.");
+        return NULL;
+    }
+    if (r->integrator != REB_INTEGRATOR_WHFAST || ri_whfast->coordinates != REB_WHFAST_COORDINATES_JACOBI || ri_whfast->kernel != REB_WHFAST_KERNEL_DEFAULT || ri_whfast->corrector2){
+        reb_error(r, "WHFast ensembles require the WHFast integrator with Jacobi coordinates, the default kernel and no second symplectic corrector.");
+        return NULL;
+    }
+    if (ri_whfast->corrector!=0 && ri_whfast->corrector!=3 && ri_whfast->corrector!=5  && ri_whfast->corrector!=7 && ri_whfast->corrector!=11 && ri_whfast->corrector!=17 ){
+        reb_error(r, "First symplectic correctors are only available in the following orders: 0, 3, 5, 7, 11, 17.");
+        return NULL;
+    }
+    if (r->gravity != REB_GRAVITY_BASIC || r->nghostx || r->nghosty || r->nghostz){
+        reb_error(r, "WHFast ensembles require REB_GRAVITY_BASIC and no ghost boxes.");
+        return NULL;
+    }
+    if (r->N_active != -1 && r->N_active != N_real){
+        reb_error(r, "WHFast ensembles do not support test particles. Set N_active to -1.");
+        return NULL;
+    }
+    if (r->additional_forces || r->pre_timestep_modifications || r->post_timestep_modifications || r->odes_N || r->collision != REB_COLLISION_NONE){
+        reb_error(r, "WHFast ensembles do not support additional forces, timestep modifications, ODEs, or collisions.");
+        return NULL;
+    }
+    const int megno = r->calculate_megno?1:0;
+    if (r->var_config_N != megno || (megno && (r->var_config[0].order != 1 || r->var_config[0].testparticle >= 0 || r->var_config[0].index != r->calculate_megno))){
+        reb_error(r, "WHFast ensembles only support the variational particles added by reb_tools_megno_init.");
+        return NULL;
+    }
+    reb_integrator_synchronize(r);
+
+    struct reb_whfast_ensemble* const e = calloc(1, sizeof(struct reb_whfast_ensemble));
+    if (e==NULL){
+        reb_error(r, "Cannot allocate memory for the WHFast ensemble.");
+        return NULL;
+    }
+    const int N = N_real;
+    const int R = N_replicas;
+    e->N = N;
+    e->N_replicas = R;
+    e->megno = megno;
+    e->corrector = ri_whfast->corrector;
+    e->is_synchronized = 1;
+    e->recalculate_coordinates = 1;
+    e->t = r->t;
+    e->dt = r->dt;
+    e->G = r->G;
+    e->softening = r->softening;
+    e->exit_max_distance = r->exit_max_distance;
+    e->exit_min_distance = r->exit_min_distance;
+
+    // All arrays are allocated in one block.
+    const int N_soa = megno?4:2;
+    const size_t NR = (size_t)N*(size_t)R;
+    e->data = malloc(sizeof(double)*(NR*(9*N_soa+2) + (size_t)R*9));
+    e->data_int = calloc(2*(size_t)R, sizeof(int));
+    if (e->data==NULL || e->data_int==NULL){
+        reb_error(r, "Cannot allocate memory for the WHFast ensemble.");
+        free(e->data);
+        free(e->data_int);
+        free(e);
+        return NULL;
+    }
+    double* d = e->data;
+    struct reb_whfast_ensemble_soa* const soa[4] = {&e->p, &e->p_j, &e->dp, &e->dp_j};
+    for (int s=0;s<N_soa;s++){
+        soa[s]->x  = d; d += NR;
+        soa[s]->y  = d; d += NR;
+        soa[s]->z  = d; d += NR;
+        soa[s]->vx = d; d += NR;
+        soa[s]->vy = d; d += NR;
+        soa[s]->vz = d; d += NR;
+        soa[s]->ax = d; d += NR;
+        soa[s]->ay = d; d += NR;
+        soa[s]->az = d; d += NR;
+    }
+    e->m = d; d += NR;
+    e->dm = d; d += NR;
+    e->mtot = d; d += R;
+    e->E0 = d; d += R;
+    e->t_exit = d; d += R;
+    e->megno_Ys = d; d += R;
+    e->megno_Yss = d; d += R;
+    e->megno_cov_Yt = d; d += R;
+    e->megno_var_t = d; d += R;
+    e->megno_mean_t = d; d += R;
+    e->megno_mean_Y = d; d += R;
+    e->status = e->data_int;
+    e->megno_n = e->data_int + R;
+
+    for (int k=0;k<R;k++){
+        reb_whfast_ensemble_set_particles(e, k, r->particles);
+        if (megno){
+            const struct reb_particle* const var = r->particles + r->calculate_megno;
+            for (int i=0;i<N;i++){
+                const int ik = i*R+k;
+                e->dp.x[ik] = var[i].x;
+                e->dp.y[ik] = var[i].y;
+                e->dp.z[ik] = var[i].z;
+                e->dp.vx[ik] = var[i].vx;
+                e->dp.vy[ik] = var[i].vy;
+                e->dp.vz[ik] = var[i].vz;
+                e->dm[ik] = var[i].m;
+            }
+        }else{
+            for (int i=0;i<N;i++){
+                e->dm[i*R+k] = 0.;
+            }
+        }
+        e->megno_Ys[k] = r->megno_Ys;
+        e->megno_Yss[k] = r->megno_Yss;
+        e->megno_cov_Yt[k] = r->megno_cov_Yt;
+        e->megno_var_t[k] = r->megno_var_t;
+        e->megno_mean_t[k] = r->megno_mean_t;
+        e->megno_mean_Y[k] = r->megno_mean_Y;
+        e->megno_n[k] = r->megno_n;
+    }
+    return e;
+}
+
+void reb_free_whfast_ensemble(struct reb_whfast_ensemble* const e){
+    if (e){
+        free(e->data);
+        free(e->data_int);
+        free(e);
+    }
+}
+
+int reb_whfast_ensemble_set_particles(struct reb_whfast_ensemble* const e, const int k, const struct reb_particle* const particles){
+    if (k<0 || k>=e->N_replicas){
+        return 0;
+    }
+    const int R = e->N_replicas;
+    for (int i=0;i<e->N;i++){
+        const int ik = i*R+k;
+        e->p.x[ik] = particles[i].x;
+        e->p.y[ik] = particles[i].y;
+        e->p.z[ik] = particles[i].z;
+        e->p.vx[ik] = particles[i].vx;
+        e->p.vy[ik] = particles[i].vy;
+        e->p.vz[ik] = particles[i].vz;
+        e->m[ik] = particles[i].m;
+    }
+    e->E0[k] = reb_whfast_ensemble_energy(e, k);
+    e->status[k] = REB_WHFAST_ENSEMBLE_RUNNING;
+    e->t_exit[k] = 0.;
+    e->recalculate_coordinates = 1;
+    return 1;
+}
+
+int reb_whfast_ensemble_get_particles(const struct reb_whfast_ensemble* const e, const int k, struct reb_particle* const particles){
+    if (k<0 || k>=e->N_replicas){
+        return 0;
+    }
+    const int R = e->N_replicas;
+    for (int i=0;i<e->N;i++){
+        const int ik = i*R+k;
+        particles[i] = (struct reb_particle){
+            .x = e->p.x[ik], .y = e->p.y[ik], .z = e->p.z[ik],
+            .vx = e->p.vx[ik], .vy = e->p.vy[ik], .vz = e->p.vz[ik],
+            .m = e->m[ik],
+        };
+    }
+    return 1;
+}
+
+void reb_whfast_ensemble_integrate(struct reb_whfast_ensemble* const e, const double tmax){
+    // Same stopping criterion as reb_integrate with exact_finish_time=0.
+    const double dtsign = (e->dt>0.)?1.:-1.;
+    long N_steps = 0;
+    double t = e->t;
+    while (t*dtsign<tmax*dtsign){
+        t += e->dt/2.;
+        t += e->dt/2.;
+        N_steps++;
+    }
+    if (N_steps==0){
+        return;
+    }
+    const int N_chunks = (e->N_replicas + WHFAST_ENSEMBLE_CHUNK - 1)/WHFAST_ENSEMBLE_CHUNK;
+    int warnings = 0;
+#pragma omp parallel for reduction(+:warnings)
+    for (int n=0;n<N_chunks;n++){
+        struct reb_whfast_ensemble_chunk c = {
+            .e = e,
+            .k0 = n*WHFAST_ENSEMBLE_CHUNK,
+            .k1 = MIN((n+1)*WHFAST_ENSEMBLE_CHUNK, e->N_replicas),
+            .warnings = 0,
+        };
+        reb_whfast_ensemble_integrate_chunk(&c, N_steps);
+        warnings += c.warnings;
+    }
+    if (warnings && e->timestep_warning==0){
+        reb_warning(NULL, "WHFast convergence issue. Timestep is larger than at least one orbital period.");
+    }
+    e->timestep_warning += warnings;
+    e->t = t;
+    e->is_synchronized = 1;
+    e->recalculate_coordinates = 0;
+}
+
+double reb_whfast_ensemble_get_t(const struct reb_whfast_ensemble* const e){
+    return e->t;
+}
+
+void reb_whfast_ensemble_get_status(const struct reb_whfast_ensemble* const e, int* const status, double* const t_exit){
+    for (int k=0;k<e->N_replicas;k++){
+        if (status) status[k] = e->status[k];
+        if (t_exit) t_exit[k] = e->t_exit[k];
+    }
+}
+
+void reb_whfast_ensemble_get_energy_error(const struct reb_whfast_ensemble* const e, double* const dE){
+    if (dE==NULL){
+        return;
+    }
+    for (int k=0;k<e->N_replicas;k++){
+        dE[k] = fabs((reb_whfast_ensemble_energy(e, k)-e->E0[k])/e->E0[k]);
+    }
+}
+
+void reb_whfast_ensemble_get_megno(const struct reb_whfast_ensemble* const e, double* const megno, double* const lyapunov){
+    for (int k=0;k<e->N_replicas;k++){
+        // MEGNO is frozen once a replica has been flagged.
+        const double t = e->status[k]?e->t_exit[k]:e->t;
+        if (megno) megno[k] = (t==0. || !e->megno)?0.:e->megno_Yss[k]/t;
+        if (lyapunov) lyapunov[k] = (e->megno_var_t[k]==0. || !e->megno)?0.:e->megno_cov_Yt[k]/e->megno_var_t[k];
+    }
+}
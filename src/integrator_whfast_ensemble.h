@@ -0,0 +1,29 @@
+/**
+ * @file 	integrator_whfast_ensemble.h
+ * @brief 	Interface for the WHFast ensemble integrator
+ * 
+ * @section 	LICENSE
+ * This file is part of rebound.
+ *
+ * rebound is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * rebound is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rebound.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef _INTEGRATOR_WHFAST_ENSEMBLE_H
+#define _INTEGRATOR_WHFAST_ENSEMBLE_H
+
+#define WHFAST_ENSEMBLE_CHUNK 64    ///< Number of replicas advanced together by one thread
+
+// The public functions are declared in rebound.h.
+
+#endif
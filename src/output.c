@@ -29,6 +29,11 @@
 #include <time.h>
 #include <string.h>
 #include <sys/time.h>
+#include <stdint.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif // __linux__
 #include "particle.h"
 #include "rebound.h"
 #include "tools.h"
@@ -36,6 +41,8 @@
 #include "integrator.h"
 #include "integrator_sei.h"
 #include "integrator_tes.h"
+#include "transformations.h"
+#include "integrator_janus.h"
 
 #include "input.h"
 #ifdef MPI
@@ -81,24 +88,250 @@ int reb_output_check(struct reb_simulation* r, double interval){
 }
 
 
-#ifdef PROFILING
-#warning PROFILING enabled. Rebound is NOT thread-safe.
-double profiling_time_sum[PROFILING_CAT_NUM];
-double profiling_time_initial   = 0;
-double profiling_timing_initial = 0;
-double profiling_time_final     = 0;
-void profiling_start(void){
-    struct timeval tim;
-    gettimeofday(&tim, NULL);
-    profiling_time_initial = tim.tv_sec+(tim.tv_usec/1000000.0);
+static const char* const reb_profiling_category_names[REB_PROFILING_CAT_N] = {
+    "integrator", "boundary", "gravity", "collision", "heartbeat",
+    "tree_update", "tree_moments", "force_walk", "encounter_predict", "encounter_step",
+    "kepler", "jump", "collision_search", "collision_resolve", "archive",
+};
+
+static const char* const reb_profiling_counter_names[REB_PROFILING_COUNTER_N] = {
+    "cycles", "instructions", "cache_misses", "branch_misses",
+};
+
+const char* reb_profiling_category_name(const enum REB_PROFILING_CAT cat){
+    if (cat<0 || cat>=REB_PROFILING_CAT_N){
+        return NULL;
+    }
+    return reb_profiling_category_names[cat];
 }
-void profiling_stop(int cat){
-    struct timeval tim;
-    gettimeofday(&tim, NULL);
-    profiling_time_final = tim.tv_sec+(tim.tv_usec/1000000.0);
-    profiling_time_sum[cat] += profiling_time_final - profiling_time_initial;
+
+const char* reb_profiling_counter_name(const enum REB_PROFILING_COUNTER counter){
+    if (counter<0 || counter>=REB_PROFILING_COUNTER_N){
+        return NULL;
+    }
+    return reb_profiling_counter_names[counter];
+}
+
+static double reb_profiling_clock(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+// Reads all hardware counters which are available. The others are set to 0.
+// The counters form one group, so a single read returns all of them.
+// If the kernel multiplexes the group with other events, the counts are 
+// scaled by the fraction of the time the group was running.
+static void reb_profiling_read_counters(const struct reb_profiling* const p, unsigned long long* const values){
+    for (int k=0;k<REB_PROFILING_COUNTER_N;k++){
+        values[k] = 0;
+    }
+#ifdef __linux__
+    int leader = -1;
+    for (int k=0;k<REB_PROFILING_COUNTER_N && leader<0;k++){
+        leader = p->counters_fd[k];
+    }
+    uint64_t buf[3+REB_PROFILING_COUNTER_N]; // Number of counters, time enabled, time running, values
+    if (read(leader, buf, sizeof(buf))<(ssize_t)(3*sizeof(uint64_t))){
+        return;
+    }
+    const uint64_t time_enabled = buf[1];
+    const uint64_t time_running = buf[2];
+    if (time_running==0){
+        return; // Group has not been scheduled yet
+    }
+    uint64_t i = 0;
+    for (int k=0;k<REB_PROFILING_COUNTER_N && i<buf[0];k++){
+        if (p->counters_fd[k]>=0){
+            values[k] = buf[3+i];
+            if (time_running<time_enabled){
+                values[k] = (unsigned long long)((double)values[k]*((double)time_enabled/(double)time_running));
+            }
+            i++;
+        }
+    }
+#endif // __linux__
+}
+
+void reb_profiling_enable(struct reb_simulation* const r){
+    if (r->profiling==NULL){
+        r->profiling = malloc(sizeof(struct reb_profiling));
+        r->profiling->counters_enabled = 0;
+        for (int k=0;k<REB_PROFILING_COUNTER_N;k++){
+            r->profiling->counters_fd[k] = -1;
+        }
+        reb_profiling_reset(r);
+    }
+}
+
+int reb_profiling_enable_counters(struct reb_simulation* const r){
+    reb_profiling_enable(r);
+    struct reb_profiling* const p = r->profiling;
+#ifdef __linux__
+    // Counters are opened for the calling thread only. With OpenMP, the other threads are not counted.
+    const uint64_t configs[REB_PROFILING_COUNTER_N] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    int leader = -1;
+    for (int k=0;k<REB_PROFILING_COUNTER_N && !p->counters_enabled;k++){
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(struct perf_event_attr));
+        attr.size = sizeof(struct perf_event_attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[k];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // Fails if the kernel or the (virtual) machine does not provide the counter,
+        // or if access is restricted (see /proc/sys/kernel/perf_event_paranoid).
+        p->counters_fd[k] = syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+        if (leader<0){
+            leader = p->counters_fd[k];
+        }
+    }
+#endif // __linux__
+    int available = 0;
+    for (int k=0;k<REB_PROFILING_COUNTER_N;k++){
+        if (p->counters_fd[k]>=0){
+            available++;
+        }
+    }
+    p->counters_enabled = available>0;
+    return available;
+}
+
+void reb_profiling_disable(struct reb_simulation* const r){
+    if (r->profiling){
+#ifdef __linux__
+        for (int k=0;k<REB_PROFILING_COUNTER_N;k++){
+            if (r->profiling->counters_fd[k]>=0){
+                close(r->profiling->counters_fd[k]);
+            }
+        }
+#endif // __linux__
+        free(r->profiling);
+        r->profiling = NULL;
+    }
+}
+
+void reb_profiling_reset(struct reb_simulation* const r){
+    struct reb_profiling* const p = r->profiling;
+    if (p){
+        // The counters stay open
+        memset(p->time, 0, sizeof(p->time));
+        memset(p->calls, 0, sizeof(p->calls));
+        memset(p->counters, 0, sizeof(p->counters));
+        p->time_phase = 0.;
+        p->time_begin = reb_profiling_clock();
+    }
+}
+
+double reb_profiling_elapsed(const struct reb_simulation* const r){
+    if (r->profiling==NULL){
+        return 0.;
+    }
+    return reb_profiling_clock() - r->profiling->time_begin;
+}
+
+// The profiler is stored in the simulation, so simulations running on
+// different threads do not interfere. The measurements themselves are
+// only taken outside of parallel regions.
+struct reb_profiling_mark reb_profiling_start(const struct reb_simulation* const r){
+    struct reb_profiling_mark mark = {0};
+    const struct reb_profiling* const p = r->profiling;
+    if (p){
+        mark.time = reb_profiling_clock();
+        if (p->counters_enabled){
+            reb_profiling_read_counters(p, mark.counters);
+        }
+    }
+    return mark;
+}
+
+// Adds the time and counts since start to cat and returns the time.
+static double reb_profiling_add(struct reb_profiling* const p, const int cat, const struct reb_profiling_mark start, unsigned long long* const counters){
+    const double time = reb_profiling_clock() - start.time;
+    p->time[cat] += time;
+    p->calls[cat]++;
+    if (p->counters_enabled){
+        reb_profiling_read_counters(p, counters);
+        for (int k=0;k<REB_PROFILING_COUNTER_N;k++){
+            counters[k] -= start.counters[k];
+            p->counters[cat][k] += counters[k];
+        }
+    }
+    return time;
+}
+
+void reb_profiling_stop(const struct reb_simulation* const r, const int cat, const struct reb_profiling_mark start){
+    struct reb_profiling* const p = r->profiling;
+    if (p==NULL || start.time==0.){
+        // Profiler was disabled or enabled during the measurement
+        return;
+    }
+    unsigned long long counters[REB_PROFILING_COUNTER_N];
+    reb_profiling_add(p, cat, start, counters);
+}
+
+void reb_profiling_stop_nested(const struct reb_simulation* const r, const int cat, const struct reb_profiling_mark start){
+    struct reb_profiling* const p = r->profiling;
+    if (p==NULL || start.time==0.){
+        return;
+    }
+    unsigned long long counters[REB_PROFILING_COUNTER_N];
+    const double time = reb_profiling_add(p, cat, start, counters);
+    if (p->time_phase!=0.){
+        p->time_phase += time;
+        if (p->counters_enabled){
+            for (int k=0;k<REB_PROFILING_COUNTER_N;k++){
+                p->counters_phase[k] += counters[k];
+            }
+        }
+    }
+}
+
+void reb_profiling_phase_start(struct reb_simulation* const r){
+    struct reb_profiling* const p = r->profiling;
+    if (p){
+        const struct reb_profiling_mark mark = reb_profiling_start(r);
+        p->time_phase = mark.time;
+        memcpy(p->counters_phase, mark.counters, sizeof(p->counters_phase));
+    }
+}
+
+void reb_profiling_phase_stop(struct reb_simulation* const r, const int cat){
+    struct reb_profiling* const p = r->profiling;
+    if (p && p->time_phase!=0.){
+        struct reb_profiling_mark start = {.time = p->time_phase};
+        memcpy(start.counters, p->counters_phase, sizeof(p->counters_phase));
+        reb_profiling_stop(r, cat, start);
+        p->time_phase = 0.;
+    }
+}
+
+// Prints instructions per cycle and misses per 1000 instructions. Unavailable counters are shown as "-".
+static void reb_profiling_print_counters(const struct reb_profiling* const p, const int cat){
+    if (!p->counters_enabled){
+        return;
+    }
+    const unsigned long long* const c = p->counters[cat];
+    const int has_cycles = p->counters_fd[REB_PROFILING_COUNTER_CYCLES]>=0;
+    const int has_instructions = p->counters_fd[REB_PROFILING_COUNTER_INSTRUCTIONS]>=0 && c[REB_PROFILING_COUNTER_INSTRUCTIONS]>0;
+    if (has_cycles && has_instructions && c[REB_PROFILING_COUNTER_CYCLES]>0){
+        printf("  %6.2f", (double)c[REB_PROFILING_COUNTER_INSTRUCTIONS]/(double)c[REB_PROFILING_COUNTER_CYCLES]);
+    }else{
+        printf("  %6s", "-");
+    }
+    const int misses[2] = {REB_PROFILING_COUNTER_CACHE_MISSES, REB_PROFILING_COUNTER_BRANCH_MISSES};
+    const int width[2] = {15, 16};
+    for (int k=0;k<2;k++){
+        if (has_instructions && p->counters_fd[misses[k]]>=0){
+            printf("%*.2f", width[k], 1000.*(double)c[misses[k]]/(double)c[REB_PROFILING_COUNTER_INSTRUCTIONS]);
+        }else{
+            printf("%*s", width[k], "-");
+        }
+    }
 }
-#endif // PROFILING
 
 void reb_output_timing(struct reb_simulation* r, const double tmax){
     const int N = r->N;
@@ -116,12 +349,12 @@ void reb_output_timing(struct reb_simulation* r, const double tmax){
         r->output_timing_last = temp;
     }else{
         printf("\r");
-#ifdef PROFILING
-        fputs("\033[A\033[2K",stdout);
-        for (int i=0;i<=PROFILING_CAT_NUM;i++){
+        if (r->profiling){
             fputs("\033[A\033[2K",stdout);
+            for (int i=0;i<=REB_PROFILING_CAT_N;i++){
+                fputs("\033[A\033[2K",stdout);
+            }
         }
-#endif // PROFILING
     }
     printf("N_tot= %- 9d  ",N_tot);
     if (r->integrator==REB_INTEGRATOR_SEI){
@@ -134,49 +367,71 @@ void reb_output_timing(struct reb_simulation* r, const double tmax){
     if (tmax>0){
         printf("t/tmax= %5.2f%%",r->t/tmax*100.0);
     }
-#ifdef PROFILING
-    if (profiling_timing_initial==0){
-        struct timeval tim;
-        gettimeofday(&tim, NULL);
-        profiling_timing_initial = tim.tv_sec+(tim.tv_usec/1000000.0);
-    }
-    printf("\nCATEGORY       TIME \n");
-    double _sum = 0;
-    for (int i=0;i<=PROFILING_CAT_NUM;i++){
-        switch (i){
-            case PROFILING_CAT_INTEGRATOR:
-                printf("Integrator     ");
-                break;
-            case PROFILING_CAT_BOUNDARY:
-                printf("Boundary check ");
-                break;
-            case PROFILING_CAT_GRAVITY:
-                printf("Gravity/Forces ");
-                break;
-            case PROFILING_CAT_COLLISION:
-                printf("Collisions     ");
-                break;
-#ifdef OPENGL
-            case PROFILING_CAT_VISUALIZATION:
-                printf("Visualization  ");
-                break;
-#endif // OPENGL
-            case PROFILING_CAT_NUM:
-                printf("Other          ");
-                break;
+    if (r->profiling){
+        const struct reb_profiling* const p = r->profiling;
+        const double elapsed = reb_profiling_elapsed(r);
+        printf("\nCATEGORY             TIME ");
+        if (p->counters_enabled){
+            printf("     IPC  CACHE-MISS/KI  BRANCH-MISS/KI");
         }
-        if (i==PROFILING_CAT_NUM){
-            printf("%5.2f%%",(1.-_sum/(profiling_time_final - profiling_timing_initial))*100.);
-        }else{
-            printf("%5.2f%%\n",profiling_time_sum[i]/(profiling_time_final - profiling_timing_initial)*100.);
-            _sum += profiling_time_sum[i];
+        printf("\n");
+        double sum = 0;
+        for (int i=0;i<=REB_PROFILING_CAT_TREE_UPDATE;i++){
+            if (i==REB_PROFILING_CAT_TREE_UPDATE){
+                printf("%-20s %6.2f%%\n", "other", (1.-sum/elapsed)*100.);
+            }else{
+                printf("%-20s %6.2f%%", reb_profiling_category_names[i], p->time[i]/elapsed*100.);
+                reb_profiling_print_counters(p, i);
+                printf("\n");
+                sum += p->time[i];
+            }
+        }
+        for (int i=REB_PROFILING_CAT_TREE_UPDATE;i<REB_PROFILING_CAT_N;i++){
+            printf("  %-18s %6.2f%%", reb_profiling_category_names[i], p->time[i]/elapsed*100.);
+            reb_profiling_print_counters(p, i);
+            if (i<REB_PROFILING_CAT_N-1){
+                printf("\n");
+            }
         }
     }
-#endif // PROFILING
     fflush(stdout);
     r->output_timing_last = temp;
 }
 
+void reb_output_profiling_json(struct reb_simulation* const r, const char* const filename){
+    const struct reb_profiling* const p = r->profiling;
+    if (p==NULL){
+        reb_error(r, "Profiler is not enabled.");
+        return;
+    }
+#ifdef MPI
+    char filename_mpi[1024];
+    sprintf(filename_mpi,"%s_%d",filename,r->mpi_id);
+    FILE* of = fopen(filename_mpi,"w"); 
+#else // MPI
+    FILE* of = fopen(filename,"w"); 
+#endif // MPI
+    if (of==NULL){
+        reb_error(r, "Can not open file.");
+        return;
+    }
+    fprintf(of, "{\n  \"elapsed\": %.9g,\n  \"steps_done\": %llu,\n  \"categories\": {\n", reb_profiling_elapsed(r), r->steps_done);
+    for (int i=0;i<REB_PROFILING_CAT_N;i++){
+        fprintf(of, "    \"%s\": {\"time\": %.9g, \"calls\": %llu", reb_profiling_category_names[i], p->time[i], p->calls[i]);
+        for (int k=0;k<REB_PROFILING_COUNTER_N;k++){
+            // Counters which are not available are written as null.
+            if (p->counters_fd[k]>=0){
+                fprintf(of, ", \"%s\": %llu", reb_profiling_counter_names[k], p->counters[i][k]);
+            }else{
+                fprintf(of, ", \"%s\": null", reb_profiling_counter_names[k]);
+            }
+        }
+        fprintf(of, "}%s\n", i<REB_PROFILING_CAT_N-1?",":"");
+    }
+    fprintf(of, "  }\n}\n");
+    fclose(of);
+}
+
 
 void reb_output_ascii(struct reb_simulation* r, char* filename){
     const int N = r->N;
@@ -339,19 +594,40 @@ void reb_output_binary_to_stream(struct reb_simulation* r, char** bufp, size_t*
     WRITE_FIELD(WHFAST_KEEPUNSYNC,  &r->ri_whfast.keep_unsynchronized,  sizeof(unsigned int));
     WRITE_FIELD(WHFAST_ISSYNCHRON,  &r->ri_whfast.is_synchronized,      sizeof(unsigned int));
     WRITE_FIELD(WHFAST_TIMESTEPWARN,&r->ri_whfast.timestep_warning,     sizeof(unsigned int));
-    WRITE_FIELD(WHFAST_PJ,          r->ri_whfast.p_jh,                  sizeof(struct reb_particle)*r->ri_whfast.allocated_N);
+    {
+        // Stored as an array of particles, used as a structure of arrays internally
+        struct reb_particle* p_jh = NULL;
+        if (r->ri_whfast.allocated_N){
+            p_jh = calloc(r->ri_whfast.allocated_N, sizeof(struct reb_particle));
+            reb_particle_soa_to_particles(p_jh, r->ri_whfast.p_jh, r->ri_whfast.allocated_N);
+        }
+        WRITE_FIELD(WHFAST_PJ,      p_jh,                               sizeof(struct reb_particle)*r->ri_whfast.allocated_N);
+        free(p_jh);
+    }
     WRITE_FIELD(WHFAST_COORDINATES, &r->ri_whfast.coordinates,          sizeof(int));
     WRITE_FIELD(IAS15_EPSILON,      &r->ri_ias15.epsilon,               sizeof(double));
     WRITE_FIELD(IAS15_MINDT,        &r->ri_ias15.min_dt,                sizeof(double));
     WRITE_FIELD(IAS15_EPSILONGLOBAL,&r->ri_ias15.epsilon_global,        sizeof(unsigned int));
+    WRITE_FIELD(IAS15_BLOCKLEVELS,  &r->ri_ias15.block_levels,          sizeof(unsigned int));
     WRITE_FIELD(IAS15_ITERATIONSMAX,&r->ri_ias15.iterations_max_exceeded,sizeof(unsigned long));
     WRITE_FIELD(IAS15_ALLOCATEDN,   &r->ri_ias15.allocatedN,            sizeof(int));
+    WRITE_FIELD(IAS15_DENSEN,       &r->ri_ias15.dense_N,               sizeof(int));
+    WRITE_FIELD(IAS15_DENSET,       &r->ri_ias15.dense_t,               sizeof(double));
     WRITE_FIELD(JANUS_SCALEPOS,     &r->ri_janus.scale_pos,             sizeof(double));
     WRITE_FIELD(JANUS_SCALEVEL,     &r->ri_janus.scale_vel,             sizeof(double));
     WRITE_FIELD(JANUS_ORDER,        &r->ri_janus.order,                 sizeof(unsigned int));
     WRITE_FIELD(JANUS_ALLOCATEDN,   &r->ri_janus.allocated_N,           sizeof(unsigned int));
     WRITE_FIELD(JANUS_RECALC,       &r->ri_janus.recalculate_integer_coordinates_this_timestep, sizeof(unsigned int));
-    WRITE_FIELD(JANUS_PINT,         r->ri_janus.p_int,                  sizeof(struct reb_particle_int)*r->ri_janus.allocated_N);
+    {
+        // Stored as an array of structs, used as a structure of arrays internally
+        struct reb_particle_int* p_int = NULL;
+        if (r->ri_janus.allocated_N){
+            p_int = malloc(sizeof(struct reb_particle_int)*r->ri_janus.allocated_N);
+            reb_particle_int_soa_to_particles_int(p_int, r->ri_janus.p_int, r->ri_janus.allocated_N);
+        }
+        WRITE_FIELD(JANUS_PINT,     p_int,                              sizeof(struct reb_particle_int)*r->ri_janus.allocated_N);
+        free(p_int);
+    }
     WRITE_FIELD(MERCURIUS_HILLFAC,  &r->ri_mercurius.hillfac,           sizeof(double));
     WRITE_FIELD(MERCURIUS_SAFEMODE, &r->ri_mercurius.safe_mode,         sizeof(unsigned int));
     WRITE_FIELD(MERCURIUS_ISSYNCHRON, &r->ri_mercurius.is_synchronized, sizeof(unsigned int));
@@ -384,6 +660,7 @@ void reb_output_binary_to_stream(struct reb_simulation* r, char** bufp, size_t*
     WRITE_FIELD(BS_FIRSTORLASTSTEP, &r->ri_bs.firstOrLastStep,          sizeof(int));
     WRITE_FIELD(BS_PREVIOUSREJECTED,&r->ri_bs.previousRejected,         sizeof(int));
     WRITE_FIELD(BS_TARGETITER,      &r->ri_bs.targetIter,               sizeof(int));
+    WRITE_FIELD(BS_PARALLELCOLUMNS, &r->ri_bs.parallel_columns,         sizeof(int));
     int functionpointersused = 0;
     if (r->coefficient_of_restitution ||
         r->collision_resolve ||
@@ -452,6 +729,10 @@ void reb_output_binary_to_stream(struct reb_simulation* r, char** bufp, size_t*
             reb_save_dp7(&(r->ri_ias15.er),N3,bufp,sizep,&allocatedsize);
         }
     }
+    if (r->ri_ias15.block_N){
+        WRITE_FIELD(IAS15_BLOCKDTWANT, r->ri_ias15.block_dt_want,  sizeof(double)*r->ri_ias15.block_N);
+        WRITE_FIELD(IAS15_BLOCKDTLAST, r->ri_ias15.block_dt_last,  sizeof(double)*r->ri_ias15.block_N);
+    }
 
 
     // Output fields for TES integrator.
@@ -27,30 +27,21 @@
 struct reb_simulation;
 
 #include <stdio.h>
+#include "rebound.h"
 void reb_output_binary_to_stream(struct reb_simulation* r, char** bufp, size_t* sizep);
 void reb_output_stream_write(char** bufp, size_t* allocatedsize, size_t* sizep, void* restrict data, size_t size); ///< Replacement for memstream
 
-#ifdef PROFILING
-/**
- * Profiling categories
- */
-enum profiling_categories {
-	PROFILING_CAT_INTEGRATOR,
-	PROFILING_CAT_BOUNDARY,
-	PROFILING_CAT_GRAVITY,
-	PROFILING_CAT_COLLISION,
-#ifdef OPENGL
-	PROFILING_CAT_VISUALIZATION,
-#endif // OPENGL
-	PROFILING_CAT_NUM,
+// Clock time and hardware counts at the beginning of a measurement.
+struct reb_profiling_mark {
+    double time;    // 0 if the profiler is disabled.
+    unsigned long long counters[REB_PROFILING_COUNTER_N];
 };
-void profiling_start(void);
-void profiling_stop(int cat);
-#define PROFILING_START() profiling_start();	///< Start profiling block 
-#define PROFILING_STOP(C) profiling_stop(C);	///< Stop profiling block 
-#else // PROFILING
-#define PROFILING_START()	///< Start profiling block (dummy, does nothing) 
-#define PROFILING_STOP(C)	///< Stop profiling block (dummy, does nothing)
-#endif // PROFILING
+struct reb_profiling_mark reb_profiling_start(const struct reb_simulation* const r); ///< Returns the current clock time and hardware counts.
+void reb_profiling_stop(const struct reb_simulation* const r, const int cat, const struct reb_profiling_mark start); ///< Adds the time and counts since start to cat.
+void reb_profiling_stop_nested(const struct reb_simulation* const r, const int cat, const struct reb_profiling_mark start); ///< Same as reb_profiling_stop, but also removes the time and counts from the enclosing exclusive category.
+void reb_profiling_phase_start(struct reb_simulation* const r); ///< Starts an exclusive category.
+void reb_profiling_phase_stop(struct reb_simulation* const r, const int cat); ///< Adds the time since the last call to reb_profiling_phase_start to cat.
+#define PROFILING_START(r) reb_profiling_phase_start(r);	///< Start profiling block 
+#define PROFILING_STOP(r,C) reb_profiling_phase_stop(r,C);	///< Stop profiling block 
 
 #endif
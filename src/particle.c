@@ -84,10 +84,13 @@ static void reb_add_local(struct reb_simulation* const r, struct reb_particle pt
             }
             rim->dcrit[r->N-1] = reb_integrator_mercurius_calculate_dcrit_for_particle(r,r->N-1);
             if (rim->allocatedN<r->N){
-                rim->particles_backup   = realloc(rim->particles_backup,sizeof(struct reb_particle)*r->N);
+                rim->particles_backup   = realloc(rim->particles_backup,sizeof(struct reb_vec6d)*r->N);
                 rim->encounter_map      = realloc(rim->encounter_map,sizeof(int)*r->N);
+                rim->encounter_bands    = realloc(rim->encounter_bands,sizeof(struct reb_mercurius_band)*r->N);
+                rim->encounter_cluster  = realloc(rim->encounter_cluster,sizeof(int)*r->N);
                 rim->allocatedN = r->N;
             }
+            rim->encounter_cluster[r->N-1] = -1; // Integrated with the current cluster only
             rim->encounter_map[rim->encounterN] = r->N-1;
             rim->encounterN++;
             if (r->N_active==-1){ 
@@ -288,6 +291,11 @@ int reb_remove(struct reb_simulation* const r, int index, int keepSorted){
                 rim->encounterNactive--;
             }
             rim->encounterN--;
+            // Cluster ids and backups of particles not yet integrated need to be shifted as well
+            for (int i=index;i<r->N-1;i++){
+                rim->encounter_cluster[i] = rim->encounter_cluster[i+1];
+                rim->particles_backup[i] = rim->particles_backup[i+1];
+            }
         }
     }
 	if (r->N==1){
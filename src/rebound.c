@@ -41,6 +41,7 @@
 #include "integrator_ias15.h"
 #include "integrator_mercurius.h"
 #include "integrator_bs.h"
+#include "integrator_eos.h"
 #include "integrator_tes.h"
 #include "boundary.h"
 #include "gravity.h"
@@ -82,7 +83,7 @@ void reb_step(struct reb_simulation* const r){
     gettimeofday(&time_beginning,NULL);
 
     // A 'DKD'-like integrator will do the first 'D' part.
-    PROFILING_START()
+    PROFILING_START(r)
     if (r->pre_timestep_modifications){
         reb_integrator_synchronize(r);
         r->pre_timestep_modifications(r);
@@ -91,24 +92,24 @@ void reb_step(struct reb_simulation* const r){
     }
    
     reb_integrator_part1(r);
-    PROFILING_STOP(PROFILING_CAT_INTEGRATOR)
+    PROFILING_STOP(r, REB_PROFILING_CAT_INTEGRATOR)
 
     // Update and simplify tree. 
     // Prepare particles for distribution to other nodes. 
     // This function also creates the tree if called for the first time.
     if (r->tree_needs_update || r->gravity==REB_GRAVITY_TREE || r->collision==REB_COLLISION_TREE || r->collision==REB_COLLISION_LINETREE){
         // Check for root crossings.
-        PROFILING_START()
+        PROFILING_START(r)
         reb_boundary_check(r);     
-        PROFILING_STOP(PROFILING_CAT_BOUNDARY)
+        PROFILING_STOP(r, REB_PROFILING_CAT_BOUNDARY)
 
         // Update tree (this will remove particles which left the box)
-        PROFILING_START()
+        PROFILING_START(r)
         reb_tree_update(r);          
-        PROFILING_STOP(PROFILING_CAT_GRAVITY)
+        PROFILING_STOP(r, REB_PROFILING_CAT_GRAVITY)
     }
 
-    PROFILING_START()
+    PROFILING_START(r)
 #ifdef MPI
     // Distribute particles and add newly received particles to tree.
     reb_communication_mpi_distribute_particles(r);
@@ -133,10 +134,10 @@ void reb_step(struct reb_simulation* const r){
     }
     // Calculate non-gravity accelerations. 
     if (r->additional_forces) r->additional_forces(r);
-    PROFILING_STOP(PROFILING_CAT_GRAVITY)
+    PROFILING_STOP(r, REB_PROFILING_CAT_GRAVITY)
 
     // A 'DKD'-like integrator will do the 'KD' part.
-    PROFILING_START()
+    PROFILING_START(r)
     reb_integrator_part2(r);
     
     if (r->post_timestep_modifications){
@@ -149,22 +150,22 @@ void reb_step(struct reb_simulation* const r){
     if (r->N_var){
         reb_var_rescale(r);
     }
-    PROFILING_STOP(PROFILING_CAT_INTEGRATOR)
+    PROFILING_STOP(r, REB_PROFILING_CAT_INTEGRATOR)
 
     // Do collisions here. We need both the positions and velocities at the same time.
     // Check for root crossings.
-    PROFILING_START()
+    PROFILING_START(r)
     reb_boundary_check(r);     
     if (r->tree_needs_update){
         // Update tree (this will remove particles which left the box)
         reb_tree_update(r);          
     }
-    PROFILING_STOP(PROFILING_CAT_BOUNDARY)
+    PROFILING_STOP(r, REB_PROFILING_CAT_BOUNDARY)
 
     // Search for collisions using local and essential tree.
-    PROFILING_START()
+    PROFILING_START(r)
     reb_collision_search(r);
-    PROFILING_STOP(PROFILING_CAT_COLLISION)
+    PROFILING_STOP(r, REB_PROFILING_CAT_COLLISION)
     
     // Update walltime
     struct timeval time_end;
@@ -319,11 +320,14 @@ void reb_free_pointers(struct reb_simulation* const r){
         free(r->display_data->orbit_data);
         free(r->display_data); // TODO: Free other pointers in display_data
     }
+    reb_profiling_disable(r); // Also closes the hardware counters
     free(r->gravity_cs  );
     free(r->collisions  );
+    reb_collision_bvh_delete(r);
     reb_integrator_whfast_reset(r);
-    reb_integrator_ias15_reset(r);
+    reb_integrator_ias15_free(r);
     reb_integrator_mercurius_reset(r);
+    reb_integrator_eos_reset(r);
     reb_integrator_bs_reset(r);
     reb_integrator_tes_reset(r);
     if(r->free_particle_ap){
@@ -343,9 +347,7 @@ void reb_free_pointers(struct reb_simulation* const r){
         r->extras_cleanup(r);
     }
     free(r->var_config);
-    for (int s=0; s<r->odes_N; s++){
-        r->odes[s]->r = NULL;
-    }
+    reb_integrator_bs_free_odes_arena(r);
 }
 
 void reb_reset_temporary_pointers(struct reb_simulation* const r){
@@ -354,8 +356,12 @@ void reb_reset_temporary_pointers(struct reb_simulation* const r){
     r->gravity_cs           = NULL;
     r->collisions_allocatedN    = 0;
     r->collisions           = NULL;
+    r->collision_bvh_allocatedN = 0;
+    r->collision_bvh_N      = 0;
+    r->collision_bvh        = NULL;
     r->extras               = NULL;
     r->messages             = NULL;
+    r->profiling            = NULL;
     // ********** Lookup Table
     r->particle_lookup_table = NULL;
     r->N_lookup = 0;
@@ -363,8 +369,8 @@ void reb_reset_temporary_pointers(struct reb_simulation* const r){
     // ********** WHFAST
     r->ri_whfast.allocated_N    = 0;
     r->ri_whfast.allocated_Ntemp= 0;
-    r->ri_whfast.p_jh           = NULL;
-    r->ri_whfast.p_temp         = NULL;
+    memset(&r->ri_whfast.p_jh, 0, sizeof(struct reb_particle_soa));
+    memset(&r->ri_whfast.p_temp, 0, sizeof(struct reb_particle_soa));
     r->ri_whfast.keep_unsynchronized = 0;
     // ********** IAS15
     r->ri_ias15.allocatedN      = 0;
@@ -384,6 +390,15 @@ void reb_reset_temporary_pointers(struct reb_simulation* const r){
     r->ri_ias15.at          = NULL;
     r->ri_ias15.map_allocated_N      = 0;
     r->ri_ias15.map         = NULL;
+    r->ri_ias15.arena       = NULL;
+    r->ri_ias15.arena_allocatedN = 0;
+    r->ri_ias15.block_N     = 0;
+    r->ri_ias15.block_level = NULL;
+    r->ri_ias15.block_index = NULL;
+    r->ri_ias15.block_dt_want = NULL;
+    r->ri_ias15.block_dt_last = NULL;
+    r->ri_ias15.block_arena = NULL;
+    r->ri_ias15.block_arena_allocatedN = 0;
     // ********** MERCURIUS
     r->ri_mercurius.allocatedN = 0;
     r->ri_mercurius.allocatedN_additionalforces = 0;
@@ -392,9 +407,17 @@ void reb_reset_temporary_pointers(struct reb_simulation* const r){
     r->ri_mercurius.particles_backup = NULL;
     r->ri_mercurius.particles_backup_additionalforces = NULL;
     r->ri_mercurius.encounter_map = NULL;
+    r->ri_mercurius.encounter_bands = NULL;
+    r->ri_mercurius.encounter_flags = NULL;
+    r->ri_mercurius.encounter_flags_allocatedN = 0;
+    r->ri_mercurius.encounter_cluster = NULL;
+    r->ri_mercurius.encounter_pairs = NULL;
+    r->ri_mercurius.encounter_pairs_allocatedN = 0;
+    // ********** EOS
+    r->ri_eos.fsal = NULL;
     // ********** JANUS
     r->ri_janus.allocated_N = 0;
-    r->ri_janus.p_int = NULL;
+    memset(&(r->ri_janus.p_int), 0, sizeof(struct reb_particle_int_soa));
     r->ri_janus.recalculate_integer_coordinates_this_timestep = 0;
     r->ri_janus.order = 6;
     r->ri_janus.scale_pos = 1e-16;
@@ -403,6 +426,8 @@ void reb_reset_temporary_pointers(struct reb_simulation* const r){
     r->odes = NULL;
     r->odes_N = 0;
     r->odes_allocatedN = 0;
+    r->odes_arena = NULL;
+    r->odes_length = 0;
     // ********** TES
     r->ri_tes.particles_dh = NULL;
 }
@@ -585,12 +610,14 @@ void reb_init_simulation(struct reb_simulation* r){
     r->ri_ias15.epsilon         = 1e-9;
     r->ri_ias15.min_dt      = 0;
     r->ri_ias15.epsilon_global  = 1;
+    r->ri_ias15.block_levels    = 0;
     r->ri_ias15.iterations_max_exceeded = 0;    
     
     // ********** SEI
     r->ri_sei.OMEGA     = 1;
     r->ri_sei.OMEGAZ    = -1;
     r->ri_sei.lastdt    = 0;
+    r->ri_sei.boundary_checked = 0;
     
     // ********** MERCURIUS
     r->ri_mercurius.mode = 0;
@@ -607,6 +634,11 @@ void reb_init_simulation(struct reb_simulation* r){
     r->ri_eos.phi1 = REB_EOS_LF;
     r->ri_eos.safe_mode = 1;
     r->ri_eos.is_synchronized = 1;
+    r->ri_eos.timing = 0;
+    r->ri_eos.walltime_drift = 0.;
+    r->ri_eos.walltime_interaction = 0.;
+    r->ri_eos.force_calculations_done = 0;
+    r->ri_eos.fsal = NULL;
     
     
     // ********** NS
@@ -803,16 +835,22 @@ static void* reb_integrate_raw(void* args){
     }
 
     r->status = REB_RUNNING;
+    PROFILING_START(r)
     reb_run_heartbeat(r);
+    PROFILING_STOP(r, REB_PROFILING_CAT_HEARTBEAT)
     while(reb_check_exit(r,thread_info->tmax,&last_full_dt)<0){
 #ifdef OPENGL
         if (r->display_data){
             if (r->display_data->opengl_enabled){ pthread_mutex_lock(&(r->display_data->mutex)); }
         }
 #endif // OPENGL
+        PROFILING_START(r)
         if (r->simulationarchive_filename){ reb_simulationarchive_heartbeat(r);}
+        PROFILING_STOP(r, REB_PROFILING_CAT_HEARTBEAT)
         reb_step(r); 
+        PROFILING_START(r)
         reb_run_heartbeat(r);
+        PROFILING_STOP(r, REB_PROFILING_CAT_HEARTBEAT)
         if (reb_sigint== 1){
             r->status = REB_EXIT_SIGINT;
         }
@@ -55,6 +55,7 @@ extern volatile sig_atomic_t reb_sigint;  ///< Graceful global interrupt handler
 struct reb_simulation;
 struct reb_display_data;
 struct reb_treecell;
+struct reb_bvhnode;
 struct reb_variational_configuration;
 
 struct reb_particle {
@@ -83,6 +84,16 @@ struct reb_vec3d {
     double z;
 };
 
+// Position and velocity only
+struct reb_vec6d {
+    double x;
+    double y;
+    double z;
+    double vx;
+    double vy;
+    double vz;
+};
+
 // Rotation (Implemented as a quaternion)
 struct reb_rotation {
     double ix;
@@ -102,6 +113,21 @@ struct reb_dp7 {
     double* REBOUND_RESTRICT p6;
 };
 
+// Coordinates and masses stored as a structure of arrays, for internal use only (WHFast, SABA).
+// All arrays are part of a single allocation starting at x.
+struct reb_particle_soa {
+    double* x;
+    double* y;
+    double* z;
+    double* vx;
+    double* vy;
+    double* vz;
+    double* ax;
+    double* ay;
+    double* az;
+    double* m;
+};
+
 struct reb_ghostbox{
     double shiftx;
     double shifty;
@@ -116,6 +142,7 @@ struct reb_simulation_integrator_ias15 {
     double epsilon;
     double min_dt;
     unsigned int epsilon_global;
+    unsigned int block_levels;  // Maximum number of timestep levels. 0 (default) and 1 use the same timestep for all particles.
    
     // Internal use
     unsigned long iterations_max_exceeded; // Counter how many times the iteration did not converge. 
@@ -137,6 +164,33 @@ struct reb_simulation_integrator_ias15 {
 
     int* map;               // internal map to particles (this is an identity map except when MERCURIUS is used
     int map_allocated_N;    // allocated size for map
+    double* arena;          // single 64-byte aligned allocation holding all arrays above (see integrator_ias15.c)
+    int arena_allocatedN;   // number of doubles per array in the arena
+
+    int block_N;            // Number of particles the block timestep arrays are set up for (0 if not initialized)
+    int* block_level;       // Level of each particle. Its timestep is r->dt/2^level.
+    int* block_index;       // Particle indices sorted by level
+    double* block_dt_want;  // Timestep each particle would like to take next
+    double* block_dt_last;  // Last timestep each particle has taken (0 if none)
+    double* block_arena;    // Backup at the beginning of a step and positions at the substeps of slower levels
+    int block_arena_allocatedN; // Number of doubles in block_arena
+
+    int dense_N;            // Number of particles after the last timestep (0 if dense output is not available)
+    double dense_t;         // Time after the last timestep
+};
+
+// Radial band swept by a particle during one timestep, for internal use only (MERCURIUS).
+struct reb_mercurius_band {
+    double rmin;    // Inner edge, inflated by the switching radius
+    double rmax;    // Outer edge, inflated by the switching radius
+    int index;      // Index of the particle
+};
+
+// Pairs of particles having a close encounter, for internal use only (MERCURIUS).
+struct reb_mercurius_encounter_pairs {
+    int* ij;                // Indices i and j of each pair, i<j
+    unsigned int N;         // Number of pairs
+    unsigned int allocatedN; // Number of pairs that fit into ij
 };
 
 struct reb_simulation_integrator_mercurius {
@@ -156,9 +210,15 @@ struct reb_simulation_integrator_mercurius {
     unsigned int allocatedN_additionalforces;
     unsigned int dcrit_allocatedN;  // Current size of dcrit arrays
     double* dcrit;                  // Precalculated switching radii for particles
-    struct reb_particle* REBOUND_RESTRICT particles_backup; //  contains coordinates before Kepler step for encounter prediction
-    struct reb_particle* REBOUND_RESTRICT particles_backup_additionalforces; // contains coordinates before Kepler step for encounter prediction
+    struct reb_vec6d* REBOUND_RESTRICT particles_backup; //  contains coordinates before Kepler step for encounter prediction
+    struct reb_vec6d* REBOUND_RESTRICT particles_backup_additionalforces; // contains heliocentric coordinates while additional forces are calculated
     int* encounter_map;             // Map to represent which particles are integrated with ias15
+    struct reb_mercurius_band* encounter_bands; // Radial bands of active particles, then of test particles, each sorted by inner edge. Used to cull pairs in encounter prediction
+    unsigned char* encounter_flags; // Encounter flags, one set of N flags per OpenMP thread
+    unsigned int encounter_flags_allocatedN; // Current size of encounter_flags array
+    int* encounter_cluster;         // Id of the independent encounter cluster a particle belongs to (-1 if none)
+    struct reb_mercurius_encounter_pairs* encounter_pairs; // Pairs having a close encounter, one list per OpenMP thread
+    unsigned int encounter_pairs_allocatedN; // Current number of lists in encounter_pairs
     struct reb_vec3d com_pos;       // Used to keep track of the centre of mass during the timestep
     struct reb_vec3d com_vel;
 };
@@ -172,6 +232,7 @@ struct reb_simulation_integrator_sei {
     double tandt;       ///< Cached tan() 
     double sindtz;      ///< Cached sin(), z axis
     double tandtz;      ///< Cached tan(), z axis
+    unsigned int boundary_checked; ///< Set if part2 already applied the shear boundary conditions.
 };
 
 struct reb_simulation_integrator_saba {
@@ -218,8 +279,8 @@ struct reb_simulation_integrator_whfast {
     unsigned int safe_mode;
     unsigned int keep_unsynchronized;
     // Internal 
-    struct reb_particle* REBOUND_RESTRICT p_jh;     // Jacobi/heliocentric/WHDS coordinates
-    struct reb_particle* REBOUND_RESTRICT p_temp;   // Used for lazy implementer's kernel 
+    struct reb_particle_soa p_jh;                   // Jacobi/heliocentric/WHDS coordinates
+    struct reb_particle_soa p_temp;                 // Used for lazy implementer's kernel 
     unsigned int is_synchronized;
     unsigned int allocated_N;
     unsigned int allocated_Ntemp;
@@ -248,6 +309,7 @@ struct reb_ode{ // defines an ODE
 };
 
 
+struct reb_bs_column;
 struct reb_simulation_integrator_bs {
     struct reb_ode* nbody_ode; //
     int* sequence;      // stepsize sequence
@@ -264,6 +326,8 @@ struct reb_simulation_integrator_bs {
     int previousRejected;
     int targetIter;
     int user_ode_needs_nbody; // Do not set manually. Use needs_nbody in reb_ode instead.
+    int parallel_columns; // Set to 1 to evaluate the columns of the extrapolation table concurrently (only useful with OpenMP).
+    struct reb_bs_column* columns; // Internal workspace used if parallel_columns is set.
 };
 
 typedef struct _StumpfCoefficients
@@ -451,12 +515,18 @@ enum REB_EOS_TYPE {
     REB_EOS_PMLF6 = 0x08,
 };
 
+struct reb_eos_fsal;
 struct reb_simulation_integrator_eos {
     enum REB_EOS_TYPE phi0;
     enum REB_EOS_TYPE phi1;
     unsigned int n;
     unsigned int safe_mode;
     unsigned int is_synchronized;
+    unsigned int timing;                // Set to 1 to measure the wall time spent in the drift and interaction steps of phi0.
+    double walltime_drift;              // Wall time spent in phi0 drift steps (this includes all phi1 steps).
+    double walltime_interaction;        // Wall time spent in phi0 interaction steps.
+    unsigned long long force_calculations_done; // Number of phi0 force calculations.
+    struct reb_eos_fsal* fsal;          // Internal cache used to reuse forces across steps.
 };
 
 
@@ -471,12 +541,23 @@ struct reb_particle_int {
     REB_PARTICLE_INT_TYPE vz;
 };
 
+// Integer-based positions and velocities stored as a structure of arrays. Used internally in JANUS.
+// All arrays are part of a single allocation starting at x.
+struct reb_particle_int_soa {
+    REB_PARTICLE_INT_TYPE* x;
+    REB_PARTICLE_INT_TYPE* y;
+    REB_PARTICLE_INT_TYPE* z;
+    REB_PARTICLE_INT_TYPE* vx;
+    REB_PARTICLE_INT_TYPE* vy;
+    REB_PARTICLE_INT_TYPE* vz;
+};
+
 struct reb_simulation_integrator_janus {
     double scale_pos;
     double scale_vel;
     unsigned int order;
     unsigned int recalculate_integer_coordinates_this_timestep;
-    struct reb_particle_int* REBOUND_RESTRICT p_int;
+    struct reb_particle_int_soa p_int;
     unsigned int allocated_N;
 };
 
@@ -502,6 +583,49 @@ enum REB_STATUS {
     REB_EXIT_COLLISION = 7,     // The integration ends early because two particles collided. 
 };
 
+// Categories of the runtime profiler (see reb_profiling_enable).
+// The first five categories are exclusive: each part of reb_integrate is attributed to exactly one of them.
+// The remaining categories are sub-phases. Their time is also included in one of the first five categories.
+enum REB_PROFILING_CAT {
+    REB_PROFILING_CAT_INTEGRATOR = 0,           // Integrator substeps (without force calculations)
+    REB_PROFILING_CAT_BOUNDARY = 1,             // Boundary checks and tree updates after the timestep
+    REB_PROFILING_CAT_GRAVITY = 2,              // Force calculations, including additional forces
+    REB_PROFILING_CAT_COLLISION = 3,            // Collision search and resolution after the timestep
+    REB_PROFILING_CAT_HEARTBEAT = 4,            // Heartbeat function, exit checks and SimulationArchive between timesteps
+    REB_PROFILING_CAT_TREE_UPDATE = 5,          // reb_tree_update()
+    REB_PROFILING_CAT_TREE_MOMENTS = 6,         // reb_tree_update_gravity_data()
+    REB_PROFILING_CAT_FORCE_WALK = 7,           // reb_calculate_acceleration() (tree walk or direct summation)
+    REB_PROFILING_CAT_ENCOUNTER_PREDICT = 8,    // MERCURIUS encounter prediction
+    REB_PROFILING_CAT_ENCOUNTER_STEP = 9,       // MERCURIUS encounter step
+    REB_PROFILING_CAT_KEPLER = 10,              // Kepler drifts of WHFast, SABA and MERCURIUS
+    REB_PROFILING_CAT_JUMP = 11,                // Jump steps of WHFast, SABA and MERCURIUS
+    REB_PROFILING_CAT_COLLISION_SEARCH = 12,    // Search part of reb_collision_search()
+    REB_PROFILING_CAT_COLLISION_RESOLVE = 13,   // Resolve part of reb_collision_search()
+    REB_PROFILING_CAT_ARCHIVE = 14,             // Writing SimulationArchive snapshots
+    REB_PROFILING_CAT_N = 15,                   // Number of categories
+};
+
+// Hardware performance counters of the runtime profiler (see reb_profiling_enable_counters).
+enum REB_PROFILING_COUNTER {
+    REB_PROFILING_COUNTER_CYCLES = 0,           // CPU cycles
+    REB_PROFILING_COUNTER_INSTRUCTIONS = 1,     // Retired instructions
+    REB_PROFILING_COUNTER_CACHE_MISSES = 2,     // Last level cache misses
+    REB_PROFILING_COUNTER_BRANCH_MISSES = 3,    // Mispredicted branches
+    REB_PROFILING_COUNTER_N = 4,                // Number of counters
+};
+
+// Runtime profiler. All times are measured with a monotonic clock and are in seconds.
+struct reb_profiling {
+    double time[REB_PROFILING_CAT_N];               // Time spent in each category.
+    unsigned long long calls[REB_PROFILING_CAT_N];  // Number of measurements in each category.
+    unsigned long long counters[REB_PROFILING_CAT_N][REB_PROFILING_COUNTER_N]; // Hardware counts in each category. Only updated if counters_enabled is 1.
+    int counters_enabled;                           // 1 if at least one hardware counter is available.
+    int counters_fd[REB_PROFILING_COUNTER_N];       // File descriptors of the hardware counters. -1 if a counter is not available.
+    double time_begin;                              // Clock time when the profiler was enabled or reset.
+    double time_phase;                              // Internal: clock time at the beginning of the current exclusive category.
+    unsigned long long counters_phase[REB_PROFILING_COUNTER_N]; // Internal: hardware counts at the beginning of the current exclusive category.
+};
+
 // IDs for content of a binary field. Used to read and write binary files.
 enum REB_BINARY_FIELD_TYPE {
     REB_BINARY_FIELD_TYPE_T = 0,
@@ -638,6 +762,12 @@ enum REB_BINARY_FIELD_TYPE {
     REB_BINARY_FIELD_TYPE_BS_PREVIOUSREJECTED = 161,
     REB_BINARY_FIELD_TYPE_BS_TARGETITER = 162,
     REB_BINARY_FIELD_TYPE_VARRESCALEWARNING = 163,
+    REB_BINARY_FIELD_TYPE_BS_PARALLELCOLUMNS = 164,
+    REB_BINARY_FIELD_TYPE_IAS15_BLOCKLEVELS = 165,
+    REB_BINARY_FIELD_TYPE_IAS15_BLOCKDTWANT = 166,
+    REB_BINARY_FIELD_TYPE_IAS15_BLOCKDTLAST = 167,
+    REB_BINARY_FIELD_TYPE_IAS15_DENSEN = 168,
+    REB_BINARY_FIELD_TYPE_IAS15_DENSET = 169,
 
     REB_BINARY_FIELD_TYPE_TES_DQ_MAX = 300,
     REB_BINARY_FIELD_TYPE_TES_RECTI_PER_ORBIT = 301,
@@ -777,7 +907,8 @@ struct reb_simulation {
     int track_energy_offset;
     double energy_offset;
     double walltime;
-    uint32_t python_unit_l;         // Only used for when working with units in python.
+    struct reb_profiling* profiling; // Runtime profiler. NULL (default) if profiling is disabled. See reb_profiling_enable().
+    uint32_t python_unit_l;        // Only used for when working with units in python.
     uint32_t python_unit_m;         // Only used for when working with units in python.
     uint32_t python_unit_t;         // Only used for when working with units in python.
     
@@ -820,6 +951,10 @@ struct reb_simulation {
     double collisions_plog;
     double max_radius[2];               // Two largest particle radii, set automatically, needed for collision search.
     long collisions_Nlog;
+    struct reb_bvhnode* collision_bvh;      // Bounding volume hierarchy of swept particle volumes (only used by REB_COLLISION_LINETREE)
+    int collision_bvh_N;                    // Number of leaves in the bounding volume hierarchy. Set to 0 to force a rebuild. 
+    int collision_bvh_allocatedN;           // Number of nodes allocated
+    double collision_bvh_cost;              // Summed surface area of all nodes after the last rebuild. Used to decide when to rebuild.
     
     // MEGNO
     int calculate_megno;    // Do not change manually. Internal flag that determines if megno is calculated (default=0, but megno_init() sets it to the index of variational particles used for megno)
@@ -899,6 +1034,8 @@ struct reb_simulation {
     struct reb_ode** odes;  // all ode sets (includes nbody if BS set as integrator)
     int odes_N;            // number of ode sets
     int odes_allocatedN;   // number of ode sets allocated
+    double* odes_arena;    // arrays of all ode sets (see integrator_bs.c). Pointers in reb_ode other than y change when ode sets are added or removed.
+    unsigned int odes_length; // combined length of all ode sets
     int ode_warnings;
 
      // Callback functions
@@ -967,6 +1104,10 @@ enum REB_STATUS reb_integrate(struct reb_simulation* const r, double tmax);
 void reb_integrator_synchronize(struct reb_simulation* r);
 void reb_integrator_reset(struct reb_simulation* r);
 void reb_update_acceleration(struct reb_simulation* r);
+// Dense output for IAS15. Copies the particles into the array particles (of size r->N) and sets their positions and 
+// velocities to the values at time t, which must lie within the last timestep. No force evaluations are required.
+// Returns 1 on success, 0 otherwise.
+int reb_integrator_ias15_interpolate(struct reb_simulation* const r, const double t, struct reb_particle* const particles);
 void reb_stop(struct reb_simulation* const r); // Stop current integration
 
 // Compare simulations
@@ -1004,6 +1145,18 @@ void reb_output_ascii(struct reb_simulation* r, char* filename);
 void reb_output_binary_positions(struct reb_simulation* r, const char* filename);
 void reb_output_velocity_dispersion(struct reb_simulation* r, char* filename);
 
+// Runtime profiler. Results are stored in r->profiling and printed by reb_output_timing().
+void reb_profiling_enable(struct reb_simulation* const r);  // Allocates r->profiling. Does nothing if the profiler is already enabled.
+void reb_profiling_disable(struct reb_simulation* const r); // Frees r->profiling.
+void reb_profiling_reset(struct reb_simulation* const r);   // Sets all times and counters to zero.
+double reb_profiling_elapsed(const struct reb_simulation* const r); // Time since the profiler was enabled or reset. Returns 0 if the profiler is disabled.
+const char* reb_profiling_category_name(const enum REB_PROFILING_CAT cat); // Short name of a category, e.g. "kepler".
+const char* reb_profiling_counter_name(const enum REB_PROFILING_COUNTER counter); // Short name of a hardware counter, e.g. "cycles".
+// Enables the profiler and the hardware counters (Linux only, using perf_event_open).
+// Returns the number of available counters. Returns 0 if no counters are available; the profiler then only measures times.
+int reb_profiling_enable_counters(struct reb_simulation* const r);
+void reb_output_profiling_json(struct reb_simulation* const r, const char* const filename); // Writes the profiler results to a JSON file.
+
 // Compares two simulations, stores difference in buffer.
 void reb_binary_diff(char* buf1, size_t size1, char* buf2, size_t size2, char** bufp, size_t* sizep); 
 // Same as reb_binary_diff, but with options.
@@ -1033,6 +1186,31 @@ enum reb_input_binary_messages {
 struct reb_ode* reb_create_ode(struct reb_simulation* r, unsigned int length);
 void reb_free_ode(struct reb_ode* ode);
 
+// WHFast ensembles
+// An ensemble holds many replicas of a small system (same number of particles, same timestep) and
+// integrates them in lockstep with WHFast. Each replica follows exactly the same sequence of
+// floating point operations as the template simulation with safe_mode=0 and exact_finish_time=0.
+// The template must use Jacobi coordinates, the default kernel, and REB_GRAVITY_BASIC.
+// If reb_tools_megno_init was called on the template, MEGNO is calculated for every replica.
+struct reb_whfast_ensemble;
+enum REB_WHFAST_ENSEMBLE_STATUS {
+    REB_WHFAST_ENSEMBLE_RUNNING = 0,     // Replica is running normally
+    REB_WHFAST_ENSEMBLE_NAN = 1,         // Non-finite coordinates
+    REB_WHFAST_ENSEMBLE_ESCAPE = 2,      // A particle is further away than exit_max_distance
+    REB_WHFAST_ENSEMBLE_ENCOUNTER = 3,   // Two particles are closer than exit_min_distance
+};
+struct reb_whfast_ensemble* reb_create_whfast_ensemble(struct reb_simulation* const r, const int N_replicas); // All replicas start as copies of r. Returns NULL on error.
+void reb_free_whfast_ensemble(struct reb_whfast_ensemble* const e);
+int reb_whfast_ensemble_set_particles(struct reb_whfast_ensemble* const e, const int k, const struct reb_particle* const particles); // Sets the particles of replica k before integrating. Returns 1 on success, 0 otherwise.
+int reb_whfast_ensemble_get_particles(const struct reb_whfast_ensemble* const e, const int k, struct reb_particle* const particles); // Copies the particles of replica k. Returns 1 on success, 0 otherwise.
+void reb_whfast_ensemble_integrate(struct reb_whfast_ensemble* const e, const double tmax);
+double reb_whfast_ensemble_get_t(const struct reb_whfast_ensemble* const e);
+// The following functions fill arrays of size N_replicas. NULL pointers will not be set.
+// Flagged replicas keep being integrated but their MEGNO values are frozen at t_exit.
+void reb_whfast_ensemble_get_status(const struct reb_whfast_ensemble* const e, int* const status, double* const t_exit);
+void reb_whfast_ensemble_get_energy_error(const struct reb_whfast_ensemble* const e, double* const dE);
+void reb_whfast_ensemble_get_megno(const struct reb_whfast_ensemble* const e, double* const megno, double* const lyapunov);
+
 // Miscellaneous functions
 uint32_t reb_hash(const char* str);
 double reb_tools_mod2pi(double f);
@@ -1331,7 +1509,7 @@ struct reb_display_data {
     struct reb_particle_opengl* particle_data;
     struct reb_orbit_opengl* orbit_data;
     struct reb_particle* particles_copy;
-    struct reb_particle* p_jh_copy;
+    double* p_jh_copy;
     unsigned long allocated_N;
     unsigned long allocated_N_whfast;
     unsigned int opengl_enabled;
@@ -39,7 +39,34 @@
 #include "input.h"
 #include "output.h"
 #include "integrator_ias15.h"
+#include "transformations.h"
+#include "integrator_janus.h"
 
+// Reads masses, positions and velocities of all particles in the old (version<2) format.
+// If use_p_jh is set, positions and velocities are stored in the (unsynchronized) 
+// Jacobi/heliocentric coordinates.
+static void reb_simulationarchive_read_posvel_v1(struct reb_simulation* const r, const int use_p_jh, FILE* inf){
+    for(int i=0;i<r->N;i++){
+        double posvel[6];
+        fread(&(r->particles[i].m),sizeof(double),1,inf);
+        fread(posvel,sizeof(double),6,inf);
+        if (use_p_jh){
+            r->ri_whfast.p_jh.x[i]  = posvel[0];
+            r->ri_whfast.p_jh.y[i]  = posvel[1];
+            r->ri_whfast.p_jh.z[i]  = posvel[2];
+            r->ri_whfast.p_jh.vx[i] = posvel[3];
+            r->ri_whfast.p_jh.vy[i] = posvel[4];
+            r->ri_whfast.p_jh.vz[i] = posvel[5];
+        }else{
+            r->particles[i].x  = posvel[0];
+            r->particles[i].y  = posvel[1];
+            r->particles[i].z  = posvel[2];
+            r->particles[i].vx = posvel[3];
+            r->particles[i].vy = posvel[4];
+            r->particles[i].vz = posvel[5];
+        }
+    }
+}
 
 void reb_create_simulation_from_simulationarchive_with_messages(struct reb_simulation* r, struct reb_simulationarchive* sa, long snapshot, enum reb_input_binary_messages* warnings){
     FILE* inf = sa->inf;
@@ -90,13 +117,13 @@ void reb_create_simulation_from_simulationarchive_with_messages(struct reb_simul
             case REB_INTEGRATOR_JANUS:
                 {
                     if (r->ri_janus.allocated_N<(unsigned int)r->N){
-                        if (r->ri_janus.p_int){
-                            free(r->ri_janus.p_int);
-                        }
-                        r->ri_janus.p_int= malloc(sizeof(struct reb_particle)*r->N);
+                        reb_particle_int_soa_realloc(&r->ri_janus.p_int, r->N);
                         r->ri_janus.allocated_N = r->N;
                     }
-                    fread(r->ri_janus.p_int,sizeof(struct reb_particle_int)*r->N,1,inf);
+                    struct reb_particle_int* p_int = malloc(sizeof(struct reb_particle_int)*r->N);
+                    fread(p_int,sizeof(struct reb_particle_int)*r->N,1,inf);
+                    reb_particle_int_soa_from_particles_int(r->ri_janus.p_int, p_int, r->N);
+                    free(p_int);
                     reb_integrator_synchronize(r);  // get floating point coordinates 
                 }
                 break;
@@ -104,66 +131,38 @@ void reb_create_simulation_from_simulationarchive_with_messages(struct reb_simul
             case REB_INTEGRATOR_SABA:
                 {
                     // Recreate Jacobi arrrays
-                    struct reb_particle* ps = r->particles;
                     if (r->ri_whfast.safe_mode==0){
                         // If same mode is off, store unsynchronized Jacobi coordinates
                         if (r->ri_whfast.allocated_N<(unsigned int)r->N){
-                            if (r->ri_whfast.p_jh){
-                                free(r->ri_whfast.p_jh);
-                            }
-                            r->ri_whfast.p_jh= malloc(sizeof(struct reb_particle)*r->N);
+                            reb_particle_soa_realloc(&r->ri_whfast.p_jh, r->N);
                             r->ri_whfast.allocated_N = r->N;
                         }
-                        ps = r->ri_whfast.p_jh;
-                    }
-                    for(int i=0;i<r->N;i++){
-                        fread(&(r->particles[i].m),sizeof(double),1,inf);
-                        fread(&(ps[i].x),sizeof(double),1,inf);
-                        fread(&(ps[i].y),sizeof(double),1,inf);
-                        fread(&(ps[i].z),sizeof(double),1,inf);
-                        fread(&(ps[i].vx),sizeof(double),1,inf);
-                        fread(&(ps[i].vy),sizeof(double),1,inf);
-                        fread(&(ps[i].vz),sizeof(double),1,inf);
                     }
+                    reb_simulationarchive_read_posvel_v1(r, r->ri_whfast.safe_mode==0, inf);
                     if (r->ri_whfast.safe_mode==0){
                         // Assume we are not synchronized
                         r->ri_whfast.is_synchronized=0.;
                         // Recalculate total mass
                         double msum = r->particles[0].m;
                         for (int i=1;i<r->N;i++){
-                            r->ri_whfast.p_jh[i].m = r->particles[i].m;
-                            r->ri_whfast.p_jh[i].r = r->particles[i].r;
+                            r->ri_whfast.p_jh.m[i] = r->particles[i].m;
                             msum += r->particles[i].m;
                         }
-                        r->ri_whfast.p_jh[0].m = msum;
-                        r->ri_whfast.p_jh[0].r = r->particles[0].r;
+                        r->ri_whfast.p_jh.m[0] = msum;
                     }
                 }
                 break;
             case REB_INTEGRATOR_MERCURIUS:
                 {
                     // Recreate heliocentric arrrays
-                    struct reb_particle* ps = r->particles;
                     if (r->ri_mercurius.safe_mode==0){
                         // If same mode is off, store unsynchronized Jacobi coordinates
                         if (r->ri_whfast.allocated_N<(unsigned int)r->N){
-                            if (r->ri_whfast.p_jh){
-                                free(r->ri_whfast.p_jh);
-                            }
-                            r->ri_whfast.p_jh= malloc(sizeof(struct reb_particle)*r->N);
+                            reb_particle_soa_realloc(&r->ri_whfast.p_jh, r->N);
                             r->ri_whfast.allocated_N = r->N;
                         }
-                        ps = r->ri_whfast.p_jh;
-                    }
-                    for(int i=0;i<r->N;i++){
-                        fread(&(r->particles[i].m),sizeof(double),1,inf);
-                        fread(&(ps[i].x),sizeof(double),1,inf);
-                        fread(&(ps[i].y),sizeof(double),1,inf);
-                        fread(&(ps[i].z),sizeof(double),1,inf);
-                        fread(&(ps[i].vx),sizeof(double),1,inf);
-                        fread(&(ps[i].vy),sizeof(double),1,inf);
-                        fread(&(ps[i].vz),sizeof(double),1,inf);
                     }
+                    reb_simulationarchive_read_posvel_v1(r, r->ri_mercurius.safe_mode==0, inf);
                     if (r->ri_mercurius.dcrit){
                         free(r->ri_mercurius.dcrit);
                     }
@@ -176,12 +175,10 @@ void reb_create_simulation_from_simulationarchive_with_messages(struct reb_simul
                         // Recalculate total mass
                         double msum = r->particles[0].m;
                         for (int i=1;i<r->N;i++){
-                            r->ri_whfast.p_jh[i].m = r->particles[i].m;
-                            r->ri_whfast.p_jh[i].r = r->particles[i].r;
+                            r->ri_whfast.p_jh.m[i] = r->particles[i].m;
                             msum += r->particles[i].m;
                         }
-                        r->ri_whfast.p_jh[0].m = msum;
-                        r->ri_whfast.p_jh[0].r = r->particles[0].r;
+                        r->ri_whfast.p_jh.m[0] = msum;
                     }
                 }
                 break;
@@ -559,6 +556,30 @@ void reb_simulationarchive_heartbeat(struct reb_simulation* const r){
         } 
     }
 }
+// Same as above but for writing
+static void reb_simulationarchive_write_posvel_v1(struct reb_simulation* const r, const int use_p_jh, FILE* of){
+    for(int i=0;i<r->N;i++){
+        double posvel[6];
+        if (use_p_jh){
+            posvel[0] = r->ri_whfast.p_jh.x[i];
+            posvel[1] = r->ri_whfast.p_jh.y[i];
+            posvel[2] = r->ri_whfast.p_jh.z[i];
+            posvel[3] = r->ri_whfast.p_jh.vx[i];
+            posvel[4] = r->ri_whfast.p_jh.vy[i];
+            posvel[5] = r->ri_whfast.p_jh.vz[i];
+        }else{
+            posvel[0] = r->particles[i].x;
+            posvel[1] = r->particles[i].y;
+            posvel[2] = r->particles[i].z;
+            posvel[3] = r->particles[i].vx;
+            posvel[4] = r->particles[i].vy;
+            posvel[5] = r->particles[i].vz;
+        }
+        fwrite(&(r->particles[i].m),sizeof(double),1,of);
+        fwrite(posvel,sizeof(double),6,of);
+    }
+}
+
 static inline void reb_save_dp7_old(struct reb_dp7* dp7, const int N3, FILE* of){
     fwrite(dp7->p0,sizeof(double),N3,of);
     fwrite(dp7->p1,sizeof(double),N3,of);
@@ -571,6 +592,7 @@ static inline void reb_save_dp7_old(struct reb_dp7* dp7, const int N3, FILE* of)
 
 void reb_simulationarchive_snapshot(struct reb_simulation* const r, const char* filename){
     if (filename==NULL) filename = r->simulationarchive_filename;
+    const struct reb_profiling_mark profiling_start = reb_profiling_start(r);
     struct stat buffer;
     if (stat(filename, &buffer) < 0){
         // File does not exist. Output binary.
@@ -590,41 +612,20 @@ void reb_simulationarchive_snapshot(struct reb_simulation* const r, const char*
             switch (r->integrator){
                 case REB_INTEGRATOR_JANUS:
                     {
-                        fwrite(r->ri_janus.p_int,sizeof(struct reb_particle_int)*r->N,1,of);
+                        struct reb_particle_int* p_int = malloc(sizeof(struct reb_particle_int)*r->N);
+                        reb_particle_int_soa_to_particles_int(p_int, r->ri_janus.p_int, r->N);
+                        fwrite(p_int,sizeof(struct reb_particle_int)*r->N,1,of);
+                        free(p_int);
                     }
                     break;
                 case REB_INTEGRATOR_WHFAST:
                     {
-                        struct reb_particle* ps = r->particles;
-                        if (r->ri_whfast.safe_mode==0){
-                            ps = r->ri_whfast.p_jh;
-                        }
-                        for(int i=0;i<r->N;i++){
-                            fwrite(&(r->particles[i].m),sizeof(double),1,of);
-                            fwrite(&(ps[i].x),sizeof(double),1,of);
-                            fwrite(&(ps[i].y),sizeof(double),1,of);
-                            fwrite(&(ps[i].z),sizeof(double),1,of);
-                            fwrite(&(ps[i].vx),sizeof(double),1,of);
-                            fwrite(&(ps[i].vy),sizeof(double),1,of);
-                            fwrite(&(ps[i].vz),sizeof(double),1,of);
-                        }
+                        reb_simulationarchive_write_posvel_v1(r, r->ri_whfast.safe_mode==0, of);
                     }
                     break;
                 case REB_INTEGRATOR_MERCURIUS:
                     {
-                        struct reb_particle* ps = r->particles;
-                        if (r->ri_mercurius.safe_mode==0){
-                            ps = r->ri_whfast.p_jh;
-                        }
-                        for(int i=0;i<r->N;i++){
-                            fwrite(&(r->particles[i].m),sizeof(double),1,of);
-                            fwrite(&(ps[i].x),sizeof(double),1,of);
-                            fwrite(&(ps[i].y),sizeof(double),1,of);
-                            fwrite(&(ps[i].z),sizeof(double),1,of);
-                            fwrite(&(ps[i].vx),sizeof(double),1,of);
-                            fwrite(&(ps[i].vy),sizeof(double),1,of);
-                            fwrite(&(ps[i].vz),sizeof(double),1,of);
-                        }
+                        reb_simulationarchive_write_posvel_v1(r, r->ri_mercurius.safe_mode==0, of);
                         fwrite(r->ri_mercurius.dcrit,sizeof(double),r->N,of);
                     }
                     break;
@@ -916,6 +917,7 @@ void reb_simulationarchive_snapshot(struct reb_simulation* const r, const char*
             }
         }
     }
+    reb_profiling_stop(r, REB_PROFILING_CAT_ARCHIVE, profiling_start);
 }
 
 static int _reb_simulationarchive_automate_set_filename(struct reb_simulation* const r, const char* filename){
@@ -25,9 +25,15 @@
  *
  */
 
+#include <stdlib.h>
+#include <string.h>
 #include "transformations.h"
 #include "rebound.h"
 
+// Loops over particles which do not depend on each other use OpenMP if there are many particles.
+// Sums over active particles are serial so that results do not depend on the number of threads.
+#define TRANSFORMATIONS_OPENMP_N_MIN 1000   // Minimum number of particles for which OpenMP is used.
+
 /******************************
  * Jacobi */
 
@@ -59,6 +65,7 @@ void reb_transformations_inertial_to_jacobi_posvel(const struct reb_particle* co
         s_vz = s_vz * pme + p_mass[i].m*p_j[i].vz;
     }
     const double ei = 1./eta;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
     for (unsigned int i=N_active;i<N;i++){
         const struct reb_particle pi = particles[i];
         p_j[i].m = pi.m;
@@ -117,6 +124,7 @@ void reb_transformations_inertial_to_jacobi_posvelacc(const struct reb_particle*
         s_az = s_az * pme + p_mass[i].m*p_j[i].az;
     }
     const double ei = 1./eta;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
     for (unsigned int i=N_active;i<N;i++){
         const struct reb_particle pi = particles[i];
         p_j[i].m = pi.m;
@@ -162,6 +170,7 @@ void reb_transformations_inertial_to_jacobi_acc(const struct reb_particle* const
         s_az = s_az * pme + p_mass[i].m*p_j[i].az;
     }
     const double ei = 1./eta;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
     for (unsigned int i=N_active;i<N;i++){
         const struct reb_particle pi = particles[i];
         p_j[i].ax = pi.ax - s_ax*ei;
@@ -183,15 +192,16 @@ void reb_transformations_jacobi_to_inertial_posvel(struct reb_particle* const pa
     double s_vx = p_j[0].vx * eta;
     double s_vy = p_j[0].vy * eta;
     double s_vz = p_j[0].vz * eta;
-    for (unsigned int i=N-1;i>=N_active;i--){
+    const double etai = 1./eta;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (unsigned int i=N_active;i<N;i++){
         const struct reb_particle pji = p_j[i];
-        const double ei = 1./eta;
-        particles[i].x  = pji.x  + s_x  * ei;
-        particles[i].y  = pji.y  + s_y  * ei;
-        particles[i].z  = pji.z  + s_z  * ei;
-        particles[i].vx = pji.vx + s_vx * ei;
-        particles[i].vy = pji.vy + s_vy * ei;
-        particles[i].vz = pji.vz + s_vz * ei;
+        particles[i].x  = pji.x  + s_x  * etai;
+        particles[i].y  = pji.y  + s_y  * etai;
+        particles[i].z  = pji.z  + s_z  * etai;
+        particles[i].vx = pji.vx + s_vx * etai;
+        particles[i].vy = pji.vy + s_vy * etai;
+        particles[i].vz = pji.vz + s_vz * etai;
     }
     for (unsigned int i=N_active-1;i>0;i--){
         const struct reb_particle pji = p_j[i];
@@ -230,12 +240,13 @@ void reb_transformations_jacobi_to_inertial_pos(struct reb_particle* const parti
     double s_x  = p_j[0].x  * eta;
     double s_y  = p_j[0].y  * eta;
     double s_z  = p_j[0].z  * eta;
-    for (unsigned int i=N-1;i>=N_active;i--){
+    const double etai = 1./eta;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (unsigned int i=N_active;i<N;i++){
         const struct reb_particle pji = p_j[i];
-        const double ei = 1./eta;
-        particles[i].x  = pji.x  + s_x*ei ;
-        particles[i].y  = pji.y  + s_y*ei ;
-        particles[i].z  = pji.z  + s_z*ei ;
+        particles[i].x  = pji.x  + s_x*etai ;
+        particles[i].y  = pji.y  + s_y*etai ;
+        particles[i].z  = pji.z  + s_z*etai ;
     }
     for (unsigned int i=N_active-1;i>0;i--){
         const struct reb_particle pji = p_j[i];
@@ -262,12 +273,13 @@ void reb_transformations_jacobi_to_inertial_acc(struct reb_particle* const parti
     double s_ax  = p_j[0].ax  * eta;
     double s_ay  = p_j[0].ay  * eta;
     double s_az  = p_j[0].az  * eta;
-    for (unsigned int i=N-1;i>=N_active;i--){
+    const double etai = 1./eta;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (unsigned int i=N_active;i<N;i++){
         const struct reb_particle pji = p_j[i];
-        const double ei = 1./eta;
-        particles[i].ax  = pji.ax  + s_ax * ei;
-        particles[i].ay  = pji.ay  + s_ay * ei;
-        particles[i].az  = pji.az  + s_az * ei;
+        particles[i].ax  = pji.ax  + s_ax * etai;
+        particles[i].ay  = pji.ay  + s_ay * etai;
+        particles[i].az  = pji.az  + s_az * etai;
     }
     for (unsigned int i=N_active-1;i>0;i--){
         const struct reb_particle pji = p_j[i];
@@ -300,7 +312,6 @@ void reb_transformations_inertial_to_whds_posvel(const struct reb_particle* cons
     double vy0 = 0.;
     double vz0 = 0.;
     double m0  = 0.;
-#pragma omp parallel for reduction(+:x0) reduction(+:y0) reduction(+:z0) reduction(+:vx0) reduction(+:vy0) reduction(+:vz0) reduction(+:m0)
     for (unsigned int i=0;i<N_active;i++){
         double m = particles[i].m;
         x0  += particles[i].x *m;
@@ -320,7 +331,7 @@ void reb_transformations_inertial_to_whds_posvel(const struct reb_particle* cons
     p_h[0].m = m0;
     
     m0 = particles[0].m;
-#pragma omp parallel for
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
     for (unsigned int i=1;i<N_active;i++){
         p_h[i].x  = particles[i].x  - particles[0].x ;
         p_h[i].y  = particles[i].y  - particles[0].y ;
@@ -332,7 +343,7 @@ void reb_transformations_inertial_to_whds_posvel(const struct reb_particle* cons
         p_h[i].vz = mf*(particles[i].vz - p_h[0].vz);
         p_h[i].m  = mi;
     }
-#pragma omp parallel for
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
     for (unsigned int i=N_active;i<N;i++){
         p_h[i].x  = particles[i].x  - particles[0].x ;
         p_h[i].y  = particles[i].y  - particles[0].y ;
@@ -352,7 +363,7 @@ void reb_transformations_whds_to_inertial_pos(struct reb_particle* const particl
 void reb_transformations_whds_to_inertial_posvel(struct reb_particle* const particles, const struct reb_particle* const p_h, const unsigned int N, const int N_active){
     reb_transformations_whds_to_inertial_pos(particles,p_h,N, N_active);
     const double m0 = particles[0].m;
-#pragma omp parallel for
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
     for (unsigned int i=1;i<N_active;i++){
         const double mi = particles[i].m;
         double mf = (m0+mi) / m0;
@@ -360,7 +371,7 @@ void reb_transformations_whds_to_inertial_posvel(struct reb_particle* const part
         particles[i].vy = p_h[i].vy/mf+p_h[0].vy;
         particles[i].vz = p_h[i].vz/mf+p_h[0].vz;
     }
-#pragma omp parallel for
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
     for (unsigned int i=N_active;i<N;i++){
         particles[i].vx = p_h[i].vx+p_h[0].vx;
         particles[i].vy = p_h[i].vy+p_h[0].vy;
@@ -369,7 +380,6 @@ void reb_transformations_whds_to_inertial_posvel(struct reb_particle* const part
     double vx0  = 0.;
     double vy0  = 0.;
     double vz0  = 0.;
-#pragma omp parallel for reduction(+:vx0) reduction(+:vy0) reduction(+:vz0) 
     for (int i=1;i<N_active;i++){
         double m = particles[i].m;
         vx0 += p_h[i].vx*m/(m0+m);
@@ -393,7 +403,6 @@ void reb_transformations_inertial_to_democraticheliocentric_posvel(const struct
     double vy0 = 0.;
     double vz0 = 0.;
     double m0  = 0.;
-#pragma omp parallel for reduction(+:x0) reduction(+:y0) reduction(+:z0) reduction(+:vx0) reduction(+:vy0) reduction(+:vz0) reduction(+:m0)
     for (int i=0;i<N_active;i++){
         double m = particles[i].m;
         x0  += particles[i].x *m;
@@ -412,7 +421,7 @@ void reb_transformations_inertial_to_democraticheliocentric_posvel(const struct
     p_h[0].vz = vz0/m0;
     p_h[0].m = m0;
     
-#pragma omp parallel for 
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
     for (unsigned int i=1;i<N;i++){
         p_h[i].x  = particles[i].x  - particles[0].x ;
         p_h[i].y  = particles[i].y  - particles[0].y ;
@@ -429,7 +438,6 @@ void reb_transformations_democraticheliocentric_to_inertial_pos(struct reb_parti
     double x0  = 0.;
     double y0  = 0.;
     double z0  = 0.;
-#pragma omp parallel for reduction(+:x0) reduction(+:y0) reduction(+:z0) 
     for (int i=1;i<N_active;i++){
         double m = p_h[i].m;
         x0 += p_h[i].x*m/mtot;
@@ -440,7 +448,7 @@ void reb_transformations_democraticheliocentric_to_inertial_pos(struct reb_parti
     particles[0].x  = p_h[0].x - x0;
     particles[0].y  = p_h[0].y - y0;
     particles[0].z  = p_h[0].z - z0;
-#pragma omp parallel for 
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
     for (unsigned int i=1;i<N;i++){
         particles[i].x = p_h[i].x+particles[0].x;
         particles[i].y = p_h[i].y+particles[0].y;
@@ -451,7 +459,7 @@ void reb_transformations_democraticheliocentric_to_inertial_pos(struct reb_parti
 void reb_transformations_democraticheliocentric_to_inertial_posvel(struct reb_particle* const particles, const struct reb_particle* const p_h, const unsigned int N, const int N_active){
     reb_transformations_democraticheliocentric_to_inertial_pos(particles,p_h,N,N_active);
     const double m0 = particles[0].m;
-#pragma omp parallel for 
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
     for (unsigned int i=1;i<N;i++){
         particles[i].vx = p_h[i].vx+p_h[0].vx;
         particles[i].vy = p_h[i].vy+p_h[0].vy;
@@ -460,7 +468,6 @@ void reb_transformations_democraticheliocentric_to_inertial_posvel(struct reb_pa
     double vx0  = 0.;
     double vy0  = 0.;
     double vz0  = 0.;
-#pragma omp parallel for reduction(+:vx0) reduction(+:vy0) reduction(+:vz0) 
     for (int i=1;i<N_active;i++){
         double m = particles[i].m;
         vx0 += p_h[i].vx*m/m0;
@@ -472,3 +479,408 @@ void reb_transformations_democraticheliocentric_to_inertial_posvel(struct reb_pa
     particles[0].vz = p_h[0].vz -vz0;
 }
 
+/******************************
+ * Structure of arrays.       *
+ * The functions below are    *
+ * the same as above, but the *
+ * Jacobi/heliocentric/WHDS   *
+ * coordinates are stored as  *
+ * a structure of arrays.     */
+
+struct reb_particle_soa reb_particle_soa_from_data(double* const data, const unsigned int N){
+    struct reb_particle_soa p;
+    p.x  = data;
+    p.y  = data+N;
+    p.z  = data+2*N;
+    p.vx = data+3*N;
+    p.vy = data+4*N;
+    p.vz = data+5*N;
+    p.ax = data+6*N;
+    p.ay = data+7*N;
+    p.az = data+8*N;
+    p.m  = data+9*N;
+    return p;
+}
+
+void reb_particle_soa_realloc(struct reb_particle_soa* const p, const unsigned int N){
+    double* data = realloc(p->x, sizeof(double)*REB_PARTICLE_SOA_FIELDS*N);
+    *p = reb_particle_soa_from_data(data, N);
+}
+
+void reb_particle_soa_free(struct reb_particle_soa* const p){
+    free(p->x);
+    memset(p, 0, sizeof(struct reb_particle_soa));
+}
+
+struct reb_particle_soa reb_particle_soa_offset(const struct reb_particle_soa p, const unsigned int i){
+    struct reb_particle_soa pi;
+    pi.x  = p.x+i;
+    pi.y  = p.y+i;
+    pi.z  = p.z+i;
+    pi.vx = p.vx+i;
+    pi.vy = p.vy+i;
+    pi.vz = p.vz+i;
+    pi.ax = p.ax+i;
+    pi.ay = p.ay+i;
+    pi.az = p.az+i;
+    pi.m  = p.m+i;
+    return pi;
+}
+
+void reb_particle_soa_to_particles(struct reb_particle* const particles, const struct reb_particle_soa p, const unsigned int N){
+    for (unsigned int i=0;i<N;i++){
+        particles[i].x  = p.x[i];
+        particles[i].y  = p.y[i];
+        particles[i].z  = p.z[i];
+        particles[i].vx = p.vx[i];
+        particles[i].vy = p.vy[i];
+        particles[i].vz = p.vz[i];
+        particles[i].ax = p.ax[i];
+        particles[i].ay = p.ay[i];
+        particles[i].az = p.az[i];
+        particles[i].m  = p.m[i];
+    }
+}
+
+void reb_particle_soa_from_particles(const struct reb_particle_soa p, const struct reb_particle* const particles, const unsigned int N){
+    for (unsigned int i=0;i<N;i++){
+        p.x[i]  = particles[i].x;
+        p.y[i]  = particles[i].y;
+        p.z[i]  = particles[i].z;
+        p.vx[i] = particles[i].vx;
+        p.vy[i] = particles[i].vy;
+        p.vz[i] = particles[i].vz;
+        p.ax[i] = particles[i].ax;
+        p.ay[i] = particles[i].ay;
+        p.az[i] = particles[i].az;
+        p.m[i]  = particles[i].m;
+    }
+}
+
+void reb_transformations_inertial_to_jacobi_posvel_soa(const struct reb_particle* const particles, const struct reb_particle_soa p_j, const struct reb_particle* const p_mass, const unsigned int N, const int N_active){
+    double eta = p_mass[0].m;
+    double s_x = eta * particles[0].x;
+    double s_y = eta * particles[0].y;
+    double s_z = eta * particles[0].z;
+    double s_vx = eta * particles[0].vx;
+    double s_vy = eta * particles[0].vy;
+    double s_vz = eta * particles[0].vz;
+    for (int i=1;i<N_active;i++){
+        const double ei = 1./eta;
+        const struct reb_particle pi = particles[i];
+        eta += p_mass[i].m;
+        const double pme = eta*ei;
+        p_j.m[i] = pi.m;
+        p_j.x[i] = pi.x - s_x*ei;
+        p_j.y[i] = pi.y - s_y*ei;
+        p_j.z[i] = pi.z - s_z*ei;
+        p_j.vx[i] = pi.vx - s_vx*ei;
+        p_j.vy[i] = pi.vy - s_vy*ei;
+        p_j.vz[i] = pi.vz - s_vz*ei;
+        s_x  = s_x  * pme + p_mass[i].m*p_j.x[i] ;
+        s_y  = s_y  * pme + p_mass[i].m*p_j.y[i] ;
+        s_z  = s_z  * pme + p_mass[i].m*p_j.z[i] ;
+        s_vx = s_vx * pme + p_mass[i].m*p_j.vx[i];
+        s_vy = s_vy * pme + p_mass[i].m*p_j.vy[i];
+        s_vz = s_vz * pme + p_mass[i].m*p_j.vz[i];
+    }
+    const double ei = 1./eta;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (unsigned int i=N_active;i<N;i++){
+        const struct reb_particle pi = particles[i];
+        p_j.m[i] = pi.m;
+        p_j.x[i] = pi.x - s_x*ei;
+        p_j.y[i] = pi.y - s_y*ei;
+        p_j.z[i] = pi.z - s_z*ei;
+        p_j.vx[i] = pi.vx - s_vx*ei;
+        p_j.vy[i] = pi.vy - s_vy*ei;
+        p_j.vz[i] = pi.vz - s_vz*ei;
+    }
+    const double Mtotal  = eta;
+    const double Mtotali = 1./Mtotal;
+    p_j.m[0] = Mtotal;
+    p_j.x[0] = s_x * Mtotali;
+    p_j.y[0] = s_y * Mtotali;
+    p_j.z[0] = s_z * Mtotali;
+    p_j.vx[0] = s_vx * Mtotali;
+    p_j.vy[0] = s_vy * Mtotali;
+    p_j.vz[0] = s_vz * Mtotali;
+}
+
+void reb_transformations_inertial_to_jacobi_acc_soa(const struct reb_particle* const particles, const struct reb_particle_soa p_j, const struct reb_particle* const p_mass, const unsigned int N, const int N_active){
+    double eta = p_mass[0].m;
+    double s_ax = eta * particles[0].ax;
+    double s_ay = eta * particles[0].ay;
+    double s_az = eta * particles[0].az;
+    for (int i=1;i<N_active;i++){
+        const double ei = 1./eta;
+        const struct reb_particle pi = particles[i];
+        eta += p_mass[i].m;
+        const double pme = eta*ei;
+        p_j.ax[i] = pi.ax - s_ax*ei;
+        p_j.ay[i] = pi.ay - s_ay*ei;
+        p_j.az[i] = pi.az - s_az*ei;
+        s_ax = s_ax * pme + p_mass[i].m*p_j.ax[i];
+        s_ay = s_ay * pme + p_mass[i].m*p_j.ay[i];
+        s_az = s_az * pme + p_mass[i].m*p_j.az[i];
+    }
+    const double ei = 1./eta;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (unsigned int i=N_active;i<N;i++){
+        p_j.ax[i] = particles[i].ax - s_ax*ei;
+        p_j.ay[i] = particles[i].ay - s_ay*ei;
+        p_j.az[i] = particles[i].az - s_az*ei;
+    }
+    const double Mtotal  = eta;
+    const double Mtotali = 1./Mtotal;
+    p_j.ax[0] = s_ax * Mtotali;
+    p_j.ay[0] = s_ay * Mtotali;
+    p_j.az[0] = s_az * Mtotali;
+}
+
+void reb_transformations_jacobi_to_inertial_posvel_soa(struct reb_particle* const particles, const struct reb_particle_soa p_j, const struct reb_particle* const p_mass, const unsigned int N, const int N_active){
+    double eta  = p_j.m[0];
+    double s_x  = p_j.x[0]  * eta;
+    double s_y  = p_j.y[0]  * eta;
+    double s_z  = p_j.z[0]  * eta;
+    double s_vx = p_j.vx[0] * eta;
+    double s_vy = p_j.vy[0] * eta;
+    double s_vz = p_j.vz[0] * eta;
+    const double etai = 1./eta;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (unsigned int i=N_active;i<N;i++){
+        particles[i].x  = p_j.x[i]  + s_x  * etai;
+        particles[i].y  = p_j.y[i]  + s_y  * etai;
+        particles[i].z  = p_j.z[i]  + s_z  * etai;
+        particles[i].vx = p_j.vx[i] + s_vx * etai;
+        particles[i].vy = p_j.vy[i] + s_vy * etai;
+        particles[i].vz = p_j.vz[i] + s_vz * etai;
+    }
+    for (unsigned int i=N_active-1;i>0;i--){
+        const double ei = 1./eta;
+        s_x  = (s_x  - p_mass[i].m * p_j.x[i] ) * ei;
+        s_y  = (s_y  - p_mass[i].m * p_j.y[i] ) * ei;
+        s_z  = (s_z  - p_mass[i].m * p_j.z[i] ) * ei;
+        s_vx = (s_vx - p_mass[i].m * p_j.vx[i]) * ei;
+        s_vy = (s_vy - p_mass[i].m * p_j.vy[i]) * ei;
+        s_vz = (s_vz - p_mass[i].m * p_j.vz[i]) * ei;
+        particles[i].x  = p_j.x[i]  + s_x ;
+        particles[i].y  = p_j.y[i]  + s_y ;
+        particles[i].z  = p_j.z[i]  + s_z ;
+        particles[i].vx = p_j.vx[i] + s_vx;
+        particles[i].vy = p_j.vy[i] + s_vy;
+        particles[i].vz = p_j.vz[i] + s_vz;
+        eta -= p_mass[i].m;
+        s_x  *= eta;
+        s_y  *= eta;
+        s_z  *= eta;
+        s_vx *= eta;
+        s_vy *= eta;
+        s_vz *= eta;
+    }
+    const double mi = 1./eta;
+    particles[0].x  = s_x  * mi;
+    particles[0].y  = s_y  * mi;
+    particles[0].z  = s_z  * mi;
+    particles[0].vx = s_vx * mi;
+    particles[0].vy = s_vy * mi;
+    particles[0].vz = s_vz * mi;
+}
+
+void reb_transformations_jacobi_to_inertial_pos_soa(struct reb_particle* const particles, const struct reb_particle_soa p_j, const struct reb_particle* const p_mass, const unsigned int N, const int N_active){
+    double eta  = p_j.m[0];
+    double s_x  = p_j.x[0]  * eta;
+    double s_y  = p_j.y[0]  * eta;
+    double s_z  = p_j.z[0]  * eta;
+    const double etai = 1./eta;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (unsigned int i=N_active;i<N;i++){
+        particles[i].x  = p_j.x[i]  + s_x*etai ;
+        particles[i].y  = p_j.y[i]  + s_y*etai ;
+        particles[i].z  = p_j.z[i]  + s_z*etai ;
+    }
+    for (unsigned int i=N_active-1;i>0;i--){
+        const double ei = 1./eta;
+        s_x  = (s_x  - p_mass[i].m * p_j.x[i] ) * ei;
+        s_y  = (s_y  - p_mass[i].m * p_j.y[i] ) * ei;
+        s_z  = (s_z  - p_mass[i].m * p_j.z[i] ) * ei;
+        particles[i].x  = p_j.x[i]  + s_x ;
+        particles[i].y  = p_j.y[i]  + s_y ;
+        particles[i].z  = p_j.z[i]  + s_z ;
+        eta -= p_mass[i].m;
+        s_x  *= eta;
+        s_y  *= eta;
+        s_z  *= eta;
+    }
+    const double mi = 1./eta;
+    particles[0].x  = s_x  * mi;
+    particles[0].y  = s_y  * mi;
+    particles[0].z  = s_z  * mi;
+}
+
+void reb_transformations_inertial_to_whds_posvel_soa(const struct reb_particle* const particles, const struct reb_particle_soa p_h, const unsigned int N, const int N_active){
+    double x0  = 0.;
+    double y0  = 0.;
+    double z0  = 0.;
+    double vx0 = 0.;
+    double vy0 = 0.;
+    double vz0 = 0.;
+    double m0  = 0.;
+    for (int i=0;i<N_active;i++){
+        double m = particles[i].m;
+        x0  += particles[i].x *m;
+        y0  += particles[i].y *m;
+        z0  += particles[i].z *m;
+        vx0 += particles[i].vx*m;
+        vy0 += particles[i].vy*m;
+        vz0 += particles[i].vz*m;
+        m0  += m;
+    }
+    p_h.x[0]  = x0/m0;
+    p_h.y[0]  = y0/m0;
+    p_h.z[0]  = z0/m0;
+    p_h.vx[0] = vx0/m0;
+    p_h.vy[0] = vy0/m0;
+    p_h.vz[0] = vz0/m0;
+    p_h.m[0] = m0;
+    
+    m0 = particles[0].m;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (int i=1;i<N_active;i++){
+        p_h.x[i]  = particles[i].x  - particles[0].x ;
+        p_h.y[i]  = particles[i].y  - particles[0].y ;
+        p_h.z[i]  = particles[i].z  - particles[0].z ;
+        const double mi = particles[i].m;
+        double mf = (m0+mi) / m0;
+        p_h.vx[i] = mf*(particles[i].vx - p_h.vx[0]);
+        p_h.vy[i] = mf*(particles[i].vy - p_h.vy[0]);
+        p_h.vz[i] = mf*(particles[i].vz - p_h.vz[0]);
+        p_h.m[i]  = mi;
+    }
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (unsigned int i=N_active;i<N;i++){
+        p_h.x[i]  = particles[i].x  - particles[0].x ;
+        p_h.y[i]  = particles[i].y  - particles[0].y ;
+        p_h.z[i]  = particles[i].z  - particles[0].z ;
+        p_h.vx[i] = particles[i].vx - p_h.vx[0];
+        p_h.vy[i] = particles[i].vy - p_h.vy[0];
+        p_h.vz[i] = particles[i].vz - p_h.vz[0];
+        p_h.m[i]  = particles[i].m;
+    }
+}
+
+void reb_transformations_whds_to_inertial_posvel_soa(struct reb_particle* const particles, const struct reb_particle_soa p_h, const unsigned int N, const int N_active){
+    // Positions same as in heliocentric case.
+    reb_transformations_democraticheliocentric_to_inertial_pos_soa(particles,p_h,N, N_active);
+    const double m0 = particles[0].m;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (int i=1;i<N_active;i++){
+        const double mi = particles[i].m;
+        double mf = (m0+mi) / m0;
+        particles[i].vx = p_h.vx[i]/mf+p_h.vx[0];
+        particles[i].vy = p_h.vy[i]/mf+p_h.vy[0];
+        particles[i].vz = p_h.vz[i]/mf+p_h.vz[0];
+    }
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (unsigned int i=N_active;i<N;i++){
+        particles[i].vx = p_h.vx[i]+p_h.vx[0];
+        particles[i].vy = p_h.vy[i]+p_h.vy[0];
+        particles[i].vz = p_h.vz[i]+p_h.vz[0];
+    }
+    double vx0  = 0.;
+    double vy0  = 0.;
+    double vz0  = 0.;
+    for (int i=1;i<N_active;i++){
+        double m = particles[i].m;
+        vx0 += p_h.vx[i]*m/(m0+m);
+        vy0 += p_h.vy[i]*m/(m0+m);
+        vz0 += p_h.vz[i]*m/(m0+m);
+    }
+    particles[0].vx = p_h.vx[0] -vx0;
+    particles[0].vy = p_h.vy[0] -vy0;
+    particles[0].vz = p_h.vz[0] -vz0;
+}
+
+void reb_transformations_inertial_to_democraticheliocentric_posvel_soa(const struct reb_particle* const particles, const struct reb_particle_soa p_h, const unsigned int N, const int N_active){
+    double x0  = 0.;
+    double y0  = 0.;
+    double z0  = 0.;
+    double vx0 = 0.;
+    double vy0 = 0.;
+    double vz0 = 0.;
+    double m0  = 0.;
+    for (int i=0;i<N_active;i++){
+        double m = particles[i].m;
+        x0  += particles[i].x *m;
+        y0  += particles[i].y *m;
+        z0  += particles[i].z *m;
+        vx0 += particles[i].vx*m;
+        vy0 += particles[i].vy*m;
+        vz0 += particles[i].vz*m;
+        m0  += m;
+    }
+    p_h.x[0]  = x0/m0;
+    p_h.y[0]  = y0/m0;
+    p_h.z[0]  = z0/m0;
+    p_h.vx[0] = vx0/m0;
+    p_h.vy[0] = vy0/m0;
+    p_h.vz[0] = vz0/m0;
+    p_h.m[0] = m0;
+    
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (unsigned int i=1;i<N;i++){
+        p_h.x[i]  = particles[i].x  - particles[0].x ;
+        p_h.y[i]  = particles[i].y  - particles[0].y ;
+        p_h.z[i]  = particles[i].z  - particles[0].z ;
+        p_h.vx[i] = particles[i].vx - p_h.vx[0];
+        p_h.vy[i] = particles[i].vy - p_h.vy[0];
+        p_h.vz[i] = particles[i].vz - p_h.vz[0];
+        p_h.m[i]  = particles[i].m;
+    }
+}
+
+void reb_transformations_democraticheliocentric_to_inertial_pos_soa(struct reb_particle* const particles, const struct reb_particle_soa p_h, const unsigned int N, const int N_active){
+    const double mtot = p_h.m[0];
+    double x0  = 0.;
+    double y0  = 0.;
+    double z0  = 0.;
+    for (int i=1;i<N_active;i++){
+        double m = p_h.m[i];
+        x0 += p_h.x[i]*m/mtot;
+        y0 += p_h.y[i]*m/mtot;
+        z0 += p_h.z[i]*m/mtot;
+        particles[i].m = m; // in case of merger/mass change
+    }
+    particles[0].x  = p_h.x[0] - x0;
+    particles[0].y  = p_h.y[0] - y0;
+    particles[0].z  = p_h.z[0] - z0;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (unsigned int i=1;i<N;i++){
+        particles[i].x = p_h.x[i]+particles[0].x;
+        particles[i].y = p_h.y[i]+particles[0].y;
+        particles[i].z = p_h.z[i]+particles[0].z;
+    }
+}
+
+void reb_transformations_democraticheliocentric_to_inertial_posvel_soa(struct reb_particle* const particles, const struct reb_particle_soa p_h, const unsigned int N, const int N_active){
+    reb_transformations_democraticheliocentric_to_inertial_pos_soa(particles,p_h,N,N_active);
+    const double m0 = particles[0].m;
+#pragma omp parallel for if(N>=TRANSFORMATIONS_OPENMP_N_MIN)
+    for (unsigned int i=1;i<N;i++){
+        particles[i].vx = p_h.vx[i]+p_h.vx[0];
+        particles[i].vy = p_h.vy[i]+p_h.vy[0];
+        particles[i].vz = p_h.vz[i]+p_h.vz[0];
+    }
+    double vx0  = 0.;
+    double vy0  = 0.;
+    double vz0  = 0.;
+    for (int i=1;i<N_active;i++){
+        double m = particles[i].m;
+        vx0 += p_h.vx[i]*m/m0;
+        vy0 += p_h.vy[i]*m/m0;
+        vz0 += p_h.vz[i]*m/m0;
+    }
+    particles[0].vx = p_h.vx[0] -vx0;
+    particles[0].vy = p_h.vy[0] -vy0;
+    particles[0].vz = p_h.vz[0] -vz0;
+}
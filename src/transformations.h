@@ -26,4 +26,26 @@
 #ifndef _TRANFORMATIONS_H
 #define _TRANFORMATIONS_H
 
+#include "rebound.h"
+
+// Structure of arrays (used internally by WHFast and SABA)
+#define REB_PARTICLE_SOA_FIELDS 10  ///< Number of arrays in struct reb_particle_soa
+void reb_particle_soa_realloc(struct reb_particle_soa* const p, const unsigned int N);  ///< Internal function (Reallocates all arrays for N particles)
+void reb_particle_soa_free(struct reb_particle_soa* const p);   ///< Internal function (Frees all arrays)
+struct reb_particle_soa reb_particle_soa_from_data(double* const data, const unsigned int N); ///< Internal function (Arrays for N particles stored in data, REB_PARTICLE_SOA_FIELDS*N doubles)
+struct reb_particle_soa reb_particle_soa_offset(const struct reb_particle_soa p, const unsigned int i);   ///< Internal function (Arrays starting at particle i)
+void reb_particle_soa_to_particles(struct reb_particle* const particles, const struct reb_particle_soa p, const unsigned int N);   ///< Internal function (Copies coordinates and masses into a particle array)
+void reb_particle_soa_from_particles(const struct reb_particle_soa p, const struct reb_particle* const particles, const unsigned int N);   ///< Internal function (Copies coordinates and masses from a particle array)
+
+// Same as the functions in rebound.h but with the Jacobi/heliocentric/WHDS coordinates stored as a structure of arrays.
+void reb_transformations_inertial_to_jacobi_posvel_soa(const struct reb_particle* const particles, const struct reb_particle_soa p_j, const struct reb_particle* const p_mass, const unsigned int N, const int N_active);
+void reb_transformations_inertial_to_jacobi_acc_soa(const struct reb_particle* const particles, const struct reb_particle_soa p_j, const struct reb_particle* const p_mass, const unsigned int N, const int N_active);
+void reb_transformations_jacobi_to_inertial_posvel_soa(struct reb_particle* const particles, const struct reb_particle_soa p_j, const struct reb_particle* const p_mass, const unsigned int N, const int N_active);
+void reb_transformations_jacobi_to_inertial_pos_soa(struct reb_particle* const particles, const struct reb_particle_soa p_j, const struct reb_particle* const p_mass, const unsigned int N, const int N_active);
+void reb_transformations_inertial_to_democraticheliocentric_posvel_soa(const struct reb_particle* const particles, const struct reb_particle_soa p_h, const unsigned int N, const int N_active);
+void reb_transformations_democraticheliocentric_to_inertial_pos_soa(struct reb_particle* const particles, const struct reb_particle_soa p_h, const unsigned int N, const int N_active);
+void reb_transformations_democraticheliocentric_to_inertial_posvel_soa(struct reb_particle* const particles, const struct reb_particle_soa p_h, const unsigned int N, const int N_active);
+void reb_transformations_inertial_to_whds_posvel_soa(const struct reb_particle* const particles, const struct reb_particle_soa p_h, const unsigned int N, const int N_active);
+void reb_transformations_whds_to_inertial_posvel_soa(struct reb_particle* const particles, const struct reb_particle_soa p_h, const unsigned int N, const int N_active);
+
 #endif
\ No newline at end of file
@@ -31,6 +31,7 @@
 #include "particle.h"
 #include "rebound.h"
 #include "boundary.h"
+#include "output.h"
 #include "tree.h"
 #ifdef MPI
 #include "communication_mpi.h"
@@ -273,6 +274,7 @@ static void reb_tree_update_gravity_data_in_cell(const struct reb_simulation* co
 }
 
 void reb_tree_update_gravity_data(struct reb_simulation* const r){
+	const struct reb_profiling_mark profiling_start = reb_profiling_start(r);
 	for(int i=0;i<r->root_n;i++){
 #ifdef MPI
 		if (reb_communication_mpi_rootbox_is_local(r, i)==1){
@@ -284,9 +286,11 @@ void reb_tree_update_gravity_data(struct reb_simulation* const r){
 		}
 #endif // MPI
 	}
+	reb_profiling_stop(r, REB_PROFILING_CAT_TREE_MOMENTS, profiling_start);
 }
 
 void reb_tree_update(struct reb_simulation* const r){
+	const struct reb_profiling_mark profiling_start = reb_profiling_start(r);
 	if (r->tree_root==NULL){
 		r->tree_root = calloc(r->root_nx*r->root_ny*r->root_nz,sizeof(struct reb_treecell*));
 	}
@@ -301,6 +305,7 @@ void reb_tree_update(struct reb_simulation* const r){
 #endif // MPI
 	}
     r->tree_needs_update= 0;
+    reb_profiling_stop(r, REB_PROFILING_CAT_TREE_UPDATE, profiling_start);
 }
 static void reb_tree_delete_cell(struct reb_treecell* node){
 	if (node==NULL){